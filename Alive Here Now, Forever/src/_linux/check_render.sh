@@ -0,0 +1,91 @@
+#!/bin/sh
+# Checks oidos_render.cpp against main_reference.cpp, the literal port of oidos.asm, on the
+# music of each intro which uses Oidos. Both are built, and each music.asm is rendered by the
+# reference, by render() and by a Stream. The check fails if a sample of render()'s output
+# differs from the reference by more than the tolerance, if one of the stream's differs by more
+# than the stream tolerance, or if the reference differs from its checksum in
+# reference_checksums.txt.
+#
+# The stream differs from the reference by the reverb state which oidos.asm carries from the end
+# of the music in one delay line to the next, so it only matches where the music ends quietly.
+#
+# By default each tone is cut to 6000 samples, which takes a minute or two, and the music
+# keeps its length, so that it still ends in silence. With -full the whole music is rendered,
+# which takes much longer, and there are no checksums to check the reference against.
+#
+# The checksums are of the output on x86-64 with glibc. Other C libraries may round the long
+# double functions which set up the partials differently.
+#
+# sh check_render.sh [-full] [-tolerance t] [-stream-tolerance t] [-threads n]
+
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+root="$here/../../.."
+
+full=0
+tolerance=0
+stream_tolerance=1
+threads=0
+
+while [ $# -gt 0 ]; do
+   case "$1" in
+      -full) full=1 ;;
+      -tolerance) tolerance="$2"; shift ;;
+      -stream-tolerance) stream_tolerance="$2"; shift ;;
+      -threads) threads="$2"; shift ;;
+      *) echo "usage: $0 [-full] [-tolerance t] [-stream-tolerance t] [-threads n]" >&2; exit 2 ;;
+   esac
+   shift
+done
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+CXX=${CXX:-g++}
+"$CXX" -O3 -ffp-contract=off -pthread "$here/main_render.cpp" "$here/../oidos_render.cpp" -o "$work/oidos_render"
+"$CXX" -O2 -ffp-contract=off -pthread "$here/main_reference.cpp" "$here/../oidos_render.cpp" -o "$work/oidos_reference"
+
+# name, music.asm
+set -- \
+   alive "$root/Alive Here Now, Forever/src/music.asm" \
+   dropletia "$root/Dropletia/src/animesuru2-sf_3/music.asm" \
+   seas "$root/From The Seas To The Stars/src/music_fish/music.asm"
+
+failed=0
+
+while [ $# -gt 0 ]; do
+   name="$1"
+   music="$2"
+   shift 2
+
+   echo "$name:"
+
+   if [ $full = 1 ]; then
+      cp "$music" "$work/$name.asm"
+   else
+      # the p_maxsamples dword of each line of _InstrumentParams
+      tr -d '\r' < "$music" | awk '
+         /^_InstrumentParams:/ { params = 1 }
+         /^_InstrumentTones:/ { params = 0 }
+         params && $1 == "dd" { n = split($0, f, ","); f[17] = 6000; line = f[1]; for(i = 2; i <= n; ++i) line = line "," f[i]; print line; next }
+         { print }' > "$work/$name.asm"
+   fi
+
+   "$work/oidos_reference" "$work/$name.asm" "$work/$name.raw"
+
+   if [ $full = 0 ] && ! (cd "$work" && grep " $name.raw\$" "$here/reference_checksums.txt" | md5sum -c --quiet -); then
+      echo "FAILED: the reference differs from its checksum"
+      failed=1
+   fi
+
+   "$work/oidos_render" "$work/$name.asm" -threads "$threads" -compare "$work/$name.raw" -tolerance "$tolerance" || failed=1
+   "$work/oidos_render" "$work/$name.asm" -threads "$threads" -stream 0 -compare "$work/$name.raw" -tolerance "$stream_tolerance" || failed=1
+done
+
+if [ $failed != 0 ]; then
+   echo "FAILED"
+   exit 1
+fi
+
+echo "all passed"
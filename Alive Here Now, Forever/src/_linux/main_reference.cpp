@@ -0,0 +1,401 @@
+// A literal single-threaded port of Oidos_GenerateMusic from oidos.asm, which check_render.sh
+// compares the output of oidos_render.cpp with. It keeps the buffers, pointers and loops of
+// oidos.asm, and does each operation in the precision of the instruction it replaces: the x87
+// code in long double and the SSE2 code in double. It writes the music as raw 16 bit stereo
+// samples, as in Oidos_MusicBuffer.
+//
+// g++ -O2 -ffp-contract=off main_reference.cpp ../oidos_render.cpp -pthread -o oidos_reference
+// oidos_reference music.asm out.raw
+
+#include "../oidos_render.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace oidos;
+
+static const long double base_freq = 0.00232970791933f;
+static const int delay_buffer_size = 25600;
+
+// the dwords of the params struc in oidos.asm
+enum
+{
+   p_modes, p_fat, p_seed, p_overtones, p_decaydiff, p_decaylow, p_harmonicity, p_sharpness,
+   p_width, p_filterlow, p_filterhigh, p_fslopelow, p_fslopehigh, p_fsweeplow, p_fsweephigh,
+   p_gain, p_maxsamples, p_release, p_attack, p_volume, p_panning
+};
+
+static std::vector<unsigned int> random_data;
+static bool uses_panning;
+static int samples_per_tick;
+
+static const unsigned char* params_ptr;
+static const signed char* tones_ptr;
+static unsigned char* tovel_ptr;
+static const unsigned char* length_ptr;
+static const signed char* note_ptr;
+
+static std::vector<double> partial_array, sample_buffer, mixing_buffer;
+
+static float paramFloat(int i)
+{
+   float f;
+   memcpy(&f, params_ptr + i * 4, 4);
+   return f;
+}
+
+static int paramInt(int i)
+{
+   int n;
+   memcpy(&n, params_ptr + i * 4, 4);
+   return n;
+}
+
+// TONE2FREQ
+static long double toneToFreq(long double tone)
+{
+   const long double x = tone / 12;
+   return ldexpl(exp2l(fmodl(x, 1.0L)), int(x));
+}
+
+// FREQ2TONE
+static long double freqToTone(long double freq)
+{
+   return 12 * log2l(freq);
+}
+
+// GETRANDOM
+static long double getRandom(const unsigned int*& random)
+{
+   return (long double)int(*random++) * (1.0L / 2147483648.0L);
+}
+
+// MakeInstrument, for the instrument at params_ptr
+static void makeInstrument(long double tone, double* sample)
+{
+   double* array = &partial_array[0];
+   const int modes = paramInt(p_modes), fat = paramInt(p_fat);
+
+   for(int mode = modes; mode > 0; --mode)
+   {
+      const unsigned int* random = &random_data[((modes - mode) << 8) + paramInt(p_seed)];
+
+      const long double subtone = fabsl(getRandom(random));
+      const long double reltone = subtone * paramInt(p_overtones);
+
+      long double ampmul = subtone * paramFloat(p_decaydiff) + paramFloat(p_decaylow);
+
+      for(int i = 0; i < 12; ++i)
+         ampmul = sqrtl(ampmul);
+
+      long double freq = toneToFreq(reltone);
+      freq += (nearbyintl(freq) - freq) * paramFloat(p_harmonicity);
+      const long double reltone2 = freqToTone(freq);
+
+      const long double mamp = toneToFreq(reltone2 * paramFloat(p_sharpness)) * getRandom(random);
+
+      for(int i = 0; i < fat; ++i)
+      {
+         const long double ptone = getRandom(random) * paramFloat(p_width) + reltone2;
+
+         // step value
+         const long double step = toneToFreq(ptone + tone) * base_freq;
+         *array++ = double(cosl(step) * ampmul);
+         *array++ = double(sinl(step) * ampmul);
+
+         // state value
+         const long double phase = 3.14159265358979323846264338327950288L * getRandom(random);
+         *array++ = double(cosl(phase) * mamp);
+         *array++ = double(sinl(phase) * mamp);
+
+         // filter value
+         *array++ = double((ptone - paramFloat(p_filterlow)) * paramFloat(p_fslopelow) + 1);
+         *array++ = double((ptone - paramFloat(p_filterhigh)) * paramFloat(p_fslopehigh) + 1);
+      }
+   }
+
+   const int num_partials = modes * fat;
+   const double filter_add_low = double(paramFloat(p_fslopelow)) * double(paramFloat(p_fsweeplow));
+   const double filter_add_high = double(paramFloat(p_fslopehigh)) * double(paramFloat(p_fsweephigh));
+   const double gain = paramFloat(p_gain);
+   const int max_samples = paramInt(p_maxsamples);
+
+   for(int s = 0; s < max_samples; ++s)
+   {
+      double sum = 0;
+
+      for(int p = 0; p < num_partials; ++p)
+      {
+         double* partial = &partial_array[p * 6];
+
+         const double x1 = partial[0], y1 = partial[1], x2 = partial[2], y2 = partial[3];
+         const double x = x1 * x2 - y1 * y2, y = y1 * x2 + x1 * y2;
+         partial[2] = x;
+         partial[3] = y;
+
+         double filter = (partial[4] < partial[5]) ? partial[4] : partial[5];
+         filter = (filter > 0) ? filter : 0;
+         filter = (filter < 1) ? filter : 1;
+         sum += x * filter;
+
+         partial[4] += filter_add_low;
+         partial[5] += filter_add_high;
+      }
+
+      sum /= sqrt(((gain - 1.0) * sum * sum + double(num_partials)) / gain);
+
+      sample[s * 2 + 0] = sum;
+      sample[s * 2 + 1] = sum;
+   }
+}
+
+// MakeChannel, which renders the tones of the next instrument and mixes its columns
+static void makeChannel(size_t total_samples)
+{
+   double* sample = &sample_buffer[0];
+
+   for(int tone = 0;;)
+   {
+      tone += *tones_ptr++;
+
+      if(tone < 0)
+         break;
+
+      makeInstrument(tone, sample);
+      sample += size_t(paramInt(p_maxsamples)) * 2;
+   }
+
+   const int max_samples = paramInt(p_maxsamples);
+   const double release = paramFloat(p_release), attack = paramFloat(p_attack);
+
+   do
+   {
+      size_t mixing = 0;
+
+      // delta decode tones
+      unsigned char* tovel = tovel_ptr;
+      int n = 0;
+
+      do
+      {
+         const unsigned char delta = tovel[n + 1];
+         n += 2;
+         tovel[n + 1] += delta;
+
+      } while((signed char)tovel[n + 1] >= 0);
+
+      tovel_ptr += n + 2;
+
+      for(;;)
+      {
+         // note length, scaled by the tick duration
+         int length = 0;
+
+         if((signed char)*length_ptr < 0)
+            length = ((~*length_ptr++) & 0xff) << 8;
+
+         length |= *length_ptr++;
+         length *= samples_per_tick;
+
+         const size_t pos = mixing;
+         mixing += length;
+
+         const int note = *note_ptr++ - 1;
+
+         if(note >= 0)
+         {
+            double volume_left = double(paramFloat(p_volume)) * tovel[note * 2 + 2], volume_right = volume_left;
+
+            if(uses_panning)
+            {
+               const double panning = paramFloat(p_panning);
+               volume_left *= 1.0 - panning;
+               volume_right *= 1.0 + panning;
+            }
+
+            const double* source = &sample_buffer[size_t(tovel[note * 2 + 1]) * max_samples * 2];
+
+            // attack and release state
+            const double release_length = tovel[0] ? double(tovel[0] * samples_per_tick) : double(length);
+            double release_state = 1.0 - release_length * release, attack_state = 0;
+
+            for(int i = 0; i < max_samples; ++i)
+            {
+               double envelope = (release_state < attack_state) ? release_state : attack_state;
+               envelope = (envelope > 0) ? envelope : 0;
+               envelope = (envelope < 1) ? envelope : 1;
+
+               // the intro's buffer has room for the end of the last note, which is cut off
+               if(pos + i < total_samples)
+               {
+                  mixing_buffer[(pos + i) * 2 + 0] += source[i * 2 + 0] * volume_left * envelope;
+                  mixing_buffer[(pos + i) * 2 + 1] += source[i * 2 + 1] * volume_right * envelope;
+               }
+
+               release_state += release;
+               attack_state += attack;
+            }
+         }
+
+         if(length == 0)
+            break;
+      }
+
+      // more columns for the instrument?
+   } while(--*(signed char*)(tones_ptr - 1) < 0);
+
+   params_ptr += (uses_panning ? 21 : 20) * 4;
+}
+
+// one low-pass filter of ReverbFilter
+static long double lowPass(long double x, float param, double& state)
+{
+   long double v = (x - state) * param + state;
+
+   // avoid denormals
+   v = (v + 1) - 1;
+
+   state = double(v);
+   return v;
+}
+
+int main(int argc, char** argv)
+{
+   if(argc < 3)
+   {
+      fprintf(stderr, "usage: %s music.asm out.raw\n", argv[0]);
+      return 2;
+   }
+
+   Music music;
+   std::string error;
+
+   if(!loadMusic(argv[1], music, error))
+   {
+      fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+      return 2;
+   }
+
+   // MakeChannel decodes the tones and the track data in place
+   std::vector<unsigned char> instrument_tones = music.instrument_tones, track_data = music.track_data;
+
+   fillRandomData(random_data);
+   uses_panning = music.uses_panning;
+   samples_per_tick = music.samples_per_tick;
+
+   params_ptr = &music.instrument_params[0];
+   tones_ptr = (const signed char*)&instrument_tones[0];
+   tovel_ptr = &track_data[0];
+   length_ptr = &music.note_lengths[0];
+   note_ptr = (const signed char*)&music.note_samples[0];
+
+   const size_t total_samples = music.total_samples;
+
+   partial_array.resize(10000 * 6);
+   sample_buffer.resize(size_t(music.max_total_instrument_samples) * 2);
+   mixing_buffer.assign(total_samples * 2, 0);
+
+   std::vector<double> reverb_buffer((total_samples + music.reverb_add_delay) * 2, 0);
+   std::vector<double> delay_buffer(delay_buffer_size, 0);
+   double reverb_state[4] = { 0, 0, 0, 0 };
+
+   // filter high, filter low, dampen high, dampen low, volume
+   float reverb_params[] = { music.reverb_filter_high, music.reverb_filter_low, music.reverb_dampen_high,
+                             music.reverb_dampen_low, music.reverb_volume_left };
+
+   size_t ebx = 0;
+
+   if(music.num_tracks_with_reverb > 0)
+   {
+      for(int i = 0; i < music.num_tracks_with_reverb; ++i)
+         makeChannel(total_samples);
+
+      long double decay = music.reverb_max_decay;
+      unsigned int num_delays = music.reverb_num_delays;
+
+      for(unsigned int delay = music.reverb_max_delay; delay > 0; --delay)
+      {
+         // is this delay length included?
+         const unsigned long long product = (unsigned long long)(unsigned int)(delay - music.reverb_min_delay) *
+                                            random_data[music.reverb_randomseed + delay];
+
+         if((unsigned int)(product >> 32) < num_delays)
+         {
+            for(; ebx < total_samples * 2; ebx += 2)
+            {
+               double& delayed = delay_buffer[(ebx >> 1) % delay];
+               double& reverb = reverb_buffer[music.reverb_add_delay * 2 + ebx];
+
+               // filter input
+               const long double x = mixing_buffer[ebx];
+               const long double input = lowPass(x, reverb_params[0], reverb_state[0]) -
+                                         lowPass(x, reverb_params[1], reverb_state[1]);
+
+               // filter echo
+               const long double echo = lowPass(delayed, reverb_params[2], reverb_state[2]) -
+                                        lowPass(delayed, reverb_params[3], reverb_state[3]);
+
+               // extract delayed signal
+               reverb = double(delayed * (long double)reverb_params[4] + reverb);
+
+               // attenuate echo and add to input
+               delayed = double(input + echo * decay);
+            }
+
+            // alternate between left and right volume
+            if(music.reverb_volume_left != music.reverb_volume_right)
+               reverb_params[4] = (reverb_params[4] == music.reverb_volume_left) ? music.reverb_volume_right
+                                                                                 : music.reverb_volume_left;
+
+            // switch side
+            ebx = (ebx & 1) ^ 1;
+
+            --num_delays;
+         }
+
+         decay *= music.reverb_decay_mul;
+      }
+   }
+
+   if(music.num_tracks_without_reverb > 0)
+   {
+      for(int i = 0; i < music.num_tracks_without_reverb; ++i)
+         makeChannel(total_samples);
+
+      ebx = 0;
+   }
+
+   // clamp and convert to shorts
+   std::vector<short> out(total_samples * 2, 0);
+
+   for(; ebx < total_samples * 2; ++ebx)
+   {
+      long double v = mixing_buffer[ebx];
+
+      if(music.num_tracks_with_reverb > 0)
+         v += reverb_buffer[ebx];
+
+      if(v >= 32767)
+         v = 32767;
+
+      v = -v;
+
+      if(v >= 32767)
+         v = 32767;
+
+      out[ebx] = short(llrintl(-v));
+   }
+
+   FILE* f = fopen(argv[2], "wb");
+
+   if(!f || fwrite(&out[0], 2, out.size(), f) != out.size())
+   {
+      fprintf(stderr, "can't write %s\n", argv[2]);
+      return 2;
+   }
+
+   fclose(f);
+   return 0;
+}
@@ -0,0 +1,271 @@
+// Renders the music of an Oidos intro to a wav file with oidos_render.cpp, and checks it
+// against a reference rendering, such as the Oidos_WavFileHeader and Oidos_MusicBuffer written
+// by the intro itself. The check passes if no sample differs by more than the tolerance.
+// With -stream, the music is rendered as a stream, and it tells how soon playback could start
+// with the given lead in seconds, and how long it would have to wait for the music after that.
+// check_render.sh checks it against main_reference.cpp on the music of each intro.
+//
+// g++ -O3 -ffp-contract=off -pthread main_render.cpp ../oidos_render.cpp -o oidos_render
+// oidos_render music.asm out.wav [-threads n] [-stream lead] [-compare reference.wav] [-tolerance t]
+
+#include "../oidos_render.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void put32(FILE* f, unsigned int u)
+{
+   const unsigned char b[] = { (unsigned char)u, (unsigned char)(u >> 8), (unsigned char)(u >> 16), (unsigned char)(u >> 24) };
+   fwrite(b, 1, 4, f);
+}
+
+static void put16(FILE* f, unsigned int u)
+{
+   const unsigned char b[] = { (unsigned char)u, (unsigned char)(u >> 8) };
+   fwrite(b, 1, 2, f);
+}
+
+// the same header as Oidos_WavFileHeader
+static bool writeWav(const char* filename, const std::vector<short>& samples)
+{
+   FILE* f = fopen(filename, "wb");
+
+   if(!f)
+      return false;
+
+   const unsigned int size = samples.size() * 2;
+
+   fwrite("RIFF", 1, 4, f);
+   put32(f, 36 + size);
+   fwrite("WAVE", 1, 4, f);
+   fwrite("fmt ", 1, 4, f);
+   put32(f, 16);
+   put16(f, 1);
+   put16(f, 2);
+   put32(f, oidos::sample_rate);
+   put32(f, oidos::sample_rate * 4);
+   put16(f, 4);
+   put16(f, 16);
+   fwrite("data", 1, 4, f);
+   put32(f, size);
+
+   for(size_t i = 0; i < samples.size(); ++i)
+      put16(f, (unsigned short)samples[i]);
+
+   const bool ok = !ferror(f);
+   fclose(f);
+   return ok;
+}
+
+// A wav file, or else raw 16 bit stereo samples.
+static bool readSamples(const char* filename, std::vector<short>& samples)
+{
+   FILE* f = fopen(filename, "rb");
+
+   if(!f)
+      return false;
+
+   std::vector<unsigned char> data;
+   unsigned char buffer[65536];
+
+   for(size_t n; (n = fread(buffer, 1, sizeof(buffer), f)) > 0;)
+      data.insert(data.end(), buffer, buffer + n);
+
+   fclose(f);
+
+   size_t begin = 0, end = data.size();
+
+   if(data.size() >= 12 && memcmp(&data[0], "RIFF", 4) == 0 && memcmp(&data[8], "WAVE", 4) == 0)
+   {
+      begin = end = 0;
+
+      for(size_t pos = 12; pos + 8 <= data.size();)
+      {
+         const size_t size = data[pos + 4] | (data[pos + 5] << 8) | (data[pos + 6] << 16) | (size_t(data[pos + 7]) << 24);
+
+         if(memcmp(&data[pos], "data", 4) == 0)
+         {
+            begin = pos + 8;
+            end = std::min(data.size(), begin + size);
+            break;
+         }
+
+         pos += 8 + size + (size & 1);
+      }
+   }
+
+   samples.resize((end - begin) / 2);
+
+   for(size_t i = 0; i < samples.size(); ++i)
+      samples[i] = short(data[begin + i * 2] | (data[begin + i * 2 + 1] << 8));
+
+   return true;
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(const Clock::time_point& start)
+{
+   return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Playback starts when the lead is rendered, and waits whenever it catches up with the music.
+static void stream(const oidos::Music& music, int num_threads, double lead, const Clock::time_point& start,
+                   std::vector<short>& samples)
+{
+   oidos::Stream s(music, num_threads);
+   s.start();
+
+   const int lead_frames = int(lead * oidos::sample_rate);
+
+   double play_start = -1, waited = 0;
+   int num_waits = 0;
+
+   for(int frames = 0; frames < music.total_samples;)
+   {
+      s.waitForLead(frames + 1);
+
+      const int rendered = s.getRenderedFrames();
+      const double now = secondsSince(start);
+
+      if(play_start < 0)
+      {
+         if(rendered >= std::min(lead_frames, music.total_samples))
+            play_start = now;
+      }
+      else
+      {
+         // when playback got to the frames which have just been rendered
+         const double needed = play_start + waited + double(frames) / oidos::sample_rate;
+
+         if(now > needed)
+         {
+            waited += now - needed;
+            ++num_waits;
+         }
+      }
+
+      frames = rendered;
+   }
+
+   printf("playback started after %.2f seconds, and waited for the music %d times for %.2f seconds\n",
+          play_start, num_waits, waited);
+
+   samples.assign(s.getSamples(), s.getSamples() + size_t(music.total_samples) * 2);
+}
+
+int main(int argc, char** argv)
+{
+   const char* music_file = NULL;
+   const char* wav_file = NULL;
+   const char* reference_file = NULL;
+   int num_threads = 0, tolerance = 1;
+   double lead = -1;
+
+   for(int i = 1; i < argc; ++i)
+   {
+      if(!strcmp(argv[i], "-threads") && i + 1 < argc)
+         num_threads = atoi(argv[++i]);
+      else if(!strcmp(argv[i], "-stream") && i + 1 < argc)
+         lead = atof(argv[++i]);
+      else if(!strcmp(argv[i], "-compare") && i + 1 < argc)
+         reference_file = argv[++i];
+      else if(!strcmp(argv[i], "-tolerance") && i + 1 < argc)
+         tolerance = atoi(argv[++i]);
+      else if(!music_file)
+         music_file = argv[i];
+      else if(!wav_file)
+         wav_file = argv[i];
+   }
+
+   if(!music_file)
+   {
+      fprintf(stderr, "usage: %s music.asm [out.wav] [-threads n] [-stream lead] [-compare reference.wav] [-tolerance t]\n", argv[0]);
+      return 2;
+   }
+
+   oidos::Music music;
+   std::string error;
+
+   if(!oidos::loadMusic(music_file, music, error))
+   {
+      fprintf(stderr, "%s: %s\n", music_file, error.c_str());
+      return 2;
+   }
+
+   std::vector<short> samples;
+
+   const Clock::time_point start = Clock::now();
+
+   if(lead < 0)
+      oidos::render(music, samples, num_threads);
+   else
+      stream(music, num_threads, lead, start, samples);
+
+   const double seconds = secondsSince(start);
+
+   printf("rendered %.1f seconds of music in %.2f seconds\n", double(music.total_samples) / oidos::sample_rate, seconds);
+
+   if(wav_file && !writeWav(wav_file, samples))
+   {
+      fprintf(stderr, "can't write %s\n", wav_file);
+      return 2;
+   }
+
+   if(!reference_file)
+      return 0;
+
+   std::vector<short> reference;
+
+   if(!readSamples(reference_file, reference))
+   {
+      fprintf(stderr, "can't read %s\n", reference_file);
+      return 2;
+   }
+
+   const size_t n = std::min(samples.size(), reference.size());
+
+   size_t num_different = 0, first_different = n;
+   int max_difference = 0;
+
+   for(size_t i = 0; i < n; ++i)
+   {
+      const int d = abs(int(samples[i]) - int(reference[i]));
+
+      if(d == 0)
+         continue;
+
+      if(!num_different)
+         first_different = i;
+
+      ++num_different;
+      max_difference = std::max(max_difference, d);
+   }
+
+   printf("%lu of %lu samples differ, by at most %d", (unsigned long)num_different, (unsigned long)n, max_difference);
+
+   if(num_different)
+      printf(", first at frame %lu", (unsigned long)(first_different / 2));
+
+   printf("\n");
+
+   if(samples.size() != reference.size())
+   {
+      printf("FAILED: %lu samples rendered, but the reference has %lu\n", (unsigned long)samples.size(), (unsigned long)reference.size());
+      return 1;
+   }
+
+   if(max_difference > tolerance)
+   {
+      printf("FAILED: the tolerance is %d\n", tolerance);
+      return 1;
+   }
+
+   printf("passed\n");
+   return 0;
+}
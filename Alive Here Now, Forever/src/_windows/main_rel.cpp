@@ -20,11 +20,19 @@
 #define VOLUME_SIZE		256
 #define CHECK_ERRORS	0
 #define REALMUSIC			1
+// 1 in the Stream configuration of the project (see music_stream.h)
+#ifndef STREAMMUSIC
+#define STREAMMUSIC		0
+#endif
 
 #if WRITEBITMAPS
 #include "../writebitmaps.h"
 #endif
 
+#if STREAMMUSIC
+#include "music_stream.h"
+#endif
+
 
 
 static const PIXELFORMATDESCRIPTOR pfd = {
@@ -45,6 +53,8 @@ static DEVMODE screenSettings = { {0},
     #endif
     };
 
+// the C runtime defines it in the Stream configuration
+#if !STREAMMUSIC
 #ifdef __cplusplus
 extern "C" 
 {
@@ -53,6 +63,7 @@ int  _fltused = 1;
 #ifdef __cplusplus
 }
 #endif
+#endif
 
 //----------------------------------------------------------------------------
 
@@ -458,6 +469,9 @@ GLuint ts[2];
 float musicticks=0.0f;
 
 #if !WRITEBITMAPS
+#if STREAMMUSIC
+	startMusicStream("src/music.asm");
+#else
 #if REALMUSIC
 	//CreateThread(0, 0, (LPTHREAD_START_ROUTINE)Oidos_GenerateMusic, NULL, 0, 0);
 	Oidos_GenerateMusic();
@@ -465,6 +479,7 @@ float musicticks=0.0f;
 	{sample sa = {0,0};for(unsigned long int i=0;i<Oidos_MusicLength;++i)Oidos_MusicBuffer[i]=sa;}
 #endif
 	Oidos_StartMusic();
+#endif
 #endif
 
     do 
@@ -478,7 +493,11 @@ static long int counter=0;
 ++counter;
 #else
 
+#if STREAMMUSIC
+	musicticks = getMusicStreamPosition();
+#else
 	musicticks = Oidos_GetPosition();
+#endif
 	const long int t = int((musicticks / Oidos_TicksPerSecond) * 1000.0f);
 	
 #endif
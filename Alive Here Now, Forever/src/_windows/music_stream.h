@@ -0,0 +1,71 @@
+#ifndef _MUSIC_STREAM_H_
+#define _MUSIC_STREAM_H_
+
+// Plays a music.asm while oidos_render.cpp renders it, instead of waiting for
+// Oidos_GenerateMusic. It is for the Stream configuration of the projects which use Oidos
+// (this one, Dropletia and From The Seas To The Stars), which builds oidos_render.cpp with the
+// C runtime and threads, and links without crinkler. Without x87 long doubles and with
+// /fp:fast, the music may differ a little from the intro's.
+//
+// Include it in one file, after windows.h and mmsystem.h.
+
+#include "../oidos_render.h"
+
+static oidos::Stream* music_stream;
+static HWAVEOUT music_wave_out;
+
+static void startMusicStream(const char* filename)
+{
+	oidos::Music music;
+	std::string error;
+
+	if(!oidos::loadMusic(filename, music, error))
+	{
+		MessageBoxA(0, error.c_str(), filename, MB_OK);
+		ExitProcess(-1);
+	}
+
+	music_stream = new oidos::Stream(music);
+	music_stream->start();
+	music_stream->waitForLead(oidos::sample_rate);
+
+	static WAVEFORMATEX format = { WAVE_FORMAT_PCM, 2, oidos::sample_rate, oidos::sample_rate * 4, 4, 16, 0 };
+	static WAVEHDR header;
+	header.lpData = (LPSTR)music_stream->getSamples();
+	header.dwBufferLength = music.total_samples * 4;
+
+	waveOutOpen(&music_wave_out, WAVE_MAPPER, &format, 0, 0, CALLBACK_NULL);
+	waveOutPrepareHeader(music_wave_out, &header, sizeof(header));
+	waveOutWrite(music_wave_out, &header, sizeof(header));
+}
+
+// Oidos_GetPosition for the stream. Playback is paused while it is less than a quarter of a
+// second from the end of the music which is rendered.
+static float getMusicStreamPosition()
+{
+	MMTIME time = { TIME_SAMPLES };
+	waveOutGetPosition(music_wave_out, &time, sizeof(time));
+
+	const int played = time.u.sample;
+
+	if(!music_stream->isFinished() && played + oidos::sample_rate / 4 > music_stream->getRenderedFrames())
+	{
+		waveOutPause(music_wave_out);
+		music_stream->waitForLead(played + oidos::sample_rate);
+		waveOutRestart(music_wave_out);
+	}
+
+	return music_stream->getPosition(played);
+}
+
+void entrypoint(void);
+
+// The Stream configuration starts at WinMain, so that the C runtime is set up for the threads
+// and the heap.
+int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int)
+{
+	entrypoint();
+	return 0;
+}
+
+#endif
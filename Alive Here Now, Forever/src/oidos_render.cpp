@@ -0,0 +1,1391 @@
+#include "oidos_render.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OIDOS_SSE2 1
+#endif
+
+using namespace oidos;
+
+// as in oidos.asm
+static const float base_freq = 0.00232970791933f;
+static const int delay_buffer_size = 25600;
+
+// samples of a tone stepped at a time, and frames mixed by each job
+static const int block_size = 256;
+static const int slice_size = 1 << 16;
+
+// frames of a chunk of a stream, and mixed by each of its jobs
+static const int chunk_size = 1 << 15;
+static const int chunk_slice_size = 1 << 12;
+
+
+//// ********** Reading music.asm **********
+
+static std::string trim(const std::string& s)
+{
+   const size_t b = s.find_first_not_of(" \t\r\n"), e = s.find_last_not_of(" \t\r\n");
+   return (b == std::string::npos) ? std::string() : s.substr(b, e - b + 1);
+}
+
+// A number as nasm puts it in a dword, where a float is written as its bits.
+static uint32_t parseDword(const std::string& s)
+{
+   const bool hex = s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X');
+
+   if(!hex && s.find_first_of(".eE") != std::string::npos)
+   {
+      const float f = strtof(s.c_str(), NULL);
+      uint32_t u;
+      memcpy(&u, &f, sizeof(u));
+      return u;
+   }
+
+   return uint32_t(strtoll(s.c_str(), NULL, 0));
+}
+
+static float dwordToFloat(uint32_t u)
+{
+   float f;
+   memcpy(&f, &u, sizeof(f));
+   return f;
+}
+
+//// ********** Random data **********
+
+static uint32_t ror(uint32_t x, uint32_t n)
+{
+   n &= 31;
+   return n ? (x >> n) | (x << (32 - n)) : x;
+}
+
+void oidos::fillRandomData(std::vector<unsigned int>& data)
+{
+   // the bytes of ID3D11Texture2D_ID in random.asm, which are the state of the generator
+   uint32_t state[4] = { 0x6f15aaf2, 0x4e89d208, 0x9548b49a, 0x9c4fd335 };
+
+   data.assign(noise_size * noise_size * noise_size, 0);
+
+   for(size_t i = 0; i < data.size(); ++i)
+      for(int j = 0; j < 3; ++j)
+      {
+         state[j] = ror(state[j], state[j]) + state[j + 1];
+         data[i] ^= state[j];
+      }
+}
+
+
+//// ********** Decoding the tables **********
+
+namespace
+{
+
+// the params struct of oidos.asm
+struct Params
+{
+   int modes, fat, seed, overtones;
+   float decaydiff, decaylow, harmonicity, sharpness, width;
+   float filterlow, filterhigh, fslopelow, fslopehigh, fsweeplow, fsweephigh;
+   float gain;
+   int maxsamples;
+   float release, attack, volume, panning;
+};
+
+// A note which isn't OFF. The release length is the note length, or the fixed length of its
+// column.
+struct Note
+{
+   int pos;
+   int release_length;
+   int tone;
+   int velocity;
+};
+
+// The tones are in the order of their samples, each of which is maxsamples long.
+struct Instrument
+{
+   Params params;
+   std::vector<int> tones;
+   std::vector<Note> notes;
+};
+
+// The pointers of oidos.asm into the tables, and the checks that they stay within them.
+class Reader
+{
+   public:
+      Reader(const std::vector<unsigned char>& data): data(data), pos(0), failed(false) { }
+
+      int byte()
+      {
+         if(pos >= data.size())
+         {
+            failed = true;
+            return -128;
+         }
+
+         return (signed char)data[pos++];
+      }
+
+      uint32_t dword()
+      {
+         uint32_t u = 0;
+
+         for(int i = 0; i < 4; ++i)
+            u |= uint32_t(byte() & 0xff) << (i * 8);
+
+         return u;
+      }
+
+      const std::vector<unsigned char>& data;
+      size_t pos;
+      bool failed;
+};
+
+}
+
+static bool decode(const Music& music, std::vector<Instrument>& instruments, std::string& error)
+{
+   Reader params(music.instrument_params), tones(music.instrument_tones), lengths(music.note_lengths);
+   Reader notes(music.note_samples);
+
+   // the tone and velocity columns are delta decoded in place
+   std::vector<unsigned char> track_data = music.track_data;
+   size_t tovel = 0;
+
+   const int num_instruments = music.num_tracks_with_reverb + music.num_tracks_without_reverb;
+
+   instruments.assign(num_instruments, Instrument());
+
+   for(int i = 0; i < num_instruments; ++i)
+   {
+      Instrument& ins = instruments[i];
+      Params& p = ins.params;
+
+      p.modes = int(params.dword());
+      p.fat = int(params.dword());
+      p.seed = int(params.dword());
+      p.overtones = int(params.dword());
+
+      float* floats[] = { &p.decaydiff, &p.decaylow, &p.harmonicity, &p.sharpness, &p.width,
+                          &p.filterlow, &p.filterhigh, &p.fslopelow, &p.fslopehigh,
+                          &p.fsweeplow, &p.fsweephigh, &p.gain };
+
+      for(size_t j = 0; j < sizeof(floats) / sizeof(floats[0]); ++j)
+         *floats[j] = dwordToFloat(params.dword());
+
+      p.maxsamples = int(params.dword());
+      p.release = dwordToFloat(params.dword());
+      p.attack = dwordToFloat(params.dword());
+      p.volume = dwordToFloat(params.dword());
+      p.panning = music.uses_panning ? dwordToFloat(params.dword()) : 0.0f;
+
+      const long last_random = ((long(p.modes) - 1) << 8) + p.seed + 2 + 2 * long(p.fat);
+
+      if(p.modes <= 0 || p.fat <= 0 || p.seed < 0 || p.maxsamples <= 0 ||
+         last_random > long(noise_size) * noise_size * noise_size)
+      {
+         char s[128];
+         snprintf(s, sizeof(s), "instrument %d has bad params", i);
+         error = s;
+         return false;
+      }
+
+      for(int tone = tones.byte(); tone >= 0 && !tones.failed; tone += tones.byte())
+         ins.tones.push_back(tone);
+
+      if(tones.failed)
+      {
+         error = "the tones end before the last instrument";
+         return false;
+      }
+
+      // The byte which ended the tones counts the columns. It goes up to -128 and past.
+      signed char columns = (signed char)music.instrument_tones[tones.pos - 1];
+
+      do
+      {
+         size_t e = 0;
+
+         for(;;)
+         {
+            if(tovel + e + 3 >= track_data.size())
+            {
+               error = "the track data ends within a column";
+               return false;
+            }
+
+            const unsigned char delta = track_data[tovel + e + 1];
+            e += 2;
+            track_data[tovel + e + 1] += delta;
+
+            if((signed char)track_data[tovel + e + 1] < 0)
+               break;
+         }
+
+         const unsigned char* column = &track_data[tovel];
+         const int num_entries = int(e / 2);
+         tovel += e + 2;
+
+         // notes are read up to and including one of zero length
+         for(int pos = 0, length = 1; length > 0 && !lengths.failed && !notes.failed; pos += length)
+         {
+            length = lengths.byte();
+
+            if(length < 0)
+               length = ((~length & 0xff) << 8) | (lengths.byte() & 0xff);
+
+            length *= music.samples_per_tick;
+
+            const int note = notes.byte() - 1;
+
+            if(note < 0)
+               continue;
+
+            if(note >= num_entries)
+            {
+               error = "a note is not in its column";
+               return false;
+            }
+
+            Note n;
+            n.pos = pos;
+            n.release_length = column[0] ? column[0] * music.samples_per_tick : length;
+            n.tone = column[note * 2 + 1];
+            n.velocity = column[note * 2 + 2];
+
+            if(n.tone >= int(ins.tones.size()))
+            {
+               error = "a note plays a tone which the instrument doesn't have";
+               return false;
+            }
+
+            ins.notes.push_back(n);
+         }
+
+         columns = (signed char)(columns - 1);
+      }
+      while(columns < 0);
+
+      if(params.failed || tones.failed || lengths.failed || notes.failed)
+      {
+         error = "the tables end before the last instrument";
+         return false;
+      }
+   }
+
+   return true;
+}
+
+
+bool oidos::loadMusic(const char* filename, Music& music, std::string& error)
+{
+   FILE* f = fopen(filename, "rb");
+
+   if(!f)
+   {
+      error = std::string("can't open ") + filename;
+      return false;
+   }
+
+   std::map<std::string, std::string> defines;
+   std::map<std::string, std::vector<unsigned char> > tables;
+   std::vector<unsigned char>* table = NULL;
+
+   char line[4096];
+
+   while(fgets(line, sizeof(line), f))
+   {
+      std::string l = line;
+      l = trim(l.substr(0, l.find(';')));
+
+      if(l.empty())
+         continue;
+
+      if(l.compare(0, 7, "%define") == 0)
+      {
+         const std::string rest = trim(l.substr(7));
+         const size_t space = rest.find_first_of(" \t");
+
+         if(space == std::string::npos)
+            defines[rest] = "";
+         else
+            defines[rest.substr(0, space)] = trim(rest.substr(space));
+
+         continue;
+      }
+
+      // labels starting with _ begin the tables, and the other labels are within them
+      const size_t colon = l.find(':');
+
+      if(colon != std::string::npos && l.find_first_of(" \t") > colon)
+      {
+         if(l[0] == '_')
+            table = &tables[l.substr(0, colon)];
+
+         l = trim(l.substr(colon + 1));
+
+         if(l.empty())
+            continue;
+      }
+
+      const std::string op = l.substr(0, 2);
+
+      if((op != "dd" && op != "db") || l.size() < 3 || (l[2] != ' ' && l[2] != '\t'))
+         continue;
+
+      if(!table)
+      {
+         error = "data outside of a table: " + l;
+         fclose(f);
+         return false;
+      }
+
+      std::string values = l.substr(3);
+
+      for(size_t start = 0; start <= values.size();)
+      {
+         size_t end = values.find(',', start);
+
+         if(end == std::string::npos)
+            end = values.size();
+
+         const uint32_t u = parseDword(trim(values.substr(start, end - start)));
+
+         if(op == "db")
+            table->push_back(u & 0xff);
+         else
+            for(int i = 0; i < 4; ++i)
+               table->push_back((u >> (i * 8)) & 0xff);
+
+         start = end + 1;
+      }
+   }
+
+   fclose(f);
+
+   struct Define
+   {
+      const char* name;
+      int* i;
+      float* f;
+   };
+
+   const Define required[] =
+   {
+      { "MUSIC_LENGTH", &music.music_length, NULL },
+      { "TOTAL_SAMPLES", &music.total_samples, NULL },
+      { "MAX_TOTAL_INSTRUMENT_SAMPLES", &music.max_total_instrument_samples, NULL },
+      { "SAMPLES_PER_TICK", &music.samples_per_tick, NULL },
+      { "TICKS_PER_SECOND", NULL, &music.ticks_per_second },
+      { "NUM_TRACKS_WITH_REVERB", &music.num_tracks_with_reverb, NULL },
+      { "NUM_TRACKS_WITHOUT_REVERB", &music.num_tracks_without_reverb, NULL },
+   };
+
+   const Define reverb[] =
+   {
+      { "REVERB_NUM_DELAYS", &music.reverb_num_delays, NULL },
+      { "REVERB_MIN_DELAY", &music.reverb_min_delay, NULL },
+      { "REVERB_MAX_DELAY", &music.reverb_max_delay, NULL },
+      { "REVERB_ADD_DELAY", &music.reverb_add_delay, NULL },
+      { "REVERB_RANDOMSEED", &music.reverb_randomseed, NULL },
+      { "REVERB_MAX_DECAY", NULL, &music.reverb_max_decay },
+      { "REVERB_DECAY_MUL", NULL, &music.reverb_decay_mul },
+      { "REVERB_FILTER_HIGH", NULL, &music.reverb_filter_high },
+      { "REVERB_FILTER_LOW", NULL, &music.reverb_filter_low },
+      { "REVERB_DAMPEN_HIGH", NULL, &music.reverb_dampen_high },
+      { "REVERB_DAMPEN_LOW", NULL, &music.reverb_dampen_low },
+      { "REVERB_VOLUME_LEFT", NULL, &music.reverb_volume_left },
+      { "REVERB_VOLUME_RIGHT", NULL, &music.reverb_volume_right },
+   };
+
+   for(size_t i = 0; i < sizeof(required) / sizeof(required[0]) + sizeof(reverb) / sizeof(reverb[0]); ++i)
+   {
+      const bool is_reverb = i >= sizeof(required) / sizeof(required[0]);
+      const Define& d = is_reverb ? reverb[i - sizeof(required) / sizeof(required[0])] : required[i];
+
+      if(!defines.count(d.name))
+      {
+         if(is_reverb && music.num_tracks_with_reverb == 0)
+         {
+            if(d.i) *d.i = 0;
+            if(d.f) *d.f = 0;
+            continue;
+         }
+
+         error = std::string("no define of ") + d.name;
+         return false;
+      }
+
+      const uint32_t u = parseDword(defines[d.name]);
+
+      if(d.i)
+         *d.i = int(u);
+      else
+         *d.f = dwordToFloat(u);
+   }
+
+   music.uses_panning = defines.count("USES_PANNING") != 0;
+
+   struct Table
+   {
+      const char* name;
+      std::vector<unsigned char>* data;
+   };
+
+   const Table required_tables[] =
+   {
+      { "_InstrumentParams", &music.instrument_params },
+      { "_InstrumentTones", &music.instrument_tones },
+      { "_TrackData", &music.track_data },
+      { "_NoteLengths", &music.note_lengths },
+      { "_NoteSamples", &music.note_samples },
+   };
+
+   for(size_t i = 0; i < sizeof(required_tables) / sizeof(required_tables[0]); ++i)
+   {
+      if(!tables.count(required_tables[i].name))
+      {
+         error = std::string("no table ") + required_tables[i].name;
+         return false;
+      }
+
+      *required_tables[i].data = tables[required_tables[i].name];
+   }
+
+   std::vector<Instrument> instruments;
+   return decode(music, instruments, error);
+}
+
+
+//// ********** Thread pool **********
+
+namespace
+{
+
+// Jobs are added in batches, which can be waited for. Urgent jobs go before the others.
+class ThreadPool
+{
+   public:
+      struct Batch
+      {
+         int pending;
+
+         Batch(): pending(0) { }
+      };
+
+      ThreadPool(int num_threads): stopping(false)
+      {
+         for(int i = 0; i < num_threads; ++i)
+            threads.push_back(std::thread(&ThreadPool::work, this));
+      }
+
+      ~ThreadPool()
+      {
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+         }
+
+         job_added.notify_all();
+
+         for(size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+      }
+
+      void add(Batch& batch, const std::function<void()>& job, bool urgent = false)
+      {
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++batch.pending;
+
+            const Job j = { job, &batch };
+
+            if(urgent)
+               jobs.push_front(j);
+            else
+               jobs.push_back(j);
+         }
+
+         job_added.notify_one();
+      }
+
+      void wait(Batch& batch)
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+
+         while(batch.pending)
+            job_done.wait(lock);
+      }
+
+   private:
+      struct Job
+      {
+         std::function<void()> run;
+         Batch* batch;
+      };
+
+      void work()
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+
+         for(;;)
+         {
+            while(jobs.empty() && !stopping)
+               job_added.wait(lock);
+
+            if(jobs.empty())
+               return;
+
+            const Job job = jobs.front();
+            jobs.pop_front();
+
+            lock.unlock();
+            job.run();
+            lock.lock();
+
+            if(--job.batch->pending == 0)
+               job_done.notify_all();
+         }
+      }
+
+      std::vector<std::thread> threads;
+      std::deque<Job> jobs;
+      std::mutex mutex;
+      std::condition_variable job_added, job_done;
+      bool stopping;
+};
+
+}
+
+
+//// ********** Instruments **********
+
+namespace
+{
+
+// The step and state of each partial as complex numbers, and its two filter values. There is a
+// multiple of 8 partials, where the ones past the instrument's are silent.
+struct Partials
+{
+   std::vector<double> step_re, step_im, re, im, lo, hi;
+};
+
+}
+
+// TONE2FREQ: 2^(x/12), as a power of the fraction and a whole power
+static long double toneToFreq(long double x)
+{
+   const long double y = x / 12;
+   return ldexpl(exp2l(fmodl(y, 1.0L)), int(y));
+}
+
+static long double getRandom(const unsigned int*& random)
+{
+   return (long double)(int32_t)*random++ * (1.0L / 2147483648.0L);
+}
+
+// As MakeInstrument sets up the PartialArray, with the same long double arithmetic as the x87.
+static void setupPartials(const Params& p, int tone, const unsigned int* random_data, Partials& partials)
+{
+   const size_t count = size_t(p.modes) * p.fat, padded = (count + 7) & ~size_t(7);
+
+   partials.step_re.assign(padded, 0.0);
+   partials.step_im.assign(padded, 0.0);
+   partials.re.assign(padded, 0.0);
+   partials.im.assign(padded, 0.0);
+   partials.lo.assign(padded, 0.0);
+   partials.hi.assign(padded, 0.0);
+
+   const long double pi = 3.14159265358979323846264338327950288L;
+
+   size_t k = 0;
+
+   for(int m = 0; m < p.modes; ++m)
+   {
+      const unsigned int* random = random_data + (uint32_t(m) << 8) + uint32_t(p.seed);
+
+      const long double subtone = fabsl(getRandom(random));
+      const long double reltone = subtone * p.overtones;
+
+      long double ampmul = subtone * p.decaydiff + p.decaylow;
+
+      for(int i = 0; i < 12; ++i)
+         ampmul = sqrtl(ampmul);
+
+      const long double freq = toneToFreq(reltone);
+      const long double harmonic = freq + (nearbyintl(freq) - freq) * p.harmonicity;
+      const long double reltone2 = 12 * log2l(harmonic);
+      const long double mamp = toneToFreq(reltone2 * p.sharpness) * getRandom(random);
+
+      for(int j = 0; j < p.fat; ++j, ++k)
+      {
+         const long double ptone = getRandom(random) * p.width + reltone2;
+         const long double step = toneToFreq(ptone + tone) * base_freq;
+
+         partials.step_re[k] = double(cosl(step) * ampmul);
+         partials.step_im[k] = double(sinl(step) * ampmul);
+
+         const long double phase = pi * getRandom(random);
+
+         partials.re[k] = double(cosl(phase) * mamp);
+         partials.im[k] = double(sinl(phase) * mamp);
+
+         partials.lo[k] = double((ptone - p.filterlow) * p.fslopelow + 1);
+         partials.hi[k] = double((ptone - p.filterhigh) * p.fslopehigh + 1);
+      }
+   }
+}
+
+// Steps all partials over n samples, and adds them to acc in the order of the partials, as the
+// decay loop of MakeInstrument does.
+static void stepPartials(Partials& ps, double sweep_low, double sweep_high, double* acc, int n)
+{
+#ifdef OIDOS_SSE2
+   // Four pairs of partials are stepped together, and their values are added afterwards, one
+   // partial at a time for two samples at a time.
+   static const int pairs = 4;
+
+   __m128d values[pairs][block_size];
+
+   const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0);
+   const __m128d dlo = _mm_set1_pd(sweep_low), dhi = _mm_set1_pd(sweep_high);
+
+   for(size_t g = 0; g < ps.re.size(); g += pairs * 2)
+   {
+      __m128d c[pairs], s[pairs], re[pairs], im[pairs], lo[pairs], hi[pairs];
+
+      for(int k = 0; k < pairs; ++k)
+      {
+         c[k] = _mm_loadu_pd(&ps.step_re[g + k * 2]);
+         s[k] = _mm_loadu_pd(&ps.step_im[g + k * 2]);
+         re[k] = _mm_loadu_pd(&ps.re[g + k * 2]);
+         im[k] = _mm_loadu_pd(&ps.im[g + k * 2]);
+         lo[k] = _mm_loadu_pd(&ps.lo[g + k * 2]);
+         hi[k] = _mm_loadu_pd(&ps.hi[g + k * 2]);
+      }
+
+      for(int i = 0; i < n; ++i)
+         for(int k = 0; k < pairs; ++k)
+         {
+            const __m128d r = _mm_sub_pd(_mm_mul_pd(c[k], re[k]), _mm_mul_pd(s[k], im[k]));
+            im[k] = _mm_add_pd(_mm_mul_pd(s[k], re[k]), _mm_mul_pd(c[k], im[k]));
+            re[k] = r;
+
+            const __m128d f = _mm_min_pd(_mm_max_pd(_mm_min_pd(lo[k], hi[k]), zero), one);
+            values[k][i] = _mm_mul_pd(r, f);
+
+            lo[k] = _mm_add_pd(lo[k], dlo);
+            hi[k] = _mm_add_pd(hi[k], dhi);
+         }
+
+      for(int k = 0; k < pairs; ++k)
+      {
+         _mm_storeu_pd(&ps.re[g + k * 2], re[k]);
+         _mm_storeu_pd(&ps.im[g + k * 2], im[k]);
+         _mm_storeu_pd(&ps.lo[g + k * 2], lo[k]);
+         _mm_storeu_pd(&ps.hi[g + k * 2], hi[k]);
+      }
+
+      for(int k = 0; k < pairs; ++k)
+      {
+         int i = 0;
+
+         for(; i + 1 < n; i += 2)
+         {
+            __m128d a = _mm_loadu_pd(acc + i);
+            a = _mm_add_pd(a, _mm_unpacklo_pd(values[k][i], values[k][i + 1]));
+            a = _mm_add_pd(a, _mm_unpackhi_pd(values[k][i], values[k][i + 1]));
+            _mm_storeu_pd(acc + i, a);
+         }
+
+         if(i < n)
+         {
+            acc[i] += _mm_cvtsd_f64(values[k][i]);
+            acc[i] += _mm_cvtsd_f64(_mm_unpackhi_pd(values[k][i], values[k][i]));
+         }
+      }
+   }
+#else
+   for(size_t k = 0; k < ps.re.size(); ++k)
+   {
+      const double c = ps.step_re[k], s = ps.step_im[k];
+      double re = ps.re[k], im = ps.im[k], lo = ps.lo[k], hi = ps.hi[k];
+
+      for(int i = 0; i < n; ++i)
+      {
+         const double r = c * re - s * im;
+         im = s * re + c * im;
+         re = r;
+
+         double f = (lo < hi) ? lo : hi;
+         f = (f > 0.0) ? f : 0.0;
+         f = (f < 1.0) ? f : 1.0;
+
+         acc[i] += r * f;
+
+         lo += sweep_low;
+         hi += sweep_high;
+      }
+
+      ps.re[k] = re;
+      ps.im[k] = im;
+      ps.lo[k] = lo;
+      ps.hi[k] = hi;
+   }
+#endif
+}
+
+// Renders the samples [begin, end) of one tone of an instrument, as MakeInstrument does, going
+// on from where the samples before begin left the partials. Only one channel is kept, as the
+// two are the same.
+static void makeTone(const Params& p, Partials& partials, double* out, int begin, int end)
+{
+   const double sweep_low = double(p.fslopelow) * double(p.fsweeplow);
+   const double sweep_high = double(p.fslopehigh) * double(p.fsweephigh);
+   const double num_partials = double(p.modes * p.fat);
+   const double gain = p.gain;
+
+   double acc[block_size];
+
+   for(int start = begin; start < end; start += block_size)
+   {
+      const int n = std::min(block_size, end - start);
+
+      std::fill(acc, acc + n, 0.0);
+      stepPartials(partials, sweep_low, sweep_high, acc, n);
+
+      for(int i = 0; i < n; ++i)
+         out[start + i] = acc[i] / sqrt(((gain - 1.0) * acc[i] * acc[i] + num_partials) / gain);
+   }
+}
+
+// Adds the notes of an instrument to the frames [begin, end) of the mix, which starts at frame
+// offset, as MakeChannel does. Each frame has the notes added in the same order whichever slice
+// it is in.
+static void mixSlice(const Instrument& ins, const double* const* tone_samples, double* mix, int offset, int begin, int end)
+{
+   const Params& p = ins.params;
+
+   const double release = p.release, attack = p.attack;
+
+   for(size_t i = 0; i < ins.notes.size(); ++i)
+   {
+      const Note& note = ins.notes[i];
+
+      if(note.pos >= end || note.pos + p.maxsamples <= begin)
+         continue;
+
+      const double volume = double(p.volume) * note.velocity;
+      const double left = volume * (1.0 - p.panning), right = volume * (1.0 + p.panning);
+
+      // the envelope is stepped from the start of the note, so that it rounds the same
+      double release_state = 1.0 - note.release_length * release, attack_state = 0.0;
+
+      int k = 0;
+
+      for(; k < begin - note.pos; ++k)
+      {
+         release_state += release;
+         attack_state += attack;
+      }
+
+      const double* src = tone_samples[note.tone];
+      const int k_end = std::min(p.maxsamples, end - note.pos);
+
+      for(; k < k_end; ++k)
+      {
+         double e = (release_state < attack_state) ? release_state : attack_state;
+         e = (e > 0.0) ? e : 0.0;
+         e = (e < 1.0) ? e : 1.0;
+
+         double* m = mix + size_t(note.pos + k - offset) * 2;
+         m[0] += src[k] * left * e;
+         m[1] += src[k] * right * e;
+
+         release_state += release;
+         attack_state += attack;
+      }
+   }
+}
+
+
+//// ********** Reverb **********
+
+namespace
+{
+
+// A delay line of the reverb, with the side of the mix which feeds it, and its volume and
+// feedback. The state of its filters and its buffer are only its own when the music is
+// streamed.
+struct DelayLine
+{
+   int length, side;
+   float volume;
+   long double decay;
+
+   int pos;
+   double state[4];
+   std::vector<double> buffer;
+};
+
+}
+
+// FILTER: a low-pass filter on the x87 stack, which keeps more precision than it stores
+static long double lowPass(long double x, float param, double& state)
+{
+   long double v = (x - state) * param + state;
+
+   // avoid denormals
+   v = (v + 1) - 1;
+
+   state = double(v);
+   return v;
+}
+
+static long double reverbFilter(long double x, const float* params, double* state)
+{
+   const long double high = lowPass(x, params[0], state[0]);
+   const long double low = lowPass(x, params[1], state[1]);
+   return high - low;
+}
+
+// The delay lines of the .delayloop in oidos.asm. The delay lengths are picked at random, and
+// each is fed by one side of the mix, taking turns. Returns the side the .sloop starts on.
+static int pickDelayLines(const Music& music, const unsigned int* random_data, std::vector<DelayLine>& lines)
+{
+   uint32_t delays_left = music.reverb_num_delays;
+   long double decay = music.reverb_max_decay;
+   float volume = music.reverb_volume_left;
+   int side = 0;
+
+   lines.clear();
+
+   for(uint32_t length = music.reverb_max_delay; length > 0; --length)
+   {
+      const uint64_t pick = uint64_t(length - uint32_t(music.reverb_min_delay)) *
+                            random_data[music.reverb_randomseed + length];
+
+      if(uint32_t(pick >> 32) < delays_left)
+      {
+         DelayLine line;
+         line.length = length;
+         line.side = side;
+         line.volume = volume;
+         line.decay = decay;
+         line.pos = 0;
+         std::fill(line.state, line.state + 4, 0.0);
+
+         lines.push_back(line);
+
+         volume = (volume == music.reverb_volume_left) ? music.reverb_volume_right : music.reverb_volume_left;
+         side ^= 1;
+
+         --delays_left;
+      }
+
+      decay *= music.reverb_decay_mul;
+   }
+
+   return side;
+}
+
+static void getReverbParams(const Music& music, float* params)
+{
+   params[0] = music.reverb_filter_high;
+   params[1] = music.reverb_filter_low;
+   params[2] = music.reverb_dampen_high;
+   params[3] = music.reverb_dampen_low;
+}
+
+// As oidos.asm, each delay line goes through the whole mix before the next, and hands on its
+// filter state and buffer to it.
+static void reverb(const Music& music, const std::vector<DelayLine>& lines, const double* mix, double* out)
+{
+   const int total = music.total_samples;
+   double* const added = out + size_t(music.reverb_add_delay) * 2;
+
+   float params[4];
+   getReverbParams(music, params);
+
+   double state[4] = { 0.0, 0.0, 0.0, 0.0 };
+   std::vector<double> delay_buffer(std::max(delay_buffer_size, music.reverb_max_delay), 0.0);
+   double* const delay = &delay_buffer[0];
+
+   for(size_t l = 0; l < lines.size(); ++l)
+   {
+      const DelayLine& line = lines[l];
+
+      for(int t = 0, j = 0; t < total; ++t)
+      {
+         const size_t i = size_t(t) * 2 + line.side;
+
+         const long double input = reverbFilter(mix[i], params, state);
+         const long double echo = reverbFilter(delay[j], params + 2, state + 2);
+
+         added[i] = double(delay[j] * (long double)line.volume + added[i]);
+         delay[j] = double(input + echo * line.decay);
+
+         if(++j == line.length)
+            j = 0;
+      }
+   }
+}
+
+// Feeds the frames [begin, end) of the mix, which starts at begin, through the delay lines in
+// the same order, but with each line going on from its own state. The delayed signal is added
+// to out, a ring of ring_size frames.
+static void reverbChunk(const Music& music, std::vector<DelayLine>& lines, const double* mix, double* out,
+                        int ring_size, int begin, int end)
+{
+   float params[4];
+   getReverbParams(music, params);
+
+   for(size_t l = 0; l < lines.size(); ++l)
+   {
+      DelayLine& line = lines[l];
+
+      if(line.buffer.empty())
+         line.buffer.assign(line.length, 0.0);
+
+      double* const delay = &line.buffer[0];
+
+      for(int t = begin; t < end; ++t)
+      {
+         const size_t i = size_t(t - begin) * 2 + line.side;
+         const size_t o = size_t((t + music.reverb_add_delay) % ring_size) * 2 + line.side;
+         const int j = line.pos;
+
+         const long double input = reverbFilter(mix[i], params, line.state);
+         const long double echo = reverbFilter(delay[j], params + 2, line.state + 2);
+
+         out[o] = double(delay[j] * (long double)line.volume + out[o]);
+         delay[j] = double(input + echo * line.decay);
+
+         if(++line.pos == line.length)
+            line.pos = 0;
+      }
+   }
+}
+
+// Clamps and converts to shorts as the .sloop does.
+static short toSample(double mix, const double* reverb)
+{
+   long double v = mix;
+
+   if(reverb)
+      v += *reverb;
+
+   if(v >= 32767)
+      v = 32767;
+
+   v = -v;
+
+   if(v >= 32767)
+      v = 32767;
+
+   v = -v;
+
+   return short(llrintl(v));
+}
+
+
+//// ********** Rendering **********
+
+void oidos::render(const Music& music, std::vector<short>& out, int num_threads)
+{
+   const size_t total = music.total_samples;
+
+   out.assign(total * 2, 0);
+
+   std::vector<Instrument> instruments;
+   std::string error;
+
+   if(!decode(music, instruments, error))
+      return;
+
+   std::vector<unsigned int> random_data;
+   fillRandomData(random_data);
+
+   if(num_threads <= 0)
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+   const int num_instruments = int(instruments.size());
+   const int num_with_reverb = music.num_tracks_with_reverb;
+
+   // Two instruments have their samples at a time, so that the next one is rendered while one
+   // is mixed.
+   size_t buffer_size = 0;
+
+   for(int i = 0; i < num_instruments; ++i)
+      buffer_size = std::max(buffer_size, instruments[i].tones.size() * instruments[i].params.maxsamples);
+
+   std::vector<double> buffers[2];
+   std::vector<double> mix(total * 2, 0.0), reverb_out;
+
+   std::vector<DelayLine> lines;
+   int end_side = 0;
+
+   if(num_with_reverb > 0)
+   {
+      reverb_out.assign((total + music.reverb_add_delay) * 2, 0.0);
+      end_side = pickDelayLines(music, &random_data[0], lines);
+   }
+
+   std::vector<ThreadPool::Batch> tone_batches(num_instruments), mix_batches(num_instruments);
+   ThreadPool::Batch reverb_batch;
+
+   std::vector<const double*> tone_samples[2];
+
+   {
+      ThreadPool pool(num_threads);
+
+      for(int i = 0; i < std::min(num_instruments, 2); ++i)
+         buffers[i].resize(buffer_size);
+
+      const auto addTones = [&](int i)
+      {
+         const Instrument& ins = instruments[i];
+         double* const samples = &buffers[i % 2][0];
+
+         for(size_t t = 0; t < ins.tones.size(); ++t)
+            pool.add(tone_batches[i], [&ins, samples, t, &random_data]()
+            {
+               Partials partials;
+               setupPartials(ins.params, ins.tones[t], &random_data[0], partials);
+               makeTone(ins.params, partials, samples + t * ins.params.maxsamples, 0, ins.params.maxsamples);
+            });
+      };
+
+      for(int i = 0; i < std::min(num_instruments, 2); ++i)
+         addTones(i);
+
+      for(int i = 0; i < num_instruments; ++i)
+      {
+         pool.wait(tone_batches[i]);
+
+         // the instruments without reverb are not mixed until the reverb has read the mix
+         if(i == num_with_reverb)
+            pool.wait(reverb_batch);
+
+         const Instrument& ins = instruments[i];
+
+         std::vector<const double*>& samples = tone_samples[i % 2];
+         samples.resize(ins.tones.size());
+
+         for(size_t t = 0; t < ins.tones.size(); ++t)
+            samples[t] = &buffers[i % 2][t * ins.params.maxsamples];
+
+         for(size_t begin = 0; begin < total; begin += slice_size)
+         {
+            const int end = int(std::min(total, begin + slice_size));
+
+            pool.add(mix_batches[i], [&ins, &samples, &mix, begin, end]()
+            {
+               mixSlice(ins, &samples[0], &mix[0], 0, int(begin), end);
+            }, true);
+         }
+
+         pool.wait(mix_batches[i]);
+
+         if(i == num_with_reverb - 1)
+            pool.add(reverb_batch, [&]()
+            {
+               reverb(music, lines, &mix[0], &reverb_out[0]);
+            }, true);
+
+         if(i + 2 < num_instruments)
+            addTones(i + 2);
+      }
+
+      pool.wait(reverb_batch);
+   }
+
+   // Without instruments after the reverb, oidos.asm starts converting on the side the reverb
+   // ended on, and leaves the first sample at zero.
+   const size_t start = (num_with_reverb > 0 && music.num_tracks_without_reverb == 0) ? end_side : 0;
+
+   for(size_t i = start; i < total * 2; ++i)
+      out[i] = toSample(mix[i], (num_with_reverb > 0) ? &reverb_out[i] : NULL);
+}
+
+
+//// ********** Streaming **********
+
+namespace
+{
+
+// A tone which is rendered as far as the chunks need, from the first note which plays it.
+// It is let go of after the end of the last one.
+struct StreamTone
+{
+   const Instrument* ins;
+   int tone;
+   int first_pos, last_end;
+
+   Partials partials;
+   std::unique_ptr<double[]> samples;
+   int rendered;
+
+   int neededBy(int frame) const
+   {
+      return (first_pos < frame) ? std::min(ins->params.maxsamples, frame - first_pos) : 0;
+   }
+};
+
+}
+
+struct oidos::Stream::State
+{
+   Music music;
+   int num_threads;
+
+   std::vector<short> out;
+   std::atomic<int> rendered;
+   std::atomic<bool> stopping;
+
+   mutable std::mutex mutex;
+   mutable std::condition_variable progress;
+
+   std::thread thread;
+
+   void run();
+   void finish(int frames);
+};
+
+oidos::Stream::Stream(const Music& music, int num_threads): state(new State)
+{
+   state->music = music;
+   state->num_threads = (num_threads > 0) ? num_threads : std::max(1u, std::thread::hardware_concurrency());
+   state->out.assign(size_t(music.total_samples) * 2, 0);
+   state->rendered = 0;
+   state->stopping = false;
+}
+
+oidos::Stream::~Stream()
+{
+   state->stopping = true;
+
+   if(state->thread.joinable())
+      state->thread.join();
+
+   delete state;
+}
+
+void oidos::Stream::start()
+{
+   if(!state->thread.joinable())
+      state->thread = std::thread(&State::run, state);
+}
+
+int oidos::Stream::getRenderedFrames() const
+{
+   return state->rendered.load(std::memory_order_acquire);
+}
+
+bool oidos::Stream::isFinished() const
+{
+   return getRenderedFrames() >= state->music.total_samples;
+}
+
+void oidos::Stream::waitForLead(int lead_frames) const
+{
+   std::unique_lock<std::mutex> lock(state->mutex);
+
+   while(getRenderedFrames() < std::min(lead_frames, state->music.total_samples) && !state->stopping)
+      state->progress.wait(lock);
+}
+
+const short* oidos::Stream::getSamples() const
+{
+   return &state->out[0];
+}
+
+float oidos::Stream::getPosition(int played_frames) const
+{
+   const int frames = std::min(played_frames + timer_offset, getRenderedFrames());
+   return float(double(frames) / state->music.samples_per_tick);
+}
+
+void oidos::Stream::State::finish(int frames)
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      rendered.store(frames, std::memory_order_release);
+   }
+
+   progress.notify_all();
+}
+
+void oidos::Stream::State::run()
+{
+   const int total = music.total_samples;
+
+   std::vector<Instrument> instruments;
+   std::string error;
+
+   if(!decode(music, instruments, error))
+   {
+      finish(total);
+      return;
+   }
+
+   std::vector<unsigned int> random_data;
+   fillRandomData(random_data);
+
+   const int num_instruments = int(instruments.size());
+   const int num_with_reverb = music.num_tracks_with_reverb;
+
+   std::vector<StreamTone> tones;
+   std::vector<std::vector<const double*> > tone_samples(num_instruments);
+
+   for(int i = 0; i < num_instruments; ++i)
+   {
+      const Instrument& ins = instruments[i];
+
+      tone_samples[i].assign(ins.tones.size(), NULL);
+
+      for(size_t t = 0; t < ins.tones.size(); ++t)
+      {
+         StreamTone tone;
+         tone.ins = &ins;
+         tone.tone = int(t);
+         tone.first_pos = INT_MAX;
+         tone.last_end = 0;
+         tone.rendered = 0;
+
+         for(size_t n = 0; n < ins.notes.size(); ++n)
+            if(ins.notes[n].tone == int(t))
+            {
+               tone.first_pos = std::min(tone.first_pos, ins.notes[n].pos);
+               tone.last_end = std::max(tone.last_end, ins.notes[n].pos + ins.params.maxsamples);
+            }
+
+         tones.push_back(std::move(tone));
+      }
+   }
+
+   std::vector<DelayLine> lines;
+   int end_side = 0;
+
+   if(num_with_reverb > 0)
+      end_side = pickDelayLines(music, &random_data[0], lines);
+
+   // the reverb is added a ring of frames ahead of the chunk
+   const int ring_size = chunk_size + music.reverb_add_delay;
+   std::vector<double> mix(size_t(chunk_size) * 2), ring(size_t(ring_size) * 2, 0.0);
+
+   const size_t start = (num_with_reverb > 0 && music.num_tracks_without_reverb == 0) ? end_side : 0;
+
+   ThreadPool::Batch tone_batches[2];
+   ThreadPool pool(num_threads);
+
+   // While a chunk is mixed, the tones are rendered on for the next one.
+   const auto addTones = [&](ThreadPool::Batch& batch, int frame)
+   {
+      for(size_t i = 0; i < tones.size(); ++i)
+      {
+         StreamTone* const tone = &tones[i];
+         const int needed = tone->neededBy(frame);
+
+         if(needed <= tone->rendered)
+            continue;
+
+         pool.add(batch, [tone, needed, &random_data]()
+         {
+            const Params& p = tone->ins->params;
+
+            if(!tone->samples)
+            {
+               tone->samples.reset(new double[p.maxsamples]);
+               setupPartials(p, tone->ins->tones[tone->tone], &random_data[0], tone->partials);
+            }
+
+            makeTone(p, tone->partials, tone->samples.get(), tone->rendered, needed);
+            tone->rendered = needed;
+         });
+      }
+   };
+
+   const auto mixInstruments = [&](int first, int last, int begin, int end)
+   {
+      ThreadPool::Batch batch;
+
+      for(int slice = begin; slice < end; slice += chunk_slice_size)
+      {
+         const int slice_end = std::min(end, slice + chunk_slice_size);
+
+         pool.add(batch, [&, slice, slice_end]()
+         {
+            for(int i = first; i < last; ++i)
+               mixSlice(instruments[i], &tone_samples[i][0], &mix[0], begin, slice, slice_end);
+         }, true);
+      }
+
+      pool.wait(batch);
+   };
+
+   addTones(tone_batches[0], std::min(total, chunk_size));
+
+   for(int begin = 0, c = 0; begin < total && !stopping; begin += chunk_size, ++c)
+   {
+      const int end = std::min(total, begin + chunk_size);
+
+      pool.wait(tone_batches[c % 2]);
+
+      for(size_t i = 0; i < tones.size(); ++i)
+         tone_samples[tones[i].ins - &instruments[0]][tones[i].tone] = tones[i].samples.get();
+
+      if(end < total)
+         addTones(tone_batches[(c + 1) % 2], std::min(total, end + chunk_size));
+
+      std::fill(mix.begin(), mix.end(), 0.0);
+
+      mixInstruments(0, num_with_reverb, begin, end);
+
+      if(num_with_reverb > 0)
+         reverbChunk(music, lines, &mix[0], &ring[0], ring_size, begin, end);
+
+      mixInstruments(num_with_reverb, num_instruments, begin, end);
+
+      for(int t = begin; t < end; ++t)
+         for(int side = 0; side < 2; ++side)
+         {
+            const size_t i = size_t(t) * 2 + side;
+            double* const reverb = &ring[size_t(t % ring_size) * 2 + side];
+
+            if(i >= start)
+               out[i] = toSample(mix[size_t(t - begin) * 2 + side], (num_with_reverb > 0) ? reverb : NULL);
+
+            *reverb = 0.0;
+         }
+
+      finish(end);
+
+      for(size_t i = 0; i < tones.size(); ++i)
+         if(tones[i].samples && tones[i].last_end <= end)
+         {
+            tone_samples[tones[i].ins - &instruments[0]][tones[i].tone] = NULL;
+            tones[i].samples.reset();
+         }
+   }
+
+   pool.wait(tone_batches[0]);
+   pool.wait(tone_batches[1]);
+}
@@ -0,0 +1,112 @@
+#ifndef _OIDOS_RENDER_H_
+#define _OIDOS_RENDER_H_
+
+// Portable renderer for Oidos music, for rendering it outside of the intro (see
+// _linux/main_render.cpp). It reads the music.asm written by the Oidos converter and renders
+// the same sound as Oidos_GenerateMusic in oidos.asm, spread over all cores.
+//
+// The instruments are rendered one tone at a time, as in oidos.asm, but the tones are jobs for
+// a pool of threads, and the partials of a tone are stepped two at a time with SSE2. The notes
+// of an instrument are mixed in parallel slices of the music. The arithmetic of the partials,
+// the mixing and the reverb is done in the same order and precision as in oidos.asm, so the
+// result only differs from the intro's where the x87 functions used to set up the partials
+// round differently from the C library's. Build without -ffast-math, and with
+// -ffp-contract=off if the target has FMA.
+//
+// A Stream renders the music in the background in time order instead, so that it can be
+// played before it is finished.
+
+#include <string>
+#include <vector>
+
+namespace oidos
+{
+
+static const int noise_size = 64;
+static const int sample_rate = 44100;
+
+// OIDOS_TIMER_OFFSET in oidos.asm, in frames
+static const int timer_offset = 2048;
+
+// The %defines and tables of a music.asm. The tables are the bytes of the dd and db lines
+// under their labels.
+struct Music
+{
+   int music_length;
+   int total_samples;
+   int max_total_instrument_samples;
+   int samples_per_tick;
+   float ticks_per_second;
+
+   int num_tracks_with_reverb, num_tracks_without_reverb;
+
+   int reverb_num_delays, reverb_min_delay, reverb_max_delay, reverb_add_delay;
+   int reverb_randomseed;
+   float reverb_max_decay, reverb_decay_mul;
+   float reverb_filter_high, reverb_filter_low, reverb_dampen_high, reverb_dampen_low;
+   float reverb_volume_left, reverb_volume_right;
+
+   bool uses_panning;
+
+   std::vector<unsigned char> instrument_params;
+   std::vector<unsigned char> instrument_tones;
+   std::vector<unsigned char> track_data;
+   std::vector<unsigned char> note_lengths;
+   std::vector<unsigned char> note_samples;
+};
+
+// Returns false with a message in error if the file can't be read or lacks a define or table.
+bool loadMusic(const char* filename, Music& music, std::string& error);
+
+// The same noise_size^3 values as Oidos_FillRandomData puts in Oidos_RandomData.
+void fillRandomData(std::vector<unsigned int>& data);
+
+// Renders the whole music as total_samples frames of interleaved left and right samples.
+// With num_threads 0 there is one thread per core.
+void render(const Music& music, std::vector<short>& out, int num_threads = 0);
+
+// Renders the music in chunks from the start, on a thread of its own and num_threads more.
+// Each (instrument, tone) is rendered only as far as the chunk needs, and goes on from there
+// for the next chunk. The frames which are finished only grow, so they can be played while the
+// rest is rendered.
+// The tones are kept from their first note to the end of their last, so a stream takes more
+// memory than render(), which only has two instruments' tones at a time.
+// Each delay line of the reverb keeps its own state from one chunk to the next, where
+// oidos.asm runs each through the whole music and then hands its state on to the next. So the
+// reverb differs from that of render() by what the lines carry over, which is the tail of the
+// music. Everything else is the same. _linux/check_render.sh checks how far the two differ.
+class Stream
+{
+   public:
+      Stream(const Music& music, int num_threads = 0);
+
+      // Stops rendering.
+      ~Stream();
+
+      void start();
+
+      // The number of frames of getSamples() which are finished.
+      int getRenderedFrames() const;
+      bool isFinished() const;
+
+      // Blocks until lead_frames are finished, or all of them if there are fewer.
+      void waitForLead(int lead_frames) const;
+
+      // total_samples frames of interleaved left and right samples
+      const short* getSamples() const;
+
+      // Oidos_GetPosition for a playback position, in ticks. It doesn't pass the finished
+      // frames, so that the visuals wait for the music if playback catches up with it.
+      float getPosition(int played_frames) const;
+
+   private:
+      Stream(const Stream&);
+      Stream& operator=(const Stream&);
+
+      struct State;
+      State* state;
+};
+
+}
+
+#endif
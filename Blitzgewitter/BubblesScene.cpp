@@ -4,6 +4,7 @@
 #include "Ran.hpp"
 #include "Particles.hpp"
 #include "Tower.hpp"
+#include "MotionBlur.hpp"
 
 #include <list>
 
@@ -43,8 +44,8 @@ private:
    GLushort spiral_num_vertices[3], spiral_num_indices[3];
 
    Shader bokeh_shader, bokeh2_shader;
-   Shader gaussbokeh_shader, composite_shader;
-   Shader mb_accum_shader;
+   Shader composite_shader;
+   motionblur::Scheduler motion_blur;
    Shader screendisplay_shader;
    Shader bgfg_shader;
    Shader bubbles_post_shader;
@@ -78,7 +79,6 @@ private:
    void drawView(float ltime);
    void drawMonster(float ltime);
    void createSpiral(int fart);
-   void gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0);
 
    void genSpiralPoints(int fart);
 
@@ -151,16 +151,16 @@ void BubblesScene::initializeTextures()
 {
    glGenTextures(num_texs, texs);
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
-   createWindowTexture(texs[12], GL_RGBA16F, 2);
-   createWindowTexture(texs[13], GL_RGBA16F, 2);
-   createWindowTexture(texs[14], GL_R16F, g_bubbles_div);
-   createWindowTexture(texs[15], GL_R16F, g_bubbles_div2);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[12], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[14], GL_R16F, g_bubbles_div);
+   acquireWindowTexture(texs[15], GL_R16F, g_bubbles_div2);
 
    CHECK_FOR_ERRORS;
 
@@ -204,10 +204,8 @@ void BubblesScene::initializeBuffers()
    bubbles_fbo[0] = fbos[14];
    bubbles_fbo[1] = fbos[15];
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -273,11 +271,8 @@ void BubblesScene::initializeShaders()
    bokeh2_shader.uniform1i("tex2", 1);
    bokeh2_shader.uniform1f("aspect_ratio", float(window_height) / float(window_width));
 
-   gaussbokeh_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "gaussblur_f.glsl");
-   gaussbokeh_shader.uniform1i("tex0", 0);
 
-   mb_accum_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_accum_f.glsl");
-   mb_accum_shader.uniform1i("tex0", 0);
+   motion_blur.loadShaders();
 
 
    composite_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "cubes_composite_f.glsl");
@@ -503,78 +498,6 @@ void BubblesScene::drawMonster(float ltime)
    }
 }
 
-void BubblesScene::gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0)
-{
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLfloat coords[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glEnableVertexAttribArray(0);
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
-
-   glViewport(0, 0, window_width / 4, window_height / 4);
-
-   // gaussian blur pass 1
-
-   {
-      gaussbokeh_shader.uniform4f("tint", tint_r, tint_g, tint_b, 1.0f);
-   }
-
-   const float gauss_radx = radx;
-   const float gauss_rady = rady;
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo0);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   glDepthMask(GL_FALSE);
-   glDisable(GL_DEPTH_TEST);
-
-   gaussbokeh_shader.bind();
-   gaussbokeh_shader.uniform2f("direction", gauss_radx * float(window_height) / float(window_width), 0.0f);
-
-   glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, src_tex);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-
-
-   // gaussian blur pass 2
-
-   gaussbokeh_shader.uniform4f("tint", 1, 1, 1, 1);
-
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo1);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   gaussbokeh_shader.uniform2f("direction", 0.0f, gauss_rady);
-
-   glBindTexture(GL_TEXTURE_2D, tex0);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-   glDisableVertexAttribArray(0);
-   glDisableVertexAttribArray(1);
-
-   CHECK_FOR_ERRORS;
-}
-
 
 void BubblesScene::render()
 {
@@ -587,6 +510,8 @@ void BubblesScene::render()
    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
 
+   motion_blur.beginFrame(time, window_width, window_height);
+
    for(int nn = 0; nn < 2; ++nn)
    {
 //if(drawing_view_for_background) continue; // **********************************************************************************
@@ -599,8 +524,8 @@ void BubblesScene::render()
       glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[3]);
       glClear(GL_COLOR_BUFFER_BIT);
 
-      num_subframes = drawing_view_for_background ? 1 : 7;
-      subframe_scale = 1.0/35.0;
+      num_subframes = drawing_view_for_background ? 1 : motion_blur.getSubframeCount();
+      subframe_scale = motion_blur.getShutter();
 
       for(int subframe = 0;subframe<num_subframes;++subframe)
       {
@@ -634,6 +559,10 @@ void BubblesScene::render()
          }
          modelview = modelview * Mat4::rotation(M_PI/2, Vec3(0.0f, 1.0f, 0.0f));
 
+         // the camera of the view which is displayed, not of the background pass
+         if(!drawing_view_for_background)
+            motion_blur.observe(projection, modelview);
+
          screendisplay_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
 
 for(int fart=0;fart<3;++fart)
@@ -717,9 +646,7 @@ for(int fart=0;fart<3;++fart)
 
          glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[3]);
 
-         mb_accum_shader.bind();
-         mb_accum_shader.uniform1f("time", float(subframe) / float(num_subframes));
-         mb_accum_shader.uniform1f("scale", 1.0f / float(num_subframes));
+         motion_blur.bindAccumulation(num_subframes);
 
          glDepthMask(GL_FALSE);
          glDisable(GL_DEPTH_TEST);
@@ -899,8 +826,10 @@ for(int fart=0;fart<3;++fart)
 
 void BubblesScene::free()
 {
+   releaseWindowTargets();
    glDeleteTextures(num_monster_texs,monster_texs);
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
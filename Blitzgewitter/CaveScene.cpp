@@ -4,6 +4,8 @@
 #include "Engine.hpp"
 #include "Bezier.hpp"
 #include "Ran.hpp"
+#include "Noise.hpp"
+#include "Surface.hpp"
 #include "Particles.hpp"
 #include <omp.h>
 
@@ -22,7 +24,7 @@ static long int lrand()
 class CaveScene: public Scene
 {
    Shader cave_shader;
-   Shader gaussbokeh_shader, composite_shader;
+   Shader composite_shader;
    Shader mb_accum_shader;
    Shader bgfg_shader;
    Shader water_shader;
@@ -74,16 +76,10 @@ class CaveScene: public Scene
 
    GLuint tet_tex;
 
-   static const int random_grid_w = 256;
-   static const int random_grid_h = 256;
-
-   float random_grid[random_grid_w*random_grid_h];
+   noise::RandomGrid random_grid;
 
    Vec3 tetrahedronPath(int tet,float ltime);
 
-   void initRandomGrid();
-   float randomGridLookup(float u, float v, int w=random_grid_w, int h=random_grid_h) const;
-
    void initCaveMesh();
    void initWaterMesh();
 
@@ -91,15 +87,12 @@ class CaveScene: public Scene
    void drawTetrahedra(const Mat4& modelview, float ltime);
    void drawWater(float ltime);
 
-   Vec3 evaluateCaveSurface(float u,float v);
-   Vec3 evaluateWaterSurface(float u,float v);
    void slowInitialize();
    void initializeTextures();
    void initializeShaders();
    void initializeBuffers();
 
    void drawView(float ltime);
-   void gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0);
 
 
    public:
@@ -127,113 +120,89 @@ static T sq(const T& x)
    return x*x;
 }
 
-void CaveScene::initRandomGrid()
+namespace
+{
+
+class WaterSurface: public surface::Surface
 {
-   for(int y=0;y<random_grid_h;++y)
-      for(int x=0;x<random_grid_w;++x)
+   public:
+      void evaluateRow(const float* u, float v, float* out, int n) const
       {
-         random_grid[x+y*random_grid_w]=(frand()-0.5)*2.0;
+         for(int i=0;i<n;++i)
+         {
+            out[i*3+0]=u[i]*2.0-1.0;
+            out[i*3+1]=0;
+            out[i*3+2]=v*2.0-1.0;
+         }
       }
-}
+};
 
-float CaveScene::randomGridLookup(float u, float v, int w, int h) const
+class CaveSurface: public surface::Surface
 {
-   if(w>random_grid_w)
-      w=random_grid_w;
-
-   if(h>random_grid_h)
-      h=random_grid_h;
-
-   u=fmodf(u,float(w));
-   v=fmodf(v,float(h));
-
-   if(u<0)
-      u+=w;
-
-   if(v<0)
-      v+=h;
-
-   const int iu=int(u);
-   const int iv=int(v);
+   static const int num_octaves=10;
 
-   const float fu=u-float(iu);
-   const float fv=v-float(iv);
+   const noise::RandomGrid& random_grid;
+   float octave_scale[num_octaves], octave_weight[num_octaves];
 
-   const float a=random_grid[iu+iv*w];
-   const float b=random_grid[((iu+1)%w)+iv*w];
-   const float c=random_grid[((iu+1)%w)+((iv+1)%h)*w];
-   const float d=random_grid[iu+((iv+1)%h)*w];
+   public:
+      CaveSurface(const noise::RandomGrid& random_grid): random_grid(random_grid)
+      {
+         for(int i=0;i<num_octaves;++i)
+         {
+            octave_scale[i]=std::pow(2.0f,float(i));
+            octave_weight[i]=1.0f/std::pow(2.0f,float(i+1));
+         }
+      }
 
-   return (1.0-fv)*((1.0-fu)*a+fu*b) + fv*((1.0-fu)*d+fu*c);
-}
+      void evaluateRow(const float* u, float v, float* out, int n) const
+      {
+         v*=2.0;
 
-Vec3 CaveScene::evaluateWaterSurface(float u,float v)
-{
-   return Vec3(u*2.0-1.0,0,v*2.0-1.0);
-}
+         // everything but the noise is constant along a row
+         const float c=cubic(clamp(v/0.6f,0.0f,1.0f));
+         const float l0=0.1f+std::pow(c,mix(1.0f,0.2f,std::pow(v,0.15f)))+cubic(clamp((v-0.9f)/0.1f,0.0f,1.0f))*0.075f;
+         const float y0=1.0f-v;
 
-Vec3 CaveScene::evaluateCaveSurface(float u,float v)
-{
-   v*=2.0;
+         std::vector<float> f(n,0.0f), su(n), sv(n), g(n);
 
-   float l=0.1f+std::pow(cubic(clamp(v/0.6f,0.0f,1.0f)),mix(1.0f,0.2f,std::pow(v,0.15f)));
+         for(int i=0;i<num_octaves;++i)
+         {
+            for(int k=0;k<n;++k)
+            {
+               su[k]=(u[k]*64)*octave_scale[i];
+               sv[k]=(v*8)*octave_scale[i];
+            }
 
-   float f=0.0f;
-   for(int i=0;i<10;++i)
-   {
-      f+=randomGridLookup((u*64)*std::pow(2.0f,float(i)),(v*8)*std::pow(2.0f,float(i)),64<<i,8<<i)/std::pow(2.0f,float(i+1));
-   }
+            random_grid.lookup(&su[0],&sv[0],&g[0],n,64<<i,8<<i);
 
-   float y=1.0f-v;
+            for(int k=0;k<n;++k)
+               f[k]+=g[k]*octave_weight[i];
+         }
 
-   l-=f*0.18*cubic(clamp(v/0.6f,0.0f,1.0f));
-   y-=f*0.1*cubic(clamp(v/0.6f,0.0f,1.0f));
+         for(int k=0;k<n;++k)
+         {
+            const float l=l0-f[k]*0.18f*c;
+            const float a=u[k]*M_PI*2;
+            out[k*3+0]=std::cos(a)*l;
+            out[k*3+1]=y0-f[k]*0.1f*c;
+            out[k*3+2]=std::sin(a)*l;
+         }
+      }
+};
 
-   l+=cubic(clamp((v-0.9f)/0.1f,0.0f,1.0f))*0.075f;
-   float a=u*M_PI*2;
-   return Vec3(std::cos(a)*l,y,std::sin(a)*l);
 }
 
 void CaveScene::initCaveMesh()
 {
-   Mat4 cave_xfrm=Mat4::identity();
-
-   for(int v=0;v<cave_mesh_num_v;++v)
-   {
-      for(int u=0;u<cave_mesh_num_u;++u)
-      {
-         float fu=float(u)/float(cave_mesh_num_u-1);
-         float fv=float(v)/float(cave_mesh_num_v-1);
+   surface::Grid grid(cave_mesh_num_u, cave_mesh_num_v);
+   grid.wrap_u=true;
+   grid.normal_eps=1e-3;
+   grid.vertices=cavemesh_vertices;
+   grid.coords=cavemesh_coords;
+   grid.normals=cavemesh_normals;
+   grid.indices=cavemesh_indices;
 
-         static const float eps=1e-3;
-
-         Vec3 p0 = cave_xfrm * evaluateCaveSurface(fu,fv);
-         Vec3 p1 = cave_xfrm * evaluateCaveSurface(fu+eps,fv);
-         Vec3 p2 = cave_xfrm * evaluateCaveSurface(fu,fv+eps);
-
-         Vec3 nrm=(p1-p0).cross(p2-p0);
-         float nrml=std::sqrt(nrm.lengthSquared());
-         assert(nrml>0.0f);
-         nrm=nrm*1.0f/nrml;
-
-         cavemesh_coords[(u+v*cave_mesh_num_u)*2+0]=fu;
-         cavemesh_coords[(u+v*cave_mesh_num_u)*2+1]=fv;
-
-         cavemesh_vertices[(u+v*cave_mesh_num_u)*3+0]=p0.x;
-         cavemesh_vertices[(u+v*cave_mesh_num_u)*3+1]=p0.y;
-         cavemesh_vertices[(u+v*cave_mesh_num_u)*3+2]=p0.z;
-
-         cavemesh_normals[(u+v*cave_mesh_num_u)*3+0]=nrm.x;
-         cavemesh_normals[(u+v*cave_mesh_num_u)*3+1]=nrm.y;
-         cavemesh_normals[(u+v*cave_mesh_num_u)*3+2]=nrm.z;
-
-         if(v<(cave_mesh_num_v-1))
-         {
-            cavemesh_indices[(u+v*cave_mesh_num_u)*2+0]=u+(v+0)*cave_mesh_num_u;
-            cavemesh_indices[(u+v*cave_mesh_num_u)*2+1]=u+(v+1)*cave_mesh_num_u;
-         }
-      }
-   }
+   surface::tessellate(CaveSurface(random_grid), Mat4::identity(), grid);
 
    glGenBuffers(1,&cavemesh_vbo);
    glGenBuffers(1,&cavemesh_ebo);
@@ -262,26 +231,11 @@ void CaveScene::initWaterMesh()
 {
    Mat4 water_xfrm = Mat4::translation(Vec3(0.0,0.0,0.0)) * Mat4::scale(Vec3(2.0,0.0,2.0));
 
-   for(int v=0;v<water_mesh_num_v;++v)
-   {
-      for(int u=0;u<water_mesh_num_u;++u)
-      {
-         float fu=float(u)/float(water_mesh_num_u-1);
-         float fv=float(v)/float(water_mesh_num_v-1);
-
-         Vec3 p0 = water_xfrm * evaluateWaterSurface(fu,fv);
+   surface::Grid grid(water_mesh_num_u, water_mesh_num_v);
+   grid.vertices=watermesh_vertices;
+   grid.indices=watermesh_indices;
 
-         watermesh_vertices[(u+v*water_mesh_num_u)*3+0]=p0.x;
-         watermesh_vertices[(u+v*water_mesh_num_u)*3+1]=p0.y;
-         watermesh_vertices[(u+v*water_mesh_num_u)*3+2]=p0.z;
-
-         if(v<(water_mesh_num_v-1))
-         {
-            watermesh_indices[(u+v*water_mesh_num_u)*2+0]=u+(v+0)*water_mesh_num_u;
-            watermesh_indices[(u+v*water_mesh_num_u)*2+1]=u+(v+1)*water_mesh_num_u;
-         }
-      }
-   }
+   surface::tessellate(WaterSurface(), water_xfrm, grid);
 
    glGenBuffers(1,&watermesh_vbo);
    glGenBuffers(1,&watermesh_ebo);
@@ -304,7 +258,7 @@ void CaveScene::slowInitialize()
 {
    tet_tex=loadTexture(IMAGES_PATH "tet.png",true);
 
-   initRandomGrid();
+   random_grid.fill(frand);
 
    initCaveMesh();
    initWaterMesh();
@@ -323,12 +277,12 @@ void CaveScene::initializeTextures()
 {
    glGenTextures(num_texs, texs);
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
 
    CHECK_FOR_ERRORS;
 
@@ -387,10 +341,8 @@ void CaveScene::initializeBuffers()
    glGenFramebuffers(num_fbos, fbos);
    glGenRenderbuffers(num_fbos, renderbuffers);
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -439,8 +391,6 @@ void CaveScene::initializeShaders()
    cave_shader.uniform1i("tex0",0);
    cave_shader.uniform1i("tex1",1);
 
-   gaussbokeh_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "gaussblur_f.glsl");
-   gaussbokeh_shader.uniform1i("tex0", 0);
 
    mb_accum_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_accum_f.glsl");
    mb_accum_shader.uniform1i("tex0", 0);
@@ -704,78 +654,6 @@ void CaveScene::drawView(float ltime)
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void CaveScene::gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0)
-{
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLfloat coords[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glEnableVertexAttribArray(0);
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
-
-   glViewport(0, 0, window_width / 4, window_height / 4);
-
-   // gaussian blur pass 1
-
-   {
-      gaussbokeh_shader.uniform4f("tint", tint_r, tint_g, tint_b, 1.0f);
-   }
-
-   const float gauss_radx = radx;
-   const float gauss_rady = rady;
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo0);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   glDepthMask(GL_FALSE);
-   glDisable(GL_DEPTH_TEST);
-
-   gaussbokeh_shader.bind();
-   gaussbokeh_shader.uniform2f("direction", gauss_radx * float(window_height) / float(window_width), 0.0f);
-
-   glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, src_tex);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-
-
-   // gaussian blur pass 2
-
-   gaussbokeh_shader.uniform4f("tint", 1, 1, 1, 1);
-
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo1);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   gaussbokeh_shader.uniform2f("direction", 0.0f, gauss_rady);
-
-   glBindTexture(GL_TEXTURE_2D, tex0);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-   glDisableVertexAttribArray(0);
-   glDisableVertexAttribArray(1);
-
-   CHECK_FOR_ERRORS;
-}
-
 
 void CaveScene::render()
 {
@@ -885,10 +763,12 @@ void CaveScene::render()
 
 void CaveScene::free()
 {
+   releaseWindowTargets();
    glDeleteTextures(1,&tet_tex);
    glDeleteBuffers(1,&cavemesh_vbo);
    glDeleteBuffers(1,&cavemesh_ebo);
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
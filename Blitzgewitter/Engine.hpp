@@ -4,12 +4,14 @@
 //#define NDEBUG
 
 #include <vector>
+#include <string>
 #include "gl3w/include/GL3/gl3w.h"
 #include <cassert>
 #include <algorithm>
 #include <set>
 
 #include <cstdio>
+#include <cstdarg>
 
 #include "Mat.hpp"
 
@@ -87,16 +89,52 @@ class Spline
     {
         T point;
         uint frame_num;
+        bool valid;
 
     } cache;
 
+    // index of the segment which was last evaluated, so that playback moving forwards
+    // through the frames can find the next segment without searching.
+    mutable uint cursor;
+
     std::vector<Node> nodes;
     uint nodes_size;
     bool initialized;
 
+    // returns the index of the node which begins the segment containing frame_num, such that
+    // nodes[i].frame_num <= frame_num < nodes[i + 1].frame_num. frame_num must lie strictly
+    // inside the range of the spline.
+    uint findSegment(const uint frame_num) const
+    {
+        uint i = cursor;
+
+        if(i + 1 < nodes_size && nodes[i].frame_num <= frame_num)
+        {
+            // step forwards a few segments before giving up and searching
+            for(uint steps = 0; steps < 4; ++steps, ++i)
+                if(frame_num < nodes[i + 1].frame_num)
+                    return cursor = i;
+        }
+
+        int start = 0, end = nodes_size - 1;
+
+        while(start < end - 1)
+        {
+            const int mid = (start + end) / 2;
+            if(frame_num >= nodes[mid].frame_num)
+                start = mid;
+            else
+                end = mid;
+        }
+
+        return cursor = start;
+    }
+
     public:
-        Spline() : nodes_size(0), initialized(false)
+        Spline() : cursor(0), nodes_size(0), initialized(false)
         {
+            cache.frame_num = 0;
+            cache.valid = false;
         }
 
         void insert(const T& point, const T& tangent, const uint frame_num)
@@ -113,6 +151,8 @@ class Spline
             std::sort(nodes.begin(), nodes.end());
             nodes_size = nodes.size();
             initialized = true;
+            cursor = 0;
+            cache.valid = false;
         }
 
         void repeat(const uint start, const uint end, const uint offset)
@@ -127,6 +167,8 @@ class Spline
                   nodes.push_back(n);
                }
             }
+            cursor = 0;
+            cache.valid = false;
         }
 
         T evaluate(const uint frame_num) const
@@ -134,32 +176,17 @@ class Spline
             assert(initialized == true);
             assert(nodes_size > 0);
 
-            if(cache.frame_num == frame_num)
+            if(cache.valid && cache.frame_num == frame_num)
                return cache.point;
 
-            int start = 0, end = nodes_size - 1;
-
-            do
-            {
-                const int mid = (start + end) / 2;
-                const Node& node = nodes[mid];
-                if(frame_num > node.frame_num)
-                    start = mid;
-                else
-                    end = mid;
-
-            } while(start < end - 1);
-
-            const Node &n0 = nodes[start], &n1 = nodes[end];
+            if(frame_num <= nodes[0].frame_num)
+                return nodes[0].point;
 
-            if(start == end)
-                return n0.point;
+            if(frame_num >= nodes[nodes_size - 1].frame_num)
+                return nodes[nodes_size - 1].point;
 
-            if(n1.frame_num <= frame_num)
-                return n1.point;
-
-            if(n0.frame_num >= frame_num)
-                return n0.point;
+            const uint i = findSegment(frame_num);
+            const Node &n0 = nodes[i], &n1 = nodes[i + 1];
 
             uint ofs = frame_num - n0.frame_num, len = n1.frame_num - n0.frame_num;
 
@@ -174,18 +201,101 @@ class Spline
 
             cache.point = point;
             cache.frame_num = frame_num;
+            cache.valid = true;
 
             return point;
         }
+
+        // the frame of the last node, after which the spline keeps its last point
+        uint getLastFrame() const
+        {
+            assert(initialized == true);
+            assert(nodes_size > 0);
+
+            return nodes[nodes_size - 1].frame_num;
+        }
+
+        // evaluates the frames first, first + 1, ..., first + count - 1 into out. each segment's
+        // hermite basis is folded into a cubic polynomial once, and the inner loop over the frames
+        // of a segment is branch-free so that it can be vectorised by the compiler.
+        void evaluate(const uint first, const uint count, T* out) const
+        {
+            assert(initialized == true);
+            assert(nodes_size > 0);
+
+            const Node &front = nodes[0], &back = nodes[nodes_size - 1];
+            uint f = first, n = 0;
+
+            while(n < count && f <= front.frame_num)
+            {
+                out[n++] = front.point;
+                ++f;
+            }
+
+            while(n < count && f < back.frame_num)
+            {
+                const uint i = findSegment(f);
+                const Node &n0 = nodes[i], &n1 = nodes[i + 1];
+
+                // p(t) = ((a * t + b) * t + c) * t + d
+                const T a = n0.point * Real(2) + n0.tangent - n1.point * Real(2) + n1.tangent;
+                const T b = n1.point * Real(3) - n0.point * Real(3) - n0.tangent * Real(2) - n1.tangent;
+                const T c = n0.tangent;
+                const T d = n0.point;
+
+                const uint span = std::min(count - n, n1.frame_num - f);
+                const uint ofs = f - n0.frame_num;
+                const Real rlen = Real(1) / Real(n1.frame_num - n0.frame_num);
+
+                T* const dst = out + n;
+
+                for(uint j = 0; j < span; ++j)
+                {
+                    const Real t = Real(ofs + j) * rlen;
+                    dst[j] = ((a * t + b) * t + c) * t + d;
+                }
+
+                n += span;
+                f += span;
+            }
+
+            while(n < count)
+                out[n++] = back.point;
+        }
 };
 
 
 class Shader
 {
+   // The last value sent to each uniform, so that setting a uniform to the value which it
+   // already has costs no GL call. The location of each name is only looked up once.
+   struct Uniform
+   {
+      std::string name;
+      GLint location;
+      GLboolean transpose;
+      std::vector<unsigned char> value;
+   };
+
    GLuint program;
    bool loaded;
+   std::vector<Uniform> uniforms;
+
+   bool changeUniform(const char* name, const void* value, size_t size, GLboolean transpose, GLint& location);
 
    public:
+      // The numbers of uniform calls which were sent to GL, and which were skipped because
+      // they would not have changed anything.
+      struct Stats
+      {
+         uint sent, skipped;
+      };
+
+      // Ends the counting for a frame. The counts of the frame are then given by getFrameStats().
+      static void endFrame();
+      static const Stats& getFrameStats();
+      static const Stats& getTotalStats();
+
       Shader() : program(0), loaded(false) { }
 
       void uniform1i(const char* name, GLint x);
@@ -309,18 +419,80 @@ class Mesh
 };
 
 
+// Spreads the redrawing of slowly changing procedural textures over frames.
+// An effect registers how many parts it is drawn in (slices, tiles, mip levels), a guess at the
+// GPU time of one part, and how long a part may go without being redrawn. Each frame, schedule()
+// hands out parts at the steady rate which keeps them all within that tolerance, then more of
+// the stalest ones until the budget is used up. Parts which are past their tolerance anyway,
+// such as after invalidate(), are always handed out. The effect must then draw exactly getCount() parts,
+// carrying on round-robin from where it left off. The part cost is corrected by timing the
+// drawing between beginTiming() and endTiming().
+class RefreshScheduler
+{
+   struct Refresh
+   {
+      int num_parts, next_part, count;
+      float part_cost_ms, max_staleness;
+      float credit;
+      std::vector<float> part_times;
+      GLuint query;
+      bool query_pending;
+      int timed_parts;
+   };
+
+   std::vector<Refresh> refreshes;
+   float budget_ms, prev_time;
+
+   public:
+      RefreshScheduler(): budget_ms(1.0f), prev_time(0) { }
+
+      int add(int num_parts, float part_cost_ms, float max_staleness);
+
+      // All of the parts will be handed out in the next frame, such as when the effect changes
+      // completely.
+      void invalidate(int id);
+
+      void setBudget(float ms) { budget_ms = ms; }
+
+      // Called once per frame with the scene time, before the scene renders.
+      void schedule(float time);
+
+      int getCount(int id) const { return refreshes[id].count; }
+      int getPartCount(int id) const { return refreshes[id].num_parts; }
+
+      void beginTiming(int id);
+      void endTiming(int id);
+
+      void clear();
+};
+
 class Scene
 {
-   Shader downsample_shader;
+   Shader downsample_shader, gaussblur_shader;
+
+   std::vector<GLuint*> window_textures, window_renderbuffers;
 
    public:
       void downsample8x(GLuint srctex, GLuint fbo0, GLuint tex0, GLuint target_fbo,
                         GLsizei vpw, GLsizei vph);
 
+      // Separable blur of src_tex at quarter resolution, horizontally into fbo0 (which must render
+      // to tex0) and then vertically into fbo1.
+      void gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0);
+
       void createWindowTexture(GLuint tex, GLenum format, uint divisor = 1);
 
+      // These put a window sized target from the shared pool into the given name, deleting
+      // whatever name was there. releaseWindowTargets gives them all back and zeroes the names,
+      // so it must be called before the scene deletes its own textures and renderbuffers.
+      void acquireWindowTexture(GLuint& tex, GLenum format, uint divisor = 1);
+      void acquireWindowRenderbuffer(GLuint& renderbuffer, GLenum format);
+      void releaseWindowTargets();
+
       static GLuint loadTexture(const char *file_name,bool mipmaps=false);
 
+      RefreshScheduler refreshes;
+
       uint frame_num;
       uint window_width, window_height;
       float time, music_time;
@@ -337,6 +509,11 @@ class Scene
       {
       }
 
+      // The scenes are made with new, which before C++17 doesn't keep to the 64 byte alignment
+      // of the tables which they hold, such as noise::RandomGrid's.
+      static void* operator new(size_t size);
+      static void operator delete(void* p);
+
       virtual void slowInitialize() = 0;
       virtual void initialize() = 0;
       virtual void render() = 0;
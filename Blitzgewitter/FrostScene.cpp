@@ -4,6 +4,8 @@
 #include "Ran.hpp"
 #include "Particles.hpp"
 #include "Tower.hpp"
+#include "Noise.hpp"
+#include "MotionBlur.hpp"
 
 #include <list>
 
@@ -80,195 +82,195 @@ float angle_distribution = 0.7f;
 float branch_shorten_factor = 0.8f;
 float roll_rate_factor = 1.0f;
 
-float noise2(float x,float y=0,float z=0)
-{
-   static bool init=true;
-   static const int size=64;
-   static float values[size*size*size];
-   if(init)
-   {
-      Ran lrnd(4343);
-      for(int z=0;z<size;++z)
-         for(int y=0;y<size;++y)
-            for(int x=0;x<size;++x)
-            {
-               values[x+(y+z*size)*size]=lrnd.doub();
-            }
-      init=false;
-   }
-
-   const int ix=int(x) & (size-1);
-   const int iy=int(y) & (size-1);
-   const int iz=int(z) & (size-1);
-
-   const float fx=x-floor(x);
-   const float fy=y-floor(y);
-   const float fz=z-floor(z);
-
-   float vs[8];
-   for(int w=0;w<2;++w)
-      for(int v=0;v<2;++v)
-         for(int u=0;u<2;++u)
-         {
-            vs[u+(v+w*2)*2]=values[((ix+u)&(size-1))+(((iy+v)&(size-1))+((iz+w)&(size-1))*size)*size];
-         }
-
-   float a=(vs[0]*(1.0f-fx)+vs[1]*fx)*(1.0f-fy)+
-           (vs[2]*(1.0f-fx)+vs[3]*fx)*fy;
-
-   float b=(vs[4]*(1.0f-fx)+vs[5]*fx)*(1.0f-fy)+
-           (vs[6]*(1.0f-fx)+vs[7]*fx)*fy;
-
-   return a*(1.0f-fz)+b*fz;
-}
+int fc=0;
+int id_counter = 0;
 
-float noise(float x,float y=0,float z=0)
+static int log2i(int x)
 {
-   float f=0;
-   for(int i=0;i<3;++i)
-   {
-      float s=float(1<<i);
-      f+=noise2(x*s,y*s,z*s)*0.5f/s;
-   }
-
-   return f;
+  int l = 0;
+  while (x >>= 1)
+    ++l;
+  return l;
 }
 
-int fc=0;
-int id_counter = 0;
-
+// The tree is always a complete binary tree, so the nodes are kept in an array in
+// breadth-first order: the children of node k are nodes 2k+1 and 2k+2, and the nodes
+// at depth d are [2^d-1, 2^(d+1)-1).
 struct Node
 {
-  Node(Node* parent, float angle)
+  float l;
+  int id;
+  float angle;
+};
+
+struct Tree
+{
+  static const int segments_per_branch = 64;
+
+  Tree(const Vec2& origin): nodes(1), depthf(0), depth(0), levels(0)
   {
-    id = id_counter++;
-    pos = Vec2(0,0);
-    this->angle = angle;
-    this->parent = parent;
+    this->origin = origin;
+    nodes[0].l = base_branch_length;
+    nodes[0].id = id_counter++;
+    nodes[0].angle = 0;
   }
 
-  void grow(int depth, int grow_by)
+  void shrinkOrGrow(float to_depthf)
   {
-    if (depth > 0)
+    int to_depth = ceil(to_depthf);
+    depthf = to_depthf;
+    if (to_depth < depth)
+      depth = to_depth;
+    else if (to_depth > depth)
     {
-      for(std::vector<Node>::iterator it=subnodes.begin();it!=subnodes.end();++it)
-        it->grow(depth - 1, grow_by);
+      grow(depth, to_depth - depth);
+      depth = to_depth;
     }
-    else
-      createSubnodes(grow_by);
   }
 
-  void createSubnodes(int depth)
+  // Regenerates all nodes below depth from_depth, down to from_depth + grow_by. The node ids
+  // are the ones a depth-first traversal would have assigned, so the branch angles match.
+  void grow(int from_depth, int grow_by)
   {
-    if (depth <= 0)
-      return;
+    levels = from_depth + grow_by;
+    nodes.resize((2 << levels) - 1);
+
+    const int first_leaf = (1 << from_depth) - 1, num_leaves = 1 << from_depth;
+    const int subtree_size = (2 << grow_by) - 2;
+
+    // the new subtrees are numbered from here, in the order of the leaves
+    std::vector<int> gen_ids(nodes.size());
+
+    for (int k = 0; k < num_leaves; ++k)
+      gen_ids[first_leaf + k] = id_counter + k * subtree_size - 1;
 
-    subnodes.clear();
+    id_counter += num_leaves * subtree_size;
 
-    for (int i = 0; i < 2; ++i)
+    for (int r = 1; r <= grow_by; ++r)
     {
-      Node sn(this, angle);
-      sn.angle += angle_distribution * (i * 2 - 1) + (noise(sn.id) - 0.5) * 2;
-      sn.l = l * branch_shorten_factor;
-      sn.createSubnodes(depth - 1);
-      subnodes.push_back(sn);
+      const int d = from_depth + r;
+      const int first = (1 << d) - 1, last = (2 << d) - 1;
+
+      for (int k = first; k < last; ++k)
+      {
+        const int i = (k - 1) & 1;
+        const Node& parent = nodes[(k - 1) / 2];
+        const int parent_gen_id = gen_ids[(k - 1) / 2];
+
+        Node& sn = nodes[k];
+        sn.id = i ? parent_gen_id + (1 << (grow_by - r + 1)) : parent_gen_id + 1;
+        sn.angle = parent.angle + angle_distribution * (i * 2 - 1) + (noise::latticeFbm(sn.id) - 0.5) * 2;
+        sn.l = parent.l * branch_shorten_factor;
+        gen_ids[k] = sn.id;
+      }
     }
   }
 
-  void render(int depth, Vec2 org, float depthf, int depthc, GLushort& num_vertices, GLfloat* vertices, GLfloat* colours)
+  // Appends one line strip per visible branch. The strips are generated together so that the
+  // noise displacement is evaluated for all vertices in batches.
+  void render(float x_scale, std::vector<GLfloat>& vertices, std::vector<GLfloat>& colours,
+              std::vector<GLint>& firsts, std::vector<GLsizei>& counts)
   {
-    if (depth < 0)
+    if (depth < 1)
       return;
 
-    float tween = 1.0f - (float(depthc) - depthf);
+    static const int n = segments_per_branch;
 
-    Vec2 dir=Vec2(cos(angle)*l, sin(angle)*l);
-    Vec2 end=org + dir;
+    const int num_nodes = (2 << depth) - 1;
+    const int num_branches = num_nodes - 1;
+    const int num_vertices = num_branches * (n + 1);
 
-    float ti = fc * 0.03 * roll_rate_factor;
-    float sx = 0.04, sy = 0.02;
-    float ss = 0.3f;
-    static const int n = 64;
-    //Vec2* prev = 0;
+    ends.resize(num_nodes);
+    ends[0] = origin + Vec2(cos(nodes[0].angle) * nodes[0].l, sin(nodes[0].angle) * nodes[0].l);
 
-    num_vertices=0;
-if(parent)
-{
-    for (int i = 0; i <= n; ++i)
+    px.resize(num_vertices);
+    py.resize(num_vertices);
+    scaled_x.resize(num_vertices);
+    scaled_y.resize(num_vertices);
+    dx.resize(num_vertices);
+    dy.resize(num_vertices);
+
+    const int first_vertex = vertices.size() / 2;
+
+    vertices.resize(vertices.size() + num_vertices * 2);
+    colours.resize(colours.size() + num_vertices * 3);
+
+    GLfloat* out_vertices = &vertices[first_vertex * 2];
+    GLfloat* out_colours = &colours[first_vertex * 3];
+
+    int v = 0;
+
+    for (int k = 1; k < num_nodes; ++k)
     {
-      float t = std::min(float(i) / float(n), tween);
+      const int depthc = log2i(k + 1);
+      const float tween = 1.0f - (float(depthc) - depthf);
+
+      const Node& node = nodes[k];
+      const Vec2 org = ends[(k - 1) / 2];
+      const Vec2 end = org + Vec2(cos(node.angle) * node.l, sin(node.angle) * node.l);
 
-      //Vec3 col= lerpColor(color(50, 50, 255), color(200, 200, 255), 1.0 / (t + float(1 + depthc))));
-      Vec3 col= mix(Vec3(50, 50, 255), Vec3(200, 200, 255), 1.0 / (t + float(1 + depthc)));
+      ends[k] = end;
 
-      Vec2 mid = ((org * (1.0f - t)) + (end * t));
-      Vec2 disp = Vec2(noise(mid.x * sx, mid.y * sy, ti), noise(mid.x * sx, mid.y * sy, ti * 2)) * small_noise_warp;
-      mid = mid + disp;
-      disp = Vec2(noise(mid.x * sx * ss, mid.y * sy * ss, ti * 1.3),
-      noise(mid.x * sx * ss, mid.y * sy * ss, 10 + ti * 1.2)) * large_noise_warp;
+      firsts.push_back(first_vertex + v);
+      counts.push_back(n + 1);
 
-      mid = mid + disp;
+      for (int i = 0; i <= n; ++i, ++v)
+      {
+        float t = std::min(float(i) / float(n), tween);
 
-      colours[num_vertices*3+0]=col.x/255.0f;
-      colours[num_vertices*3+1]=col.y/255.0f;
-      colours[num_vertices*3+2]=col.z/255.0f;
+        Vec3 col = mix(Vec3(50, 50, 255), Vec3(200, 200, 255), 1.0 / (t + float(1 + depthc)));
 
-      vertices[num_vertices*2+0]=mid.x*0.005;
-      vertices[num_vertices*2+1]=mid.y*0.005;
-      ++num_vertices;
+        Vec2 mid = ((org * (1.0f - t)) + (end * t));
 
-      //if (prev != 0)
-      //  line(prev.x, prev.y, mid.x, mid.y);
-      //prev = mid;
+        px[v] = mid.x;
+        py[v] = mid.y;
+
+        out_colours[v * 3 + 0] = col.x / 255.0f;
+        out_colours[v * 3 + 1] = col.y / 255.0f;
+        out_colours[v * 3 + 2] = col.z / 255.0f;
+      }
     }
 
-     glDrawArrays(GL_LINE_STRIP, 0, num_vertices);
-}
-    //line(org.x, org.y, end.x, end.y);
+    float ti = fc * 0.03 * roll_rate_factor;
+    float sx = 0.04, sy = 0.02;
+    float ss = 0.3f;
 
-    //for (Node sn : subnodes)
-    for(std::vector<Node>::iterator it=subnodes.begin();it!=subnodes.end();++it)
-      it->render(depth - 1, end, depthf, depthc + 1, num_vertices, vertices, colours);
-  }
+    for (int pass = 0; pass < 2; ++pass)
+    {
+      const float s = pass ? ss : 1.0f;
+      const float w = pass ? large_noise_warp : small_noise_warp;
 
-  float l;
-  int id;
-  Node* parent;
-  float angle;
-  Vec2 pos;
-  std::vector<Node> subnodes;
-};
+      for (int i = 0; i < num_vertices; ++i)
+      {
+        scaled_x[i] = px[i] * sx * s;
+        scaled_y[i] = py[i] * sy * s;
+      }
 
-struct Tree
-{
-  Tree(const Vec2& origin): root(0, 0)
-  {
-    this->origin = origin;
-    root.l = base_branch_length;
-  }
+      noise::latticeFbm(&scaled_x[0], &scaled_y[0], pass ? ti * 1.3 : ti, &dx[0], num_vertices);
+      noise::latticeFbm(&scaled_x[0], &scaled_y[0], pass ? 10 + ti * 1.2 : ti * 2, &dy[0], num_vertices);
 
-  void shrinkOrGrow(float to_depthf)
-  {
-    int to_depth = ceil(to_depthf);
-    depthf = to_depthf;
-    if (to_depth < depth)
-      depth = to_depth;
-    else if (to_depth > depth)
-    {
-      root.grow(depth, to_depth - depth);
-      depth = to_depth;
+      for (int i = 0; i < num_vertices; ++i)
+      {
+        px[i] += dx[i] * w;
+        py[i] += dy[i] * w;
+      }
     }
-  }
 
-  void render(GLushort& num_vertices, GLfloat* vertices, GLfloat* colours)
-  {
-    root.render(depth, origin, depthf, 0, num_vertices, vertices, colours);
+    for (int i = 0; i < num_vertices; ++i)
+    {
+      out_vertices[i * 2 + 0] = px[i] * 0.005 * x_scale;
+      out_vertices[i * 2 + 1] = py[i] * 0.005;
+    }
   }
 
   Vec2 origin;
-  Node root;
+  std::vector<Node> nodes;
   float depthf;
-  int depth;
+  int depth, levels;
+
+  private:
+    std::vector<Vec2> ends;
+    std::vector<float> px, py, scaled_x, scaled_y, dx, dy;
 };
 
 
@@ -305,26 +307,20 @@ class FrostScene: public Scene
 
    Worm worms[num_worms];
 
-   static const int random_grid_w = 256;
-   static const int random_grid_h = 256;
-
-   float random_grid[random_grid_w*random_grid_h];
-
-   void initRandomGrid();
-   float randomGridLookup(float u, float v) const;
+   noise::RandomGrid random_grid;
 
    GLfloat spiral_vertices[4096 * 3];
    GLushort spiral_indices[4096];
    GLushort spiral_num_vertices, spiral_num_indices;
 
-   static const GLushort lightning_max_vertices=2048;
-
-   GLfloat lightning_vertices[lightning_max_vertices*2];
-   GLfloat lightning_colours[lightning_max_vertices*3];
+   std::vector<GLfloat> lightning_vertices;
+   std::vector<GLfloat> lightning_colours;
+   std::vector<GLint> lightning_firsts;
+   std::vector<GLsizei> lightning_counts;
 
    Shader forrest_shader, bokeh_shader, bokeh2_shader;
-   Shader gaussbokeh_shader, composite_shader;
-   Shader mb_accum_shader;
+   Shader composite_shader;
+   motionblur::Scheduler motion_blur;
    Shader screendisplay_shader;
    Shader bgfg_shader;
    Shader lightning_shader;
@@ -364,7 +360,6 @@ class FrostScene: public Scene
    void initBoxes();
    void drawView(float ltime);
    void createSpiral();
-   void gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0);
    void drawLightning(float ltime);
 
    void drawHangingBalls(float ltime);
@@ -500,7 +495,7 @@ void FrostScene::stepWorm(Worm& w, int i)
 
    normalize(tang);
 
-   w.direction+=tang*0.2*randomGridLookup(i,w.step_count*0.02);
+   w.direction+=tang*0.2*random_grid.lookup(i,w.step_count*0.02);
    normalize(w.direction);
 
    ++w.step_count;
@@ -533,43 +528,9 @@ void FrostScene::initBoxes()
 }
 
 
-void FrostScene::initRandomGrid()
-{
-   for(int y=0;y<random_grid_h;++y)
-      for(int x=0;x<random_grid_w;++x)
-      {
-         random_grid[x+y*random_grid_w]=(frand()-0.5)*2.0;
-      }
-}
-
-float FrostScene::randomGridLookup(float u, float v) const
-{
-   u=fmodf(u,float(random_grid_w));
-   v=fmodf(v,float(random_grid_h));
-
-   if(u<0)
-      u+=random_grid_w;
-
-   if(v<0)
-      v+=random_grid_h;
-
-   const int iu=int(u);
-   const int iv=int(v);
-
-   const float fu=u-float(iu);
-   const float fv=v-float(iv);
-
-   const float a=random_grid[iu+iv*random_grid_w];
-   const float b=random_grid[((iu+1)%random_grid_w)+iv*random_grid_w];
-   const float c=random_grid[((iu+1)%random_grid_w)+((iv+1)%random_grid_h)*random_grid_w];
-   const float d=random_grid[iu+((iv+1)%random_grid_h)*random_grid_w];
-
-   return (1.0-fv)*((1.0-fu)*a+fu*b) + fv*((1.0-fu)*d+fu*c);
-}
-
 void FrostScene::slowInitialize()
 {
-   initRandomGrid();
+   random_grid.fill(frand);
    initWorms();
    initBoxes();
 
@@ -591,14 +552,14 @@ void FrostScene::initializeTextures()
 {
    glGenTextures(num_texs, texs);
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
-   createWindowTexture(texs[12], GL_RGBA16F, 2);
-   createWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[12], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[13], GL_RGBA16F, 2);
 
    CHECK_FOR_ERRORS;
 
@@ -637,10 +598,8 @@ void FrostScene::initializeBuffers()
 
    bokeh_temp_fbo = fbos[12];
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -699,11 +658,8 @@ void FrostScene::initializeShaders()
    bokeh2_shader.uniform1i("tex2", 1);
    bokeh2_shader.uniform1f("aspect_ratio", float(window_height) / float(window_width));
 
-   gaussbokeh_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "gaussblur_f.glsl");
-   gaussbokeh_shader.uniform1i("tex0", 0);
 
-   mb_accum_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_accum_f.glsl");
-   mb_accum_shader.uniform1i("tex0", 0);
+   motion_blur.loadShaders();
 
 
    composite_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "cubes_composite_f.glsl");
@@ -741,8 +697,8 @@ void FrostScene::update()
    using namespace lightning;
    ++g_ltime;
    step();
-   litree0.shrinkOrGrow(-0.5f + pow(noise(0 + fc * grow_shrink_rate), grow_shrink_exp) * max_depth);
-   litree1.shrinkOrGrow(-0.5f + pow(noise(10 + fc * grow_shrink_rate), grow_shrink_exp) * max_depth);
+   litree0.shrinkOrGrow(-0.5f + pow(noise::latticeFbm(0 + fc * grow_shrink_rate), grow_shrink_exp) * max_depth);
+   litree1.shrinkOrGrow(-0.5f + pow(noise::latticeFbm(10 + fc * grow_shrink_rate), grow_shrink_exp) * max_depth);
 }
 
 
@@ -759,53 +715,21 @@ void FrostScene::drawTower(tower::Tower& twr, const Mat4& modelview, Real camhei
 
    lltime+=open_time; // HAAAAAAAAAAAAAAAAAAAAAAAAAAAAAACK
 
-   unsigned int piece_index=0;
-   for(std::vector<tower::PieceInstance>::iterator p=twr.instances.begin();p!=twr.instances.end();++p,++piece_index)
-   {
-      std::map<std::string,Real>& ps=p->parameters;
+   const tower::Pieces pieces(twr);
 
-      if((ps["background"]>0.5)!=drawing_view_for_background)
+   for(unsigned int i=0;i<twr.getInstanceCount();++i)
+   {
+      if(!pieces.inView(i, drawing_view_for_background, camheight, camheightrange))
          continue;
 
-      if(camheight < (p->section->height1 - camheightrange) || camheight > (p->section->height0 + camheightrange))
-         continue;
+      forrest2_shader.uniform1f("time", lltime*pieces.time_scale[i]+pieces.time_offset[i]);
 
-      Mesh* mesh=&icosahedron_mesh;
+      pieces.setUniforms(forrest2_shader, i);
 
+      const float upwards=(i == 27) ? 0.0f : std::pow(std::max(0.0f,(lltime-15.0f-i*0.1f)),2.0f)*0.9f;
+      const float rs=(i == 27) ? 0.96f : 1.0f;
 
-      mesh->bind();
-
-      forrest2_shader.uniform1f("time", lltime*ps["time_scale"]+ps["time_offset"]);
-
-      forrest2_shader.uniform1f("ptn_thickness",ps["ptn_thickness"]);
-      forrest2_shader.uniform1f("ptn_brightness",ps["ptn_brightness"]);
-      forrest2_shader.uniform1f("ptn_scroll",ps["ptn_scroll"]);
-      forrest2_shader.uniform1f("ptn_frequency",ps["ptn_frequency"]);
-      forrest2_shader.uniform1f("shimmer",ps["shimmer"]);
-      forrest2_shader.uniform1f("l0_scroll",ps["l0_scroll"]);
-      forrest2_shader.uniform1f("l0_brightness",ps["l0_brightness"]);
-      forrest2_shader.uniform1f("l1_scroll",ps["l1_scroll"]);
-      forrest2_shader.uniform1f("l1_brightness",ps["l1_brightness"]);
-      forrest2_shader.uniform1f("l2_scroll",ps["l2_scroll"]);
-      forrest2_shader.uniform1f("l2_brightness",ps["l2_brightness"]);
-      forrest2_shader.uniform1f("ambient",ps["ambient"]);
-
-      const float upwards=(piece_index == 27) ? 0.0f : std::pow(std::max(0.0f,(lltime-15.0f-piece_index*0.1f)),2.0f)*0.9f;
-      const float rs=(piece_index == 27) ? 0.96f : 1.0f;
-
-      Mat4 modelview2 = modelview * Mat4::rotation(lltime * ps["section_rot_spd"], Vec3(0,1,0)) *
-                        Mat4::translation(Vec3(Vec3(std::cos(ps["angle"])*ps["distance"], ps["height"]-upwards, std::sin(ps["angle"])*ps["distance"]) * tscale)) *
-                        Mat4::rotation(ps["rot_z"]+lltime*ps["rot_spd_z"]*rs,Vec3(0,0,1)) * Mat4::rotation(ps["rot_y"]+lltime*ps["rot_spd_y"]*rs,Vec3(0,1,0)) * Mat4::rotation(ps["rot_x"]+lltime*ps["rot_spd_x"]*rs,Vec3(1,0,0)) *
-                        Mat4::scale(Vec3(ps["sca_x"],ps["sca_y"],ps["sca_z"]));
-
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
-      glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(mesh->getVertexCount() * sizeof(GLfloat) * 3));
-
-      forrest2_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview2.e);
-
-//// 011011
-//if(piece_index==27)
-      glDrawRangeElements(GL_TRIANGLES, 0, mesh->getVertexCount() - 1, mesh->getTriangleCount() * 3, GL_UNSIGNED_INT, 0);
+      tower::Pieces::draw(forrest2_shader, icosahedron_mesh, modelview * pieces.transform(i, lltime, upwards, rs, tscale));
 
       CHECK_FOR_ERRORS;
    }
@@ -850,8 +774,6 @@ void FrostScene::drawLightning(float ltime)
 
    fc = ltime*1000.0/20.0;
 
-   GLushort num_vertices=0;
-
    const float flup=std::pow(std::max(0.0f,ltime-open_time)*0.4f,2.0f);
 
    Mat4 projection = Mat4::identity();
@@ -876,14 +798,22 @@ void FrostScene::drawLightning(float ltime)
    glBindBuffer(GL_ARRAY_BUFFER,0);
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
 
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, lightning_vertices);
-   glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, lightning_colours);
+   lightning_vertices.clear();
+   lightning_colours.clear();
+   lightning_firsts.clear();
+   lightning_counts.clear();
 
-   litree0.render(num_vertices, lightning_vertices, lightning_colours);
-   lightning_shader.uniformMatrix4fv("projection", 1, GL_FALSE, (projection*Mat4::scale(Vec3(-1,1,1))).e);
-   litree1.render(num_vertices, lightning_vertices, lightning_colours);
+   // the second tree is mirrored
+   litree0.render(+1, lightning_vertices, lightning_colours, lightning_firsts, lightning_counts);
+   litree1.render(-1, lightning_vertices, lightning_colours, lightning_firsts, lightning_counts);
 
-   assert(num_vertices<=lightning_max_vertices);
+   if(!lightning_firsts.empty())
+   {
+      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, &lightning_vertices[0]);
+      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, &lightning_colours[0]);
+
+      glMultiDrawArrays(GL_LINE_STRIP, &lightning_firsts[0], &lightning_counts[0], lightning_firsts.size());
+   }
 
    glDisableVertexAttribArray(0);
    glDisableVertexAttribArray(1);
@@ -926,6 +856,10 @@ void FrostScene::drawView(float ltime)
 
    CHECK_FOR_ERRORS;
 
+   // the camera of the view which is displayed, not of the background pass
+   if(!drawing_view_for_background)
+      motion_blur.observe(projection, modelview);
+
    forrest_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
    screendisplay_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
 
@@ -1066,79 +1000,6 @@ void FrostScene::drawHangingBalls(float ltime)
 }
 
 
-void FrostScene::gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0)
-{
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLfloat coords[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glEnableVertexAttribArray(0);
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
-
-   glViewport(0, 0, window_width / 4, window_height / 4);
-
-   // gaussian blur pass 1
-
-   {
-      gaussbokeh_shader.uniform4f("tint", tint_r, tint_g, tint_b, 1.0f);
-   }
-
-   const float gauss_radx = radx;
-   const float gauss_rady = rady;
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo0);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   glDepthMask(GL_FALSE);
-   glDisable(GL_DEPTH_TEST);
-
-   gaussbokeh_shader.bind();
-   gaussbokeh_shader.uniform2f("direction", gauss_radx * float(window_height) / float(window_width), 0.0f);
-
-   glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, src_tex);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-
-
-   // gaussian blur pass 2
-
-   gaussbokeh_shader.uniform4f("tint", 1, 1, 1, 1);
-
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo1);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   gaussbokeh_shader.uniform2f("direction", 0.0f, gauss_rady);
-
-   glBindTexture(GL_TEXTURE_2D, tex0);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-   glDisableVertexAttribArray(0);
-   glDisableVertexAttribArray(1);
-
-   CHECK_FOR_ERRORS;
-}
-
-
 void FrostScene::render()
 {
    static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
@@ -1149,6 +1010,8 @@ void FrostScene::render()
 
    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
+   motion_blur.beginFrame(time, window_width, window_height);
+
    for(int nn = 0; nn < 2; ++nn)
    {
 //if(drawing_view_for_background) continue; // **********************************************************************************
@@ -1163,8 +1026,8 @@ void FrostScene::render()
       glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[3]);
       glClear(GL_COLOR_BUFFER_BIT);
 
-      num_subframes = drawing_view_for_background ? 1 : 7;
-      subframe_scale = 1.0/35.0;
+      num_subframes = drawing_view_for_background ? 1 : motion_blur.getSubframeCount();
+      subframe_scale = motion_blur.getShutter();
 
       for(int subframe = 0;subframe<num_subframes;++subframe)
       {
@@ -1184,9 +1047,7 @@ void FrostScene::render()
 
          glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[3]);
 
-         mb_accum_shader.bind();
-         mb_accum_shader.uniform1f("time", float(subframe) / float(num_subframes));
-         mb_accum_shader.uniform1f("scale", 1.0f / float(num_subframes));
+         motion_blur.bindAccumulation(num_subframes);
 
          glDepthMask(GL_FALSE);
          glDisable(GL_DEPTH_TEST);
@@ -1351,7 +1212,9 @@ void FrostScene::render()
 
 void FrostScene::free()
 {
+   releaseWindowTargets();
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
@@ -151,14 +151,14 @@ void IntroScene::initializeTextures()
 
    words_tex = loadTexture(IMAGES_PATH "title.png");
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
-   createWindowTexture(texs[12], GL_RGBA16F, 2);
-   createWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[12], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[13], GL_RGBA16F, 2);
 
    CHECK_FOR_ERRORS;
 
@@ -226,6 +226,7 @@ void IntroScene::initializeTextures()
 
 
 
+   acquireWindowTexture(g_particle_output0_tex, GL_RGB16F);
    glBindTexture(GL_TEXTURE_2D, g_particle_output0_tex);
 
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -233,10 +234,10 @@ void IntroScene::initializeTextures()
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-   glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, window_width, window_height);
    CHECK_FOR_ERRORS;
 
 
+   acquireWindowTexture(g_particle_output1_tex, GL_RGB16F);
    glBindTexture(GL_TEXTURE_2D, g_particle_output1_tex);
 
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -244,10 +245,10 @@ void IntroScene::initializeTextures()
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-   glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, window_width, window_height);
    CHECK_FOR_ERRORS;
 
 
+   acquireWindowTexture(g_particle_output2_tex, GL_RGB16F);
    glBindTexture(GL_TEXTURE_2D, g_particle_output2_tex);
 
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -255,7 +256,6 @@ void IntroScene::initializeTextures()
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-   glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, window_width, window_height);
    CHECK_FOR_ERRORS;
 
    glBindTexture(GL_TEXTURE_2D, 0);
@@ -267,10 +267,8 @@ void IntroScene::initializeBuffers()
    glGenFramebuffers(num_fbos, fbos);
    glGenRenderbuffers(num_fbos, renderbuffers);
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -458,11 +456,13 @@ void IntroScene::updateParticles(int tex, int frame_count)
 
 void IntroScene::free()
 {
+   releaseWindowTargets();
    glDeleteBuffers(1,&g_dummy_particle_vbo);
    delete[] particle_pix;
    particle_pix = 0;
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
 void IntroScene::update()
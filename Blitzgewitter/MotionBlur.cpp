@@ -0,0 +1,180 @@
+#include "MotionBlur.hpp"
+
+using namespace motionblur;
+
+const float Scheduler::max_gap_px = 2.0f;
+const float Scheduler::frame_budget = 1.0f / 60.0f;
+
+namespace
+{
+
+// how quickly the motion estimate falls back once things slow down, per frame
+const float motion_decay = 0.8f;
+
+// frames which must come in within budget before the cap is raised again
+const int frames_before_raise = 60;
+
+}
+
+Scheduler::Scheduler(int max_subframes, float shutter): max_subframes(max_subframes), shutter(shutter),
+                                                        num_subframes(max_subframes), cap(max_subframes), frames_within_budget(0),
+                                                        prev_time(-1), width(1), height(1),
+                                                        observed(false), have_prev_camera(false), prev_observe_time(0), prev_points_time(0),
+                                                        motion_px(max_gap_px * max_subframes), frame_motion_px(0), motion_dir(0, 0)
+{
+   assert(max_subframes > 0);
+}
+
+void Scheduler::beginFrame(float time, uint window_width, uint window_height)
+{
+   width = window_width;
+   height = window_height;
+
+   if(prev_time >= 0 && time > prev_time)
+   {
+      if(time - prev_time > frame_budget * 1.5f)
+      {
+         cap = std::max(1, cap - 1);
+         frames_within_budget = 0;
+      }
+      else if(++frames_within_budget >= frames_before_raise && cap < max_subframes)
+      {
+         ++cap;
+         frames_within_budget = 0;
+      }
+   }
+
+   prev_time = time;
+   observed = false;
+
+   motion_px = std::max(frame_motion_px, motion_px * motion_decay);
+   frame_motion_px = 0;
+
+   // the subframes are also the antialiasing samples, so there are a few even when nothing moves
+   const int lowest = std::min(min_subframes, cap);
+   const int wanted = int(std::ceil(motion_px / max_gap_px));
+
+   num_subframes = std::max(lowest, std::min(wanted, cap));
+}
+
+bool Scheduler::toPixels(const Mat4& clip, const Vec3& p, Vec2& out) const
+{
+   const float w = clip[3] * p.x + clip[7] * p.y + clip[11] * p.z + clip[15];
+
+   if(w < 1e-3f)
+      return false;
+
+   const Vec3 ndc = clip * p;
+   out = Vec2(ndc.x * 0.5f * float(width), ndc.y * 0.5f * float(height));
+   return true;
+}
+
+void Scheduler::observe(const Mat4& projection, const Mat4& modelview)
+{
+   if(observed)
+      return;
+
+   observed = true;
+
+   Mat4 unjittered = projection;
+   unjittered[8] = 0;
+   unjittered[9] = 0;
+
+   const Mat4 clip = unjittered * modelview;
+
+   if(have_prev_camera && prev_time > prev_observe_time)
+   {
+      // probes spread over the previous view at a few distances, which are fixed in the world
+      // and so only move on screen because of the camera
+      static const float depths[3] = { 2, 8, 32 };
+
+      const float scale = shutter / (prev_time - prev_observe_time);
+
+      float max_px = 0;
+      Vec2 sum(0, 0);
+      int n = 0;
+
+      for(int d = 0; d < 3; ++d)
+         for(int y = -1; y <= 1; ++y)
+            for(int x = -1; x <= 1; ++x)
+            {
+               const Vec3 p = prev_modelview_inv * Vec3(x * 0.5f * depths[d], y * 0.5f * depths[d], -depths[d]);
+
+               Vec2 p0, p1;
+               if(!toPixels(prev_clip, p, p0) || !toPixels(clip, p, p1))
+                  continue;
+
+               const Vec2 delta = p1 - p0;
+               max_px = std::max(max_px, std::sqrt(delta.lengthSquared()));
+               sum = sum + delta;
+               ++n;
+            }
+
+      if(n > 0)
+      {
+         frame_motion_px = std::max(frame_motion_px, max_px * scale);
+         motion_dir = Vec2(sum.x / float(width), sum.y / float(height)) * (scale / float(n));
+      }
+   }
+
+   prev_clip = clip;
+   prev_modelview_inv = modelview.inverse();
+   prev_observe_time = prev_time;
+   have_prev_camera = true;
+}
+
+void Scheduler::observePoints(const Vec3* world_points, int num_points)
+{
+   assert(observed);
+
+   if(prev_points_time == prev_time && !prev_points.empty())
+      return;
+
+   points.resize(num_points);
+   std::vector<bool> visible(num_points);
+
+   for(int i = 0; i < num_points; ++i)
+      visible[i] = toPixels(prev_clip, world_points[i], points[i]);
+
+   if(int(prev_points.size()) == num_points && prev_time > prev_points_time)
+   {
+      const float scale = shutter / (prev_time - prev_points_time);
+
+      for(int i = 0; i < num_points; ++i)
+         if(visible[i] && prev_points_visible[i])
+         {
+            const Vec2 delta = points[i] - prev_points[i];
+            frame_motion_px = std::max(frame_motion_px, std::sqrt(delta.lengthSquared()) * scale);
+         }
+   }
+
+   prev_points.swap(points);
+   prev_points_visible.swap(visible);
+   prev_points_time = prev_time;
+}
+
+void Scheduler::loadShaders()
+{
+   accum_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_accum_f.glsl");
+   accum_shader.uniform1i("tex0", 0);
+   smear_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_smear_f.glsl");
+   smear_shader.uniform1i("tex0", 0);
+}
+
+void Scheduler::bindAccumulation(int count)
+{
+   // each subframe stands for 1/count of the shutter, so it is smeared over that much of the
+   // motion if the copies would otherwise be visibly apart
+   if(motion_px / float(count) > max_gap_px)
+   {
+      const Vec2 smear = motion_dir * (1.0f / float(count));
+      smear_shader.bind();
+      smear_shader.uniform2f("smear", smear.x, smear.y);
+      smear_shader.uniform1f("scale", 1.0f / float(count));
+   }
+   else
+   {
+      accum_shader.bind();
+      accum_shader.uniform1f("scale", 1.0f / float(count));
+   }
+}
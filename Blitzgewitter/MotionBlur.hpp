@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Engine.hpp"
+
+// Chooses how many subframes the accumulation motion blur renders each frame.
+// The scenes report their camera (and optionally some moving points) from the first subframe,
+// and the scheduler estimates how far things move on screen while the shutter is open. It then
+// asks for just enough subframes that the copies are no more than max_gap_px apart, within a
+// cap which drops when frames overrun the budget. If the cap leaves gaps, each subframe is
+// smeared along the mean screen motion to cover them.
+
+namespace motionblur
+{
+
+class Scheduler
+{
+   public:
+      Scheduler(int max_subframes = 7, float shutter = 1.0f / 35.0f);
+
+      // time is the scene time, so the interval between calls is the real frame time.
+      void beginFrame(float time, uint window_width, uint window_height);
+
+      // Only the first call in each frame is used, so it must come from the view which is
+      // displayed and not from a pass drawn from elsewhere, such as the scenes' background
+      // views. The off-centre terms of the projection, which the scenes use for subpixel jitter,
+      // are ignored.
+      void observe(const Mat4& projection, const Mat4& modelview);
+
+      // World space positions of moving things, which must come in the same order every frame.
+      // Must follow observe(), and as with that only the first call in each frame is used.
+      void observePoints(const Vec3* points, int num_points);
+
+      int getSubframeCount() const { return num_subframes; }
+      float getShutter() const { return shutter; }
+
+      // Loads the accumulation shaders. Call once the GL context exists.
+      void loadShaders();
+
+      // Binds the shader which adds one of count subframes, held in texture unit 0, into the
+      // accumulation buffer.
+      void bindAccumulation(int count);
+
+   private:
+      static const int min_subframes = 3;
+      static const float max_gap_px;
+      static const float frame_budget;
+
+      const int max_subframes;
+      const float shutter;
+
+      int num_subframes, cap, frames_within_budget;
+      float prev_time;
+      uint width, height;
+
+      bool observed, have_prev_camera;
+      Mat4 prev_clip, prev_modelview_inv;
+      float prev_observe_time, prev_points_time;
+      std::vector<Vec2> prev_points, points;
+      std::vector<bool> prev_points_visible;
+
+      // Screen motion over the shutter in pixels, as used for this frame and as measured so far
+      // in this frame, and the mean motion of the camera probes in texture coordinates.
+      float motion_px, frame_motion_px;
+      Vec2 motion_dir;
+
+      Shader accum_shader, smear_shader;
+
+      // false if the point is behind the camera
+      bool toPixels(const Mat4& clip, const Vec3& p, Vec2& out) const;
+};
+
+}
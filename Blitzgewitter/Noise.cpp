@@ -0,0 +1,327 @@
+#include "Noise.hpp"
+#include "Ran.hpp"
+
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace noise;
+
+namespace
+{
+
+struct Tables
+{
+   float lattice[lattice_size*lattice_size*lattice_size] __attribute__((aligned(64)));
+
+   Tables()
+   {
+      Ran rnd(4343);
+      for(int i=0;i<lattice_size*lattice_size*lattice_size;++i)
+         lattice[i]=rnd.doub();
+   }
+};
+
+Tables tables;
+
+// number of points which the batched fbm functions scale at once, on the stack
+const int chunk=64;
+
+}
+
+void noise::RandomGrid::fill(Real (*rand)())
+{
+   for(int i=0;i<grid_size*grid_size;++i)
+      values[i]=(rand()-0.5)*2.0;
+}
+
+float noise::RandomGrid::lookup(float u, float v, int w, int h) const
+{
+   if(w>grid_size)
+      w=grid_size;
+
+   if(h>grid_size)
+      h=grid_size;
+
+   u=fmodf(u,float(w));
+   v=fmodf(v,float(h));
+
+   if(u<0)
+      u+=w;
+
+   if(v<0)
+      v+=h;
+
+   const int iu=int(u);
+   const int iv=int(v);
+
+   const float fu=u-float(iu);
+   const float fv=v-float(iv);
+
+   const int iu0=iu&(w-1), iu1=(iu+1)&(w-1);
+   const int iv0=(iv&(h-1))*w, iv1=((iv+1)&(h-1))*w;
+
+   const float a=values[iu0+iv0];
+   const float b=values[iu1+iv0];
+   const float c=values[iu1+iv1];
+   const float d=values[iu0+iv1];
+
+   return (1.0-fv)*((1.0-fu)*a+fu*b) + fv*((1.0-fu)*d+fu*c);
+}
+
+void noise::RandomGrid::lookup(const float* u, const float* v, float* out, int n, int w, int h) const
+{
+   if(w>grid_size)
+      w=grid_size;
+
+   if(h>grid_size)
+      h=grid_size;
+
+   int i=0;
+
+#ifdef __SSE2__
+   const __m128 one=_mm_set1_ps(1.0f);
+   const __m128 wf=_mm_set1_ps(float(w)), hf=_mm_set1_ps(float(h));
+   const __m128 rw=_mm_set1_ps(1.0f/float(w)), rh=_mm_set1_ps(1.0f/float(h));
+   const __m128 zero=_mm_setzero_ps();
+
+   // eight points at a time, so that the table reads for both halves are in flight together
+   for(;i+8<=n;i+=8)
+   {
+      __m128 fu[2],fv[2];
+      int iu[8],iv[8];
+
+      for(int half=0;half<2;++half)
+      {
+         __m128 qu=_mm_loadu_ps(u+i+half*4);
+         __m128 qv=_mm_loadu_ps(v+i+half*4);
+
+         // fmodf, which is exact here because w and h are powers of two
+         qu=_mm_sub_ps(qu,_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(qu,rw))),wf));
+         qv=_mm_sub_ps(qv,_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(qv,rh))),hf));
+
+         qu=_mm_add_ps(qu,_mm_and_ps(_mm_cmplt_ps(qu,zero),wf));
+         qv=_mm_add_ps(qv,_mm_and_ps(_mm_cmplt_ps(qv,zero),hf));
+
+         const __m128i tu=_mm_cvttps_epi32(qu);
+         const __m128i tv=_mm_cvttps_epi32(qv);
+
+         fu[half]=_mm_sub_ps(qu,_mm_cvtepi32_ps(tu));
+         fv[half]=_mm_sub_ps(qv,_mm_cvtepi32_ps(tv));
+
+         _mm_storeu_si128((__m128i*)(iu+half*4),tu);
+         _mm_storeu_si128((__m128i*)(iv+half*4),tv);
+      }
+
+      float vs[4][8];
+      for(int k=0;k<8;++k)
+      {
+         const int iu0=iu[k]&(w-1), iu1=(iu[k]+1)&(w-1);
+         const int iv0=(iv[k]&(h-1))*w, iv1=((iv[k]+1)&(h-1))*w;
+         vs[0][k]=values[iu0+iv0];
+         vs[1][k]=values[iu1+iv0];
+         vs[2][k]=values[iu1+iv1];
+         vs[3][k]=values[iu0+iv1];
+      }
+
+      for(int half=0;half<2;++half)
+      {
+         const __m128 a=_mm_loadu_ps(vs[0]+half*4), b=_mm_loadu_ps(vs[1]+half*4);
+         const __m128 c=_mm_loadu_ps(vs[2]+half*4), d=_mm_loadu_ps(vs[3]+half*4);
+
+         const __m128 gu=_mm_sub_ps(one,fu[half]), gv=_mm_sub_ps(one,fv[half]);
+
+         _mm_storeu_ps(out+i+half*4,_mm_add_ps(_mm_mul_ps(gv,_mm_add_ps(_mm_mul_ps(gu,a),_mm_mul_ps(fu[half],b))),
+                                             _mm_mul_ps(fv[half],_mm_add_ps(_mm_mul_ps(gu,d),_mm_mul_ps(fu[half],c)))));
+      }
+   }
+#endif
+
+   for(;i<n;++i)
+      out[i]=lookup(u[i],v[i],w,h);
+}
+
+float noise::RandomGrid::fbm(float u, float v, int octaves, float scale, float mag) const
+{
+   float f=0.0f;
+
+   for(int i=0;i<octaves;++i)
+   {
+      f+=lookup(u*scale,v*scale)*mag;
+      mag*=0.5f;
+      scale*=2.0f;
+   }
+
+   return f;
+}
+
+void noise::RandomGrid::fbm(const float* u, const float* v, float* out, int n, int octaves, float scale, float mag) const
+{
+   float su[chunk],sv[chunk],g[chunk];
+
+   for(int j=0;j<n;j+=chunk)
+   {
+      const int m=std::min(chunk,n-j);
+
+      for(int k=0;k<m;++k)
+         out[j+k]=0;
+
+      float s=scale,a=mag;
+
+      for(int i=0;i<octaves;++i)
+      {
+         for(int k=0;k<m;++k)
+         {
+            su[k]=u[j+k]*s;
+            sv[k]=v[j+k]*s;
+         }
+
+         lookup(su,sv,g,m);
+
+         for(int k=0;k<m;++k)
+            out[j+k]+=g[k]*a;
+
+         a*=0.5f;
+         s*=2.0f;
+      }
+   }
+}
+
+float noise::lattice(float x, float y, float z)
+{
+   static const int size=lattice_size;
+   const float* values=tables.lattice;
+
+   const int ix=int(x) & (size-1);
+   const int iy=int(y) & (size-1);
+   const int iz=int(z) & (size-1);
+
+   const float fx=x-floor(x);
+   const float fy=y-floor(y);
+   const float fz=z-floor(z);
+
+   float vs[8];
+   for(int w=0;w<2;++w)
+      for(int v=0;v<2;++v)
+         for(int u=0;u<2;++u)
+         {
+            vs[u+(v+w*2)*2]=values[((ix+u)&(size-1))+(((iy+v)&(size-1))+((iz+w)&(size-1))*size)*size];
+         }
+
+   float a=(vs[0]*(1.0f-fx)+vs[1]*fx)*(1.0f-fy)+
+           (vs[2]*(1.0f-fx)+vs[3]*fx)*fy;
+
+   float b=(vs[4]*(1.0f-fx)+vs[5]*fx)*(1.0f-fy)+
+           (vs[6]*(1.0f-fx)+vs[7]*fx)*fy;
+
+   return a*(1.0f-fz)+b*fz;
+}
+
+void noise::lattice(const float* x, const float* y, float z, float* out, int n)
+{
+   int i=0;
+
+#ifdef __SSE2__
+   static const int size=lattice_size;
+   const float* values=tables.lattice;
+
+   const int iz0=(int(z) & (size-1))*size*size;
+   const int iz1=((int(z)+1) & (size-1))*size*size;
+   const __m128 fz=_mm_set1_ps(z-floor(z));
+   const __m128 one=_mm_set1_ps(1.0f);
+
+   for(;i+4<=n;i+=4)
+   {
+      const __m128 px=_mm_loadu_ps(x+i);
+      const __m128 py=_mm_loadu_ps(y+i);
+
+      const __m128i tx=_mm_cvttps_epi32(px);
+      const __m128i ty=_mm_cvttps_epi32(py);
+
+      // floor, from truncation
+      const __m128 ftx=_mm_cvtepi32_ps(tx);
+      const __m128 fty=_mm_cvtepi32_ps(ty);
+      const __m128 fx=_mm_sub_ps(px,_mm_sub_ps(ftx,_mm_and_ps(_mm_cmpgt_ps(ftx,px),one)));
+      const __m128 fy=_mm_sub_ps(py,_mm_sub_ps(fty,_mm_and_ps(_mm_cmpgt_ps(fty,py),one)));
+
+      int ix[4],iy[4];
+      _mm_storeu_si128((__m128i*)ix,tx);
+      _mm_storeu_si128((__m128i*)iy,ty);
+
+      float vs[8][4];
+      for(int k=0;k<4;++k)
+      {
+         const int x0=ix[k] & (size-1), x1=(ix[k]+1) & (size-1);
+         const int y0=(iy[k] & (size-1))*size, y1=((iy[k]+1) & (size-1))*size;
+         vs[0][k]=values[x0+y0+iz0];
+         vs[1][k]=values[x1+y0+iz0];
+         vs[2][k]=values[x0+y1+iz0];
+         vs[3][k]=values[x1+y1+iz0];
+         vs[4][k]=values[x0+y0+iz1];
+         vs[5][k]=values[x1+y0+iz1];
+         vs[6][k]=values[x0+y1+iz1];
+         vs[7][k]=values[x1+y1+iz1];
+      }
+
+      __m128 v[8];
+      for(int k=0;k<8;++k)
+         v[k]=_mm_loadu_ps(vs[k]);
+
+      const __m128 gx=_mm_sub_ps(one,fx), gy=_mm_sub_ps(one,fy), gz=_mm_sub_ps(one,fz);
+
+      const __m128 a=_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(v[0],gx),_mm_mul_ps(v[1],fx)),gy),
+                                _mm_mul_ps(_mm_add_ps(_mm_mul_ps(v[2],gx),_mm_mul_ps(v[3],fx)),fy));
+
+      const __m128 b=_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(v[4],gx),_mm_mul_ps(v[5],fx)),gy),
+                                _mm_mul_ps(_mm_add_ps(_mm_mul_ps(v[6],gx),_mm_mul_ps(v[7],fx)),fy));
+
+      _mm_storeu_ps(out+i,_mm_add_ps(_mm_mul_ps(a,gz),_mm_mul_ps(b,fz)));
+   }
+#endif
+
+   for(;i<n;++i)
+      out[i]=lattice(x[i],y[i],z);
+}
+
+float noise::latticeFbm(float x, float y, float z)
+{
+   float f=0;
+   for(int i=0;i<3;++i)
+   {
+      float s=float(1<<i);
+      f+=lattice(x*s,y*s,z*s)*0.5f/s;
+   }
+
+   return f;
+}
+
+void noise::latticeFbm(const float* x, const float* y, float z, float* out, int n)
+{
+   float sx[chunk],sy[chunk],v[chunk];
+
+   for(int j=0;j<n;j+=chunk)
+   {
+      const int m=std::min(chunk,n-j);
+
+      for(int k=0;k<m;++k)
+         out[j+k]=0;
+
+      for(int i=0;i<3;++i)
+      {
+         float s=float(1<<i);
+
+         for(int k=0;k<m;++k)
+         {
+            sx[k]=x[j+k]*s;
+            sy[k]=y[j+k]*s;
+         }
+
+         lattice(sx,sy,z*s,v,m);
+
+         for(int k=0;k<m;++k)
+            out[j+k]+=v[k]*0.5f/s;
+      }
+   }
+}
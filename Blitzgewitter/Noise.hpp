@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Engine.hpp"
+
+// Value noise shared by the scenes. The lattice is generated once at startup.
+// The batched functions use SSE2 where it is available, eight points at a time for the grid
+// and four for the lattice, and agree with the single-point functions to within float rounding.
+
+namespace noise
+{
+
+static const int grid_size = 256;
+static const int lattice_size = 64;
+
+// Bilinearly interpolated values in [-1,1] on a grid_size by grid_size table. Each scene has
+// its own, filled from its own random numbers, so that the scenes keep their own noise and
+// their later random numbers.
+class RandomGrid
+{
+   float values[grid_size*grid_size] __attribute__((aligned(64)));
+
+   public:
+      // Draws the values in order, as (rand()-0.5)*2.
+      void fill(Real (*rand)());
+
+      // The table repeats every w by h cells. w and h must be powers of two no greater than
+      // grid_size.
+      float lookup(float u, float v, int w = grid_size, int h = grid_size) const;
+      void  lookup(const float* u, const float* v, float* out, int n, int w = grid_size, int h = grid_size) const;
+
+      // Sum of octaves of lookup(u * scale, v * scale) * mag, doubling scale and halving mag per octave.
+      float fbm(float u, float v, int octaves, float scale, float mag) const;
+      void  fbm(const float* u, const float* v, float* out, int n, int octaves, float scale, float mag) const;
+};
+
+// Trilinearly interpolated values in [0,1] on a lattice which repeats every lattice_size cells.
+// The batched version evaluates points which share the same z.
+float lattice(float x, float y = 0, float z = 0);
+void  lattice(const float* x, const float* y, float z, float* out, int n);
+
+// Three octaves of lattice noise, with the result in [0,0.875].
+float latticeFbm(float x, float y = 0, float z = 0);
+void  latticeFbm(const float* x, const float* y, float z, float* out, int n);
+
+}
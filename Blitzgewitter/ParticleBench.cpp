@@ -0,0 +1,162 @@
+// Runs particles::ReferenceSimulation without a window: a cloud of particles falls onto a ground
+// plane whose depth buffer is traced on the CPU, and it prints how many particle steps per second
+// were simulated, what became of the particles, and a checksum of their state. The checksum is
+// the same for every run of the same build, so a change to the simulation can be checked
+// against it.
+//
+// g++ -O2 ParticleBench.cpp ParticleSimulation.cpp -o particlebench
+// particlebench [number of particles] [number of sections] [steps per particle]
+
+#include "Particles.hpp"
+#include "Ran.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+static const int depth_width = 512, depth_height = 288;
+
+// column-major, as the shaders take them
+static void transform(const Mat4& m, const float in[4], float out[4])
+{
+   for(int i = 0; i < 4; ++i)
+      out[i] = m.e[i] * in[0] + m.e[4 + i] * in[1] + m.e[8 + i] * in[2] + m.e[12 + i] * in[3];
+}
+
+// the z / w of the plane y = 0 at each pixel, or 1 where the pixel sees no ground
+static void traceGround(const particles::Camera& camera, std::vector<GLfloat>& depth)
+{
+   depth.resize(depth_width * depth_height);
+
+   for(int y = 0; y < depth_height; ++y)
+      for(int x = 0; x < depth_width; ++x)
+      {
+         const float u = (x + 0.5f) / depth_width * 2.0f - 1.0f, v = (y + 0.5f) / depth_height * 2.0f - 1.0f;
+
+         // the ends of the pixel's ray, in world space
+         float ends[2][4];
+
+         for(int i = 0; i < 2; ++i)
+         {
+            const float ndc[4] = { u, v, i ? 1.0f : -1.0f, 1.0f };
+            float view[4];
+            transform(camera.getInvProjection(), ndc, view);
+
+            for(int j = 0; j < 4; ++j)
+               view[j] /= view[3];
+
+            transform(camera.getInvModelView(), view, ends[i]);
+         }
+
+         GLfloat& d = depth[x + y * depth_width];
+         d = 1.0f;
+
+         if(ends[0][1] > 0.0f && ends[1][1] < 0.0f)
+         {
+            const float t = ends[0][1] / (ends[0][1] - ends[1][1]);
+            const float p[4] = { ends[0][0] + (ends[1][0] - ends[0][0]) * t, 0.0f, ends[0][2] + (ends[1][2] - ends[0][2]) * t, 1.0f };
+
+            float mv[4], clip[4];
+            transform(camera.getModelView(), p, mv);
+            transform(camera.getProjection(), mv, clip);
+            d = clip[2] / clip[3];
+         }
+      }
+}
+
+static unsigned int hashFloats(unsigned int hash, const float* f, int n)
+{
+   for(int i = 0; i < n; ++i)
+   {
+      unsigned int u;
+      memcpy(&u, &f[i], sizeof(u));
+      hash = (hash ^ u) * 16777619u;
+   }
+
+   return hash;
+}
+
+int main(int argc, char** argv)
+{
+   const int num_particles = (argc > 1) ? atoi(argv[1]) : 1 << 18;
+   const int num_sections = (argc > 2) ? atoi(argv[2]) : 4;
+   const int num_steps = (argc > 3) ? atoi(argv[3]) : 100;
+
+   particles::Camera camera;
+
+   {
+      Mat4 modelview = Mat4::rotation(0.35f, Vec3(1.0f, 0.0f, 0.0f)) * Mat4::translation(Vec3(0.0f, -60.0f, -100.0f));
+      Mat4 projection = Mat4::frustum(-0.5f * 16.0f / 9.0f, +0.5f * 16.0f / 9.0f, -0.5f, +0.5f, 1.0f, 1000.0f);
+      camera.setModelView(modelview);
+      camera.setProjection(projection);
+   }
+
+   std::vector<GLfloat> depth;
+   traceGround(camera, depth);
+
+   particles::ReferenceSimulation sim;
+   sim.setCapacity(num_particles);
+   sim.setSectionCount(num_sections);
+   sim.setCamera(&camera);
+   sim.setGravityScale(100.0f);
+   sim.setBounce(0.1f);
+   sim.setDepth(&depth[0], depth_width, depth_height);
+
+   // a cloud as Particles::resetPositions makes, but lower down
+   Ran rnd(332);
+
+   for(int i = 0; i < num_particles; ++i)
+   {
+      float px, pz;
+
+      do
+      {
+         px = rnd.doub() - 0.5f;
+         pz = rnd.doub() - 0.5f;
+
+      } while(px * px + pz * pz > 0.25f);
+
+      const float py = rnd.doub() * 0.5f;
+
+      sim.setParticle(i, Vec3(px * 40, py * 70 + 5, pz * 40 - 5), Vec3(0, 0, 0), true);
+   }
+
+   const int num_updates = num_steps * num_sections;
+
+   const clock_t start = clock();
+
+   for(int n = 0; n < num_updates; ++n)
+      sim.update(n);
+
+   const double seconds = double(clock() - start) / CLOCKS_PER_SEC;
+
+   const std::vector<GLfloat>& pos = sim.getPositions();
+   const std::vector<GLfloat>& vel = sim.getVelocities();
+
+   int num_alive = 0, num_rising = 0, num_under = 0;
+
+   for(int i = 0; i < num_particles; ++i)
+   {
+      if(pos[i * 4 + 3] <= 0.0f)
+         continue;
+
+      ++num_alive;
+
+      if(vel[i * 3 + 1] > 0.0f)
+         ++num_rising;
+
+      if(pos[i * 4 + 1] < -1.0f)
+         ++num_under;
+   }
+
+   unsigned int hash = 2166136261u;
+   hash = hashFloats(hash, &pos[0], num_particles * 4);
+   hash = hashFloats(hash, &vel[0], num_particles * 3);
+
+   printf("%d particles, %d sections, %d updates in %.3f seconds, %.1f million particle steps per second\n",
+          num_particles, num_sections, num_updates, seconds, double(num_particles) * num_steps / seconds * 1e-6);
+   printf("%d alive, %d rising from a bounce, %d under the ground, checksum %08x\n", num_alive, num_rising, num_under, hash);
+
+   return 0;
+}
@@ -0,0 +1,226 @@
+#include "Particles.hpp"
+
+using namespace particles;
+
+void particles::sectionRange(int n, int num_sections, float& lo, float& hi)
+{
+   const int section = n % num_sections;
+   lo = 1.0f - float(section + 1) / float(num_sections);
+   hi = 1.0f - float(section) / float(num_sections);
+}
+
+Camera::Camera()
+{
+}
+
+const Mat4& Camera::getModelView() const
+{
+   return modelview;
+}
+
+const Mat4& Camera::getProjection() const
+{
+   return projection;
+}
+
+const Mat4& Camera::getInvModelView() const
+{
+   return inv_modelview;
+}
+
+const Mat4& Camera::getInvProjection() const
+{
+   return inv_projection;
+}
+
+void Camera::setModelView(Mat4& m)
+{
+   modelview = m;
+   inv_modelview = modelview.inverse();
+}
+
+void Camera::setProjection(Mat4& m)
+{
+   projection = m;
+   inv_projection = projection.inverse();
+}
+
+
+// column-major, as the shaders take them
+static void transform(const Mat4& m, const float in[4], float out[4])
+{
+   for(int i = 0; i < 4; ++i)
+      out[i] = m.e[i] * in[0] + m.e[4 + i] * in[1] + m.e[8 + i] * in[2] + m.e[12 + i] * in[3];
+}
+
+ReferenceSimulation::ReferenceSimulation():
+   tex_size(0),
+   num_sections(2),
+   camera(0),
+   gravity_scale(1.0f),
+   bounce(0.1f),
+   depth(0),
+   depth_width(0),
+   depth_height(0)
+{
+}
+
+void ReferenceSimulation::setCapacity(GLsizei count)
+{
+   tex_size = GLsizei(std::ceil(std::sqrt(double(count))));
+   positions.assign(tex_size * tex_size * 4, 0.0f);
+   velocities.assign(tex_size * tex_size * 3, 0.0f);
+}
+
+void ReferenceSimulation::setSectionCount(int n)
+{
+   assert(n > 0);
+   num_sections = n;
+}
+
+void ReferenceSimulation::setCamera(Camera* cam)
+{
+   camera = cam;
+}
+
+void ReferenceSimulation::setGravityScale(float scale)
+{
+   gravity_scale = scale;
+}
+
+void ReferenceSimulation::setBounce(float b)
+{
+   bounce = b;
+}
+
+void ReferenceSimulation::setDepth(const GLfloat* d, int width, int height)
+{
+   depth = d;
+   depth_width = width;
+   depth_height = height;
+}
+
+void ReferenceSimulation::setParticle(int index, const Vec3& pos, const Vec3& vel, bool alive)
+{
+   assert(index >= 0 && index < tex_size * tex_size);
+
+   positions[index * 4 + 0] = pos.x;
+   positions[index * 4 + 1] = pos.y;
+   positions[index * 4 + 2] = pos.z;
+   positions[index * 4 + 3] = alive ? 1.0f : 0.0f;
+
+   velocities[index * 3 + 0] = vel.x;
+   velocities[index * 3 + 1] = vel.y;
+   velocities[index * 3 + 2] = vel.z;
+}
+
+GLsizei ReferenceSimulation::getTexSize() const
+{
+   return tex_size;
+}
+
+const std::vector<GLfloat>& ReferenceSimulation::getPositions() const
+{
+   return positions;
+}
+
+const std::vector<GLfloat>& ReferenceSimulation::getVelocities() const
+{
+   return velocities;
+}
+
+float ReferenceSimulation::sampleDepth(float u, float v) const
+{
+   // bilinear, with a border of zero as for a clamp-to-border texture
+   const float x = u * depth_width - 0.5f, y = v * depth_height - 0.5f;
+   const int x0 = int(std::floor(x)), y0 = int(std::floor(y));
+   const float fx = x - x0, fy = y - y0;
+
+   float d[4];
+   for(int i = 0; i < 4; ++i)
+   {
+      const int sx = x0 + (i & 1), sy = y0 + (i >> 1);
+      d[i] = (sx >= 0 && sy >= 0 && sx < depth_width && sy < depth_height) ? depth[sx + sy * depth_width] : 0.0f;
+   }
+
+   return mix(mix(d[0], d[1], fx), mix(d[2], d[3], fx), fy);
+}
+
+Vec3 ReferenceSimulation::viewPointForCoord(float u, float v) const
+{
+   const float w_pos[4] = { u * 2.0f - 1.0f, v * 2.0f - 1.0f, sampleDepth(u, v), 1.0f };
+   float v_pos[4];
+   transform(camera->getInvProjection(), w_pos, v_pos);
+   return Vec3(v_pos[0] / v_pos[3], v_pos[1] / v_pos[3], v_pos[2] / v_pos[3]);
+}
+
+// The same steps as pm_f.glsl. The velocities are kept at full precision here, where the
+// texture holds halves.
+void ReferenceSimulation::update(int n)
+{
+   assert(camera && depth);
+
+   float lo, hi;
+   sectionRange(n, num_sections, lo, hi);
+
+   const Mat4& inv_view_mv = camera->getInvModelView();
+
+   for(int y = 0; y < tex_size; ++y)
+      for(int x = 0; x < tex_size; ++x)
+      {
+         const float tc_x = (float(x) + 0.5f) / float(tex_size);
+
+         if(tc_x < lo || tc_x >= hi)
+            continue;
+
+         GLfloat* p = &positions[(x + y * tex_size) * 4];
+         GLfloat* vel = &velocities[(x + y * tex_size) * 3];
+
+         if(p[3] <= 0.0f)
+            continue;
+
+         Vec3 pos(p[0], p[1], p[2]), v(vel[0], vel[1], vel[2]);
+
+         v += Vec3(0.0f, -1e-4f * gravity_scale, 0.0f) * 3.0f;
+
+         pos += v / 8.0f * 3.0f;
+
+         const float pos4[4] = { pos.x, pos.y, pos.z, 1.0f };
+         float mv_pos[4], clip_pos[4];
+         transform(camera->getModelView(), pos4, mv_pos);
+         transform(camera->getProjection(), mv_pos, clip_pos);
+
+         const float u = clip_pos[0] / clip_pos[3] * 0.5f + 0.5f;
+         const float w = clip_pos[1] / clip_pos[3] * 0.5f + 0.5f;
+
+         const Vec3 g_mv_pos = viewPointForCoord(u, w);
+
+         if(u > 0.0f && u < 1.0f && w > 0.0f && w < 1.0f &&
+            g_mv_pos.z < -1e-2f && g_mv_pos.z > mv_pos[2] && g_mv_pos.z < (mv_pos[2] + 4.0f))
+         {
+            const Vec3 p0 = viewPointForCoord(u, w);
+            const Vec3 p1 = viewPointForCoord(u + 1.0f / depth_width, w);
+            const Vec3 p2 = viewPointForCoord(u, w + 1.0f / depth_height);
+
+            Vec3 vn = (p1 - p0).cross(p2 - p0);
+            vn = vn / std::sqrt(vn.lengthSquared());
+
+            const Vec3 nrm(inv_view_mv.e[0] * vn.x + inv_view_mv.e[4] * vn.y + inv_view_mv.e[8] * vn.z,
+                           inv_view_mv.e[1] * vn.x + inv_view_mv.e[5] * vn.y + inv_view_mv.e[9] * vn.z,
+                           inv_view_mv.e[2] * vn.x + inv_view_mv.e[6] * vn.y + inv_view_mv.e[10] * vn.z);
+
+            const Vec3 r = v - nrm * (2.0f * nrm.dot(v));
+
+            pos += nrm * 2e-2f;
+            v = r * bounce + Vec3(std::cos(pos.x * 1e5f), std::cos(pos.y * 1e5f), std::cos(pos.z * 1e5f)) * 1e-3f;
+         }
+
+         p[0] = pos.x;
+         p[1] = pos.y;
+         p[2] = pos.z;
+
+         vel[0] = v.x;
+         vel[1] = v.y;
+         vel[2] = v.z;
+      }
+}
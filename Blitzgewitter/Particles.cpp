@@ -31,84 +31,13 @@ static void drawQuad()
    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-static void drawQuadSection(int section)
-{
-   static const int num_sections = 2;
-   static GLuint vbo = 0;
-
-   section %= num_sections;
-
-   if(vbo == 0)
-   {
-      GLfloat verts[(2 + 2 * num_sections) * 2] = { +1.0f,  -1.0f, +1.0f, +1.0f,  -1.0f,  -1.0f,  -1.0f, +1.0f };
-
-      for(int i=0;i<=num_sections;++i)
-      {
-         verts[i * 4 + 0] = +1.0f - 2.0f / num_sections * i;
-         verts[i * 4 + 1] = -1.0f;
-         verts[i * 4 + 2] = +1.0f - 2.0f / num_sections * i;
-         verts[i * 4 + 3] = +1.0f;
-      }
-
-      glGenBuffers(1, &vbo);
-      glBindBuffer(GL_ARRAY_BUFFER, vbo);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
-   }
-
-   glBindBuffer(GL_ARRAY_BUFFER, vbo);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
-   glEnableVertexAttribArray(0);
-   glDrawArrays(GL_TRIANGLE_STRIP, section * 2, 4);
-   glDisableVertexAttribArray(0);
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-}
-
-Camera::Camera()
-{
-}
-
-const Mat4& Camera::getModelView() const
-{
-   return modelview;
-}
-
-const Mat4& Camera::getProjection() const
-{
-   return projection;
-}
-
-const Mat4& Camera::getInvModelView() const
-{
-   return inv_modelview;
-}
-
-const Mat4& Camera::getInvProjection() const
-{
-   return inv_projection;
-}
-
-void Camera::setModelView(Mat4& m)
-{
-   modelview = m;
-   inv_modelview = modelview.inverse();
-}
-
-void Camera::setProjection(Mat4& m)
-{
-   projection = m;
-   inv_projection = projection.inverse();
-}
-
-
 Particles::Particles():
-   particle_pos_tex(0),
-   particle_vel_tex(0),
    depth_tex(0),
    pm_shader_program(0),
    particle_shader_program(0),
+   emit_shader_program(0),
    particle_tex_size(32),
-   particle_fbo(0),
+   capacity(32 * 32),
    camera(0),
    pm_shader_view_mv_loc(0),
    pm_shader_view_p_loc(0),
@@ -122,15 +51,33 @@ Particles::Particles():
    particle_shader_scale_loc(0),
    gravity_scale(1.0f),
    pm_shader_gravity_scale_loc(0),
+   bounce(0.1f),
+   pm_shader_bounce_loc(0),
+   pm_shader_update_range_loc(0),
+   emit_shader_tex_size_loc(0),
    initial_spread(1.0f),
-   section_counter(0)
+   initial_count(-1),
+   section_counter(0),
+   num_sections(2)
 {
+   for(int i = 0; i < 2; ++i)
+   {
+      particle_pos_tex[i] = 0;
+      particle_vel_tex[i] = 0;
+      particle_fbo[i] = 0;
+   }
+}
 
+Particles::~Particles()
+{
+   free();
 }
 
 void Particles::resetPositions()
 {
-   GLfloat* dat = new GLfloat[particle_tex_size * particle_tex_size * 3];
+   const GLsizei count = (initial_count < 0) ? capacity : std::min(initial_count, capacity);
+
+   GLfloat* dat = new GLfloat[particle_tex_size * particle_tex_size * 4];
 
    for(int y = 0; y < particle_tex_size; ++y)
       for(int x = 0; x < particle_tex_size; ++x)
@@ -148,16 +95,26 @@ void Particles::resetPositions()
 
          py = frand() * 0.5f;
 
-         dat[(x + y * particle_tex_size) * 3 + 0] = px * initial_spread * 40;
-         dat[(x + y * particle_tex_size) * 3 + 1] = py * initial_spread * 256 + 40*2;
-         dat[(x + y * particle_tex_size) * 3 + 2] = pz * initial_spread * 40 - 5;
+         dat[(x + y * particle_tex_size) * 4 + 0] = px * initial_spread * 40;
+         dat[(x + y * particle_tex_size) * 4 + 1] = py * initial_spread * 256 + 40*2;
+         dat[(x + y * particle_tex_size) * 4 + 2] = pz * initial_spread * 40 - 5;
+         dat[(x + y * particle_tex_size) * 4 + 3] = (x + y * particle_tex_size < count) ? 1.0f : 0.0f;
       }
 
-	glBindTexture(GL_TEXTURE_2D, particle_pos_tex);
-   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, particle_tex_size, particle_tex_size, GL_RGB, GL_FLOAT, dat);
+	glBindTexture(GL_TEXTURE_2D, particle_pos_tex[0]);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, particle_tex_size, particle_tex_size, GL_RGBA, GL_FLOAT, dat);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
    delete[] dat;
+
+   alive.assign(capacity, false);
+   std::fill(alive.begin(), alive.begin() + count, true);
+   pending.clear();
+
+   // the rest are free, lowest indices first
+   free_list.resize(capacity - count);
+   for(GLsizei i = 0; i < capacity - count; ++i)
+      free_list[i] = capacity - 1 - i;
 }
 
 void Particles::resetVelocities()
@@ -174,48 +131,125 @@ void Particles::resetVelocities()
          dat[(x + y * particle_tex_size) * 3 + 2] = (frand() - 0.5f) * s;
       }
 
-	glBindTexture(GL_TEXTURE_2D, particle_vel_tex);
+	glBindTexture(GL_TEXTURE_2D, particle_vel_tex[0]);
    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, particle_tex_size, particle_tex_size, GL_RGB, GL_FLOAT, dat);
 	glBindTexture(GL_TEXTURE_2D, 0);
    delete[] dat;
 }
 
-int Particles::init()
+void Particles::killAll()
 {
-	glGenTextures(1, &particle_pos_tex);
-	glBindTexture(GL_TEXTURE_2D, particle_pos_tex);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-   glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB32F, particle_tex_size, particle_tex_size);
-
-   resetPositions();
+   std::vector<GLfloat> dat(particle_tex_size * particle_tex_size * 4, 0.0f);
 
+	glBindTexture(GL_TEXTURE_2D, particle_pos_tex[0]);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, particle_tex_size, particle_tex_size, GL_RGBA, GL_FLOAT, &dat[0]);
 	glBindTexture(GL_TEXTURE_2D, 0);
-   CHECK_FOR_ERRORS("creating particle position texture");
 
+   alive.assign(capacity, false);
+   pending.clear();
 
-	glGenTextures(1, &particle_vel_tex);
-	glBindTexture(GL_TEXTURE_2D, particle_vel_tex);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-   glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, particle_tex_size, particle_tex_size);
+   // lowest indices first
+   free_list.resize(capacity);
+   for(GLsizei i = 0; i < capacity; ++i)
+      free_list[i] = capacity - 1 - i;
+}
 
-   resetVelocities();
+int Particles::emit(const Vec3& pos, const Vec3& vel)
+{
+   if(free_list.empty())
+      return -1;
+
+   const GLint index = free_list.back();
+   free_list.pop_back();
+   alive[index] = true;
+
+   const GLfloat p[8] = { GLfloat(index), pos.x, pos.y, pos.z, 1.0f, vel.x, vel.y, vel.z };
+   pending.insert(pending.end(), p, p + 8);
+
+   return index;
+}
+
+void Particles::kill(int index)
+{
+   assert(index >= 0 && index < capacity);
+
+   if(!alive[index])
+      return;
+
+   alive[index] = false;
+   free_list.push_back(index);
+
+   const GLfloat p[8] = { GLfloat(index), 0, 0, 0, 0, 0, 0, 0 };
+   pending.insert(pending.end(), p, p + 8);
+}
+
+GLsizei Particles::getCapacity() const
+{
+   return capacity;
+}
+
+GLsizei Particles::getLiveCount() const
+{
+   return capacity - GLsizei(free_list.size());
+}
+
+GLuint Particles::getPositionTex() const
+{
+   return particle_pos_tex[0];
+}
+
+void Particles::createState()
+{
+   for(int i = 0; i < 2; ++i)
+   {
+      glGenTextures(1, &particle_pos_tex[i]);
+      glBindTexture(GL_TEXTURE_2D, particle_pos_tex[i]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, particle_tex_size, particle_tex_size);
+      CHECK_FOR_ERRORS("creating particle position texture");
+
+      glGenTextures(1, &particle_vel_tex[i]);
+      glBindTexture(GL_TEXTURE_2D, particle_vel_tex[i]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, particle_tex_size, particle_tex_size);
+      CHECK_FOR_ERRORS("creating particle velocity texture");
+
+      glGenFramebuffers(1, &particle_fbo[i]);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, particle_fbo[i]);
+      glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, particle_vel_tex[i], 0);
+      glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, particle_pos_tex[i], 0);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+      CHECK_FOR_ERRORS("creating particle FBO");
+   }
 
 	glBindTexture(GL_TEXTURE_2D, 0);
-   CHECK_FOR_ERRORS("creating particle velocity texture");
 
+   resetPositions();
+   resetVelocities();
+}
+
+void Particles::deleteState()
+{
+   for(int i = 0; i < 2; ++i)
+   {
+      glDeleteTextures(1, &particle_pos_tex[i]);
+      glDeleteTextures(1, &particle_vel_tex[i]);
+      glDeleteFramebuffers(1, &particle_fbo[i]);
+      particle_pos_tex[i] = 0;
+      particle_vel_tex[i] = 0;
+      particle_fbo[i] = 0;
+   }
+}
 
-	glGenFramebuffers(1, &particle_fbo);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, particle_fbo);
-	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, particle_vel_tex, 0);
-	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, particle_pos_tex, 0);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-   CHECK_FOR_ERRORS("creating particle FBO");
+int Particles::init()
+{
+   createState();
 
 	pm_shader_program = createProgram(SHADERS_PATH "pm_v.glsl", NULL, SHADERS_PATH "pm_f.glsl");
 	glUniform1i(glGetUniformLocation(pm_shader_program, "depth_tex"), 0);
@@ -226,6 +260,8 @@ int Particles::init()
    pm_shader_inv_view_mv_loc = glGetUniformLocation(pm_shader_program, "inv_view_mv");
    pm_shader_inv_view_p_loc = glGetUniformLocation(pm_shader_program, "inv_view_p");
    pm_shader_gravity_scale_loc = glGetUniformLocation(pm_shader_program, "gravity_scale");
+   pm_shader_bounce_loc = glGetUniformLocation(pm_shader_program, "bounce");
+   pm_shader_update_range_loc = glGetUniformLocation(pm_shader_program, "update_range");
 	glUseProgram(0);
    CHECK_FOR_ERRORS("loading shaders");
 
@@ -236,16 +272,36 @@ int Particles::init()
    particle_shader_scale_loc = glGetUniformLocation(particle_shader_program, "particle_scale");
 	glUseProgram(0);
 
+   emit_shader_program = createProgram(SHADERS_PATH "pm_emit_v.glsl", NULL, SHADERS_PATH "pm_emit_f.glsl");
+   emit_shader_tex_size_loc = glGetUniformLocation(emit_shader_program, "tex_size");
+	glUseProgram(0);
+
    CHECK_FOR_ERRORS("loading shaders");
 
    return 0;
 }
 
+void Particles::free()
+{
+   deleteState();
+   glDeleteProgram(pm_shader_program);
+   glDeleteProgram(particle_shader_program);
+   glDeleteProgram(emit_shader_program);
+   pm_shader_program = 0;
+   particle_shader_program = 0;
+   emit_shader_program = 0;
+}
+
 void Particles::setInitialSpread(float spread)
 {
    initial_spread = spread;
 }
 
+void Particles::setInitialCount(GLsizei count)
+{
+   initial_count = count;
+}
+
 void Particles::setGravityScale(float scale)
 {
    gravity_scale = scale;
@@ -256,6 +312,11 @@ void Particles::setParticleScale(float scale)
    particle_scale = scale;
 }
 
+void Particles::setBounce(float b)
+{
+   bounce = b;
+}
+
 void Particles::setDepthTex(GLuint tex)
 {
    depth_tex = tex;
@@ -263,7 +324,27 @@ void Particles::setDepthTex(GLuint tex)
 
 void Particles::setParticleTexSize(GLsizei sz)
 {
-   particle_tex_size = sz;
+   setCapacity(sz * sz);
+}
+
+void Particles::setCapacity(GLsizei count)
+{
+   assert(count > 0);
+
+   capacity = count;
+   particle_tex_size = GLsizei(std::ceil(std::sqrt(double(count))));
+
+   if(particle_pos_tex[0])
+   {
+      deleteState();
+      createState();
+   }
+}
+
+void Particles::setSectionCount(int n)
+{
+   assert(n > 0);
+   num_sections = n;
 }
 
 void Particles::setFrameWidth(int w)
@@ -281,8 +362,47 @@ void Particles::setCamera(Camera* cam)
    camera = cam;
 }
 
+void Particles::flushPending()
+{
+   if(pending.empty())
+      return;
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, particle_fbo[0]);
+
+	{
+      GLenum b[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+      glDrawBuffers(2, b);
+	}
+
+	glViewport(0, 0, particle_tex_size, particle_tex_size);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	glUseProgram(emit_shader_program);
+   glUniform1i(emit_shader_tex_size_loc, particle_tex_size);
+
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glEnableVertexAttribArray(0);
+   glEnableVertexAttribArray(1);
+   glEnableVertexAttribArray(2);
+   glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, &pending[0]);
+   glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, &pending[1]);
+   glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 8, &pending[5]);
+   glDrawArrays(GL_POINTS, 0, pending.size() / 8);
+   glDisableVertexAttribArray(0);
+   glDisableVertexAttribArray(1);
+   glDisableVertexAttribArray(2);
+
+   pending.clear();
+
+   CHECK_FOR_ERRORS("emitting particles");
+}
+
 void Particles::update()
 {
+   flushPending();
+
 	glUseProgram(pm_shader_program);
 
 	glUniformMatrix4fv(pm_shader_view_mv_loc, 1, GL_FALSE, camera->getModelView().e);
@@ -290,8 +410,22 @@ void Particles::update()
    glUniformMatrix4fv(pm_shader_inv_view_mv_loc, 1, GL_FALSE, camera->getInvModelView().e);
    glUniformMatrix4fv(pm_shader_inv_view_p_loc, 1, GL_FALSE, camera->getInvProjection().e);
    glUniform1f(pm_shader_gravity_scale_loc, gravity_scale);
+   glUniform1f(pm_shader_bounce_loc, bounce);
 
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, particle_fbo);
+   // the columns of texels in the section, and one more on each side in case of rounding, which
+   // the shader copies across as they are
+   GLint x0, x1;
+
+   {
+      float lo, hi;
+      sectionRange(section_counter++, num_sections, lo, hi);
+      glUniform2f(pm_shader_update_range_loc, lo, hi);
+
+      x0 = std::max(0, GLint(std::ceil(lo * particle_tex_size - 0.5f)) - 1);
+      x1 = std::min(particle_tex_size, GLint(std::ceil(hi * particle_tex_size - 0.5f)) + 1);
+   }
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, particle_fbo[1]);
 
 	{
       GLenum b[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
@@ -302,13 +436,30 @@ void Particles::update()
 	glDepthMask(GL_FALSE);
 	glDisable(GL_DEPTH_TEST);
 	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, particle_vel_tex);
+	glBindTexture(GL_TEXTURE_2D, particle_vel_tex[0]);
 	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, particle_pos_tex);
+	glBindTexture(GL_TEXTURE_2D, particle_pos_tex[0]);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, depth_tex);
 
-   drawQuadSection(section_counter++);
+   glScissor(x0, 0, x1 - x0, particle_tex_size);
+   glEnable(GL_SCISSOR_TEST);
+   drawQuad();
+   glDisable(GL_SCISSOR_TEST);
+
+   // the section goes back into the state, and the rest of it stays where it is
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, particle_fbo[1]);
+
+   glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glBindTexture(GL_TEXTURE_2D, particle_pos_tex[0]);
+   glCopyTexSubImage2D(GL_TEXTURE_2D, 0, x0, 0, x0, 0, x1 - x0, particle_tex_size);
+
+   glReadBuffer(GL_COLOR_ATTACHMENT1);
+	glBindTexture(GL_TEXTURE_2D, particle_vel_tex[0]);
+   glCopyTexSubImage2D(GL_TEXTURE_2D, 0, x0, 0, x0, 0, x1 - x0, particle_tex_size);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
    CHECK_FOR_ERRORS("updating particles");
 }
@@ -327,8 +478,8 @@ void Particles::render()
    glBlendFunc(GL_ONE, GL_ONE);
 
 	glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, particle_pos_tex);
-   glDrawArrays(GL_POINTS, 0, particle_tex_size * particle_tex_size);
+   glBindTexture(GL_TEXTURE_2D, particle_pos_tex[0]);
+   glDrawArrays(GL_POINTS, 0, capacity);
    glBindTexture(GL_TEXTURE_2D, 0);
 
    glDisable(GL_BLEND);
@@ -1,4 +1,3 @@
-
 #pragma once
 
 #include "Engine.hpp"
@@ -27,18 +26,37 @@ class Camera
 };
 
 
+// The strip of the state textures which the nth update simulates, in texture coordinates.
+void sectionRange(int n, int num_sections, float& lo, float& hi);
+
+
+// The state of each particle is a texel of a position texture, whose w is 1 while the particle
+// is alive, and a velocity texture. Only one of num_sections vertical strips of the particles is
+// simulated per update. It is drawn from the state into a second pair of textures, and copied
+// back, so the rest of the state is left in place and the cost of an update is fixed by the
+// size of the section.
 class Particles
 {
    public:
       Particles();
+      ~Particles();
 
       int  init();
+      void free();
       void setDepthTex(GLuint);
       void setParticleTexSize(GLsizei);
+      void setCapacity(GLsizei);
+      void setSectionCount(int);
       void setCamera(Camera*);
       void setParticleScale(float);
       void setGravityScale(float);
+      void setBounce(float);
       void setInitialSpread(float);
+
+      // The number of particles which resetPositions brings to life, leaving the rest for emit.
+      // All of them by default.
+      void setInitialCount(GLsizei);
+
       void update();
       void render();
       void setFrameWidth(int);
@@ -46,14 +64,27 @@ class Particles
       void resetPositions();
       void resetVelocities();
 
+      // Emitted particles appear in the next update. emit returns the particle's index, or -1
+      // if all of them are alive.
+      int  emit(const Vec3& pos, const Vec3& vel);
+      void kill(int index);
+      void killAll();
+
+      GLsizei getCapacity() const;
+      GLsizei getLiveCount() const;
+      GLuint  getPositionTex() const;
+
    private:
-      GLuint  particle_pos_tex;
-      GLuint  particle_vel_tex;
+      // The state is in the first of each, and each update draws its section into the second.
+      GLuint  particle_pos_tex[2];
+      GLuint  particle_vel_tex[2];
       GLuint  depth_tex;
       GLuint  pm_shader_program;
       GLuint  particle_shader_program;
+      GLuint  emit_shader_program;
       GLsizei particle_tex_size;
-      GLuint  particle_fbo;
+      GLsizei capacity;
+      GLuint  particle_fbo[2];
       Camera* camera;
       GLint   pm_shader_view_mv_loc;
       GLint   pm_shader_view_p_loc;
@@ -67,8 +98,66 @@ class Particles
       GLint   particle_shader_scale_loc;
       float   gravity_scale;
       GLint   pm_shader_gravity_scale_loc;
+      float   bounce;
+      GLint   pm_shader_bounce_loc;
+      GLint   pm_shader_update_range_loc;
+      GLint   emit_shader_tex_size_loc;
       float   initial_spread;
+      GLsizei initial_count;
       int     section_counter;
+      int     num_sections;
+
+      // Indices of the dead particles, and the emits and kills waiting for the next update as
+      // index, position and alive flag, velocity.
+      std::vector<GLint>   free_list;
+      std::vector<bool>    alive;
+      std::vector<GLfloat> pending;
+
+      void createState();
+      void deleteState();
+      void flushPending();
+};
+
+
+// The update of Particles done on the CPU, on state laid out as in the textures, so that the
+// simulation can be checked against and timed without a GL context.
+class ReferenceSimulation
+{
+   public:
+      ReferenceSimulation();
+
+      void setCapacity(GLsizei);
+      void setSectionCount(int);
+      void setCamera(Camera*);
+      void setGravityScale(float);
+      void setBounce(float);
+
+      // The contents of depth_tex, which it samples with linear filtering.
+      void setDepth(const GLfloat* depth, int width, int height);
+
+      void setParticle(int index, const Vec3& pos, const Vec3& vel, bool alive);
+
+      // One update, which simulates the same section as the nth update of Particles.
+      void update(int n);
+
+      GLsizei getTexSize() const;
+
+      // xyzw and xyz per particle, in the order of the texels.
+      const std::vector<GLfloat>& getPositions() const;
+      const std::vector<GLfloat>& getVelocities() const;
+
+   private:
+      GLsizei tex_size;
+      int num_sections;
+      Camera* camera;
+      float gravity_scale;
+      float bounce;
+      std::vector<GLfloat> positions, velocities;
+      const GLfloat* depth;
+      int depth_width, depth_height;
+
+      float sampleDepth(float u, float v) const;
+      Vec3 viewPointForCoord(float u, float v) const;
 };
 
 }
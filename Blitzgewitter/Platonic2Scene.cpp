@@ -6,6 +6,7 @@
 #include "Ran.hpp"
 #include "Particles.hpp"
 #include "Tower.hpp"
+#include "MotionBlur.hpp"
 
 static inline Real frand()
 {
@@ -29,8 +30,8 @@ class Platonic2Scene: public Scene
    particles::Camera prt_camera;
 
    Shader forrest_shader, bokeh_shader, bokeh2_shader;
-   Shader gaussbokeh_shader, composite_shader;
-   Shader mb_accum_shader;
+   Shader composite_shader;
+   motionblur::Scheduler motion_blur;
    Shader screendisplay_shader;
    Shader bgfg_shader;
 
@@ -59,7 +60,6 @@ class Platonic2Scene: public Scene
 
    void drawTower(tower::Tower& twr, const Mat4& modelview, Real camheight);
    void drawView(float ltime);
-   void gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0);
 
 
    public:
@@ -201,14 +201,15 @@ void Platonic2Scene::initializeTextures()
 {
    glGenTextures(num_texs, texs);
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
-   createWindowTexture(texs[12], GL_RGBA16F, 2);
-   createWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[12], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[8], GL_R32F);
 
    CHECK_FOR_ERRORS;
 
@@ -267,7 +268,6 @@ void Platonic2Scene::initializeTextures()
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-   glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, window_width, window_height);
    CHECK_FOR_ERRORS;
    glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -280,10 +280,8 @@ void Platonic2Scene::initializeBuffers()
 
    bokeh_temp_fbo = fbos[12];
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -340,11 +338,8 @@ void Platonic2Scene::initializeShaders()
    bokeh2_shader.uniform1i("tex2", 1);
    bokeh2_shader.uniform1f("aspect_ratio", float(window_height) / float(window_width));
 
-   gaussbokeh_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "gaussblur_f.glsl");
-   gaussbokeh_shader.uniform1i("tex0", 0);
 
-   mb_accum_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_accum_f.glsl");
-   mb_accum_shader.uniform1i("tex0", 0);
+   motion_blur.loadShaders();
 
 
    composite_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "cubes_composite_f.glsl");
@@ -410,56 +405,24 @@ void Platonic2Scene::drawTower(tower::Tower& twr, const Mat4& modelview, Real ca
    else
       forrest_shader.uniform1f("glow",0.0f);
 
-   unsigned int piece_index=0;
-   for(std::vector<tower::PieceInstance>::iterator p=twr.instances.begin();p!=twr.instances.end();++p,++piece_index)
-   {
-      std::map<std::string,Real>& ps=p->parameters;
-
-      if((ps["background"]>0.5)!=drawing_view_for_background)
-         continue;
+   const tower::Pieces pieces(twr);
 
-      if(camheight < (p->section->height1 - camheightrange) || camheight > (p->section->height0 + camheightrange))
+   for(unsigned int i=0;i<twr.getInstanceCount();++i)
+   {
+      if(!pieces.inView(i, drawing_view_for_background, camheight, camheightrange))
          continue;
 
-      Mesh* mesh=&icosahedron_mesh;
-
-
-      mesh->bind();
-
       const float b=drawing_view_for_background ? (cubic(clamp(lltime*0.5f,0.0f,1.0f))) : 1;
 
-      forrest_shader.uniform1f("ptn_thickness",ps["ptn_thickness"]);
-      forrest_shader.uniform1f("ptn_brightness",ps["ptn_brightness"]);
-      forrest_shader.uniform1f("ptn_scroll",ps["ptn_scroll"]);
-      forrest_shader.uniform1f("ptn_frequency",ps["ptn_frequency"]);
-      forrest_shader.uniform1f("shimmer",ps["shimmer"]);
-      forrest_shader.uniform1f("l0_scroll",ps["l0_scroll"]);
-      forrest_shader.uniform1f("l0_brightness",ps["l0_brightness"]*b);
-      forrest_shader.uniform1f("l1_scroll",ps["l1_scroll"]);
-      forrest_shader.uniform1f("l1_brightness",ps["l1_brightness"]*b);
-      forrest_shader.uniform1f("l2_scroll",ps["l2_scroll"]);
-      forrest_shader.uniform1f("l2_brightness",ps["l2_brightness"]*b);
-      forrest_shader.uniform1f("ambient",ps["ambient"]);
+      pieces.setUniforms(forrest_shader, i, b);
 
       glActiveTexture(GL_TEXTURE0);
       glBindTexture(GL_TEXTURE_3D,noise_tex);
 
-      const float upwards=(piece_index == 27) ? 0.0f : std::pow(std::max(0.0f,(lltime-15.0f-piece_index*0.1f)),2.0f)*0.9f;
-      const float rs=(piece_index == 27) ? 0.96f : 1.0f;
-
-      Mat4 modelview2 = modelview * Mat4::rotation(lltime * ps["section_rot_spd"], Vec3(0,1,0)) *
-                        Mat4::translation(Vec3(std::cos(ps["angle"])*ps["distance"], ps["height"]-upwards, std::sin(ps["angle"])*ps["distance"])) *
-                        Mat4::rotation(ps["rot_z"]+lltime*ps["rot_spd_z"]*rs,Vec3(0,0,1)) * Mat4::rotation(ps["rot_y"]+lltime*ps["rot_spd_y"]*rs,Vec3(0,1,0)) * Mat4::rotation(ps["rot_x"]+lltime*ps["rot_spd_x"]*rs,Vec3(1,0,0)) *
-                        Mat4::scale(Vec3(ps["sca_x"],ps["sca_y"],ps["sca_z"]));
-
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
-      glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(mesh->getVertexCount() * sizeof(GLfloat) * 3));
+      const float upwards=(i == 27) ? 0.0f : std::pow(std::max(0.0f,(lltime-15.0f-i*0.1f)),2.0f)*0.9f;
+      const float rs=(i == 27) ? 0.96f : 1.0f;
 
-      forrest_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview2.e);
-
-//// 011011
-//if(piece_index==27)
-      glDrawRangeElements(GL_TRIANGLES, 0, mesh->getVertexCount() - 1, mesh->getTriangleCount() * 3, GL_UNSIGNED_INT, 0);
+      tower::Pieces::draw(forrest_shader, icosahedron_mesh, modelview * pieces.transform(i, lltime, upwards, rs));
 
       CHECK_FOR_ERRORS;
    }
@@ -519,6 +482,10 @@ void Platonic2Scene::drawView(float ltime)
 
    CHECK_FOR_ERRORS;
 
+   // the camera of the view which is displayed, not of the background pass
+   if(!drawing_view_for_background)
+      motion_blur.observe(projection, modelview);
+
    forrest_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
    screendisplay_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
    prt_camera.setProjection(projection);
@@ -575,78 +542,6 @@ void Platonic2Scene::drawView(float ltime)
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void Platonic2Scene::gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0)
-{
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLfloat coords[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glEnableVertexAttribArray(0);
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
-
-   glViewport(0, 0, window_width / 4, window_height / 4);
-
-   // gaussian blur pass 1
-
-   {
-      gaussbokeh_shader.uniform4f("tint", tint_r, tint_g, tint_b, 1.0f);
-   }
-
-   const float gauss_radx = radx;
-   const float gauss_rady = rady;
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo0);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   glDepthMask(GL_FALSE);
-   glDisable(GL_DEPTH_TEST);
-
-   gaussbokeh_shader.bind();
-   gaussbokeh_shader.uniform2f("direction", gauss_radx * float(window_height) / float(window_width), 0.0f);
-
-   glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, src_tex);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-
-
-   // gaussian blur pass 2
-
-   gaussbokeh_shader.uniform4f("tint", 1, 1, 1, 1);
-
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo1);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   gaussbokeh_shader.uniform2f("direction", 0.0f, gauss_rady);
-
-   glBindTexture(GL_TEXTURE_2D, tex0);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-   glDisableVertexAttribArray(0);
-   glDisableVertexAttribArray(1);
-
-   CHECK_FOR_ERRORS;
-}
-
 
 void Platonic2Scene::render()
 {
@@ -658,6 +553,8 @@ void Platonic2Scene::render()
 
    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
+   motion_blur.beginFrame(time, window_width, window_height);
+
    for(int nn = 0; nn < 2; ++nn)
    {
 //if(drawing_view_for_background) continue; // **********************************************************************************
@@ -670,8 +567,8 @@ void Platonic2Scene::render()
       glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[3]);
       glClear(GL_COLOR_BUFFER_BIT);
 
-      num_subframes = drawing_view_for_background ? 1 : 7;
-      subframe_scale = 1.0/35.0;
+      num_subframes = drawing_view_for_background ? 1 : motion_blur.getSubframeCount();
+      subframe_scale = motion_blur.getShutter();
 
       for(int subframe = 0;subframe<num_subframes;++subframe)
       {
@@ -686,9 +583,7 @@ void Platonic2Scene::render()
 
          glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[3]);
 
-         mb_accum_shader.bind();
-         mb_accum_shader.uniform1f("time", float(subframe) / float(num_subframes));
-         mb_accum_shader.uniform1f("scale", 1.0f / float(num_subframes));
+         motion_blur.bindAccumulation(num_subframes);
 
          glDepthMask(GL_FALSE);
          glDisable(GL_DEPTH_TEST);
@@ -853,7 +748,10 @@ void Platonic2Scene::render()
 
 void Platonic2Scene::free()
 {
+   releaseWindowTargets();
+   prt.free();
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
@@ -5,7 +5,9 @@
 #include "Bezier.hpp"
 #include "Ran.hpp"
 #include "Particles.hpp"
+#include "Voronoi.hpp"
 #include "Tower.hpp"
+#include "MotionBlur.hpp"
 
 static inline Real frand()
 {
@@ -21,11 +23,9 @@ static long int lrand()
 
 class PlatonicScene: public Scene
 {
-   typedef std::pair<Vec2,Vec2> Edge;
-
    struct VoronoiCell
    {
-      std::vector<Edge> edges;
+      int first_edge,num_edges;
       Vec2 center;
       float time0,time1;
    };
@@ -33,8 +33,8 @@ class PlatonicScene: public Scene
    tower::Tower twr0;
 
    Shader forrest_shader, bokeh_shader, bokeh2_shader;
-   Shader gaussbokeh_shader, composite_shader;
-   Shader mb_accum_shader;
+   Shader composite_shader;
+   motionblur::Scheduler motion_blur;
    Shader bgfg_shader;
    Shader text_shader;
    Shader room_logo_shader;
@@ -61,6 +61,7 @@ class PlatonicScene: public Scene
 
    static const int max_voronoi_cells=128;
    VoronoiCell voronoi_cells[max_voronoi_cells];
+   voronoi::Diagram voronoi_diagram;
    int num_voronoi_cells;
 
    model::Mesh text_mesh;
@@ -95,7 +96,6 @@ class PlatonicScene: public Scene
    void drawText(const std::string& str,bool gold=false,bool pink=false,bool bright=false);
    void drawTower(tower::Tower& twr, const Mat4& modelview, Real camheight);
    void drawView(float ltime);
-   void gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0);
 
 
    public:
@@ -139,86 +139,18 @@ void PlatonicScene::initVoronoi()
       nodes.push_back(Vec2(lrnd.doub(),lrnd.doub()));
    }
 
-   for(std::vector<Vec2>::iterator n0=nodes.begin();n0!=nodes.end();++n0)
-   {
-      std::vector<Edge> edges;
-      for(std::vector<Vec2>::iterator n1=nodes.begin();n1!=nodes.end();++n1)
-      {
-         if(n0==n1)
-            continue;
-
-         Vec2 d=(*n1)-(*n0);
-         Vec2 pd=Vec2(-d.y,d.x);
-
-         Edge e;
-
-         e.first = *n0 + (d * 0.5) - (pd * 100.0);
-         e.second = *n0 + (d * 0.5) + (pd * 100.0);
-
-         edges.push_back(e);
-      }
-      edges.push_back(Edge(Vec2(0,0),Vec2(1,0)));
-      edges.push_back(Edge(Vec2(1,0),Vec2(1,1)));
-      edges.push_back(Edge(Vec2(1,1),Vec2(0,1)));
-      edges.push_back(Edge(Vec2(0,1),Vec2(0,0)));
-
-      log("%d edges\n",edges.size());
-
-      std::vector<Edge> clipped_edges;
-      for(std::vector<Edge>::iterator e0=edges.begin();e0!=edges.end();++e0)
-      {
-         Edge e=*e0;
-         bool removed=false;
-         for(std::vector<Edge>::iterator e1=edges.begin();e1!=edges.end();++e1)
-         {
-            if(e0==e1)
-               continue;
-
-            Vec2 p=e1->second-e1->first;
-            p=Vec2(p.y,-p.x);
-            p=p*(Real(1)/std::sqrt(p.lengthSquared()));
+   voronoi::build(voronoi_diagram,&nodes[0],voronoi_num_points);
 
-            Real d0=(e.first-e1->first).dot(p);
-            Real d1=(e.second-e1->first).dot(p);
-
-            if(d0 < 0 && d1 < 0)
-               continue;
-
-            if(d0 > 0 && d1 > 0)
-            {
-               removed=true;
-               break;
-            }
-
-            if(d0 < 0)
-            {
-               Real t=d0/(d0-d1);
-               e.second=mix(e.first,e.second,t);
-            }
-            else
-            {
-               Real t=d1/(d1-d0);
-               e.first=mix(e.second,e.first,t);
-            }
-         }
-         if(!removed && (e.second-e.first).lengthSquared() > 1e-8)
-         {
-            clipped_edges.push_back(e);
-         }
-      }
-      if(!clipped_edges.empty())
-      {
-         log("%d edges\n",clipped_edges.size());
-         log("%f %f\n",n0->x,n0->y);
-         log("%f %f\n",clipped_edges[0].first.x,clipped_edges[0].first.y);
-         assert(num_voronoi_cells<max_voronoi_cells);
-         VoronoiCell& vc=voronoi_cells[num_voronoi_cells];
-         vc.edges=clipped_edges;
-         vc.center=*n0;
-         vc.time0=float(num_voronoi_cells)/float(voronoi_num_points)*3.0f;
-         vc.time1=vc.time0+1.0f;;
-         ++num_voronoi_cells;
-      }
+   for(int i=0;i<voronoi_diagram.getCellCount();++i)
+   {
+      assert(num_voronoi_cells<max_voronoi_cells);
+      VoronoiCell& vc=voronoi_cells[num_voronoi_cells];
+      vc.first_edge=voronoi_diagram.first_edges[i];
+      vc.num_edges=voronoi_diagram.edge_counts[i];
+      vc.center=voronoi_diagram.sites[i];
+      vc.time0=float(num_voronoi_cells)/float(voronoi_num_points)*3.0f;
+      vc.time1=vc.time0+1.0f;
+      ++num_voronoi_cells;
    }
 }
 
@@ -287,14 +219,14 @@ void PlatonicScene::initializeTextures()
 {
    glGenTextures(num_texs, texs);
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
-   createWindowTexture(texs[12], GL_RGBA16F, 2);
-   createWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[12], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[13], GL_RGBA16F, 2);
 
    CHECK_FOR_ERRORS;
 
@@ -333,10 +265,8 @@ void PlatonicScene::initializeBuffers()
 
    bokeh_temp_fbo = fbos[12];
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -397,11 +327,8 @@ void PlatonicScene::initializeShaders()
    bokeh2_shader.uniform1i("tex2", 1);
    bokeh2_shader.uniform1f("aspect_ratio", float(window_height) / float(window_width));
 
-   gaussbokeh_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "gaussblur_f.glsl");
-   gaussbokeh_shader.uniform1i("tex0", 0);
 
-   mb_accum_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_accum_f.glsl");
-   mb_accum_shader.uniform1i("tex0", 0);
+   motion_blur.loadShaders();
 
 
    composite_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "cubes_composite_f.glsl");
@@ -1029,15 +956,17 @@ void PlatonicScene::drawLogo(float ltime)
       voronoi_coords[num_voronoi_vertices*2+1]=vc.center.y;
       ++num_voronoi_vertices;
 
-      for(std::vector<Edge>::const_iterator e=vc.edges.begin();e!=vc.edges.end();++e)
+      for(int e=vc.first_edge;e<vc.first_edge+vc.num_edges;++e)
       {
+         const Vec2 e0=voronoi_diagram.edgeStart(e), e1=voronoi_diagram.edgeEnd(e);
+
          for(int j=0;j<edge_subdivisions;++j)
          {
             const float t0=float(j+0)/float(edge_subdivisions);
             const float t1=float(j+1)/float(edge_subdivisions);
 
-            const Vec2 p0=mix(e->first,e->second,t0);
-            const Vec2 p1=mix(e->first,e->second,t1);
+            const Vec2 p0=mix(e0,e1,t0);
+            const Vec2 p1=mix(e0,e1,t1);
 
             const Vec2 rp0=rotate(rot,p0-vc.center);
             const Vec2 rp1=rotate(rot,p1-vc.center);
@@ -1129,19 +1058,16 @@ void PlatonicScene::drawTower(tower::Tower& twr, const Mat4& modelview, Real cam
    glEnableVertexAttribArray(0);
    glEnableVertexAttribArray(2);
 
-   for(std::vector<tower::PieceInstance>::iterator p=twr.instances.begin();p!=twr.instances.end();++p)
-   {
-      std::map<std::string,Real>& ps=p->parameters;
+   const tower::Pieces pieces(twr);
 
-      if((ps["background"]>0.5)!=drawing_view_for_background)
-         continue;
-
-      if(camheight < (p->section->height1 - camheightrange) || camheight > (p->section->height0 + camheightrange))
+   for(unsigned int i=0;i<twr.getInstanceCount();++i)
+   {
+      if(!pieces.inView(i, drawing_view_for_background, camheight, camheightrange))
          continue;
 
       Mesh* mesh=&icosahedron_mesh;
 
-      switch(int(ps["geom"]+0.5))
+      switch(int(pieces.geom[i]+0.5))
       {
          case 1:
             mesh = &tetrahedron_mesh;
@@ -1152,34 +1078,11 @@ void PlatonicScene::drawTower(tower::Tower& twr, const Mat4& modelview, Real cam
             break;
       }
 
-      mesh->bind();
-
-      forrest_shader.uniform1f("time", lltime*ps["time_scale"]+ps["time_offset"]);
+      forrest_shader.uniform1f("time", lltime*pieces.time_scale[i]+pieces.time_offset[i]);
 
-      forrest_shader.uniform1f("ptn_thickness",ps["ptn_thickness"]);
-      forrest_shader.uniform1f("ptn_brightness",ps["ptn_brightness"]);
-      forrest_shader.uniform1f("ptn_scroll",ps["ptn_scroll"]);
-      forrest_shader.uniform1f("ptn_frequency",ps["ptn_frequency"]);
-      forrest_shader.uniform1f("shimmer",ps["shimmer"]);
-      forrest_shader.uniform1f("l0_scroll",ps["l0_scroll"]);
-      forrest_shader.uniform1f("l0_brightness",ps["l0_brightness"]);
-      forrest_shader.uniform1f("l1_scroll",ps["l1_scroll"]);
-      forrest_shader.uniform1f("l1_brightness",ps["l1_brightness"]);
-      forrest_shader.uniform1f("l2_scroll",ps["l2_scroll"]);
-      forrest_shader.uniform1f("l2_brightness",ps["l2_brightness"]);
-      forrest_shader.uniform1f("ambient",ps["ambient"]);
-
-      Mat4 modelview2 = modelview * Mat4::rotation(lltime * ps["section_rot_spd"], Vec3(0,1,0)) *
-                        Mat4::translation(Vec3(std::cos(ps["angle"])*ps["distance"], ps["height"], std::sin(ps["angle"])*ps["distance"])) *
-                        Mat4::rotation(ps["rot_z"]+lltime*ps["rot_spd_z"],Vec3(0,0,1)) * Mat4::rotation(ps["rot_y"]+lltime*ps["rot_spd_y"],Vec3(0,1,0)) * Mat4::rotation(ps["rot_x"]+lltime*ps["rot_spd_x"],Vec3(1,0,0)) *
-                        Mat4::scale(Vec3(ps["sca_x"],ps["sca_y"],ps["sca_z"]));
-
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
-      glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(mesh->getVertexCount() * sizeof(GLfloat) * 3));
+      pieces.setUniforms(forrest_shader, i);
 
-      forrest_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview2.e);
-
-      glDrawRangeElements(GL_TRIANGLES, 0, mesh->getVertexCount() - 1, mesh->getTriangleCount() * 3, GL_UNSIGNED_INT, 0);
+      tower::Pieces::draw(forrest_shader, *mesh, modelview * pieces.transform(i, lltime));
 
       CHECK_FOR_ERRORS;
    }
@@ -1254,6 +1157,10 @@ void PlatonicScene::drawView(float ltime)
 
    CHECK_FOR_ERRORS;
 
+   // the camera of the view which is displayed, not of the background pass
+   if(!drawing_view_for_background)
+      motion_blur.observe(projection, modelview);
+
    forrest_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
    text_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
 
@@ -1345,78 +1252,6 @@ void PlatonicScene::drawView(float ltime)
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void PlatonicScene::gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0)
-{
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLfloat coords[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glEnableVertexAttribArray(0);
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
-
-   glViewport(0, 0, window_width / 4, window_height / 4);
-
-   // gaussian blur pass 1
-
-   {
-      gaussbokeh_shader.uniform4f("tint", tint_r, tint_g, tint_b, 1.0f);
-   }
-
-   const float gauss_radx = radx;
-   const float gauss_rady = rady;
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo0);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   glDepthMask(GL_FALSE);
-   glDisable(GL_DEPTH_TEST);
-
-   gaussbokeh_shader.bind();
-   gaussbokeh_shader.uniform2f("direction", gauss_radx * float(window_height) / float(window_width), 0.0f);
-
-   glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, src_tex);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-
-
-   // gaussian blur pass 2
-
-   gaussbokeh_shader.uniform4f("tint", 1, 1, 1, 1);
-
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo1);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   gaussbokeh_shader.uniform2f("direction", 0.0f, gauss_rady);
-
-   glBindTexture(GL_TEXTURE_2D, tex0);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-   glDisableVertexAttribArray(0);
-   glDisableVertexAttribArray(1);
-
-   CHECK_FOR_ERRORS;
-}
-
 
 extern unsigned long int makeMS(int minutes,int seconds,int frames);
 
@@ -1446,6 +1281,8 @@ void PlatonicScene::render()
 
    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
+   motion_blur.beginFrame(time, window_width, window_height);
+
    for(int nn = 0; nn < 2; ++nn)
    {
 //if(drawing_view_for_background) continue; // **********************************************************************************
@@ -1458,8 +1295,8 @@ void PlatonicScene::render()
       glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[3]);
       glClear(GL_COLOR_BUFFER_BIT);
 
-      num_subframes = drawing_view_for_background ? 1 : 7;
-      subframe_scale = 1.0/35.0;
+      num_subframes = drawing_view_for_background ? 1 : motion_blur.getSubframeCount();
+      subframe_scale = motion_blur.getShutter();
 
       for(int subframe = 0;subframe<num_subframes;++subframe)
       {
@@ -1474,9 +1311,7 @@ void PlatonicScene::render()
 
          glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[3]);
 
-         mb_accum_shader.bind();
-         mb_accum_shader.uniform1f("time", float(subframe) / float(num_subframes));
-         mb_accum_shader.uniform1f("scale", 1.0f / float(num_subframes));
+         motion_blur.bindAccumulation(num_subframes);
 
          glDepthMask(GL_FALSE);
          glDisable(GL_DEPTH_TEST);
@@ -1638,6 +1473,7 @@ void PlatonicScene::render()
 
 void PlatonicScene::free()
 {
+   releaseWindowTargets();
    glDeleteTextures(1,&logo_tex);
    delete[] text_mesh_vertices;
    text_mesh_vertices=0;
@@ -1645,6 +1481,7 @@ void PlatonicScene::free()
    text_mesh_indices=0;
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
    glDeleteBuffers(1,&text_vbo);
    glDeleteBuffers(1,&text_ebo);
 }
@@ -2,16 +2,24 @@
 #include "Engine.hpp"
 #include "Bezier.hpp"
 #include "Ran.hpp"
+#include "Noise.hpp"
 #include "Particles.hpp"
+#include "MotionBlur.hpp"
 
 #include <list>
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 static inline Real frand()
 {
    static Ran rnd(643);
    return rnd.doub();
 }
 
+struct TetrahedronFrame;
+
 static long int lrand()
 {
    static Ran rnd(112);
@@ -41,33 +49,45 @@ class PreIntroScene: public Scene
       Vec2 size;
    };
 
-   struct Particle
-   {
-      int tet_idx;
-      double px,py,pz;
-      double ppx,ppy,ppz;
-      double vx,vy,vz;
-      double w;
-   };
-
-   struct Chain
+   // The chain points are stored transposed, with point j of chain i at [j*num_chains+i], so
+   // that four neighbouring chains can be relaxed side by side.
+   struct ChainPoints
    {
-      int tet_idx;
-      Real link_length;
-      std::vector<Vec3> points;
+      std::vector<Real> x, y, z;
    };
 
    static const int max_creatures=1024;
    Creature creatures[max_creatures];
    int num_creatures;
 
-   static const int max_particles=4096;
-   Particle particles[max_particles];
+   static const int max_tetrahedra=4;
+
+   // The particles are kept as parallel arrays. The particles released by each tetrahedron are
+   // contiguous, so that the tetrahedron's planes can be applied to the whole run at once.
+   struct ParticleArrays
+   {
+      std::vector<GLfloat> px, py, pz;
+      std::vector<GLfloat> ppx, ppy, ppz;
+      std::vector<GLfloat> vx, vy, vz;
+      std::vector<GLfloat> damp, lift;
+      int tet_first[max_tetrahedra], tet_count[max_tetrahedra];
+   };
+
+   static const int max_particles=4096*16;
+   ParticleArrays particles;
    int num_particles;
 
+   std::vector<GLfloat> particle_vertices;
+   GLuint particles_vbo;
+
+   // num_chains must be a multiple of 4
    static const int num_chains=64;
-   Chain prev_chains[4][num_chains];
-   Chain chains[num_chains];
+   static const int chain_length=64;
+   int chain_iterations;
+   int chain_tet[num_chains];
+   Real chain_link_length[num_chains];
+   ChainPoints prev_chains[4];
+   ChainPoints chains;
 
    static const int max_creature_indices=max_creatures*6;
    static const int max_creature_vertices=max_creatures*4;
@@ -85,13 +105,7 @@ class PreIntroScene: public Scene
    GLuint mountain_vbo;
    GLuint mountain_ebo;
 
-   static const int random_grid_w = 256;
-   static const int random_grid_h = 256;
-
-   float random_grid[random_grid_w*random_grid_h];
-
-   void initRandomGrid();
-   float randomGridLookup(float u, float v) const;
+   noise::RandomGrid random_grid;
 
    GLfloat spiral_vertices[1024 * 4 * 3];
    GLfloat spiral_coords[1024 * 4 * 2];
@@ -99,8 +113,8 @@ class PreIntroScene: public Scene
    GLushort spiral_num_vertices, spiral_num_indices;
 
    Shader glass_shader, bokeh_shader, bokeh2_shader;
-   Shader gaussbokeh_shader, composite_shader;
-   Shader mb_accum_shader;
+   Shader composite_shader;
+   motionblur::Scheduler motion_blur;
    Shader bgfg_shader;
    Shader screendisplay_shader;
    Shader background_shader;
@@ -111,8 +125,6 @@ class PreIntroScene: public Scene
    Mesh cube_mesh;
    Mesh ruin_mesh;
 
-   static const int max_tetrahedra=4;
-
    Vec3 tetofs[max_tetrahedra];
    Mat4 tetrahedra_mats[max_tetrahedra];
    Mat4 tetrahedra_mats_inverse[max_tetrahedra];
@@ -150,19 +162,20 @@ class PreIntroScene: public Scene
    void initMountain();
    void initChains();
    void createSpiral();
+   void updateParticles(int tet);
    void drawParticles();
    void initCreatures();
 
    void updateCreatures(float ltime);
    void renderCreatures(float ltime);
 
-   void moveChains(int tet=-1);
+   void moveChains(unsigned tets=~0u);
+   void relaxChains(int first_chain, int tet, const TetrahedronFrame& frame);
    void drawView(float ltime);
-   void gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0);
    void pushPrevChains();
 
    public:
-      PreIntroScene(): num_particles(0), tetrahedron_mesh(8, 8), cube_mesh(256, 256), ruin_mesh(2048*4, 2048*4)
+      PreIntroScene(): num_particles(0), chain_iterations(1), tetrahedron_mesh(8, 8), cube_mesh(256, 256), ruin_mesh(2048*4, 2048*4)
       {
          mountain_num_vertices=0;
          mountain_num_indices=0;
@@ -170,6 +183,7 @@ class PreIntroScene: public Scene
          mountain_ebo=0;
          tet_tex=0;
          creatures_ebo =0;
+         particles_vbo=0;
       }
 
       ~PreIntroScene()
@@ -182,6 +196,9 @@ class PreIntroScene: public Scene
       void render();
       void update();
       void free();
+
+      // the number of constraint iterations per tick, which can also be given in chain_iterations.txt
+      void setChainIterations(int n);
 };
 
 Scene* preIntroScene = new PreIntroScene();
@@ -194,25 +211,85 @@ static const Real tetrahedronPlanes[16]={0.000000, 0.000000, 0.816496, -0.816496
 
 static const float release_time = 50.0;
 
+// The planes of a tetrahedron brought into world space, so that points can be tested against
+// them without being transformed into the tetrahedron's frame and back. A point is inside
+// plane pl when a*x+b*y+c*z+d is not positive, and (nx,ny,nz) is the plane's normal.
+// The rows ux and uz give the x and z of a point in the tetrahedron's frame, and ax and az
+// are those axes in world space.
+struct TetrahedronFrame
+{
+   float a[4], b[4], c[4], d[4];
+   float nx[4], ny[4], nz[4];
+   float ux[4], uz[4];
+   Vec3 ax, az;
+
+   TetrahedronFrame()
+   {
+   }
+
+   TetrahedronFrame(const Mat4& m, const Mat4& mi)
+   {
+      const Vec3 s=mi*Vec3(0,0,0);
+      const Vec3 lx=mi*Vec3(1,0,0)-s, ly=mi*Vec3(0,1,0)-s, lz=mi*Vec3(0,0,1)-s;
+      const Vec3 o=m*Vec3(0,0,0);
+
+      for(int pl=0;pl<4;++pl)
+      {
+         const Real* pln=tetrahedronPlanes+pl;
+         const Vec3 n(pln[0],pln[4],pln[8]);
+         a[pl]=n.dot(lx);
+         b[pl]=n.dot(ly);
+         c[pl]=n.dot(lz);
+         d[pl]=n.dot(s)+pln[12];
+         const Vec3 wn=m*n-o;
+         nx[pl]=wn.x;
+         ny[pl]=wn.y;
+         nz[pl]=wn.z;
+      }
+
+      ux[0]=lx.x; ux[1]=ly.x; ux[2]=lz.x; ux[3]=s.x;
+      uz[0]=lx.z; uz[1]=ly.z; uz[2]=lz.z; uz[3]=s.z;
+
+      ax=m*Vec3(1,0,0)-o;
+      az=m*Vec3(0,0,1)-o;
+   }
+};
+
 
 void PreIntroScene::slowInitialize()
 {
    tet_tex = loadTexture(IMAGES_PATH "tet.png",true);
    initializeShaders();
+
+   FILE* in=fopen("chain_iterations.txt","r");
+   if(in)
+   {
+      int n=0;
+      if(fscanf(in," %d ",&n)==1 && n>0)
+         setChainIterations(n);
+      fclose(in);
+   }
+}
+
+void PreIntroScene::setChainIterations(int n)
+{
+   assert(n > 0);
+   chain_iterations=n;
 }
 
 void PreIntroScene::initializeTextures()
 {
    glGenTextures(num_texs, texs);
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
-   createWindowTexture(texs[12], GL_RGBA16F, 2);
-   createWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[12], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[8], GL_R32F);
 
    CHECK_FOR_ERRORS;
 
@@ -270,7 +347,6 @@ void PreIntroScene::initializeTextures()
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-   glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, window_width, window_height);
    CHECK_FOR_ERRORS;
    glBindTexture(GL_TEXTURE_2D, 0);
 
@@ -283,10 +359,10 @@ void PreIntroScene::initializeBuffers()
 
    bokeh_temp_fbo = fbos[12];
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   glGenBuffers(1, &particles_vbo);
+
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -346,11 +422,8 @@ void PreIntroScene::initializeShaders()
    bokeh2_shader.uniform1i("tex2", 1);
    bokeh2_shader.uniform1f("aspect_ratio", float(window_height) / float(window_width));
 
-   gaussbokeh_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "gaussblur_f.glsl");
-   gaussbokeh_shader.uniform1i("tex0", 0);
 
-   mb_accum_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_accum_f.glsl");
-   mb_accum_shader.uniform1i("tex0", 0);
+   motion_blur.loadShaders();
 
 
    composite_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "cubes_composite_f.glsl");
@@ -490,31 +563,37 @@ void PreIntroScene::initChains()
       tetrahedra_broken[tet]=false;
    }
 
+   chains.x.resize(num_chains*chain_length);
+   chains.y.resize(num_chains*chain_length);
+   chains.z.resize(num_chains*chain_length);
+
    for(int i=0;i<num_chains;++i)
    {
-      chains[i].tet_idx=std::max(0,std::min(max_tetrahedra-1,(i*max_tetrahedra)/num_chains));
+      chain_tet[i]=std::max(0,std::min(max_tetrahedra-1,(i*max_tetrahedra)/num_chains));
       float a=frand()*M_PI*2;
-      float cx=tetofs[chains[i].tet_idx].x+std::cos(a)*2;
-      float cz=tetofs[chains[i].tet_idx].z+std::sin(a)*2;
-      int num_p=64;
-      chains[i].link_length=3.0/float(num_p);
-      for(int j=0;j<num_p;++j)
-         chains[i].points.push_back(Vec3(cx,mix(-4.0f,6.0f,float(j)/float(num_p)),cz));
+      float cx=tetofs[chain_tet[i]].x+std::cos(a)*2;
+      float cz=tetofs[chain_tet[i]].z+std::sin(a)*2;
+      chain_link_length[i]=3.0/float(chain_length);
+      for(int j=0;j<chain_length;++j)
+      {
+         chains.x[j*num_chains+i]=cx;
+         chains.y[j*num_chains+i]=mix(-4.0f,6.0f,float(j)/float(chain_length));
+         chains.z[j*num_chains+i]=cz;
+      }
    }
 
    for(int n=0;n<600;++n)
       for(int i=0;i<num_chains;++i)
       {
-         Chain& c = chains[i];
-
-         for(int j=0;j<c.points.size();++j)
+         for(int j=0;j<chain_length;++j)
          {
-            Vec3& p=c.points[j];
+            Real& px=chains.x[j*num_chains+i];
+            Real& py=chains.y[j*num_chains+i];
+            Real& pz=chains.z[j*num_chains+i];
 
-            bool outside_all=true;
-            const int t=chains[i].tet_idx;
+            const int t=chain_tet[i];
             {
-               Vec3 p2=tetrahedra_mats_inverse[t]*p;
+               Vec3 p2=tetrahedra_mats_inverse[t]*Vec3(px,py,pz);
                bool outside=false;
                int nearest_plane=-1;
                Real nearest_plane_dist=-1e5;
@@ -539,16 +618,21 @@ void PreIntroScene::initChains()
                      p2.x-=p2.x/zpl*0.005;
                      p2.z-=p2.z/zpl*0.005;
                   }
-                  p=tetrahedra_mats[t]*p2;
+                  p2=tetrahedra_mats[t]*p2;
+                  px=p2.x;
+                  py=p2.y;
+                  pz=p2.z;
                }
                else if(nearest_plane > -1)
                {
-                  outside_all=false;
                   const Real e=nearest_plane_dist*-0.9;
                   p2.x+=tetrahedronPlanes[nearest_plane+0]*e;
                   p2.y+=tetrahedronPlanes[nearest_plane+4]*e;
                   p2.z+=tetrahedronPlanes[nearest_plane+8]*e;
-                  p=tetrahedra_mats[t]*p2;
+                  p2=tetrahedra_mats[t]*p2;
+                  px=p2.x;
+                  py=p2.y;
+                  pz=p2.z;
                }
             }
          }
@@ -558,47 +642,11 @@ void PreIntroScene::initChains()
       moveChains();
 }
 
-void PreIntroScene::initRandomGrid()
-{
-   for(int y=0;y<random_grid_h;++y)
-      for(int x=0;x<random_grid_w;++x)
-      {
-         random_grid[x+y*random_grid_w]=(frand()-0.5)*2.0;
-      }
-}
-
-float PreIntroScene::randomGridLookup(float u, float v) const
-{
-   u=fmodf(u,float(random_grid_w));
-   v=fmodf(v,float(random_grid_h));
-
-   if(u<0)
-      u+=random_grid_w;
-
-   if(v<0)
-      v+=random_grid_h;
-
-   const int iu=int(u);
-   const int iv=int(v);
-
-   const float fu=u-float(iu);
-   const float fv=v-float(iv);
-
-   const float a=random_grid[iu+iv*random_grid_w];
-   const float b=random_grid[((iu+1)%random_grid_w)+iv*random_grid_w];
-   const float c=random_grid[((iu+1)%random_grid_w)+((iv+1)%random_grid_h)*random_grid_w];
-   const float d=random_grid[iu+((iv+1)%random_grid_h)*random_grid_w];
-
-   return (1.0-fv)*((1.0-fu)*a+fu*b) + fv*((1.0-fu)*d+fu*c);
-}
-
 void PreIntroScene::pushPrevChains()
 {
    for(int n=2;n>=0;--n)
-      for(int i=0;i<num_chains;++i)
-         prev_chains[n+1][i]=prev_chains[n][i];
-   for(int i=0;i<num_chains;++i)
-      prev_chains[0][i]=chains[i];
+      prev_chains[n+1]=prev_chains[n];
+   prev_chains[0]=chains;
 }
 
 void PreIntroScene::initialize()
@@ -628,11 +676,10 @@ void PreIntroScene::initialize()
    ruin_mesh.generateNormals();
    //ruin_mesh.transform(Mat4::scale(Vec3(0.01)));
 
-   initRandomGrid();
+   random_grid.fill(frand);
    initChains();
    for(int n=0;n<4;++n)
-      for(int i=0;i<num_chains;++i)
-         prev_chains[n][i]=chains[i];
+      prev_chains[n]=chains;
 
    initMountain();
    initCreatures();
@@ -680,62 +727,241 @@ void PreIntroScene::initMountain()
 
 GLfloat PreIntroScene::evaluateMountainHeight(GLfloat u, GLfloat v)
 {
-   GLfloat n=0.0f;
-   GLfloat scale=16.0f,mag=4.0f;
-
-   for(int i=0;i<10;++i)
-   {
-      n += randomGridLookup(u * scale, v * scale) * mag;
-      mag *= 0.5f;
-      scale *= 2.0f;
-   }
+   GLfloat n=random_grid.fbm(u, v, 10, 16.0f, 4.0f);
 
    return n-5.0;
 }
 
-void PreIntroScene::moveChains(int tet)
+// Moves the chains which hang from the tetrahedra in the mask tets. The groups of four chains
+// of all those tetrahedra are one loop, which is split into a contiguous range of groups per
+// thread. A group is relaxed by one thread for each of its tetrahedra, as the lanes are stored
+// together.
+void PreIntroScene::moveChains(unsigned tets)
 {
+   TetrahedronFrame frames[max_tetrahedra];
+   for(int t=0;t<max_tetrahedra;++t)
+      if(tets&(1u<<t))
+         frames[t]=TetrahedronFrame(tetrahedra_mats[t], tetrahedra_mats_inverse[t]);
 
+   int first=num_chains, last=0;
+   for(int i=0;i<num_chains;++i)
+      if(tets&(1u<<chain_tet[i]))
+      {
+         first=std::min(first,i);
+         last=i+1;
+      }
+
+   if(first>=last)
+      return;
+
+   const int first_group=first/4, last_group=(last+3)/4;
+
+#pragma omp parallel for schedule(static)
+   for(int g=first_group;g<last_group;++g)
+      for(int t=0;t<max_tetrahedra;++t)
+         if(tets&(1u<<t))
+            relaxChains(g*4, t, frames[t]);
+}
+
+// Relaxes the four chains starting at first_chain, leaving alone those which don't hang from
+// the given tetrahedron. Each iteration is a Gauss-Seidel pass over the links followed by a
+// pass which pushes points out of the tetrahedron. The drift is applied once per tick.
+void PreIntroScene::relaxChains(int first_chain, int tet, const TetrahedronFrame& frame)
+{
    const Real damp=0.1;
+   const int stride=num_chains;
 
-   for(int i=0;i<num_chains;++i)
+   Real* const x=&chains.x[first_chain];
+   Real* const y=&chains.y[first_chain];
+   Real* const z=&chains.z[first_chain];
+
+   bool active[4];
+   for(int k=0;k<4;++k)
+      active[k]=(chain_tet[first_chain+k]==tet);
+
+   if(!(active[0] || active[1] || active[2] || active[3]))
+      return;
+
+   float drift_x[4][chain_length], drift_z[4][chain_length], drift_y[4];
    {
-      Chain& c = chains[i];
+      float u0[chain_length], u1[chain_length], v[chain_length];
 
-      if(tet>-1 && tet!=c.tet_idx)
-         continue;
+      for(int j=0;j<chain_length;++j)
+      {
+         u0[j]=g_ltime*0.01;
+         u1[j]=g_ltime*0.02;
+      }
+
+      for(int k=0;k<4;++k)
+      {
+         if(!active[k])
+            continue;
+
+         const int i=first_chain+k;
+
+         for(int j=0;j<chain_length;++j)
+            v[j]=i/2.0+j*0.1;
+
+         random_grid.lookup(u0,v,drift_x[k],chain_length);
+         random_grid.lookup(u1,v,drift_z[k],chain_length);
+         drift_y[k]=0.002*(2.0+random_grid.lookup(0,i));
+      }
+   }
+
+#ifdef __SSE__
+   const __m128 zero=_mm_setzero_ps();
+   const __m128 sign=_mm_set1_ps(-0.0f);
+   const __m128 epsilon=_mm_set1_ps(1e-3f);
+   const __m128 lane_active=_mm_cmpneq_ps(_mm_setr_ps(active[0],active[1],active[2],active[3]),zero);
+   const __m128 link_length=_mm_loadu_ps(chain_link_length+first_chain);
+#endif
+
+   for(int it=0;it<chain_iterations;++it)
+   {
+#ifdef __SSE__
+      {
+         const __m128 half_damp=_mm_set1_ps(0.5f*damp);
+
+         __m128 x0=_mm_loadu_ps(x), y0=_mm_loadu_ps(y), z0=_mm_loadu_ps(z);
+
+         for(int j=1;j<chain_length;++j)
+         {
+            __m128 x1=_mm_loadu_ps(x+j*stride), y1=_mm_loadu_ps(y+j*stride), z1=_mm_loadu_ps(z+j*stride);
+
+            const __m128 dx=_mm_sub_ps(x1,x0), dy=_mm_sub_ps(y1,y0), dz=_mm_sub_ps(z1,z0);
+            const __m128 dl=_mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx,dx),_mm_mul_ps(dy,dy)),_mm_mul_ps(dz,dz)));
+            const __m128 diff=_mm_sub_ps(link_length,dl);
 
-      for(int j=1;j<c.points.size();++j)
+            const __m128 mask=_mm_and_ps(lane_active,_mm_and_ps(_mm_cmpgt_ps(_mm_andnot_ps(sign,dl),epsilon),
+                                                                _mm_cmpgt_ps(_mm_andnot_ps(sign,diff),epsilon)));
+            const __m128 f=_mm_and_ps(mask,_mm_mul_ps(_mm_div_ps(diff,dl),half_damp));
+
+            x0=_mm_sub_ps(x0,_mm_mul_ps(dx,f));
+            y0=_mm_sub_ps(y0,_mm_mul_ps(dy,f));
+            z0=_mm_sub_ps(z0,_mm_mul_ps(dz,f));
+
+            _mm_storeu_ps(x+(j-1)*stride,x0);
+            _mm_storeu_ps(y+(j-1)*stride,y0);
+            _mm_storeu_ps(z+(j-1)*stride,z0);
+
+            x0=_mm_add_ps(x1,_mm_mul_ps(dx,f));
+            y0=_mm_add_ps(y1,_mm_mul_ps(dy,f));
+            z0=_mm_add_ps(z1,_mm_mul_ps(dz,f));
+         }
+
+         _mm_storeu_ps(x+(chain_length-1)*stride,x0);
+         _mm_storeu_ps(y+(chain_length-1)*stride,y0);
+         _mm_storeu_ps(z+(chain_length-1)*stride,z0);
+      }
+#else
+      for(int k=0;k<4;++k)
       {
-         Vec3 d=c.points[j] - c.points[j-1];
-         Real dl=std::sqrt(d.lengthSquared());
-         Real diff=c.link_length-dl;
-         if(std::abs(dl) > 1e-3 && std::abs(diff) > 1e-3)
+         if(!active[k])
+            continue;
+
+         const Real link_length=chain_link_length[first_chain+k];
+
+         for(int j=1;j<chain_length;++j)
          {
-            c.points[j-1]-=d*diff/dl*0.5*damp;
-            c.points[j]+=d*diff/dl*0.5*damp;
+            const int i0=(j-1)*stride+k, i1=j*stride+k;
+            Vec3 d(x[i1]-x[i0],y[i1]-y[i0],z[i1]-z[i0]);
+            Real dl=std::sqrt(d.lengthSquared());
+            Real diff=link_length-dl;
+            if(std::abs(dl) > 1e-3 && std::abs(diff) > 1e-3)
+            {
+               d=d*(diff/dl*0.5*damp);
+               x[i0]-=d.x;
+               y[i0]-=d.y;
+               z[i0]-=d.z;
+               x[i1]+=d.x;
+               y[i1]+=d.y;
+               z[i1]+=d.z;
+            }
          }
       }
+#endif
 
-      for(int j=0;j<c.points.size();++j)
+      if(it==0)
       {
-         Vec3& p=c.points[j];
+         for(int k=0;k<4;++k)
+         {
+            if(!active[k])
+               continue;
 
-         p.x-=0.001*randomGridLookup(g_ltime*0.01,i/2.0+j*0.1);
-         p.z-=0.001*randomGridLookup(g_ltime*0.02,i/2.0+j*0.1);
-         p.y-=0.002*(2.0+randomGridLookup(0,i));
+            for(int j=0;j<chain_length;++j)
+            {
+               x[j*stride+k]-=0.001*drift_x[k][j];
+               z[j*stride+k]-=0.001*drift_z[k][j];
+               y[j*stride+k]-=drift_y[k];
+            }
+         }
+      }
 
-         bool outside_all=true;
-         const int t=chains[i].tet_idx;
+#ifdef __SSE__
+      {
+         const __m128 nearest_init=_mm_set1_ps(-1e4f);
+         const __m128 push=_mm_set1_ps(0.005f);
+         const __m128 scale=_mm_set1_ps(-0.9f);
+
+         for(int j=0;j<chain_length;++j)
          {
-            Vec3 p2=tetrahedra_mats_inverse[t]*p;
+            const __m128 px=_mm_loadu_ps(x+j*stride), py=_mm_loadu_ps(y+j*stride), pz=_mm_loadu_ps(z+j*stride);
+
+            __m128 outside=zero, nearest=nearest_init;
+            __m128 nx=zero, ny=zero, nz=zero;
+
+            for(int pl=0;pl<4;++pl)
+            {
+               const __m128 dist=_mm_add_ps(_mm_add_ps(_mm_mul_ps(px,_mm_set1_ps(frame.a[pl])),_mm_mul_ps(py,_mm_set1_ps(frame.b[pl]))),
+                                            _mm_add_ps(_mm_mul_ps(pz,_mm_set1_ps(frame.c[pl])),_mm_set1_ps(frame.d[pl])));
+               outside=_mm_or_ps(outside,_mm_cmpgt_ps(dist,zero));
+               const __m128 closer=_mm_cmpgt_ps(dist,nearest);
+               nearest=_mm_or_ps(_mm_and_ps(closer,dist),_mm_andnot_ps(closer,nearest));
+               nx=_mm_or_ps(_mm_and_ps(closer,_mm_set1_ps(frame.nx[pl])),_mm_andnot_ps(closer,nx));
+               ny=_mm_or_ps(_mm_and_ps(closer,_mm_set1_ps(frame.ny[pl])),_mm_andnot_ps(closer,ny));
+               nz=_mm_or_ps(_mm_and_ps(closer,_mm_set1_ps(frame.nz[pl])),_mm_andnot_ps(closer,nz));
+            }
+
+            const __m128 inside=_mm_and_ps(_mm_andnot_ps(outside,lane_active),_mm_cmpgt_ps(nearest,nearest_init));
+
+            if(_mm_movemask_ps(inside)==0)
+               continue;
+
+            const __m128 lx=_mm_add_ps(_mm_add_ps(_mm_mul_ps(px,_mm_set1_ps(frame.ux[0])),_mm_mul_ps(py,_mm_set1_ps(frame.ux[1]))),
+                                       _mm_add_ps(_mm_mul_ps(pz,_mm_set1_ps(frame.ux[2])),_mm_set1_ps(frame.ux[3])));
+            const __m128 lz=_mm_add_ps(_mm_add_ps(_mm_mul_ps(px,_mm_set1_ps(frame.uz[0])),_mm_mul_ps(py,_mm_set1_ps(frame.uz[1]))),
+                                       _mm_add_ps(_mm_mul_ps(pz,_mm_set1_ps(frame.uz[2])),_mm_set1_ps(frame.uz[3])));
+            const __m128 r=_mm_div_ps(push,_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(lx,lx),_mm_mul_ps(lz,lz))));
+            const __m128 sx=_mm_mul_ps(lx,r), sz=_mm_mul_ps(lz,r);
+            const __m128 e=_mm_mul_ps(nearest,scale);
+
+            const __m128 dx=_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx,_mm_set1_ps(frame.ax.x)),_mm_mul_ps(sz,_mm_set1_ps(frame.az.x))),_mm_mul_ps(nx,e));
+            const __m128 dy=_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx,_mm_set1_ps(frame.ax.y)),_mm_mul_ps(sz,_mm_set1_ps(frame.az.y))),_mm_mul_ps(ny,e));
+            const __m128 dz=_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx,_mm_set1_ps(frame.ax.z)),_mm_mul_ps(sz,_mm_set1_ps(frame.az.z))),_mm_mul_ps(nz,e));
+
+            _mm_storeu_ps(x+j*stride,_mm_add_ps(px,_mm_and_ps(inside,dx)));
+            _mm_storeu_ps(y+j*stride,_mm_add_ps(py,_mm_and_ps(inside,dy)));
+            _mm_storeu_ps(z+j*stride,_mm_add_ps(pz,_mm_and_ps(inside,dz)));
+         }
+      }
+#else
+      for(int k=0;k<4;++k)
+      {
+         if(!active[k])
+            continue;
+
+         for(int j=0;j<chain_length;++j)
+         {
+            Real& px=x[j*stride+k];
+            Real& py=y[j*stride+k];
+            Real& pz=z[j*stride+k];
+
             bool outside=false;
             int nearest_plane=-1;
             Real nearest_plane_dist=-1e4;
             for(int pl=0;pl<4;++pl)
             {
-               const Real* pln=tetrahedronPlanes+pl;
-               const Real dist=pln[0]*p2.x+pln[4]*p2.y+pln[8]*p2.z+pln[12];
+               const Real dist=frame.a[pl]*px+frame.b[pl]*py+frame.c[pl]*pz+frame.d[pl];
                if(dist > 0)
                   outside=true;
                else if(dist>nearest_plane_dist)
@@ -744,32 +970,27 @@ void PreIntroScene::moveChains(int tet)
                   nearest_plane=pl;
                }
             }
-            Real zpl=std::sqrt(p2.x*p2.x+p2.z*p2.z);
-
-            if(zpl>-1e3)
-            {
-               p2.x+=p2.x/zpl*0.005;
-               p2.z+=p2.z/zpl*0.005;
-            }
             if(!outside && (nearest_plane > -1))
             {
-               outside_all=false;
-
+               const Real lx=frame.ux[0]*px+frame.ux[1]*py+frame.ux[2]*pz+frame.ux[3];
+               const Real lz=frame.uz[0]*px+frame.uz[1]*py+frame.uz[2]*pz+frame.uz[3];
+               const Real zpl=std::sqrt(lx*lx+lz*lz);
+               const Vec3 d=frame.ax*(lx/zpl*0.005)+frame.az*(lz/zpl*0.005);
                const Real e=nearest_plane_dist*-0.9;
-               p2.x+=tetrahedronPlanes[nearest_plane+0]*e;
-               p2.y+=tetrahedronPlanes[nearest_plane+4]*e;
-               p2.z+=tetrahedronPlanes[nearest_plane+8]*e;
-               p=tetrahedra_mats[t]*p2;
+               px+=d.x+frame.nx[nearest_plane]*e;
+               py+=d.y+frame.ny[nearest_plane]*e;
+               pz+=d.z+frame.nz[nearest_plane]*e;
             }
          }
-
       }
-
+#endif
    }
 }
 
 void PreIntroScene::update()
 {
+   unsigned moving=0;
+
    for(int tet=0;tet<max_tetrahedra;++tet)
    {
       const float rt=release_time+5*tet;
@@ -783,124 +1004,184 @@ void PreIntroScene::update()
          if(!tetrahedra_broken[tet])
          {
             tetrahedra_broken[tet]=true;
+            particles.tet_first[tet]=num_particles;
+            particles.tet_count[tet]=0;
             for(int i=0;i<num_chains;++i)
             {
-               Chain& c = chains[i];
-
-               if(tet==c.tet_idx)
+               if(tet==chain_tet[i])
                {
                   for(int j=0;j<16;++j)
                   {
                      assert(num_particles < max_particles);
-                     Particle& p=particles[num_particles++];
-                     p.tet_idx = tet;
-                     p.px=tetofs[tet].x;
-                     p.py=(pow(frand(),0.3)-0.5)*8.0;
-                     p.pz=tetofs[tet].z;
-                     p.ppx=p.px;
-                     p.ppy=p.py;
-                     p.ppz=p.pz;
+                     ParticleArrays& p=particles;
+                     p.px.push_back(tetofs[tet].x);
+                     p.py.push_back((pow(frand(),0.3)-0.5)*8.0);
+                     p.pz.push_back(tetofs[tet].z);
+                     p.ppx.push_back(p.px.back());
+                     p.ppy.push_back(p.py.back());
+                     p.ppz.push_back(p.pz.back());
                      const float ang=frand()*M_PI*2;
-                     p.vx=std::cos(ang)*0.001;
-                     p.vy=0;
-                     p.vz=std::sin(ang)*0.001;
-                     p.w=mix(0.4,1.0,frand());
+                     p.vx.push_back(std::cos(ang)*0.001);
+                     p.vy.push_back(0);
+                     p.vz.push_back(std::sin(ang)*0.001);
+                     const double w=mix(0.4,1.0,frand());
+                     p.damp.push_back(0.999*mix(0.8,1.0,w));
+                     p.lift.push_back(0.00001*w);
+                     ++p.tet_count[tet];
+                     ++num_particles;
                   }
                }
             }
          }
 
-         moveChains(tet);
+         moving|=1u<<tet;
       }
    }
 
-   for(int i=0;i<num_particles;++i)
-   {
-      Particle& p=particles[i];
-      p.px+=p.vx;
-      p.py+=p.vy;
-      p.pz+=p.vz;
-      p.vx*=0.999*mix(0.8,1.0,p.w);
-      p.vy+=0.00001*p.w;
-      p.vz*=0.999*mix(0.8,1.0,p.w);
-
-      const int t=p.tet_idx;
-      {
-         Vec3 p2=tetrahedra_mats_inverse[t]*Vec3(p.px,p.py,p.pz);
-         bool outside=false;
-         int nearest_plane=-1;
-         Real nearest_plane_dist=-1e4;
-         for(int pl=0;pl<4;++pl)
-         {
-            const Real* pln=tetrahedronPlanes+pl;
-            const Real dist=pln[0]*p2.x+pln[4]*p2.y+pln[8]*p2.z+pln[12];
-            if(dist > 0)
-               outside=true;
-            else if(dist>nearest_plane_dist)
-            {
-               nearest_plane_dist=dist;
-               nearest_plane=pl;
-            }
-         }
-         if(!outside)
-         {
-            p2.x-=tetrahedronPlanes[0+nearest_plane]*nearest_plane_dist;
-            p2.y-=tetrahedronPlanes[4+nearest_plane]*nearest_plane_dist;
-            p2.z-=tetrahedronPlanes[8+nearest_plane]*nearest_plane_dist;
-            p2=tetrahedra_mats[t]*p2;
-            p.px=p2.x;
-            p.py=p2.y;
-            p.pz=p2.z;
-         }
-      }
-   }
+   moveChains(moving);
+
+   for(int tet=0;tet<max_tetrahedra;++tet)
+      if(tetrahedra_broken[tet])
+         updateParticles(tet);
 
    ++g_ltime;
 }
 
-void PreIntroScene::drawParticles()
+void PreIntroScene::updateParticles(int tet)
 {
-   screendisplay_shader.uniform4f("colour", 0.1, 0.5, 0.5, 1);
+   const TetrahedronFrame frame(tetrahedra_mats[tet], tetrahedra_mats_inverse[tet]);
+   const float *pa=frame.a, *pb=frame.b, *pc=frame.c, *pd=frame.d;
+   const float *mx=frame.nx, *my=frame.ny, *mz=frame.nz;
 
-   for(int i=0;i<num_particles;++i)
+   ParticleArrays& p=particles;
+   const int first=p.tet_first[tet], last=first+p.tet_count[tet];
+
+   GLfloat *px=&p.px[0], *py=&p.py[0], *pz=&p.pz[0];
+   GLfloat *vx=&p.vx[0], *vy=&p.vy[0], *vz=&p.vz[0];
+   const GLfloat *damp=&p.damp[0], *lift=&p.lift[0];
+
+   int i=first;
+
+#ifdef __SSE__
+   for(;i+4<=last;i+=4)
    {
-      const Particle& p=particles[i];
+      __m128 x=_mm_loadu_ps(px+i), y=_mm_loadu_ps(py+i), z=_mm_loadu_ps(pz+i);
+      __m128 ux=_mm_loadu_ps(vx+i), uy=_mm_loadu_ps(vy+i), uz=_mm_loadu_ps(vz+i);
+      const __m128 dm=_mm_loadu_ps(damp+i);
+
+      x=_mm_add_ps(x,ux);
+      y=_mm_add_ps(y,uy);
+      z=_mm_add_ps(z,uz);
+      _mm_storeu_ps(vx+i,_mm_mul_ps(ux,dm));
+      _mm_storeu_ps(vy+i,_mm_add_ps(uy,_mm_loadu_ps(lift+i)));
+      _mm_storeu_ps(vz+i,_mm_mul_ps(uz,dm));
+
+      __m128 outside=_mm_setzero_ps();
+      __m128 nearest=_mm_set1_ps(-1e4f);
+      __m128 nx=_mm_setzero_ps(), ny=_mm_setzero_ps(), nz=_mm_setzero_ps();
+
+      for(int pl=0;pl<4;++pl)
+      {
+         const __m128 dist=_mm_add_ps(_mm_add_ps(_mm_mul_ps(x,_mm_set1_ps(pa[pl])),_mm_mul_ps(y,_mm_set1_ps(pb[pl]))),
+                                      _mm_add_ps(_mm_mul_ps(z,_mm_set1_ps(pc[pl])),_mm_set1_ps(pd[pl])));
+         outside=_mm_or_ps(outside,_mm_cmpgt_ps(dist,_mm_setzero_ps()));
+         const __m128 closer=_mm_cmpgt_ps(dist,nearest);
+         nearest=_mm_or_ps(_mm_and_ps(closer,dist),_mm_andnot_ps(closer,nearest));
+         nx=_mm_or_ps(_mm_and_ps(closer,_mm_set1_ps(mx[pl])),_mm_andnot_ps(closer,nx));
+         ny=_mm_or_ps(_mm_and_ps(closer,_mm_set1_ps(my[pl])),_mm_andnot_ps(closer,ny));
+         nz=_mm_or_ps(_mm_and_ps(closer,_mm_set1_ps(mz[pl])),_mm_andnot_ps(closer,nz));
+      }
 
-      if(p.py>8.0)
-         continue;
+      // the nearest distance is only used when all four are not positive, so mask it otherwise
+      nearest=_mm_andnot_ps(outside,nearest);
 
-      spiral_num_vertices = 0;
-      spiral_num_indices = 0;
+      _mm_storeu_ps(px+i,_mm_sub_ps(x,_mm_mul_ps(nx,nearest)));
+      _mm_storeu_ps(py+i,_mm_sub_ps(y,_mm_mul_ps(ny,nearest)));
+      _mm_storeu_ps(pz+i,_mm_sub_ps(z,_mm_mul_ps(nz,nearest)));
+   }
+#endif
 
-      screendisplay_shader.uniform2f("radii", 0.001, 0.001);
+   for(;i<last;++i)
+   {
+      px[i]+=vx[i];
+      py[i]+=vy[i];
+      pz[i]+=vz[i];
+      vx[i]*=damp[i];
+      vy[i]+=lift[i];
+      vz[i]*=damp[i];
+
+      bool outside=false;
+      int nearest_plane=-1;
+      float nearest_plane_dist=-1e4f;
+      for(int pl=0;pl<4;++pl)
+      {
+         const float dist=pa[pl]*px[i]+pb[pl]*py[i]+pc[pl]*pz[i]+pd[pl];
+         if(dist > 0)
+            outside=true;
+         else if(dist>nearest_plane_dist)
+         {
+            nearest_plane_dist=dist;
+            nearest_plane=pl;
+         }
+      }
+      if(!outside)
+      {
+         px[i]-=mx[nearest_plane]*nearest_plane_dist;
+         py[i]-=my[nearest_plane]*nearest_plane_dist;
+         pz[i]-=mz[nearest_plane]*nearest_plane_dist;
+      }
+   }
+}
 
+void PreIntroScene::drawParticles()
+{
+   const ParticleArrays& p=particles;
 
-      spiral_indices[spiral_num_indices++] = spiral_num_vertices;
+   particle_vertices.resize(num_particles * 2 * 3);
 
-      spiral_vertices[spiral_num_vertices * 3 + 0] = mix(p.ppx, p.px, sub_frame_time);
-      spiral_vertices[spiral_num_vertices * 3 + 1] = mix(p.ppy, p.py, sub_frame_time);
-      spiral_vertices[spiral_num_vertices * 3 + 2] = mix(p.ppz, p.pz, sub_frame_time);
+   int num_vertices=0;
+   GLfloat* v=particle_vertices.empty() ? 0 : &particle_vertices[0];
 
-      spiral_coords[spiral_num_vertices * 2 + 0] = 1.0;
-      spiral_coords[spiral_num_vertices * 2 + 1] = 1.0;
+   for(int i=0;i<num_particles;++i)
+   {
+      if(p.py[i]>8.0)
+         continue;
 
-      ++spiral_num_vertices;
+      const GLfloat x=mix(p.ppx[i], p.px[i], sub_frame_time);
+      const GLfloat y=mix(p.ppy[i], p.py[i], sub_frame_time);
+      const GLfloat z=mix(p.ppz[i], p.pz[i], sub_frame_time);
 
+      v[num_vertices * 3 + 0] = x;
+      v[num_vertices * 3 + 1] = y;
+      v[num_vertices * 3 + 2] = z;
+      ++num_vertices;
 
-      spiral_indices[spiral_num_indices++] = spiral_num_vertices;
+      v[num_vertices * 3 + 0] = x-p.vx[i]*2;
+      v[num_vertices * 3 + 1] = y-p.vy[i]*2;
+      v[num_vertices * 3 + 2] = z-p.vz[i]*2;
+      ++num_vertices;
+   }
 
-      spiral_vertices[spiral_num_vertices * 3 + 0] = mix(p.ppx, p.px, sub_frame_time)-p.vx*2;
-      spiral_vertices[spiral_num_vertices * 3 + 1] = mix(p.ppy, p.py, sub_frame_time)-p.vy*2;
-      spiral_vertices[spiral_num_vertices * 3 + 2] = mix(p.ppz, p.pz, sub_frame_time)-p.vz*2;
+   if(num_vertices == 0)
+      return;
 
-      spiral_coords[spiral_num_vertices * 2 + 0] = 1.0;
-      spiral_coords[spiral_num_vertices * 2 + 1] = 1.0;
+   screendisplay_shader.uniform4f("colour", 0.1, 0.5, 0.5, 1);
+   screendisplay_shader.uniform2f("radii", 0.001, 0.001);
 
-      ++spiral_num_vertices;
+   // all of the streaks go in one draw, as separate line segments
+   glBindBuffer(GL_ARRAY_BUFFER, particles_vbo);
+   glBufferData(GL_ARRAY_BUFFER, num_vertices * 3 * sizeof(GLfloat), 0, GL_STREAM_DRAW);
+   glBufferSubData(GL_ARRAY_BUFFER, 0, num_vertices * 3 * sizeof(GLfloat), v);
+   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+   glDisableVertexAttribArray(1);
+   glVertexAttrib2f(1, 1.0, 1.0);
 
-      glDrawRangeElements(GL_LINE_STRIP, 0, spiral_num_vertices - 1, spiral_num_indices, GL_UNSIGNED_SHORT, spiral_indices);
-   }
+   glDrawArrays(GL_LINES, 0, num_vertices);
 
+   // the spiral is drawn next from client memory
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, spiral_vertices);
+   glEnableVertexAttribArray(1);
 }
 
 void PreIntroScene::createSpiral()
@@ -914,16 +1195,17 @@ void PreIntroScene::createSpiral()
 
       screendisplay_shader.uniform2f("radii", 0.0025, 0.0025);
 
-      int j=0;
-      for(std::vector<Vec3>::const_iterator it = chains[i].points.begin(); it != chains[i].points.end(); ++it,++j)
+      for(int j=0;j<chain_length;++j)
       {
-         if(it->y > -6)
+         const int idx=j*num_chains+i;
+
+         if(chains.y[idx] > -6)
          {
             spiral_indices[spiral_num_indices++] = spiral_num_vertices;
 
-            spiral_vertices[spiral_num_vertices * 3 + 0] = mix(it->x, prev_chains[3][i].points[j].x, sub_frame_time);
-            spiral_vertices[spiral_num_vertices * 3 + 1] = mix(it->y, prev_chains[3][i].points[j].y, sub_frame_time);
-            spiral_vertices[spiral_num_vertices * 3 + 2] = mix(it->z, prev_chains[3][i].points[j].z, sub_frame_time);
+            spiral_vertices[spiral_num_vertices * 3 + 0] = mix(chains.x[idx], prev_chains[3].x[idx], sub_frame_time);
+            spiral_vertices[spiral_num_vertices * 3 + 1] = mix(chains.y[idx], prev_chains[3].y[idx], sub_frame_time);
+            spiral_vertices[spiral_num_vertices * 3 + 2] = mix(chains.z[idx], prev_chains[3].z[idx], sub_frame_time);
 
             spiral_coords[spiral_num_vertices * 2 + 0] = 1.0;
             spiral_coords[spiral_num_vertices * 2 + 1] = 1.0;
@@ -989,6 +1271,19 @@ void PreIntroScene::drawView(float ltime)
 
    CHECK_FOR_ERRORS;
 
+   motion_blur.observe(projection, modelview);
+
+   {
+      // the middle of each chain stands for its motion
+      Vec3 chain_points[num_chains];
+      for(int i = 0; i < num_chains; ++i)
+      {
+         const int idx = (chain_length / 2) * num_chains + i;
+         chain_points[i] = Vec3(chains.x[idx], chains.y[idx], chains.z[idx]);
+      }
+      motion_blur.observePoints(chain_points, num_chains);
+   }
+
    glass_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
    screendisplay_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
    mountain_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
@@ -1163,78 +1458,6 @@ void PreIntroScene::drawView(float ltime)
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void PreIntroScene::gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0)
-{
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLfloat coords[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glEnableVertexAttribArray(0);
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
-
-   glViewport(0, 0, window_width / 4, window_height / 4);
-
-   // gaussian blur pass 1
-
-   {
-      gaussbokeh_shader.uniform4f("tint", tint_r, tint_g, tint_b, 1.0f);
-   }
-
-   const float gauss_radx = radx;
-   const float gauss_rady = rady;
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo0);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   glDepthMask(GL_FALSE);
-   glDisable(GL_DEPTH_TEST);
-
-   gaussbokeh_shader.bind();
-   gaussbokeh_shader.uniform2f("direction", gauss_radx * float(window_height) / float(window_width), 0.0f);
-
-   glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, src_tex);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-
-
-   // gaussian blur pass 2
-
-   gaussbokeh_shader.uniform4f("tint", 1, 1, 1, 1);
-
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo1);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   gaussbokeh_shader.uniform2f("direction", 0.0f, gauss_rady);
-
-   glBindTexture(GL_TEXTURE_2D, tex0);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-   glDisableVertexAttribArray(0);
-   glDisableVertexAttribArray(1);
-
-   CHECK_FOR_ERRORS;
-}
-
 
 void PreIntroScene::render()
 {
@@ -1246,6 +1469,8 @@ void PreIntroScene::render()
 
    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
+   motion_blur.beginFrame(time, window_width, window_height);
+
    for(int nn = 0; nn < 2; ++nn)
    {
 //if(drawing_view_for_background) continue; // **********************************************************************************
@@ -1258,8 +1483,8 @@ void PreIntroScene::render()
       glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[3]);
       glClear(GL_COLOR_BUFFER_BIT);
 
-      num_subframes = drawing_view_for_background ? 1 : 7;
-      subframe_scale = 1.0/35.0;
+      num_subframes = drawing_view_for_background ? 1 : motion_blur.getSubframeCount();
+      subframe_scale = motion_blur.getShutter();
 
       for(int subframe = 0;subframe<num_subframes;++subframe)
       {
@@ -1276,9 +1501,7 @@ void PreIntroScene::render()
 
          sub_frame_time=float(subframe) / float(num_subframes);
 
-         mb_accum_shader.bind();
-         mb_accum_shader.uniform1f("time", sub_frame_time);
-         mb_accum_shader.uniform1f("scale", 1.0f / float(num_subframes));
+         motion_blur.bindAccumulation(num_subframes);
 
          glDepthMask(GL_FALSE);
          glDisable(GL_DEPTH_TEST);
@@ -1430,24 +1653,22 @@ void PreIntroScene::render()
 
    pushPrevChains();
 
-   for(int i=0;i<num_particles;++i)
-   {
-      Particle& p=particles[i];
-
-      p.ppx=p.px;
-      p.ppy=p.py;
-      p.ppz=p.pz;
-   }
+   particles.ppx=particles.px;
+   particles.ppy=particles.py;
+   particles.ppz=particles.pz;
 }
 
 
 void PreIntroScene::free()
 {
+   releaseWindowTargets();
    glDeleteBuffers(1,&mountain_ebo);
    glDeleteBuffers(1,&mountain_vbo);
    glDeleteBuffers(1,&creatures_ebo);
+   glDeleteBuffers(1,&particles_vbo);
    glDeleteTextures(1,&tet_tex);
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
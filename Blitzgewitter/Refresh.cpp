@@ -0,0 +1,166 @@
+#include "Engine.hpp"
+
+namespace
+{
+
+// how much of each new measurement goes into the part cost
+const float cost_smoothing = 0.25f;
+
+}
+
+int RefreshScheduler::add(int num_parts, float part_cost_ms, float max_staleness)
+{
+   assert(num_parts > 0);
+
+   Refresh r;
+   r.num_parts = num_parts;
+   r.next_part = 0;
+   r.count = 0;
+   r.credit = 0;
+   r.part_cost_ms = part_cost_ms;
+   r.max_staleness = max_staleness;
+   r.query = 0;
+   r.query_pending = false;
+   r.timed_parts = 0;
+
+   refreshes.push_back(r);
+   invalidate(refreshes.size() - 1);
+
+   return refreshes.size() - 1;
+}
+
+void RefreshScheduler::invalidate(int id)
+{
+   Refresh& r = refreshes[id];
+   r.part_times.assign(r.num_parts, -1e9f);
+   r.next_part = 0;
+}
+
+void RefreshScheduler::schedule(float time)
+{
+   // time also goes backwards when the scene is seeked
+   const float dt = (time > prev_time) ? time - prev_time : 0.0f;
+   prev_time = time;
+
+   float spent_ms = 0;
+
+   // costs from timings which have come back, then the parts which are past their tolerance or
+   // due at the steady rate
+
+   for(size_t i = 0; i < refreshes.size(); ++i)
+   {
+      Refresh& r = refreshes[i];
+
+      if(r.query_pending)
+      {
+         GLint available = 0;
+         glGetQueryObjectiv(r.query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+         if(available)
+         {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(r.query, GL_QUERY_RESULT, &ns);
+            r.part_cost_ms = mix(r.part_cost_ms, float(ns) * 1e-6f / float(r.timed_parts), cost_smoothing);
+            r.query_pending = false;
+         }
+      }
+
+      r.count = 0;
+
+      while(r.count < r.num_parts)
+      {
+         const float t = r.part_times[(r.next_part + r.count) % r.num_parts];
+
+         if(t <= time && time - t <= r.max_staleness)
+            break;
+
+         ++r.count;
+      }
+
+      // parts which are all drawn together would otherwise all go stale together
+      r.credit += (r.max_staleness > 0) ? float(r.num_parts) * dt / r.max_staleness : float(r.num_parts);
+      r.credit = std::min(r.credit, float(r.num_parts));
+
+      while(r.count < r.num_parts && r.credit >= 1.0f)
+      {
+         ++r.count;
+         r.credit -= 1.0f;
+      }
+
+      spent_ms += r.part_cost_ms * r.count;
+   }
+
+   // then the stalest of the rest, relative to their tolerance, while they fit
+
+   for(;;)
+   {
+      Refresh* best = 0;
+      float best_urgency = 0;
+
+      for(size_t i = 0; i < refreshes.size(); ++i)
+      {
+         Refresh& r = refreshes[i];
+
+         if(r.count == r.num_parts)
+            continue;
+
+         const float urgency = (time - r.part_times[(r.next_part + r.count) % r.num_parts]) / r.max_staleness;
+
+         if(urgency > best_urgency)
+         {
+            best = &r;
+            best_urgency = urgency;
+         }
+      }
+
+      if(!best || spent_ms + best->part_cost_ms > budget_ms)
+         break;
+
+      ++best->count;
+      spent_ms += best->part_cost_ms;
+   }
+
+   for(size_t i = 0; i < refreshes.size(); ++i)
+   {
+      Refresh& r = refreshes[i];
+
+      for(int j = 0; j < r.count; ++j)
+         r.part_times[(r.next_part + j) % r.num_parts] = time;
+
+      r.next_part = (r.next_part + r.count) % r.num_parts;
+   }
+}
+
+void RefreshScheduler::beginTiming(int id)
+{
+   Refresh& r = refreshes[id];
+
+   if(r.query_pending || r.count == 0)
+      return;
+
+   if(!r.query)
+      glGenQueries(1, &r.query);
+
+   glBeginQuery(GL_TIME_ELAPSED, r.query);
+   r.timed_parts = r.count;
+}
+
+void RefreshScheduler::endTiming(int id)
+{
+   Refresh& r = refreshes[id];
+
+   if(r.query_pending || r.count == 0)
+      return;
+
+   glEndQuery(GL_TIME_ELAPSED);
+   r.query_pending = true;
+}
+
+void RefreshScheduler::clear()
+{
+   for(size_t i = 0; i < refreshes.size(); ++i)
+      if(refreshes[i].query)
+         glDeleteQueries(1, &refreshes[i].query);
+
+   refreshes.clear();
+}
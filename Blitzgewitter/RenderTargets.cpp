@@ -0,0 +1,121 @@
+#include "RenderTargets.hpp"
+
+namespace
+{
+
+struct Target
+{
+   GLuint name;
+   GLenum format;
+   GLsizei width, height;
+   bool renderbuffer;
+   bool in_use;
+};
+
+std::vector<Target> g_targets;
+
+Target* findFree(GLenum format, GLsizei width, GLsizei height, bool renderbuffer)
+{
+   for(size_t i = 0; i < g_targets.size(); ++i)
+   {
+      Target& t = g_targets[i];
+      if(!t.in_use && t.renderbuffer == renderbuffer && t.format == format && t.width == width && t.height == height)
+         return &t;
+   }
+   return 0;
+}
+
+void release(GLuint name, bool renderbuffer)
+{
+   for(size_t i = 0; i < g_targets.size(); ++i)
+   {
+      Target& t = g_targets[i];
+      if(t.name == name && t.renderbuffer == renderbuffer)
+      {
+         assert(t.in_use);
+         t.in_use = false;
+         return;
+      }
+   }
+   assert(false);
+}
+
+}
+
+GLuint targets::acquireTexture(GLenum format, GLsizei width, GLsizei height)
+{
+   assert(width > 0 && height > 0);
+
+   Target* t = findFree(format, width, height, false);
+
+   if(t)
+      glBindTexture(GL_TEXTURE_2D, t->name);
+   else
+   {
+      Target nt = { 0, format, width, height, false, false };
+      glGenTextures(1, &nt.name);
+      glBindTexture(GL_TEXTURE_2D, nt.name);
+      glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+      g_targets.push_back(nt);
+      t = &g_targets.back();
+   }
+
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+   CHECK_FOR_ERRORS;
+
+   t->in_use = true;
+   return t->name;
+}
+
+GLuint targets::acquireRenderbuffer(GLenum format, GLsizei width, GLsizei height)
+{
+   assert(width > 0 && height > 0);
+
+   Target* t = findFree(format, width, height, true);
+
+   if(!t)
+   {
+      Target nt = { 0, format, width, height, true, false };
+      glGenRenderbuffers(1, &nt.name);
+      glBindRenderbuffer(GL_RENDERBUFFER, nt.name);
+      glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+      glBindRenderbuffer(GL_RENDERBUFFER, 0);
+      CHECK_FOR_ERRORS;
+      g_targets.push_back(nt);
+      t = &g_targets.back();
+   }
+
+   t->in_use = true;
+   return t->name;
+}
+
+void targets::releaseTexture(GLuint tex)
+{
+   release(tex, false);
+}
+
+void targets::releaseRenderbuffer(GLuint renderbuffer)
+{
+   release(renderbuffer, true);
+}
+
+void targets::trim()
+{
+   size_t n = 0;
+   for(size_t i = 0; i < g_targets.size(); ++i)
+   {
+      Target& t = g_targets[i];
+
+      if(t.in_use)
+         g_targets[n++] = t;
+      else if(t.renderbuffer)
+         glDeleteRenderbuffers(1, &t.name);
+      else
+         glDeleteTextures(1, &t.name);
+   }
+   g_targets.resize(n);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Engine.hpp"
+
+// A pool of render target textures and renderbuffers shared by all the scenes.
+// Only one scene is live at a time, and it hands its targets back when it is freed, so the
+// next scene takes the same storage instead of allocating its own. Targets are matched on
+// format and size, and a target is never given to two holders at once.
+
+namespace targets
+{
+
+// The texture comes with linear filtering and clamp-to-border wrapping, whatever the previous
+// holder set, and its contents are undefined.
+GLuint acquireTexture(GLenum format, GLsizei width, GLsizei height);
+GLuint acquireRenderbuffer(GLenum format, GLsizei width, GLsizei height);
+
+void releaseTexture(GLuint tex);
+void releaseRenderbuffer(GLuint renderbuffer);
+
+// Deletes the released targets, so that only the storage of the current holders remains.
+void trim();
+
+}
@@ -5,6 +5,7 @@
 #include "Bezier.hpp"
 #include "Ran.hpp"
 #include "Particles.hpp"
+#include "Voronoi.hpp"
 #include <omp.h>
 
 static inline Real frand()
@@ -23,16 +24,14 @@ static const char synth_pattern[]=".X..X.XX.X.XXXXX" ".X..X.XX.XXXXXXX";
 
 class RoomScene: public Scene
 {
-   typedef std::pair<Vec2,Vec2> Edge;
-
    struct VoronoiCell
    {
-      std::vector<Edge> edges;
+      int first_edge,num_edges;
       Vec2 center;
       float time0,time1;
    };
 
-   Shader gaussbokeh_shader, composite_shader;
+   Shader composite_shader;
    Shader mb_accum_shader;
    Shader room_shader;
    Shader room_object_shader;
@@ -62,6 +61,7 @@ class RoomScene: public Scene
 
    static const int max_voronoi_cells=128;
    VoronoiCell voronoi_cells[max_voronoi_cells];
+   voronoi::Diagram voronoi_diagram;
    int num_voronoi_cells;
 
    static const int volume_size_exp = 6;
@@ -119,7 +119,6 @@ class RoomScene: public Scene
    void drawLogo(float ltime);
    void drawRoom(const Mat4& modelview);
    void drawView(float ltime);
-   void gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0);
 
 
    public:
@@ -170,86 +169,18 @@ void RoomScene::initVoronoi()
       nodes.push_back(Vec2(lrnd.doub(),lrnd.doub()));
    }
 
-   for(std::vector<Vec2>::iterator n0=nodes.begin();n0!=nodes.end();++n0)
-   {
-      std::vector<Edge> edges;
-      for(std::vector<Vec2>::iterator n1=nodes.begin();n1!=nodes.end();++n1)
-      {
-         if(n0==n1)
-            continue;
-
-         Vec2 d=(*n1)-(*n0);
-         Vec2 pd=Vec2(-d.y,d.x);
-
-         Edge e;
-
-         e.first = *n0 + (d * 0.5) - (pd * 100.0);
-         e.second = *n0 + (d * 0.5) + (pd * 100.0);
+   voronoi::build(voronoi_diagram,&nodes[0],voronoi_num_points);
 
-         edges.push_back(e);
-      }
-      edges.push_back(Edge(Vec2(0,0),Vec2(1,0)));
-      edges.push_back(Edge(Vec2(1,0),Vec2(1,1)));
-      edges.push_back(Edge(Vec2(1,1),Vec2(0,1)));
-      edges.push_back(Edge(Vec2(0,1),Vec2(0,0)));
-
-      log("%d edges\n",edges.size());
-
-      std::vector<Edge> clipped_edges;
-      for(std::vector<Edge>::iterator e0=edges.begin();e0!=edges.end();++e0)
-      {
-         Edge e=*e0;
-         bool removed=false;
-         for(std::vector<Edge>::iterator e1=edges.begin();e1!=edges.end();++e1)
-         {
-            if(e0==e1)
-               continue;
-
-            Vec2 p=e1->second-e1->first;
-            p=Vec2(p.y,-p.x);
-            p=p*(Real(1)/std::sqrt(p.lengthSquared()));
-
-            Real d0=(e.first-e1->first).dot(p);
-            Real d1=(e.second-e1->first).dot(p);
-
-            if(d0 < 0 && d1 < 0)
-               continue;
-
-            if(d0 > 0 && d1 > 0)
-            {
-               removed=true;
-               break;
-            }
-
-            if(d0 < 0)
-            {
-               Real t=d0/(d0-d1);
-               e.second=mix(e.first,e.second,t);
-            }
-            else
-            {
-               Real t=d1/(d1-d0);
-               e.first=mix(e.second,e.first,t);
-            }
-         }
-         if(!removed && (e.second-e.first).lengthSquared() > 1e-8)
-         {
-            clipped_edges.push_back(e);
-         }
-      }
-      if(!clipped_edges.empty())
-      {
-         log("%d edges\n",clipped_edges.size());
-         log("%f %f\n",n0->x,n0->y);
-         log("%f %f\n",clipped_edges[0].first.x,clipped_edges[0].first.y);
-         assert(num_voronoi_cells<max_voronoi_cells);
-         VoronoiCell& vc=voronoi_cells[num_voronoi_cells];
-         vc.edges=clipped_edges;
-         vc.center=*n0;
-         vc.time0=float(num_voronoi_cells)/float(voronoi_num_points)*3.0f;
-         vc.time1=vc.time0+1.0f;;
-         ++num_voronoi_cells;
-      }
+   for(int i=0;i<voronoi_diagram.getCellCount();++i)
+   {
+      assert(num_voronoi_cells<max_voronoi_cells);
+      VoronoiCell& vc=voronoi_cells[num_voronoi_cells];
+      vc.first_edge=voronoi_diagram.first_edges[i];
+      vc.num_edges=voronoi_diagram.edge_counts[i];
+      vc.center=voronoi_diagram.sites[i];
+      vc.time0=float(num_voronoi_cells)/float(voronoi_num_points)*3.0f;
+      vc.time1=vc.time0+1.0f;
+      ++num_voronoi_cells;
    }
 }
 
@@ -668,12 +599,12 @@ void RoomScene::initializeTextures()
 {
    glGenTextures(num_texs, texs);
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
 
    CHECK_FOR_ERRORS;
 
@@ -780,10 +711,8 @@ void RoomScene::initializeBuffers()
    glGenFramebuffers(num_fbos, fbos);
    glGenRenderbuffers(num_fbos, renderbuffers);
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -833,8 +762,6 @@ void RoomScene::initializeShaders()
    room_object_shader.load(SHADERS_PATH "room_object_v.glsl", SHADERS_PATH "room_object_g.glsl", SHADERS_PATH "room_object_f.glsl");
    room_object_shader.uniform1i("noise_tex", 0);
 
-   gaussbokeh_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "gaussblur_f.glsl");
-   gaussbokeh_shader.uniform1i("tex0", 0);
 
    mb_accum_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_accum3_f.glsl");
    mb_accum_shader.uniform1i("tex0", 0);
@@ -1052,15 +979,17 @@ void RoomScene::drawLogo(float ltime)
       voronoi_coords[num_voronoi_vertices*2+1]=vc.center.y;
       ++num_voronoi_vertices;
 
-      for(std::vector<Edge>::const_iterator e=vc.edges.begin();e!=vc.edges.end();++e)
+      for(int e=vc.first_edge;e<vc.first_edge+vc.num_edges;++e)
       {
+         const Vec2 e0=voronoi_diagram.edgeStart(e), e1=voronoi_diagram.edgeEnd(e);
+
          for(int j=0;j<edge_subdivisions;++j)
          {
             const float t0=float(j+0)/float(edge_subdivisions);
             const float t1=float(j+1)/float(edge_subdivisions);
 
-            const Vec2 p0=mix(e->first,e->second,t0);
-            const Vec2 p1=mix(e->first,e->second,t1);
+            const Vec2 p0=mix(e0,e1,t0);
+            const Vec2 p1=mix(e0,e1,t1);
 
             assert(num_voronoi_indices<max_voronoi_indices);
             voronoi_indices[num_voronoi_indices++]=num_voronoi_vertices;
@@ -1307,78 +1236,6 @@ void RoomScene::drawView(float ltime)
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void RoomScene::gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0)
-{
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLfloat coords[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glEnableVertexAttribArray(0);
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
-
-   glViewport(0, 0, window_width / 4, window_height / 4);
-
-   // gaussian blur pass 1
-
-   {
-      gaussbokeh_shader.uniform4f("tint", tint_r, tint_g, tint_b, 1.0f);
-   }
-
-   const float gauss_radx = radx;
-   const float gauss_rady = rady;
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo0);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   glDepthMask(GL_FALSE);
-   glDisable(GL_DEPTH_TEST);
-
-   gaussbokeh_shader.bind();
-   gaussbokeh_shader.uniform2f("direction", gauss_radx * float(window_height) / float(window_width), 0.0f);
-
-   glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, src_tex);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-
-
-   // gaussian blur pass 2
-
-   gaussbokeh_shader.uniform4f("tint", 1, 1, 1, 1);
-
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo1);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   gaussbokeh_shader.uniform2f("direction", 0.0f, gauss_rady);
-
-   glBindTexture(GL_TEXTURE_2D, tex0);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-   glDisableVertexAttribArray(0);
-   glDisableVertexAttribArray(1);
-
-   CHECK_FOR_ERRORS;
-}
-
 
 void RoomScene::drawText(const std::string& str,float br)
 {
@@ -1510,10 +1367,12 @@ void RoomScene::render()
 
 void RoomScene::free()
 {
+   releaseWindowTargets();
    glDeleteTextures(1,&logo_tex);
    delete[] volume_data;
    volume_data=0;
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
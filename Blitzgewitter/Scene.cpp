@@ -1,10 +1,28 @@
 
 #include "Engine.hpp"
+#include "RenderTargets.hpp"
 
 #include <IL/il.h>
+#include <new>
+#include <xmmintrin.h>
 
 #define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
 
+void* Scene::operator new(size_t size)
+{
+   void* p = _mm_malloc(size, 64);
+
+   if(!p)
+      throw std::bad_alloc();
+
+   return p;
+}
+
+void Scene::operator delete(void* p)
+{
+   _mm_free(p);
+}
+
 static bool devil_not_initialised = true;
 
 GLuint Scene::loadTexture(const char *file_name,bool mipmaps)
@@ -153,6 +171,45 @@ void Scene::createWindowTexture(GLuint tex, GLenum format, uint divisor)
    CHECK_FOR_ERRORS;
 }
 
+void Scene::acquireWindowTexture(GLuint& tex, GLenum format, uint divisor)
+{
+   assert(divisor != 0);
+   assert(window_width != 0);
+   assert(window_height != 0);
+
+   glDeleteTextures(1, &tex);
+   tex = targets::acquireTexture(format, window_width / divisor, window_height / divisor);
+   window_textures.push_back(&tex);
+}
+
+void Scene::acquireWindowRenderbuffer(GLuint& renderbuffer, GLenum format)
+{
+   assert(window_width != 0);
+   assert(window_height != 0);
+
+   glDeleteRenderbuffers(1, &renderbuffer);
+   renderbuffer = targets::acquireRenderbuffer(format, window_width, window_height);
+   window_renderbuffers.push_back(&renderbuffer);
+}
+
+void Scene::releaseWindowTargets()
+{
+   for(size_t i = 0; i < window_textures.size(); ++i)
+   {
+      targets::releaseTexture(*window_textures[i]);
+      *window_textures[i] = 0;
+   }
+
+   for(size_t i = 0; i < window_renderbuffers.size(); ++i)
+   {
+      targets::releaseRenderbuffer(*window_renderbuffers[i]);
+      *window_renderbuffers[i] = 0;
+   }
+
+   window_textures.clear();
+   window_renderbuffers.clear();
+}
+
 void Scene::downsample8x(GLuint srctex, GLuint fbo0, GLuint tex0, GLuint target_fbo,
                          GLsizei vpw, GLsizei vph)
 {
@@ -250,3 +307,81 @@ void Scene::downsample8x(GLuint srctex, GLuint fbo0, GLuint tex0, GLuint target_
    glDisableVertexAttribArray(1);
 
 }
+
+void Scene::gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0)
+{
+   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
+   static const GLfloat coords[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
+   static const GLubyte indices[] = { 3, 0, 2, 1 };
+
+   glEnableVertexAttribArray(0);
+   glEnableVertexAttribArray(1);
+   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
+   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
+
+   glViewport(0, 0, window_width / 4, window_height / 4);
+
+   if(!gaussblur_shader.isLoaded())
+   {
+      gaussblur_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "gaussblur_f.glsl");
+      gaussblur_shader.uniform1i("tex0", 0);
+   }
+
+   // gaussian blur pass 1
+
+   {
+      gaussblur_shader.uniform4f("tint", tint_r, tint_g, tint_b, 1.0f);
+   }
+
+   const float gauss_radx = radx;
+   const float gauss_rady = rady;
+
+   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo0);
+
+   {
+      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
+      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
+   }
+
+
+   CHECK_FOR_ERRORS;
+
+   glDepthMask(GL_FALSE);
+   glDisable(GL_DEPTH_TEST);
+
+   gaussblur_shader.bind();
+   gaussblur_shader.uniform2f("direction", gauss_radx * float(window_height) / float(window_width), 0.0f);
+
+   glActiveTexture(GL_TEXTURE0);
+   glBindTexture(GL_TEXTURE_2D, src_tex);
+
+   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
+
+
+
+   // gaussian blur pass 2
+
+   gaussblur_shader.uniform4f("tint", 1, 1, 1, 1);
+
+
+   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo1);
+
+   {
+      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
+      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
+   }
+
+
+   CHECK_FOR_ERRORS;
+
+   gaussblur_shader.uniform2f("direction", 0.0f, gauss_rady);
+
+   glBindTexture(GL_TEXTURE_2D, tex0);
+
+   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
+
+   glDisableVertexAttribArray(0);
+   glDisableVertexAttribArray(1);
+
+   CHECK_FOR_ERRORS;
+}
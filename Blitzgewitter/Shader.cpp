@@ -1,67 +1,151 @@
 
 #include "Engine.hpp"
 
+static Shader::Stats g_frameStats, g_lastFrameStats, g_totalStats;
+
+void Shader::endFrame()
+{
+   g_lastFrameStats = g_frameStats;
+   g_totalStats.sent += g_frameStats.sent;
+   g_totalStats.skipped += g_frameStats.skipped;
+   g_frameStats.sent = 0;
+   g_frameStats.skipped = 0;
+}
+
+const Shader::Stats& Shader::getFrameStats()
+{
+   return g_lastFrameStats;
+}
+
+const Shader::Stats& Shader::getTotalStats()
+{
+   return g_totalStats;
+}
+
+// Returns true if the uniform is in the program and the value differs from the one it was last
+// given, in which case the value is kept and the call should be made.
+bool Shader::changeUniform(const char* name, const void* value, size_t size, GLboolean transpose, GLint& location)
+{
+   Uniform* uniform = NULL;
+
+   for(size_t i = 0; i < uniforms.size(); ++i)
+      if(uniforms[i].name == name)
+      {
+         uniform = &uniforms[i];
+         break;
+      }
+
+   if(!uniform)
+   {
+      uniforms.push_back(Uniform());
+      uniform = &uniforms.back();
+      uniform->name = name;
+      uniform->location = glGetUniformLocation(program, name);
+      uniform->transpose = GL_FALSE;
+   }
+
+   location = uniform->location;
+
+   if(location < 0)
+      return false;
+
+   const unsigned char* bytes = (const unsigned char*)value;
+
+   if(uniform->transpose == transpose && uniform->value.size() == size && (size == 0 || !memcmp(&uniform->value[0], bytes, size)))
+   {
+      ++g_frameStats.skipped;
+      return false;
+   }
+
+   uniform->transpose = transpose;
+   uniform->value.assign(bytes, bytes + size);
+
+   ++g_frameStats.sent;
+
+   return true;
+}
+
 void Shader::uniform1i(const char* name, GLint x)
 {
-   GLint loc=glGetUniformLocation(program, name);
-   if(loc<0)
+   const GLint value[] = { x };
+   GLint location;
+
+   if(!changeUniform(name, value, sizeof(value), GL_FALSE, location))
       return;
-   glProgramUniform1i(program, loc, x);
+
+   glProgramUniform1i(program, location, x);
    CHECK_FOR_ERRORS;
 }
 
 void Shader::uniform2i(const char* name, GLint x, GLint y)
 {
-   GLint loc=glGetUniformLocation(program, name);
-   if(loc<0)
+   const GLint value[] = { x, y };
+   GLint location;
+
+   if(!changeUniform(name, value, sizeof(value), GL_FALSE, location))
       return;
-   glProgramUniform2i(program, loc, x, y);
+
+   glProgramUniform2i(program, location, x, y);
    CHECK_FOR_ERRORS;
 }
 
 
 void Shader::uniform4f(const char* name, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
 {
-   GLint loc=glGetUniformLocation(program, name);
-   if(loc<0)
+   const GLfloat value[] = { x, y, z, w };
+   GLint location;
+
+   if(!changeUniform(name, value, sizeof(value), GL_FALSE, location))
       return;
-   glProgramUniform4f(program, loc, x, y, z, w);
+
+   glProgramUniform4f(program, location, x, y, z, w);
    CHECK_FOR_ERRORS;
 }
 
 void Shader::uniform3f(const char* name, GLfloat x, GLfloat y, GLfloat z)
 {
-   GLint loc=glGetUniformLocation(program, name);
-   if(loc<0)
+   const GLfloat value[] = { x, y, z };
+   GLint location;
+
+   if(!changeUniform(name, value, sizeof(value), GL_FALSE, location))
       return;
-   glProgramUniform3f(program, loc, x, y, z);
+
+   glProgramUniform3f(program, location, x, y, z);
    CHECK_FOR_ERRORS;
 }
 
 void Shader::uniform2f(const char* name, GLfloat x, GLfloat y)
 {
-   GLint loc=glGetUniformLocation(program, name);
-   if(loc<0)
+   const GLfloat value[] = { x, y };
+   GLint location;
+
+   if(!changeUniform(name, value, sizeof(value), GL_FALSE, location))
       return;
-   glProgramUniform2f(program, loc, x, y);
+
+   glProgramUniform2f(program, location, x, y);
    CHECK_FOR_ERRORS;
 }
 
 void Shader::uniform1f(const char* name, GLfloat x)
 {
-   GLint loc=glGetUniformLocation(program, name);
-   if(loc<0)
+   const GLfloat value[] = { x };
+   GLint location;
+
+   if(!changeUniform(name, value, sizeof(value), GL_FALSE, location))
       return;
-   glProgramUniform1f(program, loc, x);
+
+   glProgramUniform1f(program, location, x);
    CHECK_FOR_ERRORS;
 }
 
 void Shader::uniformMatrix4fv(const char* name, GLsizei count, GLboolean transpose, const GLfloat* value)
 {
-   GLint loc=glGetUniformLocation(program, name);
-   if(loc<0)
+   GLint location;
+
+   if(!changeUniform(name, value, sizeof(GLfloat) * 16 * count, transpose, location))
       return;
-   glProgramUniformMatrix4fv(program, loc, count, transpose, value);
+
+   glProgramUniformMatrix4fv(program, location, count, transpose, value);
    CHECK_FOR_ERRORS;
 }
 
@@ -241,6 +325,7 @@ void Shader::free()
 {
    glDeleteProgram(program);
    program = 0;
+   uniforms.clear();
 }
 
 void Shader::load(const char* vsh_filename, const char* gsh_filename,
@@ -248,5 +333,6 @@ void Shader::load(const char* vsh_filename, const char* gsh_filename,
 {
    program = createProgram(vsh_filename, gsh_filename, fsh_filename);
    loaded = true;
+   uniforms.clear();
 }
 
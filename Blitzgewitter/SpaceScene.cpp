@@ -2,6 +2,7 @@
 #include "Engine.hpp"
 #include "Bezier.hpp"
 #include "Ran.hpp"
+#include "Noise.hpp"
 #include "Particles.hpp"
 #include "Tower.hpp"
 
@@ -81,13 +82,7 @@ class SpaceScene: public Scene
    static const int g_particle_data_tex_size = 2048 / 2; // 2048, 4 floats = 67 megabytes
    static const int g_particle_count = g_particle_data_tex_size * g_particle_data_tex_size;
 
-   static const int random_grid_w = 256;
-   static const int random_grid_h = 256;
-
-   float random_grid[random_grid_w*random_grid_h];
-
-   void initRandomGrid();
-   float randomGridLookup(float u, float v) const;
+   noise::RandomGrid random_grid;
 
    float hand_swipe_pos;
    float hand_swipe_vel;
@@ -339,7 +334,7 @@ void SpaceScene::slowInitialize()
 
    }
 
-   initRandomGrid();
+   random_grid.fill(frand);
 
    //start_time = 0;
 
@@ -392,14 +387,14 @@ void SpaceScene::initializeTextures()
 {
    glGenTextures(num_texs, texs);
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
-   createWindowTexture(texs[12], GL_RGBA16F, 2);
-   createWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[12], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[13], GL_RGBA16F, 2);
 
    CHECK_FOR_ERRORS;
 
@@ -465,6 +460,7 @@ void SpaceScene::initializeTextures()
 
 
 
+   acquireWindowTexture(g_particle_output0_tex, GL_RGB16F);
    glBindTexture(GL_TEXTURE_2D, g_particle_output0_tex);
 
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -472,10 +468,10 @@ void SpaceScene::initializeTextures()
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-   glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, window_width, window_height);
    CHECK_FOR_ERRORS;
 
 
+   acquireWindowTexture(g_particle_output1_tex, GL_RGB16F);
    glBindTexture(GL_TEXTURE_2D, g_particle_output1_tex);
 
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -483,10 +479,10 @@ void SpaceScene::initializeTextures()
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-   glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, window_width, window_height);
    CHECK_FOR_ERRORS;
 
 
+   acquireWindowTexture(g_particle_output2_tex, GL_RGB16F);
    glBindTexture(GL_TEXTURE_2D, g_particle_output2_tex);
 
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -494,7 +490,6 @@ void SpaceScene::initializeTextures()
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-   glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB16F, window_width, window_height);
    CHECK_FOR_ERRORS;
 
    glBindTexture(GL_TEXTURE_2D, 0);
@@ -506,10 +501,8 @@ void SpaceScene::initializeBuffers()
    glGenFramebuffers(num_fbos, fbos);
    glGenRenderbuffers(num_fbos, renderbuffers);
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -592,41 +585,6 @@ void SpaceScene::initializeShaders()
 }
 
 
-void SpaceScene::initRandomGrid()
-{
-   for(int y=0;y<random_grid_h;++y)
-      for(int x=0;x<random_grid_w;++x)
-      {
-         random_grid[x+y*random_grid_w]=(frand()-0.5)*2.0;
-      }
-}
-
-float SpaceScene::randomGridLookup(float u, float v) const
-{
-   u=fmodf(u,float(random_grid_w));
-   v=fmodf(v,float(random_grid_h));
-
-   if(u<0)
-      u+=random_grid_w;
-
-   if(v<0)
-      v+=random_grid_h;
-
-   const int iu=int(u);
-   const int iv=int(v);
-
-   const float fu=u-float(iu);
-   const float fv=v-float(iv);
-
-   const float a=random_grid[iu+iv*random_grid_w];
-   const float b=random_grid[((iu+1)%random_grid_w)+iv*random_grid_w];
-   const float c=random_grid[((iu+1)%random_grid_w)+((iv+1)%random_grid_h)*random_grid_w];
-   const float d=random_grid[iu+((iv+1)%random_grid_h)*random_grid_w];
-
-   return (1.0-fv)*((1.0-fu)*a+fu*b) + fv*((1.0-fu)*d+fu*c);
-}
-
-
 void SpaceScene::initialize()
 {
    if(initialized)
@@ -709,7 +667,7 @@ float SpaceScene::roll(float t)
    float s=1;
    if(a>M_PI)
       a+=(a-M_PI)*2;
-   return -std::sin(a)*0.6f*s-randomGridLookup(10,t*15)*0.02-randomGridLookup(10,t*30)*0.01;
+   return -std::sin(a)*0.6f*s-random_grid.lookup(10,t*15)*0.02-random_grid.lookup(10,t*30)*0.01;
 }
 
 void SpaceScene::renderParticles(float tttime)
@@ -750,8 +708,8 @@ void SpaceScene::renderParticles(float tttime)
    modelview = modelview * Mat4::rotation(time * 0.1, Vec3(0.0f, 1.0f, 0.0f));
    //modelview = modelview * Mat4::scale(Vec3(3, 3, 3));
 
-   modelview = Mat4::rotation(randomGridLookup(0,time)*0.015, Vec3(1.0f, 0.0f, 0.0f)) * modelview;
-   modelview = Mat4::rotation(randomGridLookup(4,time)*0.015, Vec3(0.0f, 1.0f, 0.0f)) * modelview;
+   modelview = Mat4::rotation(random_grid.lookup(0,time)*0.015, Vec3(1.0f, 0.0f, 0.0f)) * modelview;
+   modelview = Mat4::rotation(random_grid.lookup(4,time)*0.015, Vec3(0.0f, 1.0f, 0.0f)) * modelview;
 
    const double looktime = 20.0;
    const double lookamount = cubic(clamp(1.0 - std::abs(time - looktime) * 0.15, 0.0, 1.0));
@@ -1060,11 +1018,13 @@ void SpaceScene::render()
 
 void SpaceScene::free()
 {
+   releaseWindowTargets();
    glDeleteBuffers(1,&text_vbo);
    glDeleteBuffers(1,&text_ebo);
    glDeleteTextures(1,&g_particle_triangle_tex);
    glDeleteTextures(num_hand_frames, hand_frame_texs);
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
@@ -0,0 +1,133 @@
+#include "Surface.hpp"
+
+#include <vector>
+
+using namespace surface;
+
+namespace
+{
+
+void transformRow(const Mat4& xfrm, GLfloat* row, int n)
+{
+   for(int u = 0; u < n; ++u)
+   {
+      const Vec3 p = xfrm * Vec3(row[u * 3 + 0], row[u * 3 + 1], row[u * 3 + 2]);
+      row[u * 3 + 0] = p.x;
+      row[u * 3 + 1] = p.y;
+      row[u * 3 + 2] = p.z;
+   }
+}
+
+void storeNormal(GLfloat* out, Vec3 nrm)
+{
+   const float nrml = std::sqrt(nrm.lengthSquared());
+   assert(nrml > 0.0f);
+   nrm = nrm * 1.0f / nrml;
+
+   out[0] = nrm.x;
+   out[1] = nrm.y;
+   out[2] = nrm.z;
+}
+
+}
+
+void surface::tessellate(const Surface& surface, const Mat4& xfrm, const Grid& grid)
+{
+   const int num_u = grid.num_u, num_v = grid.num_v;
+
+   std::vector<float> us(num_u), us_eps(num_u);
+   for(int u = 0; u < num_u; ++u)
+   {
+      us[u] = float(u) / float(num_u - 1);
+      us_eps[u] = us[u] + grid.normal_eps;
+   }
+
+   // the normals need every sample, so they are kept even if the vertices aren't wanted
+   std::vector<GLfloat> own_vertices;
+   GLfloat* vertices = grid.vertices;
+
+   if(!vertices)
+   {
+      own_vertices.resize(num_u * num_v * 3);
+      vertices = &own_vertices[0];
+   }
+
+   const bool forward_normals = grid.normals && grid.normal_eps > 0;
+
+#pragma omp parallel for
+   for(int v = 0; v < num_v; ++v)
+   {
+      const float fv = float(v) / float(num_v - 1);
+      GLfloat* row = vertices + v * num_u * 3;
+
+      surface.evaluateRow(&us[0], fv, row, num_u);
+      transformRow(xfrm, row, num_u);
+
+      if(forward_normals)
+      {
+         std::vector<GLfloat> row_u(num_u * 3), row_v(num_u * 3);
+
+         surface.evaluateRow(&us_eps[0], fv, &row_u[0], num_u);
+         surface.evaluateRow(&us[0], fv + grid.normal_eps, &row_v[0], num_u);
+         transformRow(xfrm, &row_u[0], num_u);
+         transformRow(xfrm, &row_v[0], num_u);
+
+         for(int u = 0; u < num_u; ++u)
+         {
+            const Vec3 p0(row[u * 3 + 0], row[u * 3 + 1], row[u * 3 + 2]);
+            const Vec3 p1(row_u[u * 3 + 0], row_u[u * 3 + 1], row_u[u * 3 + 2]);
+            const Vec3 p2(row_v[u * 3 + 0], row_v[u * 3 + 1], row_v[u * 3 + 2]);
+
+            storeNormal(grid.normals + (u + v * num_u) * 3, (p1 - p0).cross(p2 - p0));
+         }
+      }
+
+      if(grid.coords)
+         for(int u = 0; u < num_u; ++u)
+         {
+            grid.coords[(u + v * num_u) * 2 + 0] = us[u];
+            grid.coords[(u + v * num_u) * 2 + 1] = fv;
+         }
+
+      if(grid.indices && v < (num_v - 1))
+         for(int u = 0; u < num_u; ++u)
+         {
+            grid.indices[(u + v * num_u) * 2 + 0] = u + (v + 0) * num_u;
+            grid.indices[(u + v * num_u) * 2 + 1] = u + (v + 1) * num_u;
+         }
+   }
+
+   if(!grid.normals || forward_normals)
+      return;
+
+#pragma omp parallel for
+   for(int v = 0; v < num_v; ++v)
+   {
+      const GLfloat* v0 = vertices + std::max(0, v - 1) * num_u * 3;
+      const GLfloat* v1 = vertices + std::min(num_v - 1, v + 1) * num_u * 3;
+      const GLfloat* row = vertices + v * num_u * 3;
+
+      for(int u = 0; u < num_u; ++u)
+      {
+         int u0 = u - 1, u1 = u + 1;
+
+         if(grid.wrap_u)
+         {
+            if(u0 < 0)
+               u0 = num_u - 2;
+            if(u1 > num_u - 1)
+               u1 = 1;
+         }
+         else
+         {
+            u0 = std::max(0, u0);
+            u1 = std::min(num_u - 1, u1);
+         }
+
+         const Vec3 du(row[u1 * 3 + 0] - row[u0 * 3 + 0], row[u1 * 3 + 1] - row[u0 * 3 + 1], row[u1 * 3 + 2] - row[u0 * 3 + 2]);
+         const Vec3 dv(v1[u * 3 + 0] - v0[u * 3 + 0], v1[u * 3 + 1] - v0[u * 3 + 1], v1[u * 3 + 2] - v0[u * 3 + 2]);
+
+         storeNormal(grid.normals + (u + v * num_u) * 3, du.cross(dv));
+      }
+   }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Engine.hpp"
+
+namespace surface
+{
+
+// A parametric surface over [0,1]x[0,1], evaluated a row of constant v at a time.
+// evaluateRow writes the points at (u[i],v) for i in [0,n) to out as x,y,z triples.
+// It is called from several threads at once.
+class Surface
+{
+   public:
+      virtual ~Surface()
+      {
+      }
+
+      virtual void evaluateRow(const float* u, float v, float* out, int n) const = 0;
+};
+
+// The arrays which tessellate fills in, any of which may be null. The vertices and normals
+// are x,y,z triples, the coords are u,v pairs, and the indices are one triangle strip for
+// each pair of neighbouring rows, (num_v-1)*num_u*2 of them in all.
+struct Grid
+{
+   Grid(int num_u, int num_v): num_u(num_u), num_v(num_v), wrap_u(false), normal_eps(0),
+                               vertices(0), coords(0), normals(0), indices(0)
+   {
+   }
+
+   int num_u, num_v;
+
+   // whether the first and last columns coincide, so that the normals are continuous across them
+   bool wrap_u;
+
+   // If this is zero the normals are central differences of the grid samples. Otherwise they
+   // are forward differences over this distance in u and v, which picks up detail finer than
+   // the grid at the cost of evaluating two more rows for each row.
+   float normal_eps;
+
+   GLfloat* vertices;
+   GLfloat* coords;
+   GLfloat* normals;
+   GLuint* indices;
+};
+
+// Samples the surface on a num_u by num_v grid and transforms the points by xfrm.
+// Rows are spread over threads.
+void tessellate(const Surface& surface, const Mat4& xfrm, const Grid& grid);
+
+}
@@ -15,40 +15,181 @@ static Real randRange(const Real x0, const Real x1)
    return mix(x0,x1,frand());
 }
 
+unsigned int Tower::internParameter(const std::string& name)
+{
+   map<std::string, unsigned int>::iterator p=parameter_indices.find(name);
+
+   if(p!=parameter_indices.end())
+      return p->second;
+
+   const unsigned int index=parameter_indices.size();
+   parameter_indices[name]=index;
+   return index;
+}
+
+const Real* Tower::parameter(const char* name) const
+{
+   map<std::string, unsigned int>::const_iterator p=parameter_indices.find(name);
+
+   if(zeroes.empty())
+      return 0;
+
+   if(p==parameter_indices.end())
+      return &zeroes[0];
+
+   return &parameter_values[p->second*zeroes.size()];
+}
+
 void Tower::genInstances()
 {
-   instances.clear();
+   parameter_indices.clear();
+   instance_sections.clear();
+   parameter_values.clear();
+   zeroes.clear();
+
+   const unsigned int height_index=internParameter("height");
+   const unsigned int distance_index=internParameter("distance");
 
-   for(vector<Section>::iterator s=sections.begin();s!=sections.end();++s)
+   // the index of each parameter of each piece type, in the same order as the parameter map
+   vector<vector<vector<unsigned int> > > type_indices(sections.size());
+
+   unsigned int num_instances=0;
+
+   for(unsigned int i=0;i<sections.size();++i)
    {
+      Section& s=sections[i];
+
+      type_indices[i].resize(s.types.size());
+
+      for(unsigned int j=0;j<s.types.size();++j)
+         for(map<std::string, ParameterRange>::iterator p=s.types[j].parameters.begin();p!=s.types[j].parameters.end();++p)
+            type_indices[i][j].push_back(internParameter(p->first));
+
+      num_instances+=s.num_instances;
+   }
+
+   if(num_instances==0)
+      return;
+
+   zeroes.assign(num_instances, 0);
+   parameter_values.assign(parameter_indices.size()*num_instances, 0);
+
+   Real* const height=&parameter_values[height_index*num_instances];
+   Real* const distance=&parameter_values[distance_index*num_instances];
+
+   unsigned int instance=0;
+
+   for(unsigned int i=0;i<sections.size();++i)
+   {
+      Section& s=sections[i];
+
       Real cw=0;
-      for(vector<PieceType>::iterator t=s->types.begin();t!=s->types.end();++t)
+      for(vector<PieceType>::iterator t=s.types.begin();t!=s.types.end();++t)
       {
          cw+=t->weight;
          t->cumulative_weight=cw;
       }
 
-      for(unsigned int i=0;i<s->num_instances;++i)
+      for(unsigned int k=0;k<s.num_instances;++k,++instance)
       {
-         PieceInstance instance;
          const Real r=frand()*cw;
-         for(vector<PieceType>::iterator t=s->types.begin();t!=s->types.end();++t)
+         for(unsigned int j=0;j<s.types.size();++j)
          {
-            if(t->cumulative_weight >= r)
+            if(s.types[j].cumulative_weight >= r)
             {
-               for(map<std::string, ParameterRange>::iterator p=t->parameters.begin();p!=t->parameters.end();++p)
+               const vector<unsigned int>& indices=type_indices[i][j];
+               unsigned int n=0;
+               for(map<std::string, ParameterRange>::iterator p=s.types[j].parameters.begin();p!=s.types[j].parameters.end();++p,++n)
                {
-                  instance.parameters[p->first]=randRange(p->second.x0, p->second.x1);
+                  parameter_values[indices[n]*num_instances+instance]=randRange(p->second.x0, p->second.x1);
                }
                break;
             }
          }
 
-         instance.parameters["height"]=mix(s->height0,s->height1,instance.parameters["height"]);
-         instance.parameters["distance"]*=s->radius;
-         instance.section=&*s;
+         height[instance]=mix(s.height0,s.height1,height[instance]);
+         distance[instance]*=s.radius;
 
-         instances.push_back(instance);
+         instance_sections.push_back(i);
       }
    }
 }
+
+Pieces::Pieces(const Tower& twr): twr(twr)
+{
+   background=twr.parameter("background");
+   geom=twr.parameter("geom");
+   time_scale=twr.parameter("time_scale");
+   time_offset=twr.parameter("time_offset");
+   ptn_thickness=twr.parameter("ptn_thickness");
+   ptn_brightness=twr.parameter("ptn_brightness");
+   ptn_scroll=twr.parameter("ptn_scroll");
+   ptn_frequency=twr.parameter("ptn_frequency");
+   shimmer=twr.parameter("shimmer");
+   l0_scroll=twr.parameter("l0_scroll");
+   l0_brightness=twr.parameter("l0_brightness");
+   l1_scroll=twr.parameter("l1_scroll");
+   l1_brightness=twr.parameter("l1_brightness");
+   l2_scroll=twr.parameter("l2_scroll");
+   l2_brightness=twr.parameter("l2_brightness");
+   ambient=twr.parameter("ambient");
+   section_rot_spd=twr.parameter("section_rot_spd");
+   angle=twr.parameter("angle");
+   distance=twr.parameter("distance");
+   height=twr.parameter("height");
+   rot_z=twr.parameter("rot_z");
+   rot_spd_z=twr.parameter("rot_spd_z");
+   rot_y=twr.parameter("rot_y");
+   rot_spd_y=twr.parameter("rot_spd_y");
+   rot_x=twr.parameter("rot_x");
+   rot_spd_x=twr.parameter("rot_spd_x");
+   sca_x=twr.parameter("sca_x");
+   sca_y=twr.parameter("sca_y");
+   sca_z=twr.parameter("sca_z");
+}
+
+bool Pieces::inView(unsigned int i, bool background_pass, Real camheight, Real camheightrange) const
+{
+   const Section& section=twr.getSection(i);
+
+   if((background[i]>0.5)!=background_pass)
+      return false;
+
+   return camheight >= (section.height1 - camheightrange) && camheight <= (section.height0 + camheightrange);
+}
+
+void Pieces::setUniforms(Shader& shader, unsigned int i, Real brightness) const
+{
+   shader.uniform1f("ptn_thickness",ptn_thickness[i]);
+   shader.uniform1f("ptn_brightness",ptn_brightness[i]);
+   shader.uniform1f("ptn_scroll",ptn_scroll[i]);
+   shader.uniform1f("ptn_frequency",ptn_frequency[i]);
+   shader.uniform1f("shimmer",shimmer[i]);
+   shader.uniform1f("l0_scroll",l0_scroll[i]);
+   shader.uniform1f("l0_brightness",l0_brightness[i]*brightness);
+   shader.uniform1f("l1_scroll",l1_scroll[i]);
+   shader.uniform1f("l1_brightness",l1_brightness[i]*brightness);
+   shader.uniform1f("l2_scroll",l2_scroll[i]);
+   shader.uniform1f("l2_brightness",l2_brightness[i]*brightness);
+   shader.uniform1f("ambient",ambient[i]);
+}
+
+Mat4 Pieces::transform(unsigned int i, Real t, Real lift, Real spin_scale, Real place_scale) const
+{
+   return Mat4::rotation(t * section_rot_spd[i], Vec3(0,1,0)) *
+          Mat4::translation(Vec3(Vec3(std::cos(angle[i])*distance[i], height[i]-lift, std::sin(angle[i])*distance[i]) * place_scale)) *
+          Mat4::rotation(rot_z[i]+t*rot_spd_z[i]*spin_scale,Vec3(0,0,1)) * Mat4::rotation(rot_y[i]+t*rot_spd_y[i]*spin_scale,Vec3(0,1,0)) * Mat4::rotation(rot_x[i]+t*rot_spd_x[i]*spin_scale,Vec3(1,0,0)) *
+          Mat4::scale(Vec3(sca_x[i],sca_y[i],sca_z[i]));
+}
+
+void Pieces::draw(Shader& shader, Mesh& mesh, const Mat4& modelview)
+{
+   mesh.bind();
+
+   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
+   glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(mesh.getVertexCount() * sizeof(GLfloat) * 3));
+
+   shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
+
+   glDrawRangeElements(GL_TRIANGLES, 0, mesh.getVertexCount() - 1, mesh.getTriangleCount() * 3, GL_UNSIGNED_INT, 0);
+}
@@ -42,18 +42,57 @@ struct Section
    unsigned int num_instances;
 };
 
-struct PieceInstance
-{
-   Section* section;
-   std::map<std::string, Real> parameters;
-};
-
+// The parameter names used by the piece types are interned into indices when the
+// instances are generated, and the instance parameters are stored as one array per
+// parameter. Parameters which a piece type does not set are zero.
 struct Tower
 {
    std::vector<Section> sections;
-   std::vector<PieceInstance> instances;
 
    void genInstances();
+
+   unsigned int getInstanceCount() const { return instance_sections.size(); }
+   const Section& getSection(unsigned int instance) const { return sections[instance_sections[instance]]; }
+
+   // returns the values of the named parameter for all instances, or zeroes if no piece type has it
+   const Real* parameter(const char* name) const;
+
+   private:
+      std::map<std::string, unsigned int> parameter_indices;
+      std::vector<unsigned int> instance_sections;
+      std::vector<Real> parameter_values;
+      std::vector<Real> zeroes;
+
+      unsigned int internParameter(const std::string& name);
+};
+
+// The instance parameters which the scenes' tower shaders read, looked up once per draw, and
+// the parts of drawing a piece which PlatonicScene, Platonic2Scene and FrostScene share.
+struct Pieces
+{
+   explicit Pieces(const Tower& twr);
+
+   const Tower& twr;
+
+   const Real *background, *geom, *time_scale, *time_offset,
+              *ptn_thickness, *ptn_brightness, *ptn_scroll, *ptn_frequency, *shimmer,
+              *l0_scroll, *l0_brightness, *l1_scroll, *l1_brightness, *l2_scroll, *l2_brightness,
+              *ambient, *section_rot_spd, *angle, *distance, *height,
+              *rot_z, *rot_spd_z, *rot_y, *rot_spd_y, *rot_x, *rot_spd_x, *sca_x, *sca_y, *sca_z;
+
+   // Whether instance i is drawn in the background pass or in the main one, and its section
+   // is within camheightrange of camheight.
+   bool inView(unsigned int i, bool background_pass, Real camheight, Real camheightrange) const;
+
+   // Sets the pattern and light uniforms of instance i, with the lights scaled by brightness.
+   void setUniforms(Shader& shader, unsigned int i, Real brightness = 1) const;
+
+   // The transform of instance i at time t, from its section's spin, its place (lowered by lift,
+   // then scaled by place_scale), its own spin (scaled by spin_scale) and its scale.
+   Mat4 transform(unsigned int i, Real t, Real lift = 0, Real spin_scale = 1, Real place_scale = 1) const;
+
+   // Draws mesh with the bound shader. Attributes 0 and 2 must be enabled.
+   static void draw(Shader& shader, Mesh& mesh, const Mat4& modelview);
 };
 
 }
@@ -4,8 +4,10 @@
 #include "Engine.hpp"
 #include "Bezier.hpp"
 #include "Ran.hpp"
+#include "Noise.hpp"
 #include "Particles.hpp"
 #include "Tower.hpp"
+#include "Volume.hpp"
 
 #include <list>
 
@@ -48,13 +50,7 @@ class TriangleScene: public Scene
    static const int num_balls=2048;
    Vec3 balls[num_balls];
 
-   static const int random_grid_w = 256;
-   static const int random_grid_h = 256;
-
-   float random_grid[random_grid_w*random_grid_h];
-
-   void initRandomGrid();
-   float randomGridLookup(float u, float v) const;
+   noise::RandomGrid random_grid;
 
    GLfloat spiral_vertices[1024 * 4 * 3];
    GLfloat spiral_coords[1024 * 4 * 2];
@@ -62,7 +58,7 @@ class TriangleScene: public Scene
    GLushort spiral_num_vertices, spiral_num_indices;
 
    Shader forrest_shader;
-   Shader gaussbokeh_shader, composite_shader;
+   Shader composite_shader;
    Shader mb_accum_shader;
    Shader screendisplay_shader;
    Shader bgfg_shader;
@@ -84,7 +80,6 @@ class TriangleScene: public Scene
    static const int cloud_size = 64;
 
    GLuint cloud_tex;
-   GLuint cloud_fbo;
    GLuint cloud_nearest_sampler;
 
    static const int num_fbos = 16, num_texs = 16;
@@ -107,7 +102,6 @@ class TriangleScene: public Scene
    void drawView(float ltime);
    void drawView2(float ltime);
    void createSpiral();
-   void gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0);
 
 
    public:
@@ -156,7 +150,6 @@ void TriangleScene::slowInitialize()
    glGenFramebuffers(num_fbos, fbos);
    glGenRenderbuffers(num_fbos, renderbuffers);
 
-   cloud_fbo = fbos[1];
 
    {
       uint s = 16;
@@ -219,14 +212,14 @@ void TriangleScene::slowInitialize()
 
 void TriangleScene::initializeTextures()
 {
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
-   createWindowTexture(texs[12], GL_RGBA16F, 2);
-   createWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[12], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[13], GL_RGBA16F, 2);
 
    CHECK_FOR_ERRORS;
 
@@ -238,10 +231,8 @@ void TriangleScene::initializeBuffers()
 {
    glGenRenderbuffers(num_fbos, renderbuffers);
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -284,8 +275,6 @@ void TriangleScene::initializeShaders()
    forrest_shader.load(SHADERS_PATH "forrest3_v.glsl", NULL, SHADERS_PATH "forrest3_f.glsl");
    forrest_shader.uniform1i("noise_tex", 0);
 
-   gaussbokeh_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "gaussblur_f.glsl");
-   gaussbokeh_shader.uniform1i("tex0", 0);
 
    mb_accum_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_accum2_f.glsl");
    mb_accum_shader.uniform1i("tex0", 0);
@@ -314,40 +303,6 @@ void TriangleScene::initializeShaders()
    cloud_render_shader.uniform1i("noise_tex_2d",2);
 }
 
-void TriangleScene::initRandomGrid()
-{
-   for(int y=0;y<random_grid_h;++y)
-      for(int x=0;x<random_grid_w;++x)
-      {
-         random_grid[x+y*random_grid_w]=(frand()-0.5)*2.0;
-      }
-}
-
-float TriangleScene::randomGridLookup(float u, float v) const
-{
-   u=fmodf(u,float(random_grid_w));
-   v=fmodf(v,float(random_grid_h));
-
-   if(u<0)
-      u+=random_grid_w;
-
-   if(v<0)
-      v+=random_grid_h;
-
-   const int iu=int(u);
-   const int iv=int(v);
-
-   const float fu=u-float(iu);
-   const float fv=v-float(iv);
-
-   const float a=random_grid[iu+iv*random_grid_w];
-   const float b=random_grid[((iu+1)%random_grid_w)+iv*random_grid_w];
-   const float c=random_grid[((iu+1)%random_grid_w)+((iv+1)%random_grid_h)*random_grid_w];
-   const float d=random_grid[iu+((iv+1)%random_grid_h)*random_grid_w];
-
-   return (1.0-fv)*((1.0-fu)*a+fu*b) + fv*((1.0-fu)*d+fu*c);
-}
-
 void TriangleScene::initialize()
 {
    if(initialized)
@@ -358,7 +313,7 @@ void TriangleScene::initialize()
    initializeTextures();
    initializeBuffers();
 
-   initRandomGrid();
+   random_grid.fill(frand);
 
    initMountain();
 
@@ -435,15 +390,7 @@ void TriangleScene::initMountain()
 
 GLfloat TriangleScene::evaluateMountainHeight(GLfloat u, GLfloat v)
 {
-   GLfloat n=0.0f;
-   GLfloat scale=16.0f,mag=0.5f;
-
-   for(int i=0;i<10;++i)
-   {
-      n += randomGridLookup(u * scale, v * scale) * mag;
-      mag *= 0.5f;
-      scale *= 2.0f;
-   }
+   GLfloat n=random_grid.fbm(u, v, 10, 16.0f, 0.5f);
 
    n*=1.0f-(1.0f-cubic(clamp(std::abs(u-0.5f)*5.0f,0.0f,1.0f)))*(1.0f-cubic(clamp((v-0.5f)*1.5f,0.0f,1.0f)));
 
@@ -463,8 +410,8 @@ void TriangleScene::update()
    for(int i=0;i<num_drips;++i)
    {
       drips[i].update();
-      drips[i].pos.y-=(drips[i].r+0.01)*0.1-randomGridLookup(drips[i].pos.x*16,drips[i].pos.y*16)*0.002+((i==0)?0.002:0.0);
-      drips[i].pos.x+=(drips[i].r+0.01)*randomGridLookup(drips[i].pos.x*20,drips[i].pos.y*20)*0.2;
+      drips[i].pos.y-=(drips[i].r+0.01)*0.1-random_grid.lookup(drips[i].pos.x*16,drips[i].pos.y*16)*0.002+((i==0)?0.002:0.0);
+      drips[i].pos.x+=(drips[i].r+0.01)*random_grid.lookup(drips[i].pos.x*20,drips[i].pos.y*20)*0.2;
    }
 }
 
@@ -569,16 +516,6 @@ void TriangleScene::renderCloud(float ltime)
 
 void TriangleScene::generateCloud(float ltime)
 {
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cloud_fbo);
-   CHECK_FOR_ERRORS;
-   glViewport(0, 0, cloud_size, cloud_size);
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
    glActiveTexture(GL_TEXTURE1);
    glBindTexture(GL_TEXTURE_3D, noise_tex);
    glActiveTexture(GL_TEXTURE0);
@@ -587,23 +524,14 @@ void TriangleScene::generateCloud(float ltime)
    glDisable(GL_DEPTH_TEST);
    glDepthMask(GL_FALSE);
    glColorMask(GL_TRUE, GL_FALSE, GL_FALSE, GL_FALSE);
-   glEnableVertexAttribArray(0);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
    CHECK_FOR_ERRORS;
 
    cloud_gen_shader.bind();
 
-   for(int z=0;z<cloud_size;++z)
-   {
-      cloud_gen_shader.uniform1i("layer",z);
-      cloud_gen_shader.uniform1f("layerf",float(z)/float(cloud_size));
-      glFramebufferTexture3D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_3D, cloud_tex, 0, z);
-      CHECK_FOR_ERRORS;
-      glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-      CHECK_FOR_ERRORS;
-   }
+   volume::LayerGenerator cloud_layers;
+   cloud_layers.initialize(cloud_tex, cloud_size, cloud_size);
+   cloud_layers.generate(cloud_gen_shader);
 
-   glDisableVertexAttribArray(0);
    glActiveTexture(GL_TEXTURE1);
    glBindTexture(GL_TEXTURE_3D, 0);
    glActiveTexture(GL_TEXTURE0);
@@ -694,7 +622,7 @@ void TriangleScene::drawView2(float ltime)
    const double f=(ltime-switch_time)*0.5;
    modelview = Mat4::rotation(-1.5*cubic(clamp(ft,0.0,1.0)), Vec3(1,0,0)) * modelview;
    modelview = Mat4::rotation(-0.4*cubic(clamp((vt-12.0f)*0.2f,0.0f,1.0f)), Vec3(1,0,0)) * modelview;
-   modelview = Mat4::rotation((std::cos(ltime*4.0)*0.03+(randomGridLookup(0,ltime*10.0)-0.5)*0.02) * (cubic(clamp((vt-5.0f)*0.4f,0.0f,1.0f)) - cubic(clamp((vt-10.0f)*1.2f,0.0f,1.0f))), Vec3(0,0,1)) * modelview;
+   modelview = Mat4::rotation((std::cos(ltime*4.0)*0.03+(random_grid.lookup(0,ltime*10.0)-0.5)*0.02) * (cubic(clamp((vt-5.0f)*0.4f,0.0f,1.0f)) - cubic(clamp((vt-10.0f)*1.2f,0.0f,1.0f))), Vec3(0,0,1)) * modelview;
    modelview = Mat4::rotation(-0.1*(cubic(clamp((vt-16.0f)*0.4f,0.0f,1.0f)) - cubic(clamp((vt-20.0f)*0.4f,0.0f,1.0f))), Vec3(0,0,1)) * modelview;
 
 
@@ -826,78 +754,6 @@ void TriangleScene::drawView2(float ltime)
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void TriangleScene::gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0)
-{
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLfloat coords[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glEnableVertexAttribArray(0);
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
-
-   glViewport(0, 0, window_width / 4, window_height / 4);
-
-   // gaussian blur pass 1
-
-   {
-      gaussbokeh_shader.uniform4f("tint", tint_r, tint_g, tint_b, 1.0f);
-   }
-
-   const float gauss_radx = radx;
-   const float gauss_rady = rady;
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo0);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   glDepthMask(GL_FALSE);
-   glDisable(GL_DEPTH_TEST);
-
-   gaussbokeh_shader.bind();
-   gaussbokeh_shader.uniform2f("direction", gauss_radx * float(window_height) / float(window_width), 0.0f);
-
-   glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, src_tex);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-
-
-   // gaussian blur pass 2
-
-   gaussbokeh_shader.uniform4f("tint", 1, 1, 1, 1);
-
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo1);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   gaussbokeh_shader.uniform2f("direction", 0.0f, gauss_rady);
-
-   glBindTexture(GL_TEXTURE_2D, tex0);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-   glDisableVertexAttribArray(0);
-   glDisableVertexAttribArray(1);
-
-   CHECK_FOR_ERRORS;
-}
-
 void TriangleScene::drawView(float ltime)
 {
    lltime = ltime;
@@ -1155,7 +1011,9 @@ void TriangleScene::render()
 
 void TriangleScene::free()
 {
+   releaseWindowTargets();
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
@@ -3,6 +3,8 @@
 #include "Bezier.hpp"
 #include "Ran.hpp"
 #include "Particles.hpp"
+#include "Volume.hpp"
+#include "MotionBlur.hpp"
 
 #include <list>
 
@@ -29,8 +31,8 @@ static double g_ltime=0;
 class TunnelScene: public Scene
 {
    Shader glass_shader, bokeh_shader, bokeh2_shader;
-   Shader gaussbokeh_shader, composite_shader;
-   Shader mb_accum_shader;
+   Shader composite_shader;
+   motionblur::Scheduler motion_blur;
    Shader bgfg_shader;
    Shader tunnel_shader;
    Shader cloud_gen_shader;
@@ -82,9 +84,10 @@ class TunnelScene: public Scene
    static const int cloud_size = 64;
 
    GLuint cloud_tex;
-   GLuint cloud_fbo;
    GLuint cloud_nearest_sampler;
-   float cloud_appear_time;
+   float cloud_appear_time, cloud_generated_time;
+   volume::LayerGenerator cloud_layers;
+   int cloud_refresh, electric_refresh;
 
    GLuint tet_tex;
 
@@ -97,14 +100,13 @@ class TunnelScene: public Scene
    void initElectric();
    void genElectric(float ltime);
    void drawView(float ltime);
-   void gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0);
 
    Vec3 tetrahedronFlyPath(int tet, float ltime);
    Vec3 tetrahedronCrashPath(int tet, float start_time, float ltime);
    Vec3 tetrahedronPath(int tet, float ltime);
    Vec3 smoothTetrahedronPath(int tet, float ltime);
 
-   void generateCloud(float ltime);
+   void generateCloud(float ltime, int num_passes);
    void renderCloud(float ltime);
 
    public:
@@ -256,14 +258,14 @@ void TunnelScene::initializeTextures()
 
    glGenTextures(num_texs, texs);
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
-   createWindowTexture(texs[12], GL_RGBA16F, 2);
-   createWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[12], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[13], GL_RGBA16F, 2);
 
    CHECK_FOR_ERRORS;
 
@@ -363,14 +365,17 @@ void TunnelScene::initializeBuffers()
    glGenFramebuffers(num_fbos, fbos);
    glGenRenderbuffers(num_fbos, renderbuffers);
 
-   cloud_fbo = fbos[1];
    bokeh_temp_fbo = fbos[12];
    electric_fbo = fbos[15];
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   cloud_layers.initialize(cloud_tex, cloud_size, cloud_size);
+   cloud_generated_time = -1;
+
+   cloud_refresh = refreshes.add(cloud_layers.getPassCount(), 0.25f, 0.15f);
+   electric_refresh = refreshes.add(1, 0.5f, 1.0f / 30.0f);
+
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -434,11 +439,8 @@ void TunnelScene::initializeShaders()
    bokeh2_shader.uniform1i("tex2", 1);
    bokeh2_shader.uniform1f("aspect_ratio", float(window_height) / float(window_width));
 
-   gaussbokeh_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "gaussblur_f.glsl");
-   gaussbokeh_shader.uniform1i("tex0", 0);
 
-   mb_accum_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "mb_accum_f.glsl");
-   mb_accum_shader.uniform1i("tex0", 0);
+   motion_blur.loadShaders();
 
 
    composite_shader.load(SHADERS_PATH "generic_v.glsl", NULL, SHADERS_PATH "cubes_composite_f.glsl");
@@ -555,18 +557,8 @@ void TunnelScene::renderCloud(float ltime)
    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 }
 
-void TunnelScene::generateCloud(float ltime)
+void TunnelScene::generateCloud(float ltime, int num_passes)
 {
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cloud_fbo);
-   CHECK_FOR_ERRORS;
-   glViewport(0, 0, cloud_size, cloud_size);
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
    glActiveTexture(GL_TEXTURE1);
    glBindTexture(GL_TEXTURE_3D, noise_tex);
    glActiveTexture(GL_TEXTURE0);
@@ -575,24 +567,16 @@ void TunnelScene::generateCloud(float ltime)
    glDisable(GL_DEPTH_TEST);
    glDepthMask(GL_FALSE);
    glColorMask(GL_TRUE, GL_FALSE, GL_FALSE, GL_FALSE);
-   glEnableVertexAttribArray(0);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
    CHECK_FOR_ERRORS;
 
    cloud_gen_shader.bind();
    cloud_gen_shader.uniform1f("time", ltime);
 
-   for(int z=0;z<cloud_size;++z)
-   {
-      cloud_gen_shader.uniform1i("layer",z);
-      cloud_gen_shader.uniform1f("layerf",float(z)/float(cloud_size));
-      glFramebufferTexture3D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_3D, cloud_tex, 0, z);
-      CHECK_FOR_ERRORS;
-      glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-      CHECK_FOR_ERRORS;
-   }
+   if(num_passes == cloud_layers.getPassCount())
+      cloud_layers.generate(cloud_gen_shader);
+   else
+      cloud_layers.generateNext(cloud_gen_shader, num_passes);
 
-   glDisableVertexAttribArray(0);
    glActiveTexture(GL_TEXTURE1);
    glBindTexture(GL_TEXTURE_3D, 0);
    glActiveTexture(GL_TEXTURE0);
@@ -727,6 +711,8 @@ void TunnelScene::drawView(float ltime)
 
    CHECK_FOR_ERRORS;
 
+   motion_blur.observe(projection, modelview);
+
    glass_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
    tunnel_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
    electric_render_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
@@ -927,78 +913,6 @@ void TunnelScene::drawView(float ltime)
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void TunnelScene::gaussianBlur(Real tint_r, Real tint_g, Real tint_b, Real radx, Real rady, GLuint fbo0, GLuint fbo1, GLuint src_tex, GLuint tex0)
-{
-   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
-   static const GLfloat coords[] = { 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
-   static const GLubyte indices[] = { 3, 0, 2, 1 };
-
-   glEnableVertexAttribArray(0);
-   glEnableVertexAttribArray(1);
-   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
-
-   glViewport(0, 0, window_width / 4, window_height / 4);
-
-   // gaussian blur pass 1
-
-   {
-      gaussbokeh_shader.uniform4f("tint", tint_r, tint_g, tint_b, 1.0f);
-   }
-
-   const float gauss_radx = radx;
-   const float gauss_rady = rady;
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo0);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   glDepthMask(GL_FALSE);
-   glDisable(GL_DEPTH_TEST);
-
-   gaussbokeh_shader.bind();
-   gaussbokeh_shader.uniform2f("direction", gauss_radx * float(window_height) / float(window_width), 0.0f);
-
-   glActiveTexture(GL_TEXTURE0);
-   glBindTexture(GL_TEXTURE_2D, src_tex);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-
-
-   // gaussian blur pass 2
-
-   gaussbokeh_shader.uniform4f("tint", 1, 1, 1, 1);
-
-
-   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo1);
-
-   {
-      GLenum buffers[] = { GL_COLOR_ATTACHMENT0 };
-      glDrawBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
-   }
-
-
-   CHECK_FOR_ERRORS;
-
-   gaussbokeh_shader.uniform2f("direction", 0.0f, gauss_rady);
-
-   glBindTexture(GL_TEXTURE_2D, tex0);
-
-   glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
-
-   glDisableVertexAttribArray(0);
-   glDisableVertexAttribArray(1);
-
-   CHECK_FOR_ERRORS;
-}
-
 
 void TunnelScene::render()
 {
@@ -1031,10 +945,36 @@ void TunnelScene::render()
    }
 
    if(show_cloud)
-      generateCloud(time - cloud_appear_time);
+   {
+      // a new cloud has nothing in common with the last one
+      if(cloud_appear_time != cloud_generated_time)
+      {
+         refreshes.invalidate(cloud_refresh);
+         refreshes.invalidate(electric_refresh);
+         refreshes.schedule(time);
+         cloud_generated_time = cloud_appear_time;
+      }
+
+      if(refreshes.getCount(cloud_refresh) > 0)
+      {
+         refreshes.beginTiming(cloud_refresh);
+         generateCloud(time - cloud_appear_time, refreshes.getCount(cloud_refresh));
+         refreshes.endTiming(cloud_refresh);
+      }
+
+      // there is only one subframe while the cloud is shown, so this is drawn once for the frame
+      if(refreshes.getCount(electric_refresh) > 0)
+      {
+         refreshes.beginTiming(electric_refresh);
+         genElectric(time - cloud_appear_time);
+         refreshes.endTiming(electric_refresh);
+      }
+   }
 
    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
+   motion_blur.beginFrame(time, window_width, window_height);
+
    for(int nn = 0; nn < 2; ++nn)
    {
 //if(drawing_view_for_background) continue; // **********************************************************************************
@@ -1050,20 +990,14 @@ void TunnelScene::render()
       if(show_cloud)
          num_subframes = drawing_view_for_background ? 1 : 1;
       else
-         num_subframes = drawing_view_for_background ? 2 : 7;
+         num_subframes = drawing_view_for_background ? 2 : motion_blur.getSubframeCount();
 
-      subframe_scale = 1.0/35.0;
+      subframe_scale = motion_blur.getShutter();
 
       for(int subframe = 0;subframe<num_subframes;++subframe)
       {
          const float ltime = time + subframe_scale * float(subframe) / float(num_subframes);
 
-         if(show_cloud)
-         {
-            // do the electricty
-            genElectric(ltime-cloud_appear_time);
-         }
-
          // draw the view
 
          glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[6]);
@@ -1080,9 +1014,7 @@ void TunnelScene::render()
 
          glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[3]);
 
-         mb_accum_shader.bind();
-         mb_accum_shader.uniform1f("time", float(subframe) / float(num_subframes));
-         mb_accum_shader.uniform1f("scale", 1.0f / float(num_subframes));
+         motion_blur.bindAccumulation(num_subframes);
 
          glDepthMask(GL_FALSE);
          glDisable(GL_DEPTH_TEST);
@@ -1237,8 +1169,12 @@ void TunnelScene::render()
 
 void TunnelScene::free()
 {
+   releaseWindowTargets();
+   refreshes.clear();
+   cloud_layers.free();
    glDeleteTextures(1,&tet_tex);
    glDeleteTextures(num_texs, texs);
    glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
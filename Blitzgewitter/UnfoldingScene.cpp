@@ -53,6 +53,22 @@ struct Quad
    void build(Quad* target, int edge, int face, float angle, float time, float speed) const;
 
    static void rotateQuadGeometry(const QuadGeometry& in, const int edge, const float angle, QuadGeometry& out);
+
+   // The orthonormal frame of the given edge, with v0 on the edge and e0 along it.
+   static void pivotFrame(const QuadGeometry& in, const int edge, Vec3& v0, Vec3& e0, Vec3& e1, Vec3& e2);
+};
+
+// The data for one instance of the quad draw, as laid out in the vertex attributes. The corners
+// of the quad are given in the frame of its pivot edge, so that the vertex shader only needs to
+// turn the frame by the pivot angle.
+struct QuadInstance
+{
+   GLfloat pivot[3], start_time;
+   GLfloat e0[3], end_time;
+   GLfloat e1[3], start_angle;
+   GLfloat e2[3], end_angle;
+   GLfloat local_x[4], local_y[4], local_z[4];
+   GLfloat local_normal[4];
 };
 
 class UnfoldingScene: public Scene
@@ -75,6 +91,9 @@ class UnfoldingScene: public Scene
    Quad quads[1024];
    Quad* next_quad;
 
+   GLuint quads_vbo, quad_corners_vbo;
+   int num_quad_instances;
+
    void initializeTextures();
    void initializeShaders();
    void initializeBuffers();
@@ -87,7 +106,8 @@ class UnfoldingScene: public Scene
 
    void drawView(float ltime);
 
-   void renderQuad(const Quad& quad, const float time);
+   void initializeQuadBuffer();
+   void renderQuads(const float time);
    void buildStrip(const Quad* base, float time, const char*& c);
    void createStrip(const char* cmds, const Vec3& offset, const float time, const Mat4& transform);
 
@@ -97,6 +117,9 @@ class UnfoldingScene: public Scene
          for(int i=0;i<num_credits;++i)
             credit_texs[i]=0;
          next_quad = quads;
+         quads_vbo = 0;
+         quad_corners_vbo = 0;
+         num_quad_instances = 0;
       }
 
       ~UnfoldingScene()
@@ -140,19 +163,26 @@ void UnfoldingScene::slowInitialize()
  }
 
 
-void Quad::rotateQuadGeometry(const QuadGeometry& in, const int edge, const float angle, QuadGeometry& out)
+void Quad::pivotFrame(const QuadGeometry& in, const int edge, Vec3& v0, Vec3& e0, Vec3& e1, Vec3& e2)
 {
    static const int emap[7] = { 0, 1, 3, 2, 0, 1, 3 };
 
-   const Vec3& v0 = in.points[emap[edge + 0]];
+   v0 = in.points[emap[edge + 0]];
    const Vec3& v1 = in.points[emap[edge + 1]];
    const Vec3& v2 = in.points[emap[edge + 3]];
 
-   Vec3 e0 = normalize(v1 - v0);
-   Vec3 e1 = v2 - v0;
-   Vec3 e2 = normalize(e0.cross(e1));
+   e0 = normalize(v1 - v0);
+   e1 = v2 - v0;
+   e2 = normalize(e0.cross(e1));
 
    e1 = normalize(e0.cross(e2));
+}
+
+void Quad::rotateQuadGeometry(const QuadGeometry& in, const int edge, const float angle, QuadGeometry& out)
+{
+   Vec3 v0, e0, e1, e2;
+
+   pivotFrame(in, edge, v0, e0, e1, e2);
 
    for(int i = 0; i < 4; ++i)
    {
@@ -190,63 +220,115 @@ void Quad::build(Quad* target, int edge, int face, float angle, float time, floa
 
 
 
-void UnfoldingScene::renderQuad(const Quad& quad, const float time)
+void UnfoldingScene::initializeQuadBuffer()
 {
-   if(time < quad.start_time)
-      return;
+   std::vector<QuadInstance> instances;
 
-   QuadGeometry rotated_geom;
+   for(const Quad* q = quads; q < next_quad; ++q)
+   {
+      QuadInstance qi;
 
-   const float bias = std::min(1.0f, (time - quad.start_time) / (quad.end_time - quad.start_time));
-   const float angle = quad.start_angle + bias * (quad.end_angle - quad.start_angle);
+      Vec3 v0(0, 0, 0), e0(1, 0, 0), e1(0, 1, 0), e2(0, 0, 1);
 
-   if(quad.edge == -1 || time >= quad.end_time)
-      rotated_geom = quad.geometry;
-   else
-      Quad::rotateQuadGeometry(quad.geometry, quad.edge, angle, rotated_geom);
+      if(q->edge != -1)
+         Quad::pivotFrame(q->geometry, q->edge, v0, e0, e1, e2);
 
-   GLfloat verts[4 * 3] = { 0 };
-   GLfloat norms[4 * 3] = { 0 };
-   GLfloat colours[4 * 3] = { 0 };
+      const Vec3 normal = normalize((q->geometry.points[1] - q->geometry.points[0]).cross(q->geometry.points[2] - q->geometry.points[0]));
 
-   for(int i = 0; i < 4; ++i)
-   {
-      verts[i * 3 + 0] = rotated_geom.points[i].x;
-      verts[i * 3 + 1] = rotated_geom.points[i].y;
-      verts[i * 3 + 2] = rotated_geom.points[i].z;
+      for(int i = 0; i < 3; ++i)
+      {
+         qi.pivot[i] = v0[i];
+         qi.e0[i] = e0[i];
+         qi.e1[i] = e1[i];
+         qi.e2[i] = e2[i];
+      }
+
+      qi.start_time = q->start_time;
+
+      if(q->edge == -1)
+      {
+         qi.end_time = q->start_time;
+         qi.start_angle = 0.0f;
+         qi.end_angle = 0.0f;
+      }
+      else
+      {
+         qi.end_time = q->end_time;
+         qi.start_angle = q->start_angle;
+         qi.end_angle = q->end_angle;
+      }
+
+      for(int i = 0; i < 4; ++i)
+      {
+         const Vec3 d = q->geometry.points[i] - v0;
+         qi.local_x[i] = d.dot(e0);
+         qi.local_y[i] = d.dot(e1);
+         qi.local_z[i] = d.dot(e2);
+      }
+
+      qi.local_normal[0] = normal.dot(e0);
+      qi.local_normal[1] = normal.dot(e1);
+      qi.local_normal[2] = normal.dot(e2);
+      qi.local_normal[3] = 0.0f;
+
+      instances.push_back(qi);
    }
 
-   const Vec3 normal = normalize((rotated_geom.points[1] - rotated_geom.points[0]).cross(rotated_geom.points[2] - rotated_geom.points[0]));
-   const Vec3 base_normal = normalize((quad.geometry.points[1] - quad.geometry.points[0]).cross(quad.geometry.points[2] - quad.geometry.points[0]));
+   num_quad_instances = instances.size();
 
-   for(int i = 0; i < 4; ++i)
+   glGenBuffers(1, &quads_vbo);
+   glBindBuffer(GL_ARRAY_BUFFER, quads_vbo);
+   glBufferData(GL_ARRAY_BUFFER, num_quad_instances * sizeof(QuadInstance), instances.empty() ? 0 : &instances[0], GL_STATIC_DRAW);
+
+   // the index of each corner, as a per-vertex array at attribute 0. A compatibility context may
+   // draw nothing unless array 0 is enabled.
+   static const GLfloat corners[4] = { 0, 1, 2, 3 };
+
+   glGenBuffers(1, &quad_corners_vbo);
+   glBindBuffer(GL_ARRAY_BUFFER, quad_corners_vbo);
+   glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   CHECK_FOR_ERRORS;
+}
+
+// Draws every quad with one instanced draw. The pivot angles are worked out in the vertex shader.
+void UnfoldingScene::renderQuads(const float time)
+{
+   static const int num_attribs = 8;
+   static const GLsizei offsets[num_attribs] = { 0, 4, 8, 12, 16, 20, 24, 28 };
+   static const GLint sizes[num_attribs] = { 4, 4, 4, 4, 4, 4, 4, 3 };
+
+   logo_shader.uniform1f("time", time);
+
+   glBindBuffer(GL_ARRAY_BUFFER, quad_corners_vbo);
+   glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, 0, 0);
+   glEnableVertexAttribArray(0);
+
+   glBindBuffer(GL_ARRAY_BUFFER, quads_vbo);
+
+   for(int i = 0; i < num_attribs; ++i)
    {
-      norms[i * 3 + 0] = normal.x;
-      norms[i * 3 + 1] = normal.y;
-      norms[i * 3 + 2] = normal.z;
+      glVertexAttribPointer(3 + i, sizes[i], GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (const GLvoid*)(offsets[i] * sizeof(GLfloat)));
+      glVertexAttribDivisor(3 + i, 1);
+      glEnableVertexAttribArray(3 + i);
    }
 
-   for(int i = 0; i < 4; ++i)
+   glVertexAttrib3f(2, 0.3f, 0.3f, 0.3f);
+
+   glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, num_quad_instances);
+
+   glDisableVertexAttribArray(0);
+
+   for(int i = 0; i < num_attribs; ++i)
    {
-      colours[i * 3 + 0] = 0.3f;
-      colours[i * 3 + 1] = 0.3f;
-      colours[i * 3 + 2] = 0.3f;
+      glDisableVertexAttribArray(3 + i);
+      glVertexAttribDivisor(3 + i, 0);
    }
 
    glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-   glVertexAttribPointer(0, 3, GL_FLOAT, false, 0, verts);
-   glVertexAttribPointer(1, 3, GL_FLOAT, false, 0, norms);
-   glVertexAttribPointer(2, 3, GL_FLOAT, false, 0, colours);
 
-   glEnableVertexAttribArray(0);
-   glEnableVertexAttribArray(1);
-   glEnableVertexAttribArray(2);
-   glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-   glDisableVertexAttribArray(0);
-   glDisableVertexAttribArray(1);
-   glDisableVertexAttribArray(2);
+   CHECK_FOR_ERRORS;
 }
 
 
@@ -324,14 +406,14 @@ void UnfoldingScene::initializeTextures()
 {
    glGenTextures(num_texs, texs);
 
-   createWindowTexture(texs[0], GL_RGBA16F);
-   createWindowTexture(texs[2], GL_RGBA16F);
-   createWindowTexture(texs[4], GL_RGBA16F, 4);
-   createWindowTexture(texs[5], GL_RGBA16F, 4);
-   createWindowTexture(texs[6], GL_RGBA16F);
-   createWindowTexture(texs[9], GL_RGBA16F, 4);
-   createWindowTexture(texs[12], GL_RGBA16F, 2);
-   createWindowTexture(texs[13], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[0], GL_RGBA16F);
+   acquireWindowTexture(texs[2], GL_RGBA16F);
+   acquireWindowTexture(texs[4], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[5], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[6], GL_RGBA16F);
+   acquireWindowTexture(texs[9], GL_RGBA16F, 4);
+   acquireWindowTexture(texs[12], GL_RGBA16F, 2);
+   acquireWindowTexture(texs[13], GL_RGBA16F, 2);
 
    CHECK_FOR_ERRORS;
 
@@ -369,10 +451,8 @@ void UnfoldingScene::initializeBuffers()
    glGenFramebuffers(num_fbos, fbos);
    glGenRenderbuffers(num_fbos, renderbuffers);
 
-   glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, window_width, window_height);
+   acquireWindowRenderbuffer(renderbuffers[1], GL_DEPTH_COMPONENT24);
    CHECK_FOR_ERRORS;
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[0]);
    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texs[0], 0);
@@ -440,6 +520,7 @@ void UnfoldingScene::initialize()
 
    initializeTextures();
    initializeBuffers();
+   initializeQuadBuffer();
 }
 
 void UnfoldingScene::update()
@@ -448,6 +529,12 @@ void UnfoldingScene::update()
 
 void UnfoldingScene::free()
 {
+   releaseWindowTargets();
+   glDeleteBuffers(1, &quads_vbo);
+   glDeleteBuffers(1, &quad_corners_vbo);
+   glDeleteTextures(num_texs, texs);
+   glDeleteFramebuffers(num_fbos, fbos);
+   glDeleteRenderbuffers(num_fbos, renderbuffers);
 }
 
 void UnfoldingScene::drawView(float ltime)
@@ -489,10 +576,7 @@ void UnfoldingScene::drawView(float ltime)
    glBindTexture(GL_TEXTURE_2D, noise_tex_2d);
 
 
-   for(Quad* q = quads; q < next_quad; ++q)
-   {
-      renderQuad(q[0], ltime*1.5);
-   }
+   renderQuads(ltime*1.5);
 
    {
       glDisable(GL_DEPTH_TEST);
@@ -0,0 +1,84 @@
+#include "Volume.hpp"
+
+using namespace volume;
+
+void LayerGenerator::initialize(GLuint texture, int texture_size, int texture_depth)
+{
+   assert(texture_depth % layers_per_pass == 0);
+
+   free();
+
+   tex = texture;
+   size = texture_size;
+   depth = texture_depth;
+   next_pass = 0;
+
+   fbos.resize(depth / layers_per_pass);
+   glGenFramebuffers(fbos.size(), &fbos[0]);
+
+   for(size_t p = 0; p < fbos.size(); ++p)
+   {
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[p]);
+
+      for(int i = 0; i < layers_per_pass; ++i)
+         glFramebufferTexture3D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_3D, tex, 0, p * layers_per_pass + i);
+
+      assert(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+   }
+
+   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+   CHECK_FOR_ERRORS;
+}
+
+void LayerGenerator::free()
+{
+   if(!fbos.empty())
+      glDeleteFramebuffers(fbos.size(), &fbos[0]);
+
+   fbos.clear();
+}
+
+void LayerGenerator::generate(Shader& shader)
+{
+   runPasses(shader, 0, getPassCount());
+   next_pass = 0;
+}
+
+void LayerGenerator::generateNext(Shader& shader, int num_passes)
+{
+   num_passes = std::min(num_passes, getPassCount());
+
+   while(num_passes > 0)
+   {
+      const int n = std::min(num_passes, getPassCount() - next_pass);
+      runPasses(shader, next_pass, n);
+      next_pass = (next_pass + n) % getPassCount();
+      num_passes -= n;
+   }
+}
+
+void LayerGenerator::runPasses(Shader& shader, int first_pass, int num_passes)
+{
+   static const GLfloat vertices[] = { -1.0f, -1.0f, +1.0f, -1.0f, +1.0f, +1.0f, -1.0f, +1.0f };
+   static const GLubyte indices[] = { 3, 0, 2, 1 };
+
+   static const GLenum buffers[layers_per_pass] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3,
+                                                    GL_COLOR_ATTACHMENT4, GL_COLOR_ATTACHMENT5, GL_COLOR_ATTACHMENT6, GL_COLOR_ATTACHMENT7 };
+
+   glViewport(0, 0, size, size);
+   glEnableVertexAttribArray(0);
+   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, vertices);
+
+   shader.uniform1i("num_layers", depth);
+
+   for(int p = first_pass; p < first_pass + num_passes; ++p)
+   {
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[p]);
+      glDrawBuffers(layers_per_pass, buffers);
+      shader.uniform1i("first_layer", p * layers_per_pass);
+      glDrawRangeElements(GL_TRIANGLE_STRIP, 0, 3, 4, GL_UNSIGNED_BYTE, indices);
+   }
+
+   glDisableVertexAttribArray(0);
+   CHECK_FOR_ERRORS;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Engine.hpp"
+
+namespace volume
+{
+
+// Fills a 3D texture whose layers are computed in order, each one from the layer before it,
+// such as a transmittance volume. Each pass draws one full-screen quad into layers_per_pass
+// consecutive layers at once, which are attached to the colour outputs of a framebuffer made
+// up front, so no attachments change while generating.
+//
+// The shader is bound by the caller with its own uniforms, and gets "first_layer" and
+// "num_layers". It writes layer first_layer+i to output i, and can read layer first_layer-1
+// from the texture itself since that layer is not attached.
+class LayerGenerator
+{
+   public:
+      static const int layers_per_pass = 8;
+
+      LayerGenerator(): tex(0), size(0), depth(0), next_pass(0)
+      {
+      }
+
+      ~LayerGenerator()
+      {
+         free();
+      }
+
+      // The depth must be a multiple of layers_per_pass.
+      void initialize(GLuint tex, int size, int depth);
+      void free();
+
+      int getPassCount() const { return int(fbos.size()); }
+
+      void generate(Shader& shader);
+
+      // Runs num_passes of the passes, carrying on from where the last call left off, so that
+      // the whole volume is refreshed every getPassCount() / num_passes calls. Each pass then
+      // reads the layer before it as it was when that layer was last refreshed.
+      void generateNext(Shader& shader, int num_passes);
+
+   private:
+      GLuint tex;
+      int size, depth;
+      int next_pass;
+      std::vector<GLuint> fbos;
+
+      void runPasses(Shader& shader, int first_pass, int num_passes);
+};
+
+}
@@ -0,0 +1,463 @@
+#include "Voronoi.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace voronoi;
+
+namespace
+{
+
+struct Point
+{
+   double x, y;
+
+   Point()
+   {
+   }
+
+   Point(double x, double y): x(x), y(y)
+   {
+   }
+};
+
+// The vertices run counter-clockwise, and n[k] is the triangle across the edge from v[k] to
+// v[(k + 1) % 3], or -1 on the outside of the triangulation.
+struct Triangle
+{
+   int v[3], n[3];
+   double cx, cy, r2;
+};
+
+// An edge of the hole left by removing the triangles around a new point, the triangle outside
+// it, and the new triangle which fills the hole on it.
+struct CavityEdge
+{
+   int a, b, outside, triangle;
+};
+
+typedef std::vector<Point> Polygon;
+
+// Keeps the part of the polygon where a*x+b*y <= c.
+void clipPolygon(Polygon& poly, Polygon& temp, double a, double b, double c)
+{
+   temp.clear();
+
+   const int n = poly.size();
+   for(int i = 0; i < n; ++i)
+   {
+      const Point& p = poly[i];
+      const Point& q = poly[(i + 1) % n];
+
+      const double dp = a * p.x + b * p.y - c;
+      const double dq = a * q.x + b * q.y - c;
+
+      if(dp <= 0)
+         temp.push_back(p);
+
+      if((dp < 0 && dq > 0) || (dp > 0 && dq < 0))
+      {
+         const double t = dp / (dp - dq);
+         temp.push_back(Point(p.x + (q.x - p.x) * t, p.y + (q.y - p.y) * t));
+      }
+   }
+
+   poly.swap(temp);
+}
+
+void clipToUnitSquare(Polygon& poly, Polygon& temp)
+{
+   clipPolygon(poly, temp, -1, 0, 0);
+   clipPolygon(poly, temp, +1, 0, 1);
+   clipPolygon(poly, temp, 0, -1, 0);
+   clipPolygon(poly, temp, 0, +1, 1);
+}
+
+double polygonArea(const Polygon& poly)
+{
+   double a = 0;
+   const int n = poly.size();
+   for(int i = 0; i < n; ++i)
+   {
+      const Point& p = poly[i];
+      const Point& q = poly[(i + 1) % n];
+      a += p.x * q.y - q.x * p.y;
+   }
+   return a * 0.5;
+}
+
+void appendCell(Diagram& diagram, const Vec2& site, const Polygon& poly)
+{
+   const int first_edge = diagram.getEdgeCount();
+   const int n = poly.size();
+
+   for(int i = 0; i < n; ++i)
+   {
+      const Point& p = poly[i];
+      const Point& q = poly[(i + 1) % n];
+
+      if((q.x - p.x) * (q.x - p.x) + (q.y - p.y) * (q.y - p.y) > 1e-8)
+      {
+         diagram.edges.push_back(p.x);
+         diagram.edges.push_back(p.y);
+         diagram.edges.push_back(q.x);
+         diagram.edges.push_back(q.y);
+      }
+   }
+
+   if(diagram.getEdgeCount() > first_edge)
+   {
+      diagram.sites.push_back(site);
+      diagram.first_edges.push_back(first_edge);
+      diagram.edge_counts.push_back(diagram.getEdgeCount() - first_edge);
+   }
+}
+
+Triangle makeTriangle(const std::vector<Point>& points, int a, int b, int c)
+{
+   Triangle t;
+   t.v[0] = a;
+   t.v[1] = b;
+   t.v[2] = c;
+   t.n[0] = t.n[1] = t.n[2] = -1;
+
+   const Point& p0 = points[a];
+   const double bx = points[b].x - p0.x, by = points[b].y - p0.y;
+   const double cx = points[c].x - p0.x, cy = points[c].y - p0.y;
+   const double d = 2 * (bx * cy - by * cx);
+   const double b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+   const double ux = (cy * b2 - by * c2) / d, uy = (bx * c2 - cx * b2) / d;
+
+   t.cx = p0.x + ux;
+   t.cy = p0.y + uy;
+   t.r2 = ux * ux + uy * uy;
+   return t;
+}
+
+double orient(const Point& a, const Point& b, const Point& c)
+{
+   return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+bool inCircumcircle(const Triangle& t, const Point& p)
+{
+   const double dx = p.x - t.cx, dy = p.y - t.cy;
+   return dx * dx + dy * dy < t.r2;
+}
+
+// Finds the triangle containing p by walking towards it from the triangle start, or returns
+// -1 if the walk leaves the triangulation or doesn't arrive.
+int locate(const std::vector<Triangle>& triangles, const std::vector<Point>& points, int start, const Point& p)
+{
+   int t = start;
+
+   for(size_t steps = 0; steps < triangles.size(); ++steps)
+   {
+      const Triangle& tri = triangles[t];
+      int next = t;
+
+      for(int k = 0; k < 3; ++k)
+         if(orient(points[tri.v[k]], points[tri.v[(k + 1) % 3]], p) < 0)
+         {
+            next = tri.n[k];
+            break;
+         }
+
+      if(next == t)
+         return t;
+
+      if(next < 0)
+         return -1;
+
+      t = next;
+   }
+
+   return -1;
+}
+
+struct RowOrder
+{
+   const Point* points;
+   int rows;
+
+   int row(int i) const
+   {
+      return std::min(rows - 1, std::max(0, int(points[i].y * rows)));
+   }
+
+   // left to right on even rows and right to left on odd ones, so that each site is near the last
+   bool operator()(int a, int b) const
+   {
+      const int ra = row(a), rb = row(b);
+
+      if(ra != rb)
+         return ra < rb;
+
+      return (ra & 1) ? points[a].x > points[b].x : points[a].x < points[b].x;
+   }
+};
+
+// Angle of (x,y) mapped monotonically onto [0,4), without trigonometry.
+double pseudoAngle(double x, double y)
+{
+   const double p = x / (std::abs(x) + std::abs(y));
+   return y < 0 ? 3 + p : 1 - p;
+}
+
+struct AngleOrder
+{
+   const double* angles;
+
+   bool operator()(int a, int b) const
+   {
+      return angles[a] < angles[b];
+   }
+};
+
+}
+
+void Diagram::clear()
+{
+   sites.clear();
+   first_edges.clear();
+   edge_counts.clear();
+   edges.clear();
+}
+
+void voronoi::build(Diagram& diagram, const Vec2* sites, int num_sites)
+{
+   diagram.clear();
+
+   // Four distant sites surround the others so that every site is an interior vertex of the
+   // triangulation. Their cells lie entirely outside the unit square, so they don't change the
+   // clipped cells of the real sites.
+   std::vector<Point> points(num_sites + 4);
+   for(int i = 0; i < num_sites; ++i)
+      points[i] = Point(sites[i].x, sites[i].y);
+
+   points[num_sites + 0] = Point(-10, -10);
+   points[num_sites + 1] = Point(+11, -10);
+   points[num_sites + 2] = Point(+11, +11);
+   points[num_sites + 3] = Point(-10, +11);
+
+   std::vector<Triangle> triangles;
+   triangles.push_back(makeTriangle(points, num_sites + 0, num_sites + 1, num_sites + 2));
+   triangles.push_back(makeTriangle(points, num_sites + 0, num_sites + 2, num_sites + 3));
+   triangles[0].n[2] = 1;
+   triangles[1].n[0] = 0;
+
+   // inserting the sites in rows keeps the walk to each one from the last short
+   std::vector<int> order(num_sites);
+   for(int i = 0; i < num_sites; ++i)
+      order[i] = i;
+
+   RowOrder row_order = { &points[0], std::max(1, int(std::sqrt(num_sites * 0.5))) };
+   std::sort(order.begin(), order.end(), row_order);
+
+   std::vector<int> visited(triangles.size(), -1), removed, stack;
+   std::vector<CavityEdge> cavity;
+   int last = 0;
+
+   for(int j = 0; j < num_sites; ++j)
+   {
+      const int i = order[j];
+      const Point& p = points[i];
+
+      int start = locate(triangles, points, last, p);
+
+      // the walk can only fail on degenerate input, so then any triangle will do
+      if(start < 0 || !inCircumcircle(triangles[start], p))
+      {
+         start = -1;
+         for(size_t t = 0; t < triangles.size() && start < 0; ++t)
+            if(inCircumcircle(triangles[t], p))
+               start = t;
+
+         if(start < 0)
+            continue;
+      }
+
+      // remove the triangles whose circumcircles contain the new point, which are connected,
+      // and keep the edges around them
+      removed.clear();
+      cavity.clear();
+      stack.clear();
+
+      stack.push_back(start);
+      visited[start] = i;
+
+      while(!stack.empty())
+      {
+         const int t = stack.back();
+         stack.pop_back();
+         removed.push_back(t);
+
+         const Triangle& tri = triangles[t];
+
+         for(int k = 0; k < 3; ++k)
+         {
+            const int n = tri.n[k];
+
+            if(n >= 0 && visited[n] == i)
+               continue;
+
+            if(n >= 0 && inCircumcircle(triangles[n], p))
+            {
+               visited[n] = i;
+               stack.push_back(n);
+            }
+            else
+            {
+               const CavityEdge e = { tri.v[k], tri.v[(k + 1) % 3], n, -1 };
+               cavity.push_back(e);
+            }
+         }
+      }
+
+      // fill the hole with a fan of triangles around the new point, reusing the removed ones
+      for(size_t e = 0; e < cavity.size(); ++e)
+      {
+         int t;
+
+         if(e < removed.size())
+            t = removed[e];
+         else
+         {
+            t = triangles.size();
+            triangles.push_back(Triangle());
+            visited.push_back(-1);
+         }
+
+         const CavityEdge& c = cavity[e];
+         triangles[t] = makeTriangle(points, c.a, c.b, i);
+         triangles[t].n[0] = c.outside;
+
+         // found by its vertices, as the removed triangle's index may already have been reused
+         if(c.outside >= 0)
+            for(int k = 0; k < 3; ++k)
+               if(triangles[c.outside].v[k] == c.b)
+                  triangles[c.outside].n[k] = t;
+
+         cavity[e].triangle = t;
+      }
+
+      // the new triangle on the edge (a, b) meets the one starting at b, and the one ending at a
+      for(size_t e = 0; e < cavity.size(); ++e)
+         for(size_t f = 0; f < cavity.size(); ++f)
+         {
+            if(cavity[f].a == cavity[e].b)
+               triangles[cavity[e].triangle].n[1] = cavity[f].triangle;
+
+            if(cavity[f].b == cavity[e].a)
+               triangles[cavity[e].triangle].n[2] = cavity[f].triangle;
+         }
+
+      last = cavity[0].triangle;
+   }
+
+   // the triangles around each site, by counting sort
+   std::vector<int> site_first(num_sites + 1, 0);
+   for(size_t t = 0; t < triangles.size(); ++t)
+      for(int k = 0; k < 3; ++k)
+         if(triangles[t].v[k] < num_sites)
+            ++site_first[triangles[t].v[k] + 1];
+
+   for(int i = 0; i < num_sites; ++i)
+      site_first[i + 1] += site_first[i];
+
+   std::vector<int> site_triangles(site_first[num_sites]);
+   {
+      std::vector<int> fill(site_first.begin(), site_first.end() - 1);
+      for(size_t t = 0; t < triangles.size(); ++t)
+         for(int k = 0; k < 3; ++k)
+            if(triangles[t].v[k] < num_sites)
+               site_triangles[fill[triangles[t].v[k]]++] = t;
+   }
+
+   // each cell is the polygon of the circumcentres of the triangles around its site
+   std::vector<Polygon> cells(num_sites);
+   std::vector<double> angles(triangles.size());
+   Polygon temp;
+   double area = 0;
+
+   for(int i = 0; i < num_sites; ++i)
+   {
+      int* const first = &site_triangles[0] + site_first[i];
+      int* const last = &site_triangles[0] + site_first[i + 1];
+
+      if(last - first < 3)
+         continue;
+
+      for(int* t = first; t != last; ++t)
+         angles[*t] = pseudoAngle(triangles[*t].cx - points[i].x, triangles[*t].cy - points[i].y);
+
+      AngleOrder order = { &angles[0] };
+      std::sort(first, last, order);
+
+      Polygon& poly = cells[i];
+      for(int* t = first; t != last; ++t)
+         poly.push_back(Point(triangles[*t].cx, triangles[*t].cy));
+
+      clipToUnitSquare(poly, temp);
+      area += polygonArea(poly);
+   }
+
+   // the cells tile the square exactly unless the triangulation has gone wrong, which can only
+   // happen with coincident or otherwise degenerate sites
+   if(std::abs(area - 1.0) > 1e-6)
+   {
+      clipCells(diagram, sites, num_sites);
+      return;
+   }
+
+   for(int i = 0; i < num_sites; ++i)
+      appendCell(diagram, sites[i], cells[i]);
+}
+
+void voronoi::clipCells(Diagram& diagram, const Vec2* sites, int num_sites)
+{
+   diagram.clear();
+
+   std::vector<Polygon> cells(num_sites);
+
+#pragma omp parallel for
+   for(int i = 0; i < num_sites; ++i)
+   {
+      Polygon& poly = cells[i];
+      Polygon temp;
+
+      poly.push_back(Point(0, 0));
+      poly.push_back(Point(1, 0));
+      poly.push_back(Point(1, 1));
+      poly.push_back(Point(0, 1));
+
+      const double sx = sites[i].x, sy = sites[i].y;
+
+      // the furthest any point of the cell is from the site, squared
+      double reach2 = 0;
+      for(size_t k = 0; k < poly.size(); ++k)
+         reach2 = std::max(reach2, (poly[k].x - sx) * (poly[k].x - sx) + (poly[k].y - sy) * (poly[k].y - sy));
+
+      for(int j = 0; j < num_sites && !poly.empty(); ++j)
+      {
+         if(j == i)
+            continue;
+
+         const double dx = sites[j].x - sx, dy = sites[j].y - sy;
+         const double d2 = dx * dx + dy * dy;
+
+         // a bisector further away than the whole cell can't cut it
+         if(d2 * 0.25 >= reach2)
+            continue;
+
+         clipPolygon(poly, temp, dx, dy, (sx + dx * 0.5) * dx + (sy + dy * 0.5) * dy);
+
+         reach2 = 0;
+         for(size_t k = 0; k < poly.size(); ++k)
+            reach2 = std::max(reach2, (poly[k].x - sx) * (poly[k].x - sx) + (poly[k].y - sy) * (poly[k].y - sy));
+      }
+   }
+
+   for(int i = 0; i < num_sites; ++i)
+      appendCell(diagram, sites[i], cells[i]);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Engine.hpp"
+#include <vector>
+
+namespace voronoi
+{
+
+// A Voronoi diagram clipped to the unit square. The edges are stored as one flat array of
+// x0,y0,x1,y1 values, and the edges of each cell are contiguous and run counter-clockwise.
+// Sites whose cells don't reach into the unit square have no cell.
+struct Diagram
+{
+   std::vector<Vec2> sites;
+   std::vector<int> first_edges, edge_counts;
+   std::vector<Real> edges;
+
+   int getCellCount() const { return int(sites.size()); }
+   int getEdgeCount() const { return int(edges.size() / 4); }
+
+   Vec2 edgeStart(int e) const { return Vec2(edges[e * 4 + 0], edges[e * 4 + 1]); }
+   Vec2 edgeEnd(int e) const { return Vec2(edges[e * 4 + 2], edges[e * 4 + 3]); }
+
+   void clear();
+};
+
+// Builds the diagram as the dual of an incrementally constructed Delaunay triangulation.
+// If the triangulation turns out degenerate, the diagram is built with clipCells instead.
+void build(Diagram& diagram, const Vec2* sites, int num_sites);
+
+// Builds each cell independently, and in parallel, by clipping the unit square against
+// the bisectors between its site and the others.
+void clipCells(Diagram& diagram, const Vec2* sites, int num_sites);
+
+}
@@ -1,5 +1,6 @@
 
 #include "Engine.hpp"
+#include "RenderTargets.hpp"
 
 
 #include <SDL/SDL.h>
@@ -447,6 +448,8 @@ int main(int argc, char** argv)
 
    unsigned long manual_music_time_offset = 0;
 
+   uint num_frames = 0;
+
 
    while(!finished)
    {
@@ -497,6 +500,9 @@ int main(int argc, char** argv)
             scene->initialize();
          }
 
+         // the new scene has taken what it wants of the previous scene's targets
+         targets::trim();
+
          t_offset = t;
 
          ++sc;
@@ -524,12 +530,16 @@ int main(int argc, char** argv)
          }
 
          scene->frame_num = (t - t_offset + bbb) / 10;
+         scene->refreshes.schedule(scene->time);
          scene->render();
       }
 
 
       SDL_GL_SwapBuffers();
 
+      Shader::endFrame();
+      ++num_frames;
+
       {
          char str[256];
          //snprintf(str, sizeof(str), "%d", t);
@@ -541,6 +551,12 @@ int main(int argc, char** argv)
       }
    }
 
+   if(num_frames > 0)
+   {
+      const Shader::Stats& stats = Shader::getTotalStats();
+      log("Uniform calls per frame: %.1f sent, %.1f skipped.\n", double(stats.sent) / num_frames, double(stats.skipped) / num_frames);
+   }
+
    fclose(g_logfile);
 
     BASS_Free();
@@ -2,10 +2,11 @@
 
 uniform sampler3D tex0;
 uniform sampler3D noise_tex;
-uniform int layer;
-uniform float layerf;
+uniform int first_layer;
+uniform int num_layers;
 
-out vec4 output_colour;
+// one output per layer, see volume::LayerGenerator
+layout(location = 0) out float output_layers[8];
 
 noperspective in vec2 v2f_coord;
 
@@ -16,18 +17,25 @@ float density(vec3 p)
 }
 
 
-void main()
+float layerTransmittance(int i)
 {
     float x=0.26;
-    if(layer == 0)
-    {
-        float f=density(vec3(v2f_coord, 1.0-layerf));
-        output_colour.r=exp(-f*x);
-    }
-    else
-    {
-        float f=density(vec3(v2f_coord, 1.0-layerf));
-        float a=texelFetch(tex0, ivec3(ivec2(gl_FragCoord.xy), layer - 1), 0).r;
-        output_colour.r=a*exp(-f*x);
-    }
+    float f=density(vec3(v2f_coord, 1.0-(float(first_layer + i) / float(num_layers))));
+    return exp(-f*x);
+}
+
+void main()
+{
+    float a=1.0;
+    if(first_layer > 0)
+        a=texelFetch(tex0, ivec3(ivec2(gl_FragCoord.xy), first_layer - 1), 0).r;
+
+    a*=layerTransmittance(0); output_layers[0]=a;
+    a*=layerTransmittance(1); output_layers[1]=a;
+    a*=layerTransmittance(2); output_layers[2]=a;
+    a*=layerTransmittance(3); output_layers[3]=a;
+    a*=layerTransmittance(4); output_layers[4]=a;
+    a*=layerTransmittance(5); output_layers[5]=a;
+    a*=layerTransmittance(6); output_layers[6]=a;
+    a*=layerTransmittance(7); output_layers[7]=a;
 }
@@ -0,0 +1,21 @@
+#version 330
+
+uniform sampler2D tex0;
+uniform float scale;
+uniform vec2 smear;
+
+noperspective in vec2 v2f_coord;
+
+out vec4 output_colour;
+
+const int num_taps = 8;
+
+void main()
+{
+    vec4 sum = vec4(0.0);
+
+    for(int i = 0; i < num_taps; ++i)
+        sum += texture2D(tex0, v2f_coord + smear * (float(i) / float(num_taps - 1) - 0.5));
+
+    output_colour = sum * (scale / float(num_taps));
+}
@@ -21,6 +21,10 @@ void emit(vec2 p)
 
 void main()
 {
+    // dead particles
+    if(gl_in[0].gl_Position.w <= 0.0)
+        return;
+
     emit(vec2(+1.0, -1.0));
     emit(vec2(+1.0, +1.0));
     emit(vec2(-1.0, -1.0));
@@ -0,0 +1,12 @@
+#version 330
+
+flat in vec4 v2f_pos;
+flat in vec3 v2f_vel;
+
+out vec4 output0, output1;
+
+void main()
+{
+	output0 = v2f_pos;
+	output1.xyz = v2f_vel;
+}
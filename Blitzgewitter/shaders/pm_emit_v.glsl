@@ -0,0 +1,22 @@
+// Writes emitted and killed particles into the state textures, one point per particle.
+
+#version 330
+
+uniform int tex_size;
+
+layout(location = 0) in float index;
+layout(location = 1) in vec4 emit_pos;
+layout(location = 2) in vec3 emit_vel;
+
+flat out vec4 v2f_pos;
+flat out vec3 v2f_vel;
+
+void main()
+{
+	int i = int(index);
+	vec2 texel = vec2(i % tex_size, i / tex_size) + vec2(0.5);
+
+	v2f_pos = emit_pos;
+	v2f_vel = emit_vel;
+	gl_Position = vec4(texel / float(tex_size) * 2.0 - vec2(1.0), 0.0, 1.0);
+}
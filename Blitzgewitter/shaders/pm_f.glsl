@@ -9,6 +9,12 @@ uniform mat4 view_mv, view_p;
 uniform mat4 inv_view_mv, inv_view_p;
 
 uniform float gravity_scale;
+uniform float bounce;
+
+// The strip of particles which is simulated in this update, in texture coordinates. Only about
+// that strip is drawn, and the texels in it which are outside the range are copied across as
+// they are, as are the dead ones.
+uniform vec2 update_range;
 
 in vec2 tc;
 
@@ -26,9 +32,17 @@ vec3 vsPointForCoord(vec2 tc)
 void main()
 {
 	// Read in the particle's state.
-	vec3 pos = texture2D(particle_pos_tex, tc).xyz;
+	vec4 state = texture2D(particle_pos_tex, tc);
+	vec3 pos = state.xyz;
     vec3 v = texture2D(particle_vel_tex, tc).xyz;
 
+	if(state.w <= 0.0 || tc.x < update_range.x || tc.x >= update_range.y)
+	{
+		output0 = state;
+		output1.xyz = v;
+		return;
+	}
+
     v += vec3(0.0, -1e-4 * gravity_scale, 0.0) * 3.0;
 
 	pos += v / 8.0 * 3.0;
@@ -57,10 +71,10 @@ void main()
 		vec3 r = reflect(v, n);
 		
 		pos += n * 2e-2;
-		v = r * 0.1 + cos(pos * 1e5) * 1e-3;
+		v = r * bounce + cos(pos * 1e5) * 1e-3;
     }
 
 	// Write the updated state for this particle.
-	output0.xyz = pos;
+	output0 = vec4(pos, state.w);
 	output1.xyz = v;
 }
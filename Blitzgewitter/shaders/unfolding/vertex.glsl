@@ -1,20 +1,50 @@
 #version 330
 
 uniform mat4 modelview, projection;
+uniform float time;
 
-layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 normal;
+layout(location = 0) in float corner;
 layout(location = 2) in vec3 colour;
 
+// Per-quad attributes. The corners of the quad are given in the frame of the edge which it
+// pivots around, so only the frame needs to be turned by the pivot angle.
+layout(location = 3) in vec4 pivot_start_time;
+layout(location = 4) in vec4 e0_end_time;
+layout(location = 5) in vec4 e1_start_angle;
+layout(location = 6) in vec4 e2_end_angle;
+layout(location = 7) in vec4 local_x;
+layout(location = 8) in vec4 local_y;
+layout(location = 9) in vec4 local_z;
+layout(location = 10) in vec3 local_normal;
+
 out vec3 v2f_normal;
 out vec3 v2f_e;
 out vec3 v2f_colour;
 
 void main()
 {
+    float start_time = pivot_start_time.w, end_time = e0_end_time.w;
+    float start_angle = e1_start_angle.w, end_angle = e2_end_angle.w;
+
+    float angle = end_angle;
+
+    if(time < end_time)
+        angle = mix(start_angle, end_angle, min(1.0, (time - start_time) / (end_time - start_time)));
+
+    vec3 e0 = e0_end_time.xyz;
+    vec3 e1 = e1_start_angle.xyz * cos(angle) + e2_end_angle.xyz * sin(angle);
+    vec3 e2 = e2_end_angle.xyz * cos(angle) - e1_start_angle.xyz * sin(angle);
+
+    int i = int(corner);
+
+    vec3 pos = pivot_start_time.xyz + local_x[i] * e0 + local_y[i] * e1 + local_z[i] * e2;
+
     v2f_colour = colour;
-    v2f_normal = normal;
+    v2f_normal = local_normal.x * e0 + local_normal.y * e1 + local_normal.z * e2;
     v2f_e = (modelview * vec4(pos, 1.0)).xyz;
     gl_Position = projection * modelview * vec4(pos, 1.0);
-}
 
+    // quads which haven't appeared yet are moved outside of the clip volume
+    if(time < start_time)
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+}
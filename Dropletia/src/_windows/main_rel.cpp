@@ -25,6 +25,15 @@
 #include "../writebitmaps.h"
 #endif
 
+// 1 in the Stream configuration of the project (see music_stream.h)
+#ifndef STREAMMUSIC
+#define STREAMMUSIC 0
+#endif
+
+#if STREAMMUSIC
+#include "../../../Alive Here Now, Forever/src/_windows/music_stream.h"
+#endif
+
 
 
 #pragma data_seg(".pixelfmt")
@@ -144,9 +153,13 @@ void entrypoint( void )
 
 #if ENABLE_MUSIC
 	Oidos_FillRandomData();
+#if STREAMMUSIC
+	startMusicStream("src/animesuru2-sf_3/music.asm");
+#else
 	Oidos_GenerateMusic();
 	Oidos_StartMusic();
 #endif
+#endif
 
 #if WRITEWAV
 {
@@ -183,7 +196,11 @@ static int frame=0;
 	loop:
 
 #if ENABLE_MUSIC
+#if STREAMMUSIC
+	const float musicticks = getMusicStreamPosition();
+#else
 	const float musicticks = Oidos_GetPosition();
+#endif
 	const int time = int((musicticks / Oidos_TicksPerSecond) * 1000.0f);
 #else
 	const float musicticks = 0;//Oidos_GetPosition();
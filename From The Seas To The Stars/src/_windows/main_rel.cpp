@@ -72,6 +72,15 @@ MMTIME MMTime =
 #include "../writebitmaps.h"
 #endif
 
+// 1 in the Stream configuration of the project (see music_stream.h)
+#ifndef STREAMMUSIC
+#define STREAMMUSIC 0
+#endif
+
+#if STREAMMUSIC
+#include "../../../Alive Here Now, Forever/src/_windows/music_stream.h"
+#endif
+
 #if HOT_RELOAD | LOAD_MUSIC
 DWORD g_BytesTransferred = 0;
 VOID CALLBACK FileIOCompletionRoutine(
@@ -109,6 +118,8 @@ static DEVMODE screenSettings = { {0},
     #endif
     };
 
+// the C runtime defines it in the Stream configuration
+#if !STREAMMUSIC
 #ifdef __cplusplus
 extern "C" 
 {
@@ -117,6 +128,7 @@ int  _fltused = 1;
 #ifdef __cplusplus
 }
 #endif
+#endif
 
 //----------------------------------------------------------------------------
 
@@ -209,9 +221,13 @@ CloseHandle(hFile);
 
 #if ENABLE_MUSIC
 	Oidos_FillRandomData();
+#if STREAMMUSIC
+	startMusicStream("src/music_fish/music.asm");
+#else
 	Oidos_GenerateMusic();
 	Oidos_StartMusic();
 #endif
+#endif
 
 }
 
@@ -441,7 +457,11 @@ dooneframe=true;
 		long int t = (long int)(((MMTime.u.sample) * 100) / 4410);
 #else
 #if ENABLE_MUSIC
+#if STREAMMUSIC
+	const float musicticks = getMusicStreamPosition();
+#else
 	const float musicticks = Oidos_GetPosition();
+#endif
 	const int t = int((musicticks / Oidos_TicksPerSecond) * 1000.0f);
 #else
 	const float musicticks = 0;//Oidos_GetPosition();
@@ -0,0 +1,61 @@
+#include "Engine.hpp"
+
+#include "Boops.hpp"
+#include "Arps.hpp"
+
+BeatTrack arp_track(alk_arps, num_alk_arps);
+BeatTrack boop_track(alk_boops, num_alk_boops);
+
+// the cursor only steps this far forwards before a binary search is quicker
+static const int max_cursor_steps = 8;
+
+BeatTrack::BeatTrack(const float* times, int count): times(times, times + count), cursor(-1)
+{
+   std::sort(this->times.begin(), this->times.end());
+}
+
+int BeatTrack::find(float t) const
+{
+   const int n = getCount();
+
+   // the cursor is still right if t is after its event and not after the next one
+   if(cursor < 0 || times[cursor] < t)
+   {
+      for(int i = 0; i < max_cursor_steps; ++i)
+      {
+         if(cursor + 1 >= n || times[cursor + 1] >= t)
+            return cursor;
+
+         ++cursor;
+      }
+   }
+
+   cursor = int(std::lower_bound(times.begin(), times.end(), t) - times.begin()) - 1;
+
+   return cursor;
+}
+
+float BeatTrack::previous(float t) const
+{
+   const int i = find(t);
+   return (i < 0) ? 0.0f : times[i];
+}
+
+float BeatTrack::next(float t) const
+{
+   if(times.empty())
+      return 0.0f;
+
+   const int i = find(t);
+   return times[std::min(i + 1, getCount() - 1)];
+}
+
+float BeatTrack::phase(float t) const
+{
+   const float t0 = previous(t), t1 = next(t);
+
+   if(t1 <= t0)
+      return 1.0f;
+
+   return std::min(1.0f, std::max(0.0f, (t - t0) / (t1 - t0)));
+}
@@ -0,0 +1,31 @@
+#include <vector>
+
+// The times in seconds of the hits of one instrument in the music, in order.
+// The scenes ask about times which are usually a little later than the last ones, so a cursor is
+// kept at the last event found and stepped forwards. Any other time is found by binary search.
+class BeatTrack
+{
+   public:
+      BeatTrack(const float* times, int count);
+
+      int getCount() const { return int(times.size()); }
+      float getTime(int i) const { return times[i]; }
+
+      // The index of the last event before t, or -1 if there isn't one.
+      int find(float t) const;
+
+      // The time of the last event before t, or 0 if there isn't one.
+      float previous(float t) const;
+
+      // The time of the first event at or after t, or of the last event if there isn't one.
+      float next(float t) const;
+
+      // How far t has gone from the previous event to the next, from 0 to 1.
+      float phase(float t) const;
+
+   private:
+      std::vector<float> times;
+      mutable int cursor;
+};
+
+extern BeatTrack arp_track, boop_track;
@@ -2,11 +2,13 @@
 #define NDEBUG
 
 #include <vector>
+#include <string>
 #include "gl3w/include/GL3/gl3w.h"
 #include <cassert>
 #include <algorithm>
 
 #include <cstdio>
+#include <cstdarg>
 
 #include "Mat.hpp"
 
@@ -26,9 +28,9 @@ typedef TVec2<Real> Vec2;
 typedef Real Vec1;
 
 #include  "Model.hpp"
+#include "Text.hpp"
 
-#include "Boops.hpp"
-#include "Arps.hpp"
+#include "Beats.hpp"
 
 static double mix(double a, double b, double c)
 {
@@ -84,16 +86,52 @@ class Spline
     {
         T point;
         uint frame_num;
+        bool valid;
 
     } cache;
 
+    // index of the segment which was last evaluated, so that playback moving forwards
+    // through the frames can find the next segment without searching.
+    mutable uint cursor;
+
     std::vector<Node> nodes;
     uint nodes_size;
     bool initialized;
 
+    // returns the index of the node which begins the segment containing frame_num, such that
+    // nodes[i].frame_num <= frame_num < nodes[i + 1].frame_num. frame_num must lie strictly
+    // inside the range of the spline.
+    uint findSegment(const uint frame_num) const
+    {
+        uint i = cursor;
+
+        if(i + 1 < nodes_size && nodes[i].frame_num <= frame_num)
+        {
+            // step forwards a few segments before giving up and searching
+            for(uint steps = 0; steps < 4; ++steps, ++i)
+                if(frame_num < nodes[i + 1].frame_num)
+                    return cursor = i;
+        }
+
+        int start = 0, end = nodes_size - 1;
+
+        while(start < end - 1)
+        {
+            const int mid = (start + end) / 2;
+            if(frame_num >= nodes[mid].frame_num)
+                start = mid;
+            else
+                end = mid;
+        }
+
+        return cursor = start;
+    }
+
     public:
-        Spline() : nodes_size(0), initialized(false)
+        Spline() : cursor(0), nodes_size(0), initialized(false)
         {
+            cache.frame_num = 0;
+            cache.valid = false;
         }
 
         void insert(const T& point, const T& tangent, const uint frame_num)
@@ -110,6 +148,8 @@ class Spline
             std::sort(nodes.begin(), nodes.end());
             nodes_size = nodes.size();
             initialized = true;
+            cursor = 0;
+            cache.valid = false;
         }
 
         void repeat(const uint start, const uint end, const uint offset)
@@ -124,6 +164,8 @@ class Spline
                   nodes.push_back(n);
                }
             }
+            cursor = 0;
+            cache.valid = false;
         }
 
         T evaluate(const uint frame_num) const
@@ -131,32 +173,17 @@ class Spline
             assert(initialized == true);
             assert(nodes_size > 0);
 
-            if(cache.frame_num == frame_num)
+            if(cache.valid && cache.frame_num == frame_num)
                return cache.point;
 
-            int start = 0, end = nodes_size - 1;
-
-            do
-            {
-                const int mid = (start + end) / 2;
-                const Node& node = nodes[mid];
-                if(frame_num > node.frame_num)
-                    start = mid;
-                else
-                    end = mid;
-
-            } while(start < end - 1);
-
-            const Node &n0 = nodes[start], &n1 = nodes[end];
+            if(frame_num <= nodes[0].frame_num)
+                return nodes[0].point;
 
-            if(start == end)
-                return n0.point;
+            if(frame_num >= nodes[nodes_size - 1].frame_num)
+                return nodes[nodes_size - 1].point;
 
-            if(n1.frame_num <= frame_num)
-                return n1.point;
-
-            if(n0.frame_num >= frame_num)
-                return n0.point;
+            const uint i = findSegment(frame_num);
+            const Node &n0 = nodes[i], &n1 = nodes[i + 1];
 
             uint ofs = frame_num - n0.frame_num, len = n1.frame_num - n0.frame_num;
 
@@ -171,18 +198,101 @@ class Spline
 
             cache.point = point;
             cache.frame_num = frame_num;
+            cache.valid = true;
 
             return point;
         }
+
+        // the frame of the last node, after which the spline keeps its last point
+        uint getLastFrame() const
+        {
+            assert(initialized == true);
+            assert(nodes_size > 0);
+
+            return nodes[nodes_size - 1].frame_num;
+        }
+
+        // evaluates the frames first, first + 1, ..., first + count - 1 into out. each segment's
+        // hermite basis is folded into a cubic polynomial once, and the inner loop over the frames
+        // of a segment is branch-free so that it can be vectorised by the compiler.
+        void evaluate(const uint first, const uint count, T* out) const
+        {
+            assert(initialized == true);
+            assert(nodes_size > 0);
+
+            const Node &front = nodes[0], &back = nodes[nodes_size - 1];
+            uint f = first, n = 0;
+
+            while(n < count && f <= front.frame_num)
+            {
+                out[n++] = front.point;
+                ++f;
+            }
+
+            while(n < count && f < back.frame_num)
+            {
+                const uint i = findSegment(f);
+                const Node &n0 = nodes[i], &n1 = nodes[i + 1];
+
+                // p(t) = ((a * t + b) * t + c) * t + d
+                const T a = n0.point * Real(2) + n0.tangent - n1.point * Real(2) + n1.tangent;
+                const T b = n1.point * Real(3) - n0.point * Real(3) - n0.tangent * Real(2) - n1.tangent;
+                const T c = n0.tangent;
+                const T d = n0.point;
+
+                const uint span = std::min(count - n, n1.frame_num - f);
+                const uint ofs = f - n0.frame_num;
+                const Real rlen = Real(1) / Real(n1.frame_num - n0.frame_num);
+
+                T* const dst = out + n;
+
+                for(uint j = 0; j < span; ++j)
+                {
+                    const Real t = Real(ofs + j) * rlen;
+                    dst[j] = ((a * t + b) * t + c) * t + d;
+                }
+
+                n += span;
+                f += span;
+            }
+
+            while(n < count)
+                out[n++] = back.point;
+        }
 };
 
 
 class Shader
 {
+   // The last value sent to each uniform, so that setting a uniform to the value which it
+   // already has costs no GL call. The location of each name is only looked up once.
+   struct Uniform
+   {
+      std::string name;
+      GLint location;
+      GLboolean transpose;
+      std::vector<unsigned char> value;
+   };
+
    GLuint program;
    bool loaded;
+   std::vector<Uniform> uniforms;
+
+   bool changeUniform(const char* name, const void* value, size_t size, GLboolean transpose, GLint& location);
 
    public:
+      // The numbers of uniform calls which were sent to GL, and which were skipped because
+      // they would not have changed anything.
+      struct Stats
+      {
+         uint sent, skipped;
+      };
+
+      // Ends the counting for a frame. The counts of the frame are then given by getFrameStats().
+      static void endFrame();
+      static const Stats& getFrameStats();
+      static const Stats& getTotalStats();
+
       Shader() : program(0), loaded(false) { }
 
       void uniform1i(const char* name, GLint x);
@@ -214,6 +324,8 @@ class Mesh
    bool dirty;
    const GLuint max_vcount, max_tcount;
 
+   void addFace(const Vec3* corners, bool reverse);
+
    public:
       Mesh(const uint max_vcount = 4096, const uint max_tcount = 4096);
       ~Mesh();
@@ -231,6 +343,14 @@ class Mesh
       void generateSimpleCube();
       void generateCube();
       void addInstance(const Mesh& mesh, const Mat4& transform);
+
+      // Adds the faces of the cells of a w x h x d grid (indexed x + y * w + z * w * h) which hold
+      // the given value, with cell (x, y, z) being the unit cube from (x, y, z) to (x + 1, y + 1,
+      // z + 1) before the transform. Faces against any non-zero cell are left out, and the faces
+      // in each plane are merged into as few rectangles as possible. Each face has its own
+      // vertices and normals, so generateNormals() isn't needed.
+      void addVoxels(const int* cells, const uint w, const uint h, const uint d, const int value,
+                     const Mat4& transform);
       void separate();
       void transform(const Mat4& transform);
       void reverseWindings();
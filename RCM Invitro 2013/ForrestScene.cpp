@@ -1,6 +1,60 @@
 
 #include "Engine.hpp"
 #include "Bezier.hpp"
+#include "Game.hpp"
+
+static const std::string g_gameTexts0[] = {
+   "the retro computer museum",
+   "are hosting a half term",
+   "weekend special.",
+   "",
+   "so come and visit us at",
+   "",
+   "snibston and the century theatre",
+   "ashby road",
+   "coalville",
+   "leicestershire",
+   "le67 3ln",
+   "",
+   "on the 26th and 27th",
+   "of october.",
+   "",
+   "",
+   "",
+};
+
+//Snibston and the Century Theatre, Ashby Road, Coalville, Leicestershire LE67 3LN
+
+static const std::string g_gameTexts1[] = {
+   "",
+   "",
+   "",
+   "",
+   "",
+   "for more information go to",
+   "www.retrocomputermuseum.co.uk"
+   "",
+   "",
+   "",
+   "",
+   "",
+   "",
+};
+
+static const int g_numGameTexts0 = sizeof(g_gameTexts0) / sizeof(g_gameTexts0[0]);
+static const int g_numGameTexts1 = sizeof(g_gameTexts1) / sizeof(g_gameTexts1[0]);
+
+static void sampleSpline(const Spline<Real>& spline, std::vector<Real>& frames)
+{
+   frames.resize(spline.getLastFrame() + 1);
+   spline.evaluate(0, frames.size(), &frames[0]);
+}
+
+// the spline keeps its last point after its last node
+static Real sampledAt(const std::vector<Real>& frames, uint frame_num)
+{
+   return frames[std::min<size_t>(frame_num, frames.size() - 1)];
+}
 
 
 class ForrestScene: public Scene
@@ -8,16 +62,27 @@ class ForrestScene: public Scene
    Shader forrest_shader, bokeh_shader, bokeh2_shader;
    Shader gaussbokeh_shader, composite_shader, ao_shader;
    Shader game_shader;
+   Shader sprite_shader;
 
    static const int num_sprite_meshes = 5, max_sprite_cols = 8;
 
    Mesh sprite_meshes[num_sprite_meshes][max_sprite_cols];
    Vec3 sprite_cols[num_sprite_meshes][max_sprite_cols];
 
+   // Per-sprite constants for the instanced sprite draws, grouped by sprite mesh. Sprite i uses
+   // mesh i % num_sprite_meshes.
+   GLuint sprite_instance_vbo;
+   int num_sprites;
+   int sprite_instance_first[num_sprite_meshes], sprite_instance_count[num_sprite_meshes];
+
    Spline<Vec3> tint_spline;
    Spline<Real> cam_dist_spline, cam_rotY_spline, cam_rotX_spline, cam_focus_spline;
    Spline<Real> cam_posY_spline;
 
+   // The camera splines at every frame up to their last node, filled once by the batch
+   // Spline::evaluate so that drawView() only looks them up.
+   std::vector<Real> cam_dist_frames, cam_rotY_frames, cam_rotX_frames, cam_focus_frames, cam_posY_frames;
+
    static const int num_fbos = 16, num_texs = 16;
 
    static const int stuff_appear_offset = -3;
@@ -30,173 +95,55 @@ class ForrestScene: public Scene
 
    GLuint game_font;
 
+   text::Font game_text_font;
+   text::Cache game_text_cache;
+   const text::Mesh* game_texts0[g_numGameTexts0];
+   const text::Mesh* game_texts1[g_numGameTexts1];
+
+   // whether the shaders, font, splines and sprite meshes have been set up, which free() leaves
+   // alone
+   bool set_up;
+
    void initializeTextures();
    void initializeShaders();
    void initializeBuffers();
+   void initializeGameText();
+   void cacheGameText();
 
    void drawGame();
    void drawView();
 
+   void buildSpriteInstances();
+   void drawSprites(const Mat4& projection);
+
    static const int game_width = 256, game_height = 256;
-   GLfloat game_coords[8192 * 2];
-   GLfloat game_vertices[8192 * 2];
-   GLushort game_indices[8192], num_game_vertices, num_game_indices;
+   std::vector<GLfloat> game_coords;
+   std::vector<GLfloat> game_vertices;
+   std::vector<GLushort> game_indices;
 
 
    void addGameQuad(Vec2 p0, Vec2 p1, int c = 0);
-   void addGameText(Vec2 org, const std::string& text);
-   Vec2 gameQuantise(const Vec2& v) const;
-
+   void drawGameText(const std::string* lines, const text::Mesh* const* meshes, int num_lines, int textness);
 
 
-   struct Pong
-   {
-      Vec2 ballpos, ballvel;
-      Real bat0x, bat1x;
-      Real bat0y, bat1y;
-      Real ballsize;
-      Vec2 batsize;
-
-      Pong()
-      {
-         ballpos = Vec2(0, 0);
-         bat0x = -0.84;
-         bat1x = +0.84;
-         bat0y = 0;
-         bat1y = 0;
-         batsize = Vec2(0.06, 0.3) * 0.5;
-         ballsize = 0.03;
-         ballvel = Vec2(0.16, 0.09) * 0.1;
-      }
-
-   } pong;
 
-
-
-
-   struct Snake
-   {
-      static const int num_snakes = 12, grid_w = 32, grid_h = 32, snake_length = 10;
-
-      int snakes[num_snakes][4]; // x, y, dir, free
-      int update_count;
-      int grid[grid_w * grid_h][2]; // snake index, counter
-
-      template<class T>
-      static int sign(T t)
-      {
-         return t < 0 ? -1 : t > 0 ? 1 : 0;
-      }
-
-      Snake()
-      {
-         for(int y=0;y<grid_h;++y)
-            for(int x=0;x<grid_w;++x)
-            {
-               grid[x+y*grid_w][0]=-1;
-               grid[x+y*grid_w][1]=0;
-            }
-
-         for(int i=0;i<num_snakes;++i)
-         {
-            snakes[i][0]=rand() % grid_w;
-            snakes[i][1]=rand() % grid_h;
-            snakes[i][2]=rand() % 4;
-         }
-
-         update_count = 0;
-      }
-
-      bool cellFree(int x, int y)
-      {
-         if(x < 0 || y < 0 || x >= grid_w || y >= grid_h)
-            return false;
-
-         return grid[x+y*grid_w][1] == 0;
-      }
-
-      void update()
-      {
-         ++update_count;
-
-         if(update_count & 15)
-            return;
-
-         for(int i=0;i<num_snakes;++i)
-         {
-            int nx=snakes[i][0];
-            int ny=snakes[i][1];
-
-            if(((update_count / 16 + i) & 7) == 0)
-            {
-               snakes[i][2] = rand() % 4;
-            }
-
-            switch(snakes[i][2])
-            {
-               case 0: nx += -1; break;
-               case 1: nx += +1; break;
-               case 2: ny += -1; break;
-               case 3: ny += +1; break;
-            }
-            if(cellFree(nx, ny))
-            {
-               snakes[i][0]=nx;
-               snakes[i][1]=ny;
-               snakes[i][3] = 1;
-               grid[nx+ny*grid_w][0]=i;
-               grid[nx+ny*grid_w][1]=snake_length;
-            }
-            else
-            {
-               snakes[i][3] = 0;
-               const int xf = (rand() & 1) ? +1 : -1;
-               const int yf = (rand() & 1) ? +1 : -1;
-               for(int y=-1;y<2 && !snakes[i][3];++y)
-                  for(int x=-1;x<2;++x)
-                  {
-                     const int x2 = x * xf, y2 = y * yf;
-                     if(labs(x) != labs(y) && cellFree(snakes[i][0]+x2, snakes[i][1]+y2))
-                     {
-                        snakes[i][2] = (sign(x2+y2)+1)/2 + labs(y2)*2;
-                        snakes[i][3] = 1;
-                        snakes[i][0] += x2;
-                        snakes[i][1] += y2;
-                        grid[snakes[i][0]+snakes[i][1]*grid_w][0]=i;
-                        grid[snakes[i][0]+snakes[i][1]*grid_w][1]=snake_length;
-                        break;
-                     }
-                  }
-            }
-         }
-
-         for(int y=0;y<grid_h;++y)
-            for(int x=0;x<grid_w;++x)
-            {
-               int* g = grid[x+y*grid_w];
-
-               if(g[1] > 0 && g[0] != -1 && snakes[g[0]][3])
-               {
-                  g[1] -= 1;
-
-                  if(g[1] == 0)
-                     g[0] = -1;
-               }
-            }
-      }
-
-   } snake;
+   game::Pong pong;
+   game::Snake snake;
+   std::vector<game::Quad> game_quads;
 
 
 
 
    public:
-      ForrestScene()
+      ForrestScene(): game_text_font(GL_TRIANGLES)
       {
-         num_game_vertices = 0;
-         num_game_indices = 0;
+         sprite_instance_vbo = 0;
+         num_sprites = 800;
+         set_up = false;
       }
 
+      void setSpriteCount(int n);
+
       void initialize();
       void render();
       void update();
@@ -374,6 +321,10 @@ void ForrestScene::initializeShaders()
 
    game_shader.load(SHADERS_PATH "game_v.glsl", NULL, SHADERS_PATH "game_f.glsl");
 
+   sprite_shader.load(SHADERS_PATH "sprite_v.glsl", NULL, SHADERS_PATH "forrest_f.glsl");
+   sprite_shader.uniform1i("noiseTex", 0);
+   sprite_shader.uniform1i("colour_tex", 1);
+
 
    bokeh_shader.load(SHADERS_PATH "bokeh_v.glsl", NULL, SHADERS_PATH "bokeh_f.glsl");
    bokeh_shader.uniform1i("tex0", 0);
@@ -403,11 +354,6 @@ void ForrestScene::initializeShaders()
    ao_shader.uniform1i("noise_tex", 1);
 }
 
-static inline Real frand()
-{
-   return Real(rand()) / Real(RAND_MAX);
-}
-
 void ForrestScene::initialize()
 {
    if(initialized)
@@ -415,10 +361,33 @@ void ForrestScene::initialize()
 
    initialized = true;
 
-   initializeShaders();
+   // free() releases these, so they are made again each time the scene is initialized
    initializeTextures();
    initializeBuffers();
 
+   if(set_up)
+   {
+      cacheGameText();
+      return;
+   }
+
+   set_up = true;
+
+   initializeShaders();
+   initializeGameText();
+   cacheGameText();
+
+   // The number of falling sprites can be changed without a rebuild, to see how they scale.
+   {
+      FILE* count_file = fopen("forrest_sprite_count.txt", "r");
+      if(count_file)
+      {
+         int n;
+         if(fscanf(count_file, "%d", &n) == 1 && n >= 0)
+            setSpriteCount(n);
+         fclose(count_file);
+      }
+   }
 
 
    tint_spline.insert(Vec3(0, 0, 0), Vec3(0, 0, 0), 0);
@@ -447,6 +416,12 @@ void ForrestScene::initialize()
    cam_focus_spline.insert(0, 0, 0);
    cam_focus_spline.initialize();
 
+   sampleSpline(cam_dist_spline, cam_dist_frames);
+   sampleSpline(cam_rotY_spline, cam_rotY_frames);
+   sampleSpline(cam_rotX_spline, cam_rotX_frames);
+   sampleSpline(cam_posY_spline, cam_posY_frames);
+   sampleSpline(cam_focus_spline, cam_focus_frames);
+
 
 
 
@@ -571,47 +546,22 @@ void ForrestScene::initialize()
       {
          for(int j=0;j<max_sprite_cols;++j)
          {
-            Mesh cube(60, 24);
-            Mesh& mesh = sprite_meshes[i][j];
-
-            cube.generateSimpleCube();
-            cube.transform(Mat4::scale(Vec3(0.5, 0.5, 0.5)));
-            cube.separate();
-
-            for(int y=0;y<h;++y)
-            {
-               for(int x=0;x<w;++x)
-               {
-                  if(sprites[i][y][x]==(j+1))
-                  {
-                     Vec3 pos(x-w/2, -(y-h/2), 0);
-                     mesh.addInstance(cube, Mat4::translation(pos));
-                  }
-               }
-            }
-
-            //cubes_mesh.subdivide();
-            mesh.generateNormals();
+            // cell (x, y) is centred on (x - w / 2, -(y - h / 2), 0)
+            const Mat4 transform = Mat4::translation(Vec3(-w / 2 - 0.5, h / 2 + 0.5, -0.5)) * Mat4::scale(Vec3(1, -1, 1));
+
+            sprite_meshes[i][j].addVoxels(&sprites[i][0][0], w, h, 1, j + 1, transform);
          }
       }
    }
 
 }
 
-Vec2 ForrestScene::gameQuantise(const Vec2& v) const
-{
-   return Vec2(floor((v.x + 1.0) * 0.5 * game_width) / game_width,
-               floor((v.y + 1.0) * 0.5 * game_height) / game_height ) * 2.0 - Vec2(1.0, 1.0);
-
-//   return Vec2(floor((v.x + 1.0) * 0.5 * game_width * 0.5) / game_width * 2, floor(v.y * game_height * 0.5) / game_height * 2);
-}
-
 void ForrestScene::addGameQuad(Vec2 p0, Vec2 p1, int c)
 {
-   p0 = gameQuantise(p0);
-   p1 = gameQuantise(p1);
+   p0 = game::quantise(p0, game_width, game_height);
+   p1 = game::quantise(p1, game_width, game_height);
 
-   GLushort i0 = num_game_vertices, i1 = i0 + 1, i2 = i0 + 2, i3 = i0 + 3;
+   const GLushort i0 = game_vertices.size() / 2, i1 = i0 + 1, i2 = i0 + 2, i3 = i0 + 3;
 
    const int num_chars = 38;
 
@@ -619,95 +569,87 @@ void ForrestScene::addGameQuad(Vec2 p0, Vec2 p1, int c)
 
    const Vec2 c0 = Vec2(Real(c) / num_chars + 0.5 / (num_chars * 8), 0), c1 = Vec2(Real(c + 1) / num_chars, 1);
 
-   game_vertices[i0 * 2 + 0] = p0.x;
-   game_vertices[i0 * 2 + 1] = p0.y;
+   const GLfloat vertices[] = { p0.x, p0.y, p1.x, p0.y, p0.x, p1.y, p1.x, p1.y };
+   const GLfloat coords[] = { c0.x, c0.y, c1.x, c0.y, c0.x, c1.y, c1.x, c1.y };
+   const GLushort indices[] = { i0, i1, i2, i1, i3, i2 };
 
-   game_vertices[i1 * 2 + 0] = p1.x;
-   game_vertices[i1 * 2 + 1] = p0.y;
-
-   game_vertices[i2 * 2 + 0] = p0.x;
-   game_vertices[i2 * 2 + 1] = p1.y;
+   game_vertices.insert(game_vertices.end(), vertices, vertices + 8);
+   game_coords.insert(game_coords.end(), coords, coords + 8);
+   game_indices.insert(game_indices.end(), indices, indices + 6);
+}
 
-   game_vertices[i3 * 2 + 0] = p1.x;
-   game_vertices[i3 * 2 + 1] = p1.y;
 
-   game_coords[i0 * 2 + 0] = c0.x;
-   game_coords[i0 * 2 + 1] = c0.y;
 
-   game_coords[i1 * 2 + 0] = c1.x;
-   game_coords[i1 * 2 + 1] = c0.y;
+void ForrestScene::update()
+{
+   const bool playing = time <= (12 + stuff_appear_offset);
 
-   game_coords[i2 * 2 + 0] = c0.x;
-   game_coords[i2 * 2 + 1] = c1.y;
+   if(!playing)
+      snake.step();
 
-   game_coords[i3 * 2 + 0] = c1.x;
-   game_coords[i3 * 2 + 1] = c1.y;
+   pong.playing = playing;
+   pong.step();
+}
 
-   game_indices[num_game_indices + 0] = i0;
-   game_indices[num_game_indices + 1] = i1;
-   game_indices[num_game_indices + 2] = i2;
+void ForrestScene::initializeGameText()
+{
+   const int num_chars = 38;
 
-   game_indices[num_game_indices + 3] = i1;
-   game_indices[num_game_indices + 4] = i3;
-   game_indices[num_game_indices + 5] = i2;
+   for(int c = 0; c < 256; ++c)
+   {
+      int g = -1;
 
-   num_game_vertices += 4;
-   num_game_indices += 6;
-}
+      if(c == '.')
+         g = 37;
+      else if(isalpha(c))
+         g = 1 + tolower(c) - 'a';
+      else if(isdigit(c))
+         g = 1 + 26 + c - '0';
 
+      if(g < 0)
+         continue;
 
+      game_text_font.addQuad(c, Vec2(Real(g) / num_chars + 0.5 / (num_chars * 8), 0), Vec2(Real(g + 1) / num_chars, 1));
+   }
+}
 
-void ForrestScene::update()
+void ForrestScene::cacheGameText()
 {
-   // snake
-
-   if(time > (12 + stuff_appear_offset))
-      snake.update();
-
-   // pong
+   // the glyphs are whole pixels in size, so they stay on the game's pixel grid when they are
+   // drawn at a whole pixel offset
+   const Vec2 sz(2.0 / (game_width / 8.0), 2.0 / (game_height / 8.0));
 
-   pong.ballpos += pong.ballvel;
+   for(int i = 0; i < g_numGameTexts0; ++i)
+      game_texts0[i] = game_text_cache.get(game_text_font, g_gameTexts0[i], sz, sz);
 
+   for(int i = 0; i < g_numGameTexts1; ++i)
+      game_texts1[i] = game_text_cache.get(game_text_font, g_gameTexts1[i], sz, sz);
+}
 
-   if(time > (12 + stuff_appear_offset))
-   {
-      pong.bat0y += 0.02;
-      pong.bat1y -= 0.02;
-   }
-   else
+// Types out the lines up to the textness'th character which isn't a space.
+void ForrestScene::drawGameText(const std::string* lines, const text::Mesh* const* meshes, int num_lines, int textness)
+{
+   int c = 0;
+   float y = 26+8*3;
+   for(int i = 0; i < num_lines; ++i)
    {
-      pong.bat0y = mix(cos(time) * 0.4, pong.ballpos.y, std::min(1.0f, std::max(0.0f, -pong.ballpos.x * 1.2f)));
-      pong.bat1y = mix(sin(time * 0.8) * 0.4, pong.ballpos.y, std::min(1.0f, std::max(0.0f, +pong.ballpos.x * 1.2f)));
+      int n = 0;
 
-      if(std::abs(pong.ballpos.x) > pong.bat1x - pong.batsize.x - pong.ballsize)
+      for(std::string::const_iterator it = lines[i].begin(); it != lines[i].end() && c < textness; ++it, ++n)
       {
-         pong.ballvel.x *= -1;
-         pong.ballvel.y += (frand() - 0.5) * 0.01;
+         if(!isspace(*it))
+            ++c;
       }
-   }
 
-   if(std::abs(pong.ballpos.y) > 0.7 - pong.ballsize)
-      pong.ballvel.y *= -1;
-}
+      const Mat4 modelview = Mat4::translation(Vec3(-(112+16) * 2.0 / game_width, y * 2.0 / game_height, 0));
 
-void ForrestScene::addGameText(Vec2 org, const std::string& text)
-{
-   const Vec2 sz(2.0 / (game_width / 8.0), 2.0 / (game_height / 8.0));
+      game_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
+      meshes[i]->draw(n);
 
-   org *= Vec2(2.0 / game_width, 2.0 / game_height);
+      y -= 8;
 
-   for(std::string::const_iterator it = text.begin(); it != text.end(); ++it)
-   {
-      if(!isspace(*it))
-      {
-         if(*it == '.')
-            addGameQuad(org, org + sz, 37);
-         if(isalpha(*it))
-            addGameQuad(org, org + sz, 1 + tolower(*it) - 'a');
-         else if(isdigit(*it))
-            addGameQuad(org, org + sz, 1 + 26 + *it - '0');
-      }
-      org.x += sz.x;
+      if(c >= textness)
+         break;
    }
 }
 
@@ -746,191 +688,63 @@ void ForrestScene::drawGame()
 
    glClear(GL_COLOR_BUFFER_BIT);
 
-   num_game_vertices = 0;
-   num_game_indices = 0;
+   game_vertices.clear();
+   game_coords.clear();
+   game_indices.clear();
 
 
    CHECK_FOR_ERRORS;
 
-   // SNAKE
-   for(int y=0;y<Snake::grid_h;++y)
-      for(int x=0;x<Snake::grid_w;++x)
-      {
-         const double s = 0.1;
-
-         double x0 = s;
-         double y0 = s;
-         double x1 = 1.0 - s;
-         double y1 = 1.0 - s;
-
-         const int snake_index = snake.grid[x+y*Snake::grid_w][0];
-         const int c = snake.grid[x+y*Snake::grid_w][1];
-
-         for(int v=-1;v<2;++v)
-            for(int u=-1;u<2;++u)
-            {
-               int x2=x+u, y2=y+v;
-
-               if(labs(u) == labs(v) ||  x2 < 0 || y2 < 0 || x2 >= Snake::grid_w || y2 >= Snake::grid_h)
-                  continue;
-
-               if(snake.grid[x2+y2*Snake::grid_w][0] == snake_index && labs(snake.grid[x2+y2*Snake::grid_w][1] - c) == 1)
-               {
-                  x0 += std::min(u, 0) * s;
-                  y0 += std::min(v, 0) * s;
-                  x1 += std::max(u, 0) * s;
-                  y1 += std::max(v, 0) * s;
-               }
-            }
-
-         if(c > 0)
-         {
-            addGameQuad(Vec2(-1.0 + 2.0 * (double(x)+x0)/double(Snake::grid_w), -1.0 + 2.0 * (double(y)+0+s)/double(Snake::grid_h)) * 0.9,
-                        Vec2(-1.0 + 2.0 * (double(x)+x1)/double(Snake::grid_w), -1.0 + 2.0 * (double(y)+1-s)/double(Snake::grid_h)) * 0.9);
-
-            addGameQuad(Vec2(-1.0 + 2.0 * (double(x)+0+s)/double(Snake::grid_w), -1.0 + 2.0 * (double(y)+y0)/double(Snake::grid_h)) * 0.9,
-                        Vec2(-1.0 + 2.0 * (double(x)+1-s)/double(Snake::grid_w), -1.0 + 2.0 * (double(y)+y1)/double(Snake::grid_h)) * 0.9);
-         }
-      }
-
+   game_quads.clear();
+   snake.addQuads(game_quads);
+   pong.addQuads(game_quads);
 
-   // PONG
-   addGameQuad(pong.ballpos - Vec2(pong.ballsize), pong.ballpos + Vec2(pong.ballsize));
-   addGameQuad(Vec2(pong.bat0x, pong.bat0y) - pong.batsize, Vec2(pong.bat0x, pong.bat0y) + pong.batsize);
-   addGameQuad(Vec2(pong.bat1x, pong.bat1y) - pong.batsize, Vec2(pong.bat1x, pong.bat1y) + pong.batsize);
+   for(size_t i = 0; i < game_quads.size(); ++i)
+      addGameQuad(game_quads[i].p0, game_quads[i].p1, game_quads[i].c);
 
 
    CHECK_FOR_ERRORS;
 
 
-   // TEXT
+   game_shader.bind();
+   game_shader.uniform1f("time", time);
+   game_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
+   game_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
+   game_shader.uniform3f("colour", 1, 1, 1);
 
-   static const std::string texts0[] = {
-   "the retro computer museum",
-   "are hosting a half term",
-   "weekend special.",
-   "",
-   "so come and visit us at",
-   "",
-   "snibston and the century theatre",
-   "ashby road",
-   "coalville",
-   "leicestershire",
-   "le67 3ln",
-   "",
-   "on the 26th and 27th",
-   "of october.",
-   "",
-   "",
-   "",
-   };
-
-//Snibston and the Century Theatre, Ashby Road, Coalville, Leicestershire LE67 3LN
-
-   static const std::string texts1[] = {
-   "",
-   "",
-   "",
-   "",
-   "",
-   "for more information go to",
-   "www.retrocomputermuseum.co.uk"
-   "",
-   "",
-   "",
-   "",
-   "",
-   "",
-   };
-
-   static const int num_texts0 = sizeof(texts0) / sizeof(texts0[0]);
-   static const int num_texts1 = sizeof(texts1) / sizeof(texts1[0]);
-
-   const int textness0 = (time - 13 - stuff_appear_offset) * 16;
-   const int textness1 = (time - 27 - stuff_appear_offset) * 16;
+   glActiveTexture(GL_TEXTURE0);
+   glBindTexture(GL_TEXTURE_2D, game_font);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
-   if(textness1 > 0)
+   if(!game_indices.empty())
    {
-      int c = 0;
-      float y = 26+8*3;
-      for(int i = 0; i < num_texts1; ++i)
-      {
-         std::string str = "";
-
-         for(std::string::const_iterator it = texts1[i].begin(); it != texts1[i].end(); ++it)
-         {
-            if(c >= textness1)
-               break;
-
-            str += *it;
+      glEnableVertexAttribArray(0);
+      glEnableVertexAttribArray(1);
 
-            if(!isspace(*it))
-               ++c;
-         }
+      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, &game_vertices[0]);
+      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, &game_coords[0]);
 
-         addGameText(Vec2(-(112+16), y), str);
-         y -= 8;
+      glDrawRangeElements(GL_TRIANGLES, 0, game_vertices.size() / 2 - 1, game_indices.size(), GL_UNSIGNED_SHORT, &game_indices[0]);
 
-         if(c >= textness1)
-            break;
-      }
+      glDisableVertexAttribArray(0);
+      glDisableVertexAttribArray(1);
    }
-   else if(textness0 > 0)
-   {
-      int c = 0;
-      float y = 26+8*3;
-      for(int i = 0; i < num_texts0; ++i)
-      {
-         std::string str = "";
 
-         for(std::string::const_iterator it = texts0[i].begin(); it != texts0[i].end(); ++it)
-         {
-            if(c >= textness0)
-               break;
-
-            str += *it;
 
-            if(!isspace(*it))
-               ++c;
-         }
+   // TEXT
 
-         addGameText(Vec2(-(112+16), y), str);
-         y -= 8;
+   const int textness0 = (time - 13 - stuff_appear_offset) * 16;
+   const int textness1 = (time - 27 - stuff_appear_offset) * 16;
 
-         if(c >= textness0)
-            break;
-      }
-   }
+   if(textness1 > 0)
+      drawGameText(g_gameTexts1, game_texts1, g_numGameTexts1, textness1);
+   else if(textness0 > 0)
+      drawGameText(g_gameTexts0, game_texts0, g_numGameTexts0, textness0);
 
    CHECK_FOR_ERRORS;
 
 
-   if(num_game_indices > 0)
-   {
-      glEnableVertexAttribArray(0);
-      glEnableVertexAttribArray(1);
-
-      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, game_vertices);
-      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, game_coords);
-
-      game_shader.bind();
-      game_shader.uniform1f("time", time);
-      game_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
-      game_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
-      game_shader.uniform3f("colour", 1, 1, 1);
-
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, game_font);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-      glDrawRangeElements(GL_TRIANGLES, 0, num_game_vertices, num_game_indices, GL_UNSIGNED_SHORT, game_indices);
-
-      glDisableVertexAttribArray(0);
-      glDisableVertexAttribArray(1);
-   }
-
-
    glUseProgram(0);
 
    CHECK_FOR_ERRORS;
@@ -1024,6 +838,120 @@ void ForrestScene::drawGame()
    CHECK_FOR_ERRORS;
 }
 
+void ForrestScene::setSpriteCount(int n)
+{
+   assert(n >= 0);
+
+   num_sprites = n;
+
+   if(sprite_instance_vbo)
+      buildSpriteInstances();
+}
+
+void ForrestScene::buildSpriteInstances()
+{
+   // The phases which the sprite index drives are reduced here, as the shader's sin() in single
+   // precision is poor for the large arguments which the indices give.
+   std::vector<GLfloat> data;
+   data.reserve(num_sprites * 6);
+
+   for(int k = 0; k < num_sprite_meshes; ++k)
+   {
+      sprite_instance_first[k] = data.size() / 6;
+
+      for(int i = k; i < num_sprites; i += num_sprite_meshes)
+      {
+         data.push_back(sin(i*7)*5);
+         data.push_back(sin(i*26)*2);
+         data.push_back((-sin(i*88))*1.2);
+         data.push_back(fmod(double(i), 2.0 * M_PI));
+         data.push_back(fmod(i * 0.4, 2.0 * M_PI));
+         data.push_back(fmod(i * 0.5, 2.0 * M_PI));
+      }
+
+      sprite_instance_count[k] = data.size() / 6 - sprite_instance_first[k];
+   }
+
+   if(sprite_instance_vbo == 0)
+      glGenBuffers(1, &sprite_instance_vbo);
+
+   glBindBuffer(GL_ARRAY_BUFFER, sprite_instance_vbo);
+   glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(GLfloat), data.empty() ? NULL : &data[0], GL_STATIC_DRAW);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   CHECK_FOR_ERRORS;
+}
+
+// One instanced draw per sprite mesh and colour. The placement of each sprite is worked out in
+// sprite_v.glsl from its constants and the time.
+void ForrestScene::drawSprites(const Mat4& projection)
+{
+   if(sprite_instance_vbo == 0)
+      buildSpriteInstances();
+
+   const double fall = std::pow(std::max(0.0, time - 33.0), 4.0), rfall = 1.0 + fall * 0.02;
+
+   sprite_shader.bind();
+   sprite_shader.uniform1f("material", 0.0f);
+   sprite_shader.uniform1f("bump_scale", 1.0f);
+   sprite_shader.uniform1f("time", time);
+   sprite_shader.uniform1f("fall", fall);
+   sprite_shader.uniform1f("rfall", rfall);
+   sprite_shader.uniform1f("approach", cubic(std::min(1.0f, time / 9)) * 2);
+   sprite_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
+
+   glEnableVertexAttribArray(0);
+   glEnableVertexAttribArray(2);
+   glEnableVertexAttribArray(3);
+   glEnableVertexAttribArray(4);
+   glVertexAttribDivisor(3, 1);
+   glVertexAttribDivisor(4, 1);
+
+   for(int k=0;k<num_sprite_meshes;++k)
+   {
+      if(sprite_instance_count[k] == 0)
+         continue;
+
+      const GLfloat* first = (const GLfloat*)0 + sprite_instance_first[k] * 6;
+
+      for(int j=0;j<max_sprite_cols;++j)
+      {
+         Mesh& mesh = sprite_meshes[k][j];
+
+         if(mesh.getTriangleCount() == 0)
+            continue;
+
+         const Vec3& col = sprite_cols[k][j];
+
+         mesh.bind();
+
+         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
+         glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(mesh.getVertexCount() * sizeof(GLfloat) * 3));
+
+         glBindBuffer(GL_ARRAY_BUFFER, sprite_instance_vbo);
+         glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 6, first);
+         glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 6, first + 4);
+
+         sprite_shader.uniform3f("colour", col.x, col.y, col.z);
+
+         glDrawElementsInstanced(GL_TRIANGLES, mesh.getTriangleCount() * 3, GL_UNSIGNED_INT, 0, sprite_instance_count[k]);
+
+         CHECK_FOR_ERRORS;
+      }
+   }
+
+   glVertexAttribDivisor(3, 0);
+   glVertexAttribDivisor(4, 0);
+   glDisableVertexAttribArray(0);
+   glDisableVertexAttribArray(2);
+   glDisableVertexAttribArray(3);
+   glDisableVertexAttribArray(4);
+
+   glUseProgram(0);
+
+   CHECK_FOR_ERRORS;
+}
+
 void ForrestScene::drawView()
 {
    const float aspect_ratio = float(window_height) / float(window_width);
@@ -1036,7 +964,7 @@ void ForrestScene::drawView()
 
    projection = Mat4::frustum(-1.0f, +1.0f, -aspect_ratio, +aspect_ratio, znear, zfar) * projection;
 
-   const float A = 1.0f / 10.0f, focallength = znear, focalplane = 25.0f + cam_focus_spline.evaluate(frame_num);
+   const float A = 1.0f / 10.0f, focallength = znear, focalplane = 25.0f + sampledAt(cam_focus_frames, frame_num);
 
    const float CoCScale = (A * focallength * focalplane * (zfar - znear)) / ((focalplane - focallength) * znear * zfar);
    const float CoCBias = (A * focallength * (znear - focalplane)) / ((focalplane * focallength) * znear);
@@ -1044,9 +972,11 @@ void ForrestScene::drawView()
    forrest_shader.uniform2f("CoCScaleAndBias", CoCScale, CoCBias);
    forrest_shader.uniform1f("time", time);
 
-   modelview = modelview * Mat4::rotation(cam_rotX_spline.evaluate(frame_num), Vec3(1.0f, 0.0f, 0.0f));
-   modelview = modelview * Mat4::translation(Vec3(0.0f, -1.0f + cam_posY_spline.evaluate(frame_num), -3.0f - cam_dist_spline.evaluate(frame_num)));
-   modelview = modelview * Mat4::rotation(cam_rotY_spline.evaluate(frame_num), Vec3(0.0f, 1.0f, 0.0f));
+   sprite_shader.uniform2f("CoCScaleAndBias", CoCScale, CoCBias);
+
+   modelview = modelview * Mat4::rotation(sampledAt(cam_rotX_frames, frame_num), Vec3(1.0f, 0.0f, 0.0f));
+   modelview = modelview * Mat4::translation(Vec3(0.0f, -1.0f + sampledAt(cam_posY_frames, frame_num), -3.0f - sampledAt(cam_dist_frames, frame_num)));
+   modelview = modelview * Mat4::rotation(sampledAt(cam_rotY_frames, frame_num), Vec3(0.0f, 1.0f, 0.0f));
 
    //modelview = modelview * Mat4::translation(Vec3(0.0f, -1.0f, -6.0f + sin(time)));
    //modelview = modelview * Mat4::rotation(time * 0.3f, Vec3(0.0f, 1.0f, 0.0f));
@@ -1109,57 +1039,8 @@ void ForrestScene::drawView()
 
 
 
-   forrest_shader.bind();
-   forrest_shader.uniform1f("material", 0.0f);
-
    if(time > 1)
-   for(int i=0;i<800;++i)
-   {
-      for(int j=0;j<max_sprite_cols;++j)
-      {
-         const int k = i%num_sprite_meshes;
-
-         Mesh& mesh = sprite_meshes[k][j];
-
-         if(mesh.getTriangleCount() == 0)
-            continue;
-
-         const Vec3& col = sprite_cols[k][j];
-
-         mesh.bind();
-
-         Vec3 pos(sin(i*7)*5+sin(time*0.1+i)*0.06, sin(i*26)*2+cos(time*0.1+i)*0.3, (-sin(i*88))*1.2 + 2 - cubic(std::min(1.0f, time / 9)) * 2 );
-
-         pos = pos * 10;
-
-         const double fall = std::pow(std::max(0.0, time - 33.0), 4.0), rfall = 1.0 + fall * 0.02;
-
-         pos.y -= fall;
-
-         Mat4 rot = Mat4::rotation(cos((i+time*0.3*rfall)*0.4), Vec3(1, 0, 0)) *
-                    Mat4::rotation(sin((i+time*0.2*rfall)*0.5), Vec3(0, 1, 0));
-
-         Mat4 modelview2 = Mat4::translation(Vec3(0, 0, -2.6 * 1.2 * 10)) * Mat4::translation(pos) * rot * Mat4::scale(Vec3(0.6,0.6,0.6));
-
-         glEnableVertexAttribArray(0);
-         glEnableVertexAttribArray(2);
-
-         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
-         glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(mesh.getVertexCount() * sizeof(GLfloat) * 3));
-
-         forrest_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview2.e);
-         //forrest_shader.uniform3f("colour", (i%3)*0.33f, ((i+1)%3)*0.33f, ((i+2)%3)*0.33f);
-         forrest_shader.uniform3f("colour", col.x, col.y, col.z);
-
-         glDrawRangeElements(GL_TRIANGLES, 0, mesh.getVertexCount() - 1, mesh.getTriangleCount() * 3, GL_UNSIGNED_INT, 0);
-
-         glDisableVertexAttribArray(0);
-         glDisableVertexAttribArray(2);
-
-         CHECK_FOR_ERRORS;
-      }
-   }
-
+      drawSprites(projection);
 
    glUseProgram(0);
 
@@ -1472,8 +1353,14 @@ void ForrestScene::render()
 
 void ForrestScene::free()
 {
+   glDeleteBuffers(1, &sprite_instance_vbo);
+   sprite_instance_vbo = 0;
+   game_text_cache.clear();
    glDeleteTextures(num_texs, texs);
+   glDeleteTextures(1, &game_font);
    glDeleteFramebuffers(num_fbos, fbos);
    glDeleteRenderbuffers(num_fbos, renderbuffers);
+
+   initialized = false;
 }
 
@@ -0,0 +1,239 @@
+#include "Game.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace game;
+
+// xorshift32
+unsigned int game::Random::next()
+{
+   state ^= state << 13;
+   state ^= state >> 17;
+   state ^= state << 5;
+   return state;
+}
+
+float game::Random::uniform()
+{
+   return float(next() >> 8) / float(1 << 24);
+}
+
+int game::Random::below(int n)
+{
+   return int(next() % unsigned(n));
+}
+
+Vec2 game::quantise(const Vec2& v, int width, int height)
+{
+   return Vec2(std::floor((v.x + 1.0f) * 0.5f * width) / width,
+               std::floor((v.y + 1.0f) * 0.5f * height) / height) * 2.0f - Vec2(1.0f, 1.0f);
+}
+
+static inline float mix(float a, float b, float t)
+{
+   return a + (b - a) * t;
+}
+
+static inline float saturate(float x)
+{
+   return std::min(1.0f, std::max(0.0f, x));
+}
+
+game::Pong::Pong(unsigned int seed): random(seed)
+{
+   ballpos = Vec2(0, 0);
+   bat0x = -0.84f;
+   bat1x = +0.84f;
+   bat0y = 0;
+   bat1y = 0;
+   batsize = Vec2(0.06f, 0.3f) * 0.5f;
+   ballsize = 0.03f;
+   ballvel = Vec2(0.16f, 0.09f) * 0.1f;
+   playing = true;
+   num_steps = 0;
+   num_hits = 0;
+}
+
+void game::Pong::step()
+{
+   const float time = num_steps * step_seconds;
+
+   ++num_steps;
+
+   ballpos += ballvel;
+
+   if(playing)
+   {
+      bat0y = mix(std::cos(time) * 0.4f, ballpos.y, saturate(-ballpos.x * 1.2f));
+      bat1y = mix(std::sin(time * 0.8f) * 0.4f, ballpos.y, saturate(+ballpos.x * 1.2f));
+
+      if(std::abs(ballpos.x) > bat1x - batsize.x - ballsize)
+      {
+         ballvel.x *= -1;
+         ballvel.y += (random.uniform() - 0.5f) * 0.01f;
+         ++num_hits;
+      }
+   }
+   else
+   {
+      bat0y += 0.02f;
+      bat1y -= 0.02f;
+   }
+
+   if(std::abs(ballpos.y) > 0.7f - ballsize)
+      ballvel.y *= -1;
+}
+
+void game::Pong::addQuads(std::vector<Quad>& quads) const
+{
+   const Quad ball = { ballpos - Vec2(ballsize), ballpos + Vec2(ballsize), 0 };
+   const Quad bat0 = { Vec2(bat0x, bat0y) - batsize, Vec2(bat0x, bat0y) + batsize, 0 };
+   const Quad bat1 = { Vec2(bat1x, bat1y) - batsize, Vec2(bat1x, bat1y) + batsize, 0 };
+
+   quads.push_back(ball);
+   quads.push_back(bat0);
+   quads.push_back(bat1);
+}
+
+// the moves for each direction, in the order of the directions
+static const int g_moves[4][2] = { { -1, 0 }, { +1, 0 }, { 0, -1 }, { 0, +1 } };
+
+game::Snake::Snake(unsigned int seed): random(seed)
+{
+   for(int i = 0; i < grid_w * grid_h; ++i)
+   {
+      grid[i][0] = -1;
+      grid[i][1] = 0;
+   }
+
+   for(int i = 0; i < num_snakes; ++i)
+   {
+      snakes[i][0] = random.below(grid_w);
+      snakes[i][1] = random.below(grid_h);
+      snakes[i][2] = random.below(4);
+      snakes[i][3] = 0;
+      body_lengths[i] = 0;
+   }
+
+   update_count = 0;
+}
+
+bool game::Snake::cellFree(int x, int y) const
+{
+   if(x < 0 || y < 0 || x >= grid_w || y >= grid_h)
+      return false;
+
+   return grid[x + y * grid_w][1] == 0;
+}
+
+void game::Snake::step()
+{
+   ++update_count;
+
+   if(update_count % steps_per_move)
+      return;
+
+   for(int i = 0; i < num_snakes; ++i)
+   {
+      int* s = snakes[i];
+
+      if(((update_count / steps_per_move + i) & 7) == 0)
+         s[2] = random.below(4);
+
+      // straight on, or else the first free turn in an order which is flipped at random
+      const bool flip_x = random.next() & 1, flip_y = random.next() & 1;
+
+      const int order[5] = { s[2], flip_y ? 3 : 2, flip_x ? 1 : 0, flip_x ? 0 : 1, flip_y ? 2 : 3 };
+
+      s[3] = 0;
+
+      for(int j = 0; j < 5; ++j)
+      {
+         const int nx = s[0] + g_moves[order[j]][0], ny = s[1] + g_moves[order[j]][1];
+
+         if(cellFree(nx, ny))
+         {
+            s[0] = nx;
+            s[1] = ny;
+            s[2] = order[j];
+            s[3] = 1;
+            grid[nx + ny * grid_w][0] = i;
+            grid[nx + ny * grid_w][1] = snake_length;
+            break;
+         }
+      }
+   }
+
+   // the snakes which moved have a new head, and their other cells count down to being free
+   for(int i = 0; i < num_snakes; ++i)
+   {
+      if(!snakes[i][3])
+         continue;
+
+      int* body = bodies[i];
+      int& length = body_lengths[i];
+
+      body[length++] = snakes[i][0] + snakes[i][1] * grid_w;
+
+      for(int j = 0; j < length; ++j)
+         --grid[body[j]][1];
+
+      if(grid[body[0]][1] == 0)
+      {
+         grid[body[0]][0] = -1;
+         std::copy(body + 1, body + length, body);
+         --length;
+      }
+   }
+
+   buildQuads();
+}
+
+void game::Snake::addQuads(std::vector<Quad>& quads) const
+{
+   quads.insert(quads.end(), this->quads.begin(), this->quads.end());
+}
+
+// Each cell is a cross of two quads, which reach over to the cells before and after it in the
+// snake.
+void game::Snake::buildQuads()
+{
+   quads.clear();
+
+   const float s = 0.1f, scale = 0.9f;
+   const Vec2 grid_size(grid_w, grid_h);
+
+   for(int i = 0; i < num_snakes; ++i)
+      for(int j = 0; j < body_lengths[i]; ++j)
+      {
+         const int cell = bodies[i][j];
+         const int x = cell % grid_w, y = cell / grid_w;
+
+         float x0 = s, y0 = s, x1 = 1 - s, y1 = 1 - s;
+
+         for(int k = j - 1; k <= j + 1; k += 2)
+         {
+            if(k < 0 || k >= body_lengths[i])
+               continue;
+
+            const int u = bodies[i][k] % grid_w - x, v = bodies[i][k] / grid_w - y;
+
+            x0 += std::min(u, 0) * s;
+            y0 += std::min(v, 0) * s;
+            x1 += std::max(u, 0) * s;
+            y1 += std::max(v, 0) * s;
+         }
+
+         const Vec2 p(x, y);
+
+         const Quad across = { ((p + Vec2(x0, s)) * 2.0f / grid_size - Vec2(1.0f)) * scale,
+                               ((p + Vec2(x1, 1 - s)) * 2.0f / grid_size - Vec2(1.0f)) * scale, 0 };
+
+         const Quad down = { ((p + Vec2(s, y0)) * 2.0f / grid_size - Vec2(1.0f)) * scale,
+                             ((p + Vec2(1 - s, y1)) * 2.0f / grid_size - Vec2(1.0f)) * scale, 0 };
+
+         quads.push_back(across);
+         quads.push_back(down);
+      }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Vec.hpp"
+
+#include <vector>
+
+// The pong and snake games shown on the screen in ForrestScene.
+// They only simulate, and have no GL in them, so they can be run without a window (see
+// GameBench.cpp). Each step is a fixed 10ms tick. The random numbers come from a generator in
+// each game, so a game plays the same way every time from the same seed.
+// Their pictures come out as a list of quads in [-1, 1] coordinates for the scene to draw.
+
+namespace game
+{
+
+typedef TVec2<float> Vec2;
+
+class Random
+{
+   public:
+      Random(unsigned int seed): state(seed ? seed : 1) { }
+
+      unsigned int next();
+
+      // in [0, 1)
+      float uniform();
+
+      // in [0, n)
+      int below(int n);
+
+   private:
+      unsigned int state;
+};
+
+// c is the glyph of the game font which fills the quad.
+struct Quad
+{
+   Vec2 p0, p1;
+   int c;
+};
+
+// Rounds down to the pixel grid of a picture of the given size.
+Vec2 quantise(const Vec2& v, int width, int height);
+
+static const float step_seconds = 0.01f;
+
+struct Pong
+{
+   Vec2 ballpos, ballvel;
+   float bat0x, bat1x;
+   float bat0y, bat1y;
+   float ballsize;
+   Vec2 batsize;
+
+   // While playing, each bat wanders until the ball comes towards it and then follows the ball
+   // in, so that it is always hit. Otherwise the bats leave and the ball goes out.
+   bool playing;
+
+   int num_steps, num_hits;
+
+   Random random;
+
+   Pong(unsigned int seed = 1);
+
+   void step();
+   void addQuads(std::vector<Quad>& quads) const;
+};
+
+struct Snake
+{
+   static const int num_snakes = 12, grid_w = 32, grid_h = 32, snake_length = 10;
+
+   // the snakes move once in this many steps
+   static const int steps_per_move = 16;
+
+   int snakes[num_snakes][4]; // x, y, dir, free
+   int update_count;
+   int grid[grid_w * grid_h][2]; // snake index, counter
+
+   // the cells of each snake from its tail to its head, so that only they are visited
+   int bodies[num_snakes][snake_length];
+   int body_lengths[num_snakes];
+
+   Random random;
+
+   // the picture only changes when the snakes move, so it is kept from then
+   std::vector<Quad> quads;
+
+   Snake(unsigned int seed = 1);
+
+   bool cellFree(int x, int y) const;
+
+   void step();
+   void addQuads(std::vector<Quad>& quads) const;
+
+   private:
+      void buildQuads();
+};
+
+}
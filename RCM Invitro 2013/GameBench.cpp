@@ -0,0 +1,88 @@
+// Runs the games from ForrestScene without a window, as fast as possible, and prints how many
+// games per second were played and a checksum of the pictures drawn in them. The checksum is the
+// same for every run of the same build, so a change to the games can be checked against it.
+//
+// g++ -O2 GameBench.cpp Game.cpp -o gamebench
+// gamebench [number of games]
+
+#include "Game.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+// as in the scene, the games are played for 9 seconds and then the bats leave and the snakes
+// move until it ends at 34 seconds
+static const int num_playing_steps = 900, num_leaving_steps = 2500;
+
+// the quads are taken every this many steps, as the scene would draw them
+static const int steps_per_frame = 4;
+
+static unsigned int hashFloats(unsigned int hash, const float* f, int n)
+{
+   for(int i = 0; i < n; ++i)
+   {
+      unsigned int u;
+      memcpy(&u, &f[i], sizeof(u));
+      hash = (hash ^ u) * 16777619u;
+   }
+
+   return hash;
+}
+
+int main(int argc, char** argv)
+{
+   const int num_games = (argc > 1) ? atoi(argv[1]) : 10000;
+
+   std::vector<game::Quad> quads;
+   unsigned int hash = 2166136261u;
+   long num_quads = 0, num_hits = 0;
+
+   const clock_t start = clock();
+
+   for(int i = 0; i < num_games; ++i)
+   {
+      game::Pong pong(i + 1);
+      game::Snake snake(i + 1);
+
+      for(int j = 0; j < num_playing_steps + num_leaving_steps; ++j)
+      {
+         pong.playing = j < num_playing_steps;
+
+         if(!pong.playing)
+            snake.step();
+
+         pong.step();
+
+         if((j % steps_per_frame) == 0)
+         {
+            quads.clear();
+            snake.addQuads(quads);
+            pong.addQuads(quads);
+
+            // the pong of every picture
+            const float state[] = { pong.ballpos.x, pong.ballpos.y, pong.bat0y, pong.bat1y };
+
+            num_quads += quads.size();
+            hash = hashFloats(hash, state, 4);
+         }
+      }
+
+      // and all of the last picture
+      for(size_t j = 0; j < quads.size(); ++j)
+      {
+         const float corners[] = { quads[j].p0.x, quads[j].p0.y, quads[j].p1.x, quads[j].p1.y };
+         hash = hashFloats(hash, corners, 4);
+      }
+
+      num_hits += pong.num_hits;
+   }
+
+   const double seconds = double(clock() - start) / CLOCKS_PER_SEC;
+
+   printf("%d games in %.3f seconds, %.0f games per second\n", num_games, seconds, num_games / seconds);
+   printf("%ld quads, %ld hits, checksum %08x\n", num_quads, num_hits, hash);
+
+   return 0;
+}
@@ -529,6 +529,133 @@ void Mesh::addInstance(const Mesh& mesh, const Mat4& transform)
    }
 }
 
+void Mesh::addFace(const Vec3* corners, bool reverse)
+{
+   assert(vcount + 4 <= max_vcount);
+   assert(tcount + 2 <= max_tcount);
+
+   const GLuint i0 = vcount;
+
+   for(int i = 0; i < 4; ++i)
+   {
+      vertices[vcount * 3 + 0] = corners[i].x;
+      vertices[vcount * 3 + 1] = corners[i].y;
+      vertices[vcount * 3 + 2] = corners[i].z;
+      ++vcount;
+   }
+
+   // corners 0, 1, 3, 2 go anticlockwise unless reversed
+   const GLuint quad[6] = { 0, 1, 3, 0, 3, 2 };
+
+   for(int i = 0; i < 6; ++i)
+      indices[tcount * 3 + i] = i0 + quad[reverse ? 5 - i : i];
+
+   tcount += 2;
+
+   Vec3 normal = (corners[1] - corners[0]).cross(corners[3] - corners[0]);
+
+   if(reverse)
+      normal = -normal;
+
+   normal = normal * (1.0f / sqrtf(normal.lengthSquared()));
+
+   for(GLuint v = i0; v < vcount; ++v)
+   {
+      normals[v * 3 + 0] = normal.x;
+      normals[v * 3 + 1] = normal.y;
+      normals[v * 3 + 2] = normal.z;
+   }
+}
+
+void Mesh::addVoxels(const int* cells, const uint w, const uint h, const uint d, const int value,
+                     const Mat4& transform)
+{
+   dirty = true;
+
+   assert(indices != NULL);
+   assert(vertices != NULL);
+   assert(normals != NULL);
+   assert(cells != NULL);
+
+   const int dims[3] = { int(w), int(h), int(d) };
+   const int strides[3] = { 1, int(w), int(w * h) };
+
+   if(std::find(cells, cells + w * h * d, value) == cells + w * h * d)
+      return;
+
+   // a transform which mirrors would turn the faces inside out
+   const bool mirrored = transform.determinant() < 0;
+
+   std::vector<char> mask;
+
+   for(int axis = 0; axis < 3; ++axis)
+   {
+      const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+      const int mw = dims[u], mh = dims[v];
+
+      mask.resize(mw * mh);
+
+      for(int side = 0; side < 2; ++side)
+         for(int layer = 0; layer < dims[axis]; ++layer)
+         {
+            // the faces of this layer which are on the outside
+            const bool edge = side ? (layer == dims[axis] - 1) : (layer == 0);
+
+            int c[3];
+            c[axis] = layer;
+
+            for(c[v] = 0; c[v] < mh; ++c[v])
+               for(c[u] = 0; c[u] < mw; ++c[u])
+               {
+                  const int ci = c[0] + c[1] * strides[1] + c[2] * strides[2];
+
+                  mask[c[u] + c[v] * mw] = cells[ci] == value &&
+                                           (edge || cells[side ? ci + strides[axis] : ci - strides[axis]] == 0);
+               }
+
+            // grow each rectangle along u and then along v, taking its faces out of the mask
+            for(int j = 0; j < mh; ++j)
+               for(int i = 0; i < mw; ++i)
+               {
+                  if(!mask[i + j * mw])
+                     continue;
+
+                  int qw = 1, qh = 1;
+
+                  while(i + qw < mw && mask[i + qw + j * mw])
+                     ++qw;
+
+                  for(; j + qh < mh; ++qh)
+                  {
+                     int k = 0;
+
+                     while(k < qw && mask[i + k + (j + qh) * mw])
+                        ++k;
+
+                     if(k < qw)
+                        break;
+                  }
+
+                  for(int y = j; y < j + qh; ++y)
+                     for(int x = i; x < i + qw; ++x)
+                        mask[x + y * mw] = false;
+
+                  Vec3 corners[4];
+
+                  for(int k = 0; k < 4; ++k)
+                  {
+                     corners[k][axis] = layer + side;
+                     corners[k][u] = i + ((k & 1) ? qw : 0);
+                     corners[k][v] = j + ((k & 2) ? qh : 0);
+                     corners[k] = transform * corners[k];
+                  }
+
+                  addFace(corners, (side == 0) != mirrored);
+               }
+         }
+   }
+}
+
 void Mesh::reverseWindings()
 {
    dirty = true;
@@ -3,10 +3,34 @@
 
 #include <cctype>
 
+static const std::string g_scrollerText =
+   "relive the classics!.. sinclair .. amstrad .. sega .. acorn .. "
+   "commodore .. nintendo .. apple .. tandy .. sony .. philips .."
+   " and much more!";
+
 class PSXScene: public Scene
 {
    model::Mesh amiga_mesh, atari_mesh, c64_mesh, gameboy_mesh, torus_mesh;
 
+   // A model::Mesh in one interleaved vertex buffer of position and texcoord, with its
+   // triangles sorted by material so that each material is one range of the index buffer.
+   struct BakedModel
+   {
+      struct Range
+      {
+         const model::Material* material;
+         GLuint first, count; // in indices
+         GLuint min_vertex, max_vertex;
+      };
+
+      GLuint vbo, ebo;
+      std::vector<Range> ranges;
+
+      BakedModel(): vbo(0), ebo(0) { }
+   };
+
+   BakedModel amiga_model, atari_model, c64_model, gameboy_model, torus_model;
+
    Shader screen_shader, gaussblur_shader, composite_shader;
    Shader screen2_shader, screendisplay_shader, zoomblur_shader;
    Shader mesh_shader, torus_shader, text_shader;
@@ -28,30 +52,34 @@ class PSXScene: public Scene
    GLuint font_tex;
    GLuint credits_tex;
 
-   GLfloat text_coords[8192 * 2];
-   GLfloat text_vertices[8192 * 2];
-   GLushort text_indices[8192], num_text_vertices, num_text_indices;
+   text::Font font;
+   text::Cache text_cache;
+   const text::Mesh* scroller_text;
+
+   // whether the shaders, textures, meshes, fonts and splines have been set up, which free()
+   // leaves alone
+   bool set_up;
 
    void initializeTextures();
    void initializeShaders();
    void initializeBuffers();
    void initialiseMeshes();
+   void bakeModels();
+   void initializeText();
+   void cacheText();
 
    void gaussianBlur(GLuint srctex);
    void renderDisplay();
    void renderDisplayWires(float t, const Mat4& projection);
 
    void bindMaterialForMesh(const model::Material *const mat);
-   void renderModel(const model::Mesh *const m);
-
-   void addTextQuad(Vec2 p0, Vec2 p1, int c = 0);
-   void addText(Vec2 org, const std::string& text);
+   void bakeModel(const model::Mesh& m, BakedModel& baked);
+   void freeModel(BakedModel& baked);
+   void renderModel(const BakedModel& baked);
 
    public:
-      PSXScene()
+      PSXScene(): font(GL_TRIANGLES, 0.7), scroller_text(0), set_up(false)
       {
-         num_text_vertices = 0;
-         num_text_indices = 0;
       }
 
       void initialize();
@@ -64,79 +92,42 @@ Scene* psxScene = new PSXScene();
 
 const int gauss_divisor = 4;
 
-void PSXScene::addTextQuad(Vec2 p0, Vec2 p1, int c)
+void PSXScene::initializeText()
 {
-   if(c < 0)
-      return;
-
-   GLushort i0 = num_text_vertices, i1 = i0 + 1, i2 = i0 + 2, i3 = i0 + 3;
-
    const int gw = 16, gh = 3;
-   const int x = c % gw, y = gh - ((c / gw) % gh) - 1;
 
-   const Vec2 c0 = Vec2(Real(x + 0) / Real(gw), Real(y + 0) / Real(gh));
-   const Vec2 c1 = Vec2(Real(x + 1) / Real(gw), Real(y + 1) / Real(gh));
-
-   text_vertices[i0 * 2 + 0] = p0.x;
-   text_vertices[i0 * 2 + 1] = p0.y;
-
-   text_vertices[i1 * 2 + 0] = p1.x;
-   text_vertices[i1 * 2 + 1] = p0.y;
-
-   text_vertices[i2 * 2 + 0] = p0.x;
-   text_vertices[i2 * 2 + 1] = p1.y;
-
-   text_vertices[i3 * 2 + 0] = p1.x;
-   text_vertices[i3 * 2 + 1] = p1.y;
-
-   text_coords[i0 * 2 + 0] = c0.x;
-   text_coords[i0 * 2 + 1] = c0.y;
-
-   text_coords[i1 * 2 + 0] = c1.x;
-   text_coords[i1 * 2 + 1] = c0.y;
+   for(int c = 0; c < 256; ++c)
+   {
+      int g = -1;
 
-   text_coords[i2 * 2 + 0] = c0.x;
-   text_coords[i2 * 2 + 1] = c1.y;
+      if(c == '!')
+         g = 36;
+      else if(c == '.')
+         g = 38;
+      else if(isalpha(c))
+         g = tolower(c) - 'a';
+      else if(isdigit(c))
+         g = 26 + c - '0';
 
-   text_coords[i3 * 2 + 0] = c1.x;
-   text_coords[i3 * 2 + 1] = c1.y;
+      if(g < 0)
+         continue;
 
-   text_indices[num_text_indices + 0] = i0;
-   text_indices[num_text_indices + 1] = i1;
-   text_indices[num_text_indices + 2] = i2;
+      const int x = g % gw, y = gh - ((g / gw) % gh) - 1;
 
-   text_indices[num_text_indices + 3] = i1;
-   text_indices[num_text_indices + 4] = i3;
-   text_indices[num_text_indices + 5] = i2;
+      font.addQuad(c, Vec2(Real(x + 0) / Real(gw), Real(y + 0) / Real(gh)),
+                      Vec2(Real(x + 1) / Real(gw), Real(y + 1) / Real(gh)));
+   }
 
-   num_text_vertices += 4;
-   num_text_indices += 6;
+   font.setAdvance('w', 1);
+   font.setAdvance('m', 1);
+   font.setAdvance('i', 0.4);
 }
 
-void PSXScene::addText(Vec2 org, const std::string& text)
+void PSXScene::cacheText()
 {
    const Vec2 sz(0.15, 0.1);
 
-   for(std::string::const_iterator it = text.begin(); it != text.end(); ++it)
-   {
-      if(!isspace(*it))
-      {
-         if(*it == '!')
-            addTextQuad(org, org + sz, 36);
-         else if(*it == '.')
-            addTextQuad(org, org + sz, 38);
-         else if(isalpha(*it))
-            addTextQuad(org, org + sz, tolower(*it) - 'a');
-         else if(isdigit(*it))
-            addTextQuad(org, org + sz, 26 + *it - '0');
-      }
-      if(*it == 'w' || *it == 'm')
-         org.x += sz.x;
-      else if(*it == 'i')
-         org.x += sz.x * 0.4;
-      else
-         org.x += sz.x * 0.7;
-   }
+   scroller_text = text_cache.get(font, g_scrollerText, sz, sz);
 }
 
 
@@ -160,6 +151,113 @@ void PSXScene::initialiseMeshes()
    torus_mesh.centerOrigin();
 }
 
+void PSXScene::bakeModels()
+{
+   bakeModel(amiga_mesh, amiga_model);
+   bakeModel(atari_mesh, atari_model);
+   bakeModel(c64_mesh, c64_model);
+   bakeModel(gameboy_mesh, gameboy_model);
+   bakeModel(torus_mesh, torus_model);
+}
+
+void PSXScene::bakeModel(const model::Mesh& m, BakedModel& baked)
+{
+   // materials in the order in which they first appear, so that the draw order is as in the file
+   std::vector<const model::Material*> materials;
+   std::vector<std::vector<uint> > material_triangles;
+
+   for(uint j = 0; j < m.triangles.size(); ++j)
+   {
+      const model::Material* mat = m.triangles[j].material;
+      const uint k = std::find(materials.begin(), materials.end(), mat) - materials.begin();
+
+      if(k == materials.size())
+      {
+         materials.push_back(mat);
+         material_triangles.push_back(std::vector<uint>());
+      }
+
+      material_triangles[k].push_back(j);
+   }
+
+   // corners which share a position and texcoord share a vertex
+   std::map<std::pair<uint, std::pair<Real, Real> >, GLuint> vertex_map;
+   std::vector<GLfloat> vertices;
+   std::vector<GLuint> indices;
+
+   baked.ranges.clear();
+
+   for(uint k = 0; k < materials.size(); ++k)
+   {
+      BakedModel::Range range;
+      range.material = materials[k];
+      range.first = indices.size();
+      range.min_vertex = ~0u;
+      range.max_vertex = 0;
+
+      for(uint n = 0; n < material_triangles[k].size(); ++n)
+      {
+         const model::Mesh::Triangle& t = m.triangles[material_triangles[k][n]];
+         const uint corners[3] = { t.a, t.b, t.c };
+
+         for(int c = 0; c < 3; ++c)
+         {
+            const std::pair<uint, std::pair<Real, Real> > key(corners[c], std::make_pair(t.texcoords[c].x, t.texcoords[c].y));
+            std::map<std::pair<uint, std::pair<Real, Real> >, GLuint>::const_iterator it = vertex_map.find(key);
+
+            GLuint index;
+
+            if(it != vertex_map.end())
+               index = it->second;
+            else
+            {
+               index = vertices.size() / 5;
+               vertex_map[key] = index;
+
+               const Vec3& v = m.vertices[corners[c]];
+               vertices.push_back(v.x);
+               vertices.push_back(v.y);
+               vertices.push_back(v.z);
+               vertices.push_back(t.texcoords[c].x);
+               vertices.push_back(t.texcoords[c].y);
+            }
+
+            indices.push_back(index);
+            range.min_vertex = std::min(range.min_vertex, index);
+            range.max_vertex = std::max(range.max_vertex, index);
+         }
+      }
+
+      range.count = indices.size() - range.first;
+      baked.ranges.push_back(range);
+   }
+
+   if(baked.vbo == 0)
+      glGenBuffers(1, &baked.vbo);
+
+   if(baked.ebo == 0)
+      glGenBuffers(1, &baked.ebo);
+
+   glBindBuffer(GL_ARRAY_BUFFER, baked.vbo);
+   glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, baked.ebo);
+   glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+   CHECK_FOR_ERRORS;
+}
+
+void PSXScene::freeModel(BakedModel& baked)
+{
+   glDeleteBuffers(1, &baked.vbo);
+   glDeleteBuffers(1, &baked.ebo);
+   baked.vbo = 0;
+   baked.ebo = 0;
+   baked.ranges.clear();
+}
+
 void PSXScene::initializeTextures()
 {
    glGenTextures(num_texs, texs);
@@ -311,24 +409,43 @@ void PSXScene::initialize()
 
    initialized = true;
 
-   initializeShaders();
-   initializeTextures();
-   initializeBuffers();
-   initialiseMeshes();
-
-   zoom_spline.insert(1, 0, 1000);
-   //zoom_spline.insert(50, 0, 4000);
-   zoom_spline.initialize();
+   if(!set_up)
+   {
+      set_up = true;
+
+      initializeShaders();
+      initializeTextures();
+      initializeBuffers();
+      initialiseMeshes();
+      initializeText();
+
+      zoom_spline.insert(1, 0, 1000);
+      //zoom_spline.insert(50, 0, 4000);
+      zoom_spline.initialize();
+
+      tint_spline.insert(0, 0, 0);
+      tint_spline.insert(1, 0, 400);
+      tint_spline.insert(1, 0, 4250);
+      tint_spline.insert(0, 0, 4400);
+      tint_spline.initialize();
+   }
 
-   tint_spline.insert(0, 0, 0);
-   tint_spline.insert(1, 0, 400);
-   tint_spline.insert(1, 0, 4250);
-   tint_spline.insert(0, 0, 4400);
-   tint_spline.initialize();
+   // free() releases these, so they are made again each time the scene is initialized
+   bakeModels();
+   cacheText();
 }
 
 void PSXScene::free()
 {
+   freeModel(amiga_model);
+   freeModel(atari_model);
+   freeModel(c64_model);
+   freeModel(gameboy_model);
+   freeModel(torus_model);
+   text_cache.clear();
+   scroller_text = 0;
+
+   initialized = false;
 }
 
 void PSXScene::gaussianBlur(GLuint srctex)
@@ -446,73 +563,32 @@ void PSXScene::bindMaterialForMesh(const model::Material *const mat)
    mesh_shader.uniform4f("colour", mat->diffuse.x, mat->diffuse.y, mat->diffuse.z, 1);
 }
 
-void PSXScene::renderModel(const model::Mesh *const m)
+void PSXScene::renderModel(const BakedModel& baked)
 {
-   const model::Material* mat = 0;
-
-   static GLushort indices[1024*4];
-   static GLfloat vertices[1024*4*3];
-   static GLfloat coords[1024*4*2];
-   int num_vertices=0;
-
    glDisable(GL_CULL_FACE);
 
+   glBindBuffer(GL_ARRAY_BUFFER, baked.vbo);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, baked.ebo);
+
    glEnableVertexAttribArray(0);
    glEnableVertexAttribArray(1);
 
-   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, vertices);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
+   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5, (GLvoid*)0);
+   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5, (GLvoid*)(sizeof(GLfloat) * 3));
 
-   for(int j=0;j<m->triangles.size();++j)
+   for(uint k = 0; k < baked.ranges.size(); ++k)
    {
-      const model::Mesh::Triangle& t = m->triangles[j];
-
-      if(t.material != mat)
-      {
-         if(mat)
-         {
-            bindMaterialForMesh(mat);
-            glDrawRangeElements(GL_TRIANGLES, 0, num_vertices, num_vertices, GL_UNSIGNED_SHORT, indices);
-         }
-
-         mat = t.material;
-         num_vertices=0;
-      }
-
-      indices[num_vertices] = num_vertices;
-      vertices[num_vertices*3+0]=m->vertices[t.a].x;
-      vertices[num_vertices*3+1]=m->vertices[t.a].y;
-      vertices[num_vertices*3+2]=m->vertices[t.a].z;
-      coords[num_vertices*2+0]=t.texcoords[0].x;
-      coords[num_vertices*2+1]=t.texcoords[0].y;
-      ++num_vertices;
-
-      indices[num_vertices] = num_vertices;
-      vertices[num_vertices*3+0]=m->vertices[t.b].x;
-      vertices[num_vertices*3+1]=m->vertices[t.b].y;
-      vertices[num_vertices*3+2]=m->vertices[t.b].z;
-      coords[num_vertices*2+0]=t.texcoords[1].x;
-      coords[num_vertices*2+1]=t.texcoords[1].y;
-      ++num_vertices;
-
-      indices[num_vertices] = num_vertices;
-      vertices[num_vertices*3+0]=m->vertices[t.c].x;
-      vertices[num_vertices*3+1]=m->vertices[t.c].y;
-      vertices[num_vertices*3+2]=m->vertices[t.c].z;
-      coords[num_vertices*2+0]=t.texcoords[2].x;
-      coords[num_vertices*2+1]=t.texcoords[2].y;
-      ++num_vertices;
-
-      if(j == (m->triangles.size()-1))
-      {
-         bindMaterialForMesh(mat);
-         glDrawRangeElements(GL_TRIANGLES, 0, num_vertices, num_vertices, GL_UNSIGNED_SHORT, indices);
-      }
+      const BakedModel::Range& range = baked.ranges[k];
 
+      bindMaterialForMesh(range.material);
+      glDrawRangeElements(GL_TRIANGLES, range.min_vertex, range.max_vertex, range.count, GL_UNSIGNED_INT, (GLvoid*)(range.first * sizeof(GLuint)));
    }
 
    glDisableVertexAttribArray(0);
    glDisableVertexAttribArray(1);
+
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void PSXScene::renderDisplayWires(float t, const Mat4& projection)
@@ -570,15 +646,7 @@ void PSXScene::renderDisplayWires(float t, const Mat4& projection)
    // TORUS
 
    {
-      float last_arp=0.0f;
-
-      for(int i=0;i<num_alk_arps;++i)
-      {
-         if(music_time > alk_arps[i])
-            last_arp=alk_arps[i];
-         else
-            break;
-      }
+      const float last_arp=arp_track.previous(music_time);
 
       const float rate = 1.0f;
 
@@ -591,7 +659,7 @@ void PSXScene::renderDisplayWires(float t, const Mat4& projection)
       Mat4 modelview = Mat4::translation(Vec3(cos(time) * ms, sin(time) * ms, 0.0)) * Mat4::rotation(cos(time * 0.6) * 2, Vec3(0, 0, 1)) * Mat4::rotation(M_PI * 0.5, Vec3(0, 1, 0)) *
                Mat4::scale(Vec3(300, 200, 100)) * Mat4::translation(Vec3(0, 0, -1)) * Mat4::rotation(-time, Vec3(0, 1, 0));
       torus_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
-      renderModel(&torus_mesh);
+      renderModel(torus_model);
    }
 
    mesh_shader.bind();
@@ -619,27 +687,27 @@ void PSXScene::renderDisplayWires(float t, const Mat4& projection)
          {
             Mat4 modelview = vr * Mat4::translation(Vec3(0, y, z)) * Mat4::rotation(r + dr * 0, Vec3(0.0f, 1.0f, 0.0f)) * Mat4::translation(Vec3(0, 0, cd)) * rotm * outline_scaler;
             mesh_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
-            renderModel(&amiga_mesh);
+            renderModel(amiga_model);
          }
 
          {
             Mat4 modelview = vr * Mat4::translation(Vec3(0, y, z)) * Mat4::rotation(r + dr * 1, Vec3(0.0f, 1.0f, 0.0f)) * Mat4::translation(Vec3(0, 0, cd)) * rotm * outline_scaler;
             mesh_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
-            renderModel(&atari_mesh);
+            renderModel(atari_model);
          }
 
          {
             Mat4 modelview = vr * Mat4::translation(Vec3(0, y, z)) * Mat4::rotation(r + dr * 2, Vec3(0.0f, 1.0f, 0.0f)) * Mat4::translation(Vec3(0, 0, cd)) * Mat4::rotation(M_PI, Vec3(0.0f, 1.0f, 0.0f)) *
                      rotm * outline_scaler;
             mesh_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
-            renderModel(&c64_mesh);
+            renderModel(c64_model);
          }
 
          {
             Mat4 modelview = vr * Mat4::translation(Vec3(0, y, z)) * Mat4::rotation(r + dr * 3, Vec3(0.0f, 1.0f, 0.0f)) * Mat4::translation(Vec3(0, 0, cd)) * Mat4::rotation(M_PI * 1.2, Vec3(0.0f, 1.0f, 0.0f)) *
                                           Mat4::rotation(gameboy_r, Vec3(0.0f, 1.0f, 0.0f)) * Mat4::rotation(1.0, Vec3(1.0f, 0.0f, 0.0f)) * Mat4::scale(Vec3(1.2, 1.2, 1.2)) * outline_scaler;
             mesh_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
-            renderModel(&gameboy_mesh);
+            renderModel(gameboy_model);
          }
       }
 
@@ -648,52 +716,27 @@ void PSXScene::renderDisplayWires(float t, const Mat4& projection)
    {
       Mat4 modelview = Mat4::translation(Vec3(2.0 - time, 0.52, -1.8));
 
-      num_text_indices = 0;
-      num_text_vertices = 0;
-
-      static const std::string texts[] = {
-         "relive the classics!.. sinclair .. amstrad .. sega .. acorn .. "
-         "commodore .. nintendo .. apple .. tandy .. sony .. philips .."
-         " and much more!"
-         };
-
-      addText(Vec2(0, 0), texts[0]);
-
       glDisable(GL_DEPTH_TEST);
       glDepthMask(GL_FALSE);
       glEnable(GL_BLEND);
       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-      if(num_text_indices > 0)
-      {
-         glEnableVertexAttribArray(0);
-         glEnableVertexAttribArray(1);
-
-         glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, text_vertices);
-         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, text_coords);
-
-         text_shader.bind();
-         text_shader.uniform1f("time", time);
-
-         glActiveTexture(GL_TEXTURE0);
-         glBindTexture(GL_TEXTURE_2D, font_tex);
-         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      text_shader.bind();
+      text_shader.uniform1f("time", time);
 
-
-         text_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, (modelview * Mat4::translation(Vec3(-0.01, -0.01, 0.0))).e);
-         text_shader.uniform3f("colour", 0, 0, 0);
-         glDrawRangeElements(GL_TRIANGLES, 0, num_text_vertices, num_text_indices, GL_UNSIGNED_SHORT, text_indices);
-
-         text_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
-         text_shader.uniform3f("colour", 1, 1, 1);
-         glDrawRangeElements(GL_TRIANGLES, 0, num_text_vertices, num_text_indices, GL_UNSIGNED_SHORT, text_indices);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, font_tex);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
 
+      text_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, (modelview * Mat4::translation(Vec3(-0.01, -0.01, 0.0))).e);
+      text_shader.uniform3f("colour", 0, 0, 0);
+      scroller_text->draw();
 
-         glDisableVertexAttribArray(0);
-         glDisableVertexAttribArray(1);
-      }
+      text_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
+      text_shader.uniform3f("colour", 1, 1, 1);
+      scroller_text->draw();
    }
 
 
@@ -1,11 +1,11 @@
-
 #include <vector>
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 
 static inline double random(double r)
 {
-    return double(rand()) / double(RAND_MAX);
+    return double(rand()) / (double(RAND_MAX) + 1.0) * r;
 }
 
 struct Coord
@@ -31,83 +31,130 @@ struct Coord
    }
 };
 
-struct Snake
+// A grid of one-bit cells with a one-cell border which is always set, so that
+// the neighbours of any interior cell can be tested without bounds checks.
+struct BitGrid
 {
-  static const int UP = 0;
-  static const int LEFT = 1;
-  static const int RIGHT = 2;
-  static const int DOWN = 3;
-
-  Snake()
+  BitGrid(): w(0), h(0), pitch(0)
   {
-    reset();
   }
 
-  Coord nextPos()
+  void resize(int w, int h)
   {
-    switch(dir)
+    this->w = w;
+    this->h = h;
+    pitch = w + 2;
+    bits.assign(((w + 2) * (h + 2) + 31) / 32, 0);
+
+    for (int x = 0; x < w + 2; ++x)
     {
-    case UP:
-      return (Coord){
-        pos[0], pos[1] - 1
-      };
-    case DOWN:
-      return (Coord){
-        pos[0], pos[1] + 1
-      };
-    case LEFT:
-      return (Coord){
-        pos[0] - 1, pos[1]
-      };
-    case RIGHT:
-      return (Coord){
-        pos[0] + 1, pos[1]
-      };
+      set(x);
+      set(x + (h + 1) * pitch);
     }
 
-    return pos;
+    for (int y = 0; y < h + 2; ++y)
+    {
+      set(y * pitch);
+      set(w + 1 + y * pitch);
+    }
   }
 
-  void reset()
+  int cell(int x, int y) const
   {
-    active = true;
-    black = false;
-    pos[0] = pos[1] = 0;
-    start_pos[0] = start_pos[1] = 0;
-    dir = 0;
-    id = 0;
-    step_num = 32768;
-    turn_num = 0;
-    going_backwards = false;
+    return (x + 1) + (y + 1) * pitch;
   }
 
-  bool active;
-  bool black;
-  Coord pos, start_pos;
-  int dir;
-  int id;
-  int step_num;
-  int turn_num;
-  bool going_backwards;
-};
+  bool test(int c) const
+  {
+    return (bits[c >> 5] >> (c & 31)) & 1;
+  }
 
+  void set(int c)
+  {
+    bits[c >> 5] |= 1u << (c & 31);
+  }
 
+  void reset(int c)
+  {
+    bits[c >> 5] &= ~(1u << (c & 31));
+  }
+
+  void assign(int c, bool b)
+  {
+    if (b)
+      set(c);
+    else
+      reset(c);
+  }
+
+  int w, h, pitch;
+  std::vector<unsigned int> bits;
+};
+
+// The snakes are kept as parallel arrays indexed by snake slot, and cell positions
+// are stored as indices into the padded grid.
 struct Maze
 {
-  typedef std::vector<Snake> SnakeCollection;
+  static const int UP = 0;
+  static const int LEFT = 1;
+  static const int RIGHT = 2;
+  static const int DOWN = 3;
+  static const int NONE = 4;
+
+  static const int FLAG_ACTIVE = 1;
+  static const int FLAG_BLACK = 2;
+  static const int FLAG_BACKWARDS = 4;
 
   Maze(int w, int h, int num_snakes)
   {
     this->w = w;
     this->h = h;
+    occupancy.resize(w, h);
+    blackgrid.resize(w, h);
     occupied = new int[w * h];
-    blackgrid = new bool[w * h];
+    memset(occupied, 0, sizeof(int) * w * h);
     restarts = 0;
     snake_id_counter = 1;
 
+    const int pitch = occupancy.pitch;
+    dir_offsets[UP] = -pitch;
+    dir_offsets[LEFT] = -1;
+    dir_offsets[RIGHT] = +1;
+    dir_offsets[DOWN] = +pitch;
+
     addSomeSnakes(num_snakes);
   }
 
+  ~Maze()
+  {
+    delete[] occupied;
+  }
+
+  int getSnakeCount() const
+  {
+    return int(pos.size());
+  }
+
+  int getActiveSnakeCount() const
+  {
+    return int(active.size());
+  }
+
+  Coord getSnakePos(int s) const
+  {
+    return Coord(pos[s] % occupancy.pitch - 1, pos[s] / occupancy.pitch - 1);
+  }
+
+  bool isOccupied(int x, int y) const
+  {
+    return occupancy.test(occupancy.cell(x, y));
+  }
+
+  bool isBlack(int x, int y) const
+  {
+    return blackgrid.test(blackgrid.cell(x, y));
+  }
+
   void addSomeSnakes(int n)
   {
     for (int i = 0; i < n; ++i)
@@ -125,53 +172,57 @@ struct Maze
     }
   }
 
-  bool snakeOverlaps(int x, int y)
+  // Snakes mark their cell in the occupancy grid as soon as they arrive in it, so
+  // a cell which holds a snake is never clear.
+  bool snakeOverlaps(int x, int y) const
   {
-    for (SnakeCollection::iterator s = snakes.begin(); s != snakes.end(); ++s)
-    {
-      if (x == s->pos[0] && y == s->pos[1])
-        return true;
-    }
-    return false;
+    return occupancy.test(occupancy.cell(x, y));
   }
 
   void createSnake(int x, int y)
   {
-    Snake* s = 0;
+    int s;
 
-    for(int j = 0; j < snakes.size(); ++j)
-      if(snakes[j].active == false)
-      {
-        s = &snakes[j];
-        s->reset();
-        s->id = snake_id_counter;
-        ++snake_id_counter;
-        break;
-      }
-
-    if(s == 0)
+    if (!free_slots.empty())
+    {
+      s = free_slots.back();
+      free_slots.pop_back();
+    }
+    else
     {
-      snakes.push_back(Snake());
-      s = &snakes.back();
+      s = int(pos.size());
+      pos.push_back(0);
+      start_pos.push_back(0);
+      dir.push_back(0);
+      flags.push_back(0);
+      id.push_back(0);
+      step_num.push_back(0);
+      turn_num.push_back(0);
     }
 
-    s->pos[0] = x;
-    s->pos[1] = y;
-    s->start_pos[0] = s->pos[0];
-    s->start_pos[1] = s->pos[1];
-    s->dir = int(random(4));
-    //s.black = random(1) < 0.5;
+    const int c = occupancy.cell(x, y);
+
+    pos[s] = c;
+    start_pos[s] = c;
+    dir[s] = (unsigned char)random(4);
+    flags[s] = FLAG_ACTIVE;
+    //if(random(1) < 0.5) flags[s] |= FLAG_BLACK;
+    id[s] = snake_id_counter;
+    step_num[s] = 32768;
+    turn_num[s] = 0;
 
-    s->id = snake_id_counter;
     ++snake_id_counter;
+
+    active.push_back(s);
+    visit(s);
   }
 
-  bool clear(int x, int y)
+  bool clear(int x, int y) const
   {
     if (x < 0 || y < 0 || x >= w || y >= h)
       return false;
 
-    return occupied[x + y * w] == 0;
+    return !occupancy.test(occupancy.cell(x, y));
   }
 
   /*
@@ -181,7 +232,7 @@ struct Maze
       for (int x = 0; x < w; ++x)
       {
         int id = occupied[x + y * w];
-        bool black = blackgrid[x + y * w];
+        bool black = isBlack(x, y);
         if (id > 0)
         {
           fill(255);
@@ -226,125 +277,122 @@ struct Maze
   }
 */
 
-  void update()
+  // Advances all snakes by n steps. Returns false once no snakes are left active.
+  bool update(int n = 1)
   {
-    bool any_active = false;
-    for (SnakeCollection::iterator s = snakes.begin(); s != snakes.end(); ++s)
-    {
-      if (s->active)
-      {
-        any_active = true;
+    for (int i = 0; i < n && !active.empty(); ++i)
+      step();
 
-        occupied[s->pos[0] + s->pos[1] * w] = (s->id << 16) + s->step_num;
-        blackgrid[s->pos[0] + s->pos[1] * w] = s->black;
+    return !active.empty();
+  }
 
-        Coord np = s->nextPos();
+  void step()
+  {
+    int num_active = 0;
 
-        if (clear(np[0], np[1]))
-        {
-          s->pos[0] = np[0];
-          s->pos[1] = np[1];
-          s->step_num += s->going_backwards ? -1 : +1;
+    for (size_t i = 0; i < active.size(); ++i)
+    {
+      const int s = active[i];
+      const int np = pos[s] + dir_offsets[dir[s]];
 
-          //if(s.turn_num > 10)
-            //s.active = false;
+      if (!occupancy.test(np))
+      {
+        pos[s] = np;
+        step_num[s] += (flags[s] & FLAG_BACKWARDS) ? -1 : +1;
+        visit(s);
 
-          if((s->step_num % 20) == 0)
-            s->dir = getFreeDirection(s->pos[0], s->pos[1], s->dir);
-        }
-        else
+        if ((step_num[s] % 20) == 0)
         {
-          int nd = getFreeDirection(s->pos[0], s->pos[1], s->dir);
+          const int nd = getFreeDirection(pos[s], dir[s]);
 
-          if (nd == 4)
-          {
-            if(s->going_backwards)
-              s->active = false;
-            else
-            {
-              nd = getFreeDirection(s->start_pos[0], s->start_pos[1], -1);
+          // if boxed in, keep the direction and let the next step find the way blocked
+          if (nd != NONE)
+            dir[s] = nd;
+        }
+      }
+      else
+      {
+        int nd = getFreeDirection(pos[s], dir[s]);
 
-              if(nd == 4)
-                s->active = false;
-              else
-              {
-                s->pos[0] = s->start_pos[0];
-                s->pos[1] = s->start_pos[1];
-                s->going_backwards = true;
-                s->step_num = 32768;
-                s->dir = nd;
-              }
-            }
-          }
+        if (nd == NONE)
+        {
+          if (flags[s] & FLAG_BACKWARDS)
+            nd = NONE;
           else
           {
-            s->dir = nd;
-            s->turn_num++;
-          }
-        }
-      }
-    }
+            nd = getFreeDirection(start_pos[s], -1);
 
-/*
-    if (!any_active && restarts < 40)
-    {
-      List<int[]> empties = new ArrayList<int[]>();
+            if (nd != NONE)
+            {
+              pos[s] = start_pos[s];
+              flags[s] |= FLAG_BACKWARDS;
+              step_num[s] = 32768;
+            }
+          }
 
-      for (int y = 0; y < h; ++y)
-        for (int x = 0; x < w; ++x)
-        {
-          if (occupied[x + y * w] == 0)
-          empties.add(new int[] {
-            x, y
+          if (nd == NONE)
+          {
+            flags[s] &= ~FLAG_ACTIVE;
+            free_slots.push_back(s);
+            continue;
           }
-          );
         }
+        else
+          turn_num[s]++;
 
-      Collections.shuffle(empties);
-
-      for (int i = 0; i < min(4, empties.size()); ++i)
-      {
-        Snake s = createSnake(empties.get(i)[0], empties.get(i)[1]);
-        snakes.add(s);
+        dir[s] = nd;
       }
 
-      ++restarts;
+      active[num_active++] = s;
     }
-    */
-  }
 
+    active.resize(num_active);
+  }
 
-  int getFreeDirection(int x, int y, int avoid_dir)
+  // Returns a random direction which leads to a clear cell, excluding avoid_dir,
+  // or NONE if the cell at c is boxed in.
+  int getFreeDirection(int c, int avoid_dir) const
   {
-    std::vector<int> dirs;;
-    int nd = 0;
+    int mask = 0;
 
-    for (int v = -1; v < 2; ++v)
-      for (int u = -1; u < 2; ++u)
-      {
-        if (abs(u) != abs(v))
-        {
-          if (nd != avoid_dir && clear(x + u, y + v))
-            dirs.push_back(nd);
+    for (int d = 0; d < 4; ++d)
+      mask |= (!occupancy.test(c + dir_offsets[d])) << d;
 
-          nd += 1;
-        }
-      }
+    if (avoid_dir >= 0)
+      mask &= ~(1 << avoid_dir);
 
-    if(dirs.size() == 0)
-      return 4;
+    const int count = ((mask >> 0) & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
 
-    std::random_shuffle(dirs.begin(), dirs.end());
+    if (count == 0)
+      return NONE;
 
-    return dirs[0];
+    for (int k = rand() % count; ; mask &= mask - 1, --k)
+      if (k == 0)
+        return __builtin_ctz(mask);
   }
 
   int w, h, snake_id_counter;
-  SnakeCollection snakes;
-  int* occupied;
-  bool* blackgrid;
   int restarts;
-};
 
+  // occupied holds (id << 16) + step_num of the snake which visited each cell, for drawing
+  int* occupied;
+  BitGrid occupancy, blackgrid;
+  int dir_offsets[4];
+
+  std::vector<int> pos, start_pos;
+  std::vector<unsigned char> dir, flags;
+  std::vector<int> id, step_num, turn_num;
+
+  std::vector<int> active, free_slots;
 
+private:
+  void visit(int s)
+  {
+    const int c = pos[s];
+    const int pitch = occupancy.pitch;
 
+    occupancy.set(c);
+    blackgrid.assign(c, flags[s] & FLAG_BLACK);
+    occupied[(c % pitch - 1) + (c / pitch - 1) * w] = (id[s] << 16) + step_num[s];
+  }
+};
@@ -0,0 +1,95 @@
+// Checks that the batch Spline::evaluate gives the same points as evaluating each frame on its
+// own, on random splines of reals and of vectors and on runs of frames which start before the
+// first node and end after the last. It prints the largest difference found, relative to the
+// size of the points, and fails if that is more than rounding would explain.
+//
+// g++ -O2 SplineCheck.cpp -o splinecheck
+// splinecheck [number of splines]
+
+#include "Engine.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+static const Real tolerance = 1e-5f;
+
+static unsigned int rnd_state = 1234;
+
+static Real rnd()
+{
+   rnd_state = rnd_state * 1664525u + 1013904223u;
+   return Real(rnd_state >> 8) / Real(1 << 24);
+}
+
+static Real magnitude(Real x) { return std::fabs(x); }
+static Real magnitude(const Vec3& v) { return std::max(std::fabs(v.x), std::max(std::fabs(v.y), std::fabs(v.z))); }
+
+static Real randomPoint(Real) { return (rnd() - 0.5f) * 20.0f; }
+static Vec3 randomPoint(const Vec3&) { return Vec3(rnd() - 0.5f, rnd() - 0.5f, rnd() - 0.5f) * 20.0f; }
+
+// the largest difference relative to the size of the points
+template<typename T>
+static Real check(int num_nodes)
+{
+   Spline<T> spline;
+
+   uint frame = uint(rnd() * 50);
+
+   for(int i = 0; i < num_nodes; ++i)
+   {
+      spline.insert(randomPoint(T()), randomPoint(T()), frame);
+      frame += 1 + uint(rnd() * 400);
+   }
+
+   spline.initialize();
+
+   const uint last = spline.getLastFrame();
+   Real largest = 0;
+
+   for(int run = 0; run < 4; ++run)
+   {
+      const uint first = uint(rnd() * (last + 100)), count = 1 + uint(rnd() * (last + 200));
+
+      std::vector<T> batch(count);
+      spline.evaluate(first, count, &batch[0]);
+
+      Real size = 1, difference = 0;
+
+      for(uint i = 0; i < count; ++i)
+      {
+         const T single = spline.evaluate(first + i);
+         size = std::max(size, magnitude(single));
+         difference = std::max(difference, magnitude(single - batch[i]));
+      }
+
+      largest = std::max(largest, difference / size);
+   }
+
+   return largest;
+}
+
+int main(int argc, char** argv)
+{
+   const int num_splines = (argc > 1) ? atoi(argv[1]) : 1000;
+
+   Real largest = 0;
+
+   for(int i = 0; i < num_splines; ++i)
+   {
+      const int num_nodes = 1 + int(rnd() * 20);
+      largest = std::max(largest, check<Real>(num_nodes));
+      largest = std::max(largest, check<Vec3>(num_nodes));
+   }
+
+   printf("%d splines of reals and of vectors, largest relative difference %g\n", num_splines, largest);
+
+   if(largest > tolerance)
+   {
+      printf("FAILED: the tolerance is %g\n", tolerance);
+      return 1;
+   }
+
+   printf("passed\n");
+   return 0;
+}
@@ -292,27 +292,8 @@ static void addNotes(const char *const str, const ChannelState& st,
    }
 }
 
-int initAudio()
+static void addTracks()
 {
-   SDL_AudioSpec desired;
-
-   memset(&desired, 0, sizeof(desired));
-
-   desired.freq = samplerate;
-   desired.format =  AUDIO_S16LSB;
-   desired.samples = 4096;
-   desired.callback = audioCallback;
-   desired.userdata = NULL;
-
-   if(SDL_OpenAudio(&desired, NULL))
-   {
-      log("SDL_OpenAudio failed.\n");
-      return -1;
-   }
-
-   for(int i = 0; i < noise_table_size; ++i)
-      noise_table[i] = double(rand()) / double(RAND_MAX) * 2.0 - 1.0;
-
    const double drums_start_time = barTime(16, 0);
 
 #if 1
@@ -731,12 +712,78 @@ int initAudio()
    std::sort(channel_events.begin(), channel_events.end());
 
    num_events = channel_events.size();
+}
+
+int initAudio()
+{
+   SDL_AudioSpec desired;
+
+   memset(&desired, 0, sizeof(desired));
+
+   desired.freq = samplerate;
+   desired.format =  AUDIO_S16LSB;
+   desired.samples = 4096;
+   desired.callback = audioCallback;
+   desired.userdata = NULL;
+
+   if(SDL_OpenAudio(&desired, NULL))
+   {
+      log("SDL_OpenAudio failed.\n");
+      return -1;
+   }
+
+   for(int i = 0; i < noise_table_size; ++i)
+      noise_table[i] = double(rand()) / double(RAND_MAX) * 2.0 - 1.0;
+
+   if(channel_events.empty())
+      addTracks();
 
    SDL_PauseAudio(0);
 
    return 0;
 }
 
+// Writes the times at which notes start on the given channels, as a table like those in
+// Arps.hpp and Boops.hpp. Notes which start together on several channels are one event.
+int writeBeatTrack(const char* file_name, const char* table_name, int first_channel, int num_channels)
+{
+   if(channel_events.empty())
+      addTracks();
+
+   FILE* out = fopen(file_name, "w");
+
+   if(!out)
+   {
+      log("Couldn't open '%s' for writing.\n", file_name);
+      return -1;
+   }
+
+   fprintf(out, "const float %s[] = {\n", table_name);
+
+   double last_onset = -1.0;
+
+   for(int i = 0; i < num_events; ++i)
+   {
+      const ChannelEvent& e = channel_events[i];
+
+      if(e.channel < first_channel || e.channel >= first_channel + num_channels || e.amp == 0.0)
+         continue;
+
+      const double onset = e.time / double(samplerate);
+
+      if(last_onset >= 0.0 && (onset - last_onset) < 0.001)
+         continue;
+
+      fprintf(out, "%.3f,\n", onset);
+      last_onset = onset;
+   }
+
+   fprintf(out, "};\n\nconst int num_%s = sizeof(%s) / sizeof(%s[0]);\n", table_name, table_name, table_name);
+   fclose(out);
+
+   return 0;
+}
+
 void uninitAudio()
 {
    SDL_PauseAudio(1);
@@ -16,17 +16,20 @@ static const Vec2 g_letterPoints[] = {  Vec2(0.0f, 0.0f), Vec2(0.5f, 0.0f), Vec2
 
 static const int g_letterCount = sizeof(g_letters) / sizeof(g_letters[0]);
 
-static GLushort text_indices[1024*2];
-static GLfloat text_vertices[1024*2*3];
-static int num_text_indices=0, num_text_vertices=0;
+static const int g_numTexts = 4, g_numRows = 2;
+static const std::string g_texts[g_numTexts][g_numRows] = { {"", ""}, {"please", "accept"}, {"this", "invitation"}, {"for", ""} };
+
+static const Vec2 g_textSize = Vec2(1.5, -1.0), g_textStep = Vec2(2.0, -1.6);
+static const std::string g_museumText = "retro computer museum";
+static const Vec2 g_museumTextSize = Vec2(1.0, -1.0), g_museumTextStep = Vec2(1.3, -1.6);
 
 class TVScene: public Scene
 {
    float dilate;
 
    Shader screen_shader, gaussblur_shader, composite_shader;
-   Shader screen2_shader, screendisplay_shader, zoomblur_shader;
-   Shader particles_shader;
+   Shader screen2_shader, zoomblur_shader;
+   Shader particles_shader, wires_shader, echotext_shader;
 
    Spline<Real> cube_dist_spline, zoom_spline, tint_spline;
    Spline<Real> logo_disappear_spline;
@@ -43,19 +46,45 @@ class TVScene: public Scene
 
    GLuint rcm_logo_tex;
 
+   text::Font line_font;
+   text::Cache text_cache;
+   const text::Mesh* texts[g_numTexts][g_numRows];
+   const text::Mesh* museum_text;
+
+   // The display is drawn several times a tenth of a second apart, with the later echoes
+   // brighter. Each part of it is one instanced draw for all of the echoes, with the time offset
+   // and colour of each echo as instance attributes. There are two entries per echo, one for
+   // each of the grids, and the other draws use every other entry.
+   int num_echoes;
+   GLuint echo_vbo;
+
+   static const int grid_width = 8, grid_height = 8;
+   static const int logo_width = 128, logo_height = 128;
+
+   GLuint grid_vbo, grid_ebo, logo_vbo;
+   GLsizei num_grid_indices;
+
+   // whether the shaders, textures, font and splines have been set up, which free() leaves alone
+   bool set_up;
+
    void initializeTextures();
    void initializeShaders();
    void initializeBuffers();
+   void initializeText();
+   void cacheText();
+   void initializeEchoes();
 
    void gaussianBlur(GLuint srctex);
    void renderDisplay();
-   void renderDisplayWires(const float t, const Mat4& projection);
+   void renderDisplayEchoes();
 
    public:
-      TVScene()
+      TVScene(): line_font(GL_LINES), num_echoes(8), echo_vbo(0), grid_vbo(0), grid_ebo(0), logo_vbo(0), num_grid_indices(0), set_up(false)
       {
       }
 
+      void setEchoCount(int n);
+
       void initialize();
       void render();
       void update();
@@ -190,7 +219,8 @@ void TVScene::initializeShaders()
    composite_shader.uniform1i("tex0", 0);
    composite_shader.uniform1i("tex1", 1);
 
-   screendisplay_shader.load(SHADERS_PATH "lines_v.glsl", SHADERS_PATH "lines_g.glsl", SHADERS_PATH "lines_f.glsl");
+   wires_shader.load(SHADERS_PATH "wires_v.glsl", SHADERS_PATH "echo_lines_g.glsl", SHADERS_PATH "echo_lines_f.glsl");
+   echotext_shader.load(SHADERS_PATH "echotext_v.glsl", SHADERS_PATH "echo_lines_g.glsl", SHADERS_PATH "echo_lines_f.glsl");
 
    particles_shader.load(SHADERS_PATH "particles_v.glsl", SHADERS_PATH "particles_g.glsl", SHADERS_PATH "particles_f.glsl");
    particles_shader.uniform1i("logo_tex", 0);
@@ -200,6 +230,31 @@ void TVScene::initializeShaders()
    zoomblur_shader.uniform1i("noise_tex", 1);
 }
 
+void TVScene::initializeText()
+{
+   for(int i = 0; i < g_letterCount; ++i)
+   {
+      const char c = g_letters[i][0];
+
+      for(const char* l = g_letters[i] + 1; *l; l += 2)
+      {
+         line_font.addLine(c, g_letterPoints[l[0] - '0'], g_letterPoints[l[1] - '0']);
+
+         if(isalpha(c))
+            line_font.addLine(tolower(c), g_letterPoints[l[0] - '0'], g_letterPoints[l[1] - '0']);
+      }
+   }
+}
+
+void TVScene::cacheText()
+{
+   for(int line = 0; line < g_numTexts; ++line)
+      for(int row = 0; row < g_numRows; ++row)
+         texts[line][row] = text_cache.get(line_font, g_texts[line][row], g_textSize, g_textStep);
+
+   museum_text = text_cache.get(line_font, g_museumText, g_museumTextSize, g_museumTextStep);
+}
+
 void TVScene::initialize()
 {
    if(initialized)
@@ -207,33 +262,161 @@ void TVScene::initialize()
 
    initialized = true;
 
-   initializeShaders();
-   initializeTextures();
-   initializeBuffers();
-
-   cube_dist_spline.insert(-40, 0, 600);
-   cube_dist_spline.insert(-3, 0, 1000);
-   cube_dist_spline.insert(-3, 0, 2200);
-   cube_dist_spline.insert(-40, 0, 2600);
-   cube_dist_spline.initialize();
-
-   zoom_spline.insert(1, 0, 1000);
-   //zoom_spline.insert(50, 0, 4000);
-   zoom_spline.initialize();
-
-   logo_disappear_spline.insert(0, 0, 3000);
-   logo_disappear_spline.insert(1, 0, 3500);
-   logo_disappear_spline.initialize();
-
-   tint_spline.insert(0, 0, 0);
-   tint_spline.insert(1, 0, 400);
-   tint_spline.insert(1, 0, 4250);
-   tint_spline.insert(0, 0, 4400);
-   tint_spline.initialize();
+   if(!set_up)
+   {
+      set_up = true;
+
+      initializeShaders();
+      initializeTextures();
+      initializeBuffers();
+      initializeText();
+
+      cube_dist_spline.insert(-40, 0, 600);
+      cube_dist_spline.insert(-3, 0, 1000);
+      cube_dist_spline.insert(-3, 0, 2200);
+      cube_dist_spline.insert(-40, 0, 2600);
+      cube_dist_spline.initialize();
+
+      zoom_spline.insert(1, 0, 1000);
+      //zoom_spline.insert(50, 0, 4000);
+      zoom_spline.initialize();
+
+      logo_disappear_spline.insert(0, 0, 3000);
+      logo_disappear_spline.insert(1, 0, 3500);
+      logo_disappear_spline.initialize();
+
+      tint_spline.insert(0, 0, 0);
+      tint_spline.insert(1, 0, 400);
+      tint_spline.insert(1, 0, 4250);
+      tint_spline.insert(0, 0, 4400);
+      tint_spline.initialize();
+   }
+
+   // free() releases these, so they are made again each time the scene is initialized
+   cacheText();
+   initializeEchoes();
 }
 
 void TVScene::free()
 {
+   text_cache.clear();
+
+   glDeleteBuffers(1, &echo_vbo);
+   glDeleteBuffers(1, &grid_vbo);
+   glDeleteBuffers(1, &grid_ebo);
+   glDeleteBuffers(1, &logo_vbo);
+   echo_vbo = 0;
+   grid_vbo = 0;
+   grid_ebo = 0;
+   logo_vbo = 0;
+
+   initialized = false;
+}
+
+void TVScene::setEchoCount(int n)
+{
+   assert(n > 0);
+
+   num_echoes = n;
+
+   if(echo_vbo)
+      initializeEchoes();
+}
+
+void TVScene::initializeEchoes()
+{
+   std::vector<GLfloat> echoes;
+
+   for(int i = 0; i < num_echoes; ++i)
+      for(int g = 0; g < 2; ++g)
+      {
+         echoes.push_back(GLfloat(i) * 0.1f);
+         echoes.push_back(std::pow(GLfloat(0.25) + GLfloat(i) / GLfloat(num_echoes), 2.0f));
+         echoes.push_back(g);
+      }
+
+   if(!echo_vbo)
+      glGenBuffers(1, &echo_vbo);
+
+   glBindBuffer(GL_ARRAY_BUFFER, echo_vbo);
+   glBufferData(GL_ARRAY_BUFFER, echoes.size() * sizeof(GLfloat), &echoes[0], GL_STATIC_DRAW);
+
+   if(!grid_vbo)
+   {
+      GLfloat vertices[grid_width * grid_height * 2];
+      GLushort indices[grid_width * grid_height * 8];
+
+      num_grid_indices = 0;
+
+      for(int y=0;y<grid_height;++y)
+         for(int x=0;x<grid_width;++x)
+         {
+            int i=x+y*grid_width;
+            vertices[i*2+0]=x;
+            vertices[i*2+1]=y;
+
+            if(x < (grid_width-1))
+            {
+               indices[num_grid_indices++]=i;
+               indices[num_grid_indices++]=i+1;
+            }
+
+            if(y < (grid_height-1))
+            {
+               indices[num_grid_indices++]=i;
+               indices[num_grid_indices++]=i+grid_width;
+            }
+
+            if(x > 0)
+            {
+               indices[num_grid_indices++]=i;
+               indices[num_grid_indices++]=i-1;
+            }
+
+            if(y > 0)
+            {
+               indices[num_grid_indices++]=i;
+               indices[num_grid_indices++]=i-grid_width;
+            }
+         }
+
+      glGenBuffers(1, &grid_vbo);
+      glGenBuffers(1, &grid_ebo);
+
+      glBindBuffer(GL_ARRAY_BUFFER, grid_vbo);
+      glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid_ebo);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_grid_indices * sizeof(GLushort), indices, GL_STATIC_DRAW);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+   }
+
+   if(!logo_vbo)
+   {
+      const float aspect=815.0f/450.0f;
+      std::vector<GLfloat> vertices(logo_width * logo_height * 5);
+
+      for(int y=0;y<logo_height;++y)
+         for(int x=0;x<logo_width;++x)
+         {
+            const int vi=(x+y*logo_width)*5;
+
+            vertices[vi+0]=(x-logo_width*0.5)*aspect;
+            vertices[vi+1]=y-logo_height*0.5;
+            vertices[vi+2]=0;
+
+            vertices[vi+3]=float(x)/float(logo_width);
+            vertices[vi+4]=float(y)/float(logo_height);
+         }
+
+      glGenBuffers(1, &logo_vbo);
+      glBindBuffer(GL_ARRAY_BUFFER, logo_vbo);
+      glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), &vertices[0], GL_STATIC_DRAW);
+   }
+
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   CHECK_FOR_ERRORS;
 }
 
 void TVScene::gaussianBlur(GLuint srctex)
@@ -325,266 +508,79 @@ void TVScene::gaussianBlur(GLuint srctex)
    CHECK_FOR_ERRORS;
 }
 
-static void addTextLine(const Vec2& p0, const Vec2& p1)
+void TVScene::renderDisplayEchoes()
 {
-   text_indices[num_text_indices++]=num_text_vertices;
-   text_vertices[num_text_vertices*3+0]=p0.x;
-   text_vertices[num_text_vertices*3+1]=p0.y;
-   text_vertices[num_text_vertices*3+2]=0;
-   num_text_vertices++;
-
-   text_indices[num_text_indices++]=num_text_vertices;
-   text_vertices[num_text_vertices*3+0]=p1.x;
-   text_vertices[num_text_vertices*3+1]=p1.y;
-   text_vertices[num_text_vertices*3+2]=0;
-   num_text_vertices++;
-}
-
-static void addText(const char* str, Vec2 pos, const Vec2 step, const Vec2 size)
-{
-    const Real ox = pos.x;
-    for(; *str; ++str)
-    {
-        const char c = toupper(*str);
-
-        if(c == '\n')
-        {
-            pos.x = ox;
-            pos.y += step.y;
-            continue;
-        }
-
-        for(int i = 0; i < g_letterCount; ++i)
-        {
-            const char* l = g_letters[i];
-
-            if(l[0] == c)
-            {
-                ++l;
-
-                for(; *l; l += 2)
-                {
-                    addTextLine(pos + g_letterPoints[l[0] - '0'] * size,
-                            pos + g_letterPoints[l[1] - '0'] * size);
-                }
-                break;
-            }
-        }
+   const float last_echo_time = time + GLfloat(num_echoes - 1) * 0.1f;
+   const float last_arp = arp_track.previous(music_time);
 
-        pos.x += step.x;
-    }
-}
-
-
-void TVScene::renderDisplayWires(const float t, const Mat4& projection)
-{
-   screendisplay_shader.bind();
-
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+   glBlendFunc(GL_ONE, GL_ONE);
+   glEnable(GL_BLEND);
 
-    glBlendFunc(GL_ONE, GL_ONE);
-    glEnable(GL_BLEND);
+   glDisable(GL_DEPTH_TEST);
+   glDepthMask(GL_FALSE);
 
+   glEnableVertexAttribArray(3);
+   glVertexAttribDivisor(3, 1);
 
    // grid
-   for(int g=0;g<2;++g)
    {
-      Mat4 modelview = Mat4::identity();
-
-      const double dis = std::max(0.0f, t - 24) * 0.4;
-      const double c=cubic(clamp((t-7),0.0,1.0));
-
-      modelview = modelview * Mat4::translation(Vec3(0, 0, -20 - dis*80));
-
-      if(t > 24)
-         modelview = modelview * Mat4::rotation(t - 24, Vec3(1.0f, 0.0f, 0.0f));
-
-      modelview = modelview * Mat4::rotation(t * 0.33, Vec3(0.0f, 1.0f, 0.0f));
-
-      screendisplay_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
-      screendisplay_shader.uniform1f("brightness", (mix(20.0, 0.05, c) + dis) * (1.0 - clamp((t - 26), 0.0, 1.0)) );
-
-
-      float last_arp=0.0f;
-
-      for(int i=0;i<num_alk_arps;++i)
-      {
-         if(music_time > alk_arps[i])
-            last_arp=alk_arps[i];
-         else
-            break;
-      }
-
-      particles_shader.uniform1f("arp", 30.0f / (1.0f + (music_time - last_arp) * 5.0f));
-
-
-      float h=mix(90,4,c)*(1.0-g*2.0);
-      float hwobble = std::max(0.0f, 1.0f - (music_time - last_arp) * 0.9f);
-      float s=3;
-      int grid_width=8, grid_height=8;
-
-      GLushort indices[grid_width * grid_height * 8], num_indices = 0;
-      GLfloat vertices[grid_width * grid_height * 3];
-
-      for(int y=0;y<grid_height;++y)
-         for(int x=0;x<grid_width;++x)
-         {
-            int i=x+y*grid_width;
-            vertices[i*3+0]=(-(grid_width-1)*0.5f + x)*s;
-            vertices[i*3+1]=h + hwobble * cos(x+time*4*2) * sin(y+time*5.2*2);
-            vertices[i*3+2]=(-(grid_height-1)*0.5f + y)*s;
-
-            if(x < (grid_width-1))
-            {
-               indices[num_indices++]=i;
-               indices[num_indices++]=i+1;
-            }
-
-            if(y < (grid_height-1))
-            {
-               indices[num_indices++]=i;
-               indices[num_indices++]=i+grid_width;
-            }
-
-            if(x > 0)
-            {
-               indices[num_indices++]=i;
-               indices[num_indices++]=i-1;
-            }
-
-            if(y > 0)
-            {
-               indices[num_indices++]=i;
-               indices[num_indices++]=i-grid_width;
-            }
-         }
+      wires_shader.bind();
+      wires_shader.uniform1f("time", time);
+      wires_shader.uniform1f("wobble", std::max(0.0f, 1.0f - (music_time - last_arp) * 0.9f));
 
+      glBindBuffer(GL_ARRAY_BUFFER, echo_vbo);
+      glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 3, 0);
 
+      glBindBuffer(GL_ARRAY_BUFFER, grid_vbo);
       glEnableVertexAttribArray(0);
+      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, vertices);
-
-      glDisable(GL_DEPTH_TEST);
-      glDepthMask(GL_FALSE);
-
-      glDrawRangeElements(GL_LINES, 0, grid_width * grid_height, num_indices, GL_UNSIGNED_SHORT, indices);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid_ebo);
+      glDrawElementsInstanced(GL_LINES, num_grid_indices, GL_UNSIGNED_SHORT, 0, num_echoes * 2);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
       glDisableVertexAttribArray(0);
-
-/*
-      GLushort indices[(grid_width+1) * 2 + (grid_height+1) * 2];
-      GLfloat vertices[((grid_width+1) * 2 + (grid_height+1) * 2)*3];
-
-      for(int i=0;i<=grid_width;++i)
-      {
-         vertices[i*6+0]=(-grid_width*0.5f + i)*s;
-         vertices[i*6+1]=h;
-         vertices[i*6+2]=(-grid_height*0.5f)*s;
-
-         vertices[i*6+3]=(-grid_width*0.5f + i)*s;
-         vertices[i*6+4]=h;
-         vertices[i*6+5]=(+grid_height*0.5f)*s;
-
-         indices[i*2+0]=i*2+0;
-         indices[i*2+1]=i*2+1;
-      }
-      for(int i=0;i<=grid_height;++i)
-      {
-         vertices[(grid_width+1)*6+i*6+0]=(-grid_width*0.5f)*s;
-         vertices[(grid_width+1)*6+i*6+1]=h;
-         vertices[(grid_width+1)*6+i*6+2]=(-grid_height*0.5f + i)*s;
-
-         vertices[(grid_width+1)*6+i*6+3]=(+grid_width*0.5f)*s;
-         vertices[(grid_width+1)*6+i*6+4]=h;
-         vertices[(grid_width+1)*6+i*6+5]=(-grid_height*0.5f + i)*s;
-
-         indices[(grid_width+1)*2+i*2+0]=(grid_width+1+i)*2+0;
-         indices[(grid_width+1)*2+i*2+1]=(grid_width+1+i)*2+1;
-      }
-
-      glEnableVertexAttribArray(0);
-
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, vertices);
-
-      glDisable(GL_DEPTH_TEST);
-      glDepthMask(GL_FALSE);
-
-      glDrawRangeElements(GL_LINES, 0, (grid_width+1) * 2 + (grid_height+1) * 2, (grid_width+1) * 2 + (grid_height+1) * 2, GL_UNSIGNED_SHORT, indices);
-
-      glDisableVertexAttribArray(0);
-*/
    }
 
+   // the rest is drawn once per echo, so it takes every other entry
+   glBindBuffer(GL_ARRAY_BUFFER, echo_vbo);
+   glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 6, 0);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
    // text
    {
-      Real transit_t = 2.0, wait_t = 2.0;
-      Real t_per_line = transit_t * 2.0 + wait_t;
+      const Real transit_t = 2.0, wait_t = 2.0;
+      const Real t_per_line = transit_t * 2.0 + wait_t;
 
-      int line = int(floor(t / t_per_line));
-      Real tf = t - line * t_per_line;
-      Real x = cubic(1.0 - tf / transit_t);
+      echotext_shader.bind();
+      echotext_shader.uniform1f("time", time);
 
-      if(tf > (wait_t + transit_t))
-         x = cubic((tf - (wait_t + transit_t)) / transit_t) * -1;
-      else if(tf > transit_t)
-         x = 0;
+      // the shader hides the echoes which are showing another line
+      const int first_line = std::max(0, int(floor(time / t_per_line)));
+      const int last_line = std::min(g_numTexts - 1, int(floor(last_echo_time / t_per_line)));
 
-      static const int num_texts=4,num_rows=2;
-      static const std::string texts[num_texts][num_rows] = { {"", ""}, {"please", "accept"}, {"this", "invitation"}, {"for", ""} };
-
-      if(line < num_texts)
+      for(int line = first_line; line <= last_line; ++line)
       {
-         const Mat4 modelview = Mat4::translation(Vec3(0, sin(t*2.2)*0.2+0.5, -10+sin(t)*0.1));
-
-         screendisplay_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
-         screendisplay_shader.uniform1f("brightness", 1);
-
-         glDisable(GL_DEPTH_TEST);
-         glDepthMask(GL_FALSE);
-         glEnableVertexAttribArray(0);
-         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, text_vertices);
+         echotext_shader.uniform1i("line", line);
 
-         num_text_indices=0;
-         num_text_vertices=0;
-
-         for(int row=0;row<num_rows;++row)
+         for(int row=0;row<g_numRows;++row)
          {
-            const std::string& text = texts[line][row];
-            const Vec2 text_size = Vec2(1.5, -1.0), text_step = Vec2(2.0, -1.6);
+            const std::string& text = g_texts[line][row];
 
-            addText(text.c_str(), Vec2(x * 30 - text_step.x * 0.5 * text.size(), texts[line][1].empty() ? 0.0 : (-0.5 + row) * text_step.y ), text_step, text_size);
+            echotext_shader.uniform2f("row_offset", -g_textStep.x * 0.5 * text.size(), g_texts[line][1].empty() ? 0.0 : (-0.5 + row) * g_textStep.y);
+            texts[line][row]->draw(texts[line][row]->getCharCount(), num_echoes);
          }
-
-         glDrawRangeElements(GL_LINES, 0, num_text_vertices, num_text_indices, GL_UNSIGNED_SHORT, text_indices);
-         glDisableVertexAttribArray(0);
       }
 
 
       // TEXT UNDER THE LOGOO
       {
-         const Mat4 modelview = Mat4::translation(Vec3(0, -10, -22));
-
-         screendisplay_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
-         screendisplay_shader.uniform1f("brightness", std::min(1.0f, std::max(0.0f, (t - 27) * 0.3f)));
-
-         glDisable(GL_DEPTH_TEST);
-         glDepthMask(GL_FALSE);
-         glEnableVertexAttribArray(0);
-         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, text_vertices);
-
-         num_text_indices=0;
-         num_text_vertices=0;
+         const Mat4 modelview = Mat4::translation(Vec3(-g_museumTextStep.x * 0.5 * g_museumText.size(), -10, -22));
 
+         echotext_shader.uniform1i("line", -1);
+         echotext_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
 
-         const std::string& text = "retro computer museum";
-         const Vec2 text_size = Vec2(1.0, -1.0), text_step = Vec2(1.3, -1.6);
-
-         addText(text.c_str(), Vec2(-text_step.x * 0.5 * text.size(), 0.0), text_step, text_size);
-
-
-         glDrawRangeElements(GL_LINES, 0, num_text_vertices, num_text_indices, GL_UNSIGNED_SHORT, text_indices);
-         glDisableVertexAttribArray(0);
+         museum_text->draw(museum_text->getCharCount(), num_echoes);
       }
 
    }
@@ -594,61 +590,33 @@ void TVScene::renderDisplayWires(const float t, const Mat4& projection)
    particles_shader.uniform1f("logo_bias", 1);
    particles_shader.uniform1f("radius", 0.02 + 0.07 * logo_disappear_spline.evaluate(frame_num));
    particles_shader.uniform1f("disappear", logo_disappear_spline.evaluate(frame_num));
-   screen2_shader.uniform1f("disappear", cubic(1.0 - clamp(music_time / alk_boops[0], 0.0, 1.0)) * 0.2 + logo_disappear_spline.evaluate(frame_num));
+   screen2_shader.uniform1f("disappear", cubic(1.0 - clamp(music_time / boop_track.getTime(0), 0.0, 1.0)) * 0.2 + logo_disappear_spline.evaluate(frame_num));
    particles_shader.uniform1f("aspect_ratio", float(window_height) / float(window_width));
+   particles_shader.uniform1f("arp", 30.0f / (1.0f + (music_time - last_arp) * 5.0f));
 
    glActiveTexture(GL_TEXTURE0);
    glBindTexture(GL_TEXTURE_2D, rcm_logo_tex);
 
 
-   // logo
-   if(t > 26)
+   // logo, which the shader hides for the echoes before it appears
+   if(last_echo_time > 26)
    {
-      Mat4 modelview = Mat4::identity();
-
-      modelview = modelview * Mat4::translation(Vec3(0, 0, -320 - 1200 * (1.0 - cubic(clamp((t - 26) * 0.4, 0.0, 1.0))) )) * Mat4::scale(Vec3(2, 2, 2));
-      //modelview = modelview * Mat4::rotation(t, Vec3(1.0f, 0.0f, 0.0f));
-      // modelview = modelview * Mat4::rotation(t * 0.33, Vec3(0.0f, 1.0f, 0.0f));
-
-      particles_shader.uniformMatrix4fv("modelview", 1, GL_FALSE, modelview.e);
       particles_shader.uniform1f("brightness", 0.15);
 
-      glDisable(GL_DEPTH_TEST);
-      glDepthMask(GL_FALSE);
-
-      const float aspect=815.0f/450.0f;
-      const int w=128,h=128;
-
-      GLfloat vertices[w*h*3];
-      GLfloat coords[w*h*2];
-      GLushort indices[w*h];
-
-      for(int y=0;y<h;++y)
-         for(int x=0;x<w;++x)
-         {
-            const int vi=(x+y*w)*3;
-            const int ci=(x+y*w)*2;
-
-            vertices[vi+0]=(x-w*0.5)*aspect;
-            vertices[vi+1]=y-h*0.5;
-            vertices[vi+2]=0;
-
-            coords[ci+0]=float(x)/float(w);
-            coords[ci+1]=float(y)/float(h);
-
-            indices[x+y*w]=x+y*w;
-         }
+      glBindBuffer(GL_ARRAY_BUFFER, logo_vbo);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5, 0);
+      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 5, (const GLvoid*)(sizeof(GLfloat) * 3));
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, vertices);
-      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, coords);
       glEnableVertexAttribArray(0);
       glEnableVertexAttribArray(1);
-      glDrawRangeElements(GL_POINTS, 0, w*h, w*h, GL_UNSIGNED_SHORT, indices);
+      glDrawArraysInstanced(GL_POINTS, 0, logo_width * logo_height, num_echoes);
       glDisableVertexAttribArray(0);
       glDisableVertexAttribArray(1);
    }
 
-
+   glVertexAttribDivisor(3, 0);
+   glDisableVertexAttribArray(3);
 
    CHECK_FOR_ERRORS;
 }
@@ -664,9 +632,11 @@ void TVScene::renderDisplay()
 
    projection = Mat4::frustum(-1.0f, +1.0f, -aspect_ratio, +aspect_ratio, znear, zfar) * projection;
 
-   screendisplay_shader.uniform2f("radii", 0.01f+dilate*0.01f, 0.01f+dilate*0.01f);
+   wires_shader.uniform2f("radii", 0.01f+dilate*0.01f, 0.01f+dilate*0.01f);
+   echotext_shader.uniform2f("radii", 0.01f+dilate*0.01f, 0.01f+dilate*0.01f);
 
-   screendisplay_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
+   wires_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
+   echotext_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
    particles_shader.uniformMatrix4fv("projection", 1, GL_FALSE, projection.e);
 
    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, display_fbo);
@@ -680,13 +650,7 @@ void TVScene::renderDisplay()
 
    glClear(GL_COLOR_BUFFER_BIT);
 
-   for(int i = 0; i < 8; ++i)
-   {
-      GLfloat c = std::pow(GLfloat(0.25) + GLfloat(i) / GLfloat(8), 2.0);
-      screendisplay_shader.uniform4f("colour", c, c, c, c);
-      particles_shader.uniform4f("colour", c, c, c, c);
-      renderDisplayWires(time + GLfloat(i) * 0.1, projection);
-   }
+   renderDisplayEchoes();
 }
 
 
@@ -708,29 +672,19 @@ void TVScene::render()
 
 
    {
-      float last_boop=0.0f;
-      int j=0;
-      for(int i=0;i<num_alk_boops;++i)
-      {
-         if(music_time > alk_boops[i])
-         {
-            last_boop=alk_boops[i];
-            j=i;
-         }
-         else
-            break;
-      }
+      const int j=std::max(0, boop_track.find(music_time));
+      const float last_boop=boop_track.previous(music_time);
 
       float rate=1;
 
-      if(j < (num_alk_boops - 1) && (alk_boops[j+1]-alk_boops[j]) < 1)
+      if(j < (boop_track.getCount() - 1) && (boop_track.getTime(j+1)-boop_track.getTime(j)) < 1)
          rate=3;
 
       //dilate=2.1-2.0*std::min(1.0,fmod(time,2.0));//+cos(time*4);
       dilate=((last_boop > 0.0f) ? ((1.0 - std::min(1.0f, (music_time - last_boop) * rate * 0.6f)) * 2) : 0.0) + 0.1;
 
-      //if(music_time < alk_boops[0])
-        // dilate += music_time / alk_boops[0] * 0.3;
+      //if(music_time < boop_track.getTime(0))
+        // dilate += music_time / boop_track.getTime(0) * 0.3;
    }
 
 
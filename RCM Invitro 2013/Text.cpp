@@ -0,0 +1,186 @@
+#include "Engine.hpp"
+
+using namespace text;
+
+text::Font::Font(GLenum primitive, Real advance): primitive(primitive)
+{
+   for(int c = 0; c < 256; ++c)
+      glyphs[c].advance = advance;
+}
+
+void text::Font::addLine(unsigned char c, const Vec2& p0, const Vec2& p1)
+{
+   Glyph& g = glyphs[c];
+   const GLuint i0 = g.vertices.size() / 4;
+
+   const GLfloat vertices[] = { p0.x, p0.y, 0, 0,
+                                p1.x, p1.y, 0, 0 };
+
+   g.vertices.insert(g.vertices.end(), vertices, vertices + 8);
+   g.indices.push_back(i0);
+   g.indices.push_back(i0 + 1);
+}
+
+void text::Font::addQuad(unsigned char c, const Vec2& uv0, const Vec2& uv1)
+{
+   Glyph& g = glyphs[c];
+   const GLuint i0 = g.vertices.size() / 4;
+
+   const GLfloat vertices[] = { 0, 0, uv0.x, uv0.y,
+                                1, 0, uv1.x, uv0.y,
+                                0, 1, uv0.x, uv1.y,
+                                1, 1, uv1.x, uv1.y };
+
+   const GLuint indices[] = { i0, i0 + 1, i0 + 2,
+                              i0 + 1, i0 + 3, i0 + 2 };
+
+   g.vertices.insert(g.vertices.end(), vertices, vertices + 16);
+   g.indices.insert(g.indices.end(), indices, indices + 6);
+}
+
+void text::Mesh::build(const Font& font, const std::string& str, const Vec2& size, const Vec2& step)
+{
+   std::vector<GLfloat> vertices;
+   std::vector<GLuint> indices;
+
+   char_ends.resize(str.size());
+
+   Vec2 pos(0, 0);
+
+   for(size_t i = 0; i < str.size(); ++i)
+   {
+      const unsigned char c = str[i];
+
+      if(c == '\n')
+      {
+         pos.x = 0;
+         pos.y += step.y;
+         char_ends[i] = indices.size();
+         continue;
+      }
+
+      const Glyph& g = font.glyphs[c];
+      const GLuint i0 = vertices.size() / 4;
+
+      for(size_t j = 0; j < g.vertices.size(); j += 4)
+      {
+         vertices.push_back(pos.x + g.vertices[j + 0] * size.x);
+         vertices.push_back(pos.y + g.vertices[j + 1] * size.y);
+         vertices.push_back(g.vertices[j + 2]);
+         vertices.push_back(g.vertices[j + 3]);
+      }
+
+      for(size_t j = 0; j < g.indices.size(); ++j)
+         indices.push_back(i0 + g.indices[j]);
+
+      char_ends[i] = indices.size();
+      pos.x += g.advance * step.x;
+   }
+
+   if(!vbo)
+   {
+      glGenBuffers(1, &vbo);
+      glGenBuffers(1, &ebo);
+   }
+
+   primitive = font.primitive;
+   num_vertices = vertices.size() / 4;
+
+   glBindBuffer(GL_ARRAY_BUFFER, vbo);
+   glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+   glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+   CHECK_FOR_ERRORS;
+}
+
+void text::Mesh::free()
+{
+   glDeleteBuffers(1, &vbo);
+   glDeleteBuffers(1, &ebo);
+   vbo = 0;
+   ebo = 0;
+   num_vertices = 0;
+   char_ends.clear();
+}
+
+void text::Mesh::draw() const
+{
+   draw(getCharCount());
+}
+
+void text::Mesh::draw(int num_chars, int num_instances) const
+{
+   num_chars = std::min(num_chars, getCharCount());
+
+   if(num_chars <= 0 || num_instances <= 0 || char_ends[num_chars - 1] == 0)
+      return;
+
+   glBindBuffer(GL_ARRAY_BUFFER, vbo);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+   glEnableVertexAttribArray(0);
+   glEnableVertexAttribArray(1);
+
+   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4, 0);
+   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 4, (const GLvoid*)(sizeof(GLfloat) * 2));
+
+   if(num_instances > 1)
+      glDrawElementsInstanced(primitive, char_ends[num_chars - 1], GL_UNSIGNED_INT, 0, num_instances);
+   else
+      glDrawRangeElements(primitive, 0, num_vertices - 1, char_ends[num_chars - 1], GL_UNSIGNED_INT, 0);
+
+   glDisableVertexAttribArray(0);
+   glDisableVertexAttribArray(1);
+
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+   CHECK_FOR_ERRORS;
+}
+
+bool text::Cache::Key::operator<(const Key& k) const
+{
+   if(font != k.font)
+      return font < k.font;
+
+   if(size_x != k.size_x)
+      return size_x < k.size_x;
+
+   if(size_y != k.size_y)
+      return size_y < k.size_y;
+
+   if(step_x != k.step_x)
+      return step_x < k.step_x;
+
+   if(step_y != k.step_y)
+      return step_y < k.step_y;
+
+   return str < k.str;
+}
+
+const text::Mesh* text::Cache::get(const Font& font, const std::string& str, const Vec2& size, const Vec2& step)
+{
+   const Key key = { &font, str, size.x, size.y, step.x, step.y };
+
+   std::map<Key, Mesh>::iterator it = meshes.find(key);
+
+   if(it == meshes.end())
+   {
+      it = meshes.insert(std::make_pair(key, Mesh())).first;
+      it->second.build(font, str, size, step);
+   }
+
+   return &it->second;
+}
+
+void text::Cache::clear()
+{
+   for(std::map<Key, Mesh>::iterator it = meshes.begin(); it != meshes.end(); ++it)
+      it->second.free();
+
+   meshes.clear();
+}
@@ -0,0 +1,89 @@
+#include <map>
+#include <string>
+#include <vector>
+
+// Text drawn from vertex buffers which are laid out once per string.
+// A font is a table of glyphs indexed directly by character, so laying out a string is linear in
+// its length. The meshes start at the origin, and are moved and scaled by the modelview they
+// are drawn with, so text which doesn't change costs nothing on the CPU after it is laid out.
+
+namespace text
+{
+
+// Vertices are x, y, u, v with x and y in units of the text size. The advance is in units of
+// the text step.
+struct Glyph
+{
+   std::vector<GLfloat> vertices;
+   std::vector<GLuint> indices;
+   Real advance;
+
+   Glyph(): advance(1) { }
+};
+
+struct Font
+{
+   // GL_LINES or GL_TRIANGLES
+   GLenum primitive;
+   Glyph glyphs[256];
+
+   Font(GLenum primitive, Real advance = 1);
+
+   void addLine(unsigned char c, const Vec2& p0, const Vec2& p1);
+
+   // A unit quad showing the given rectangle of the font texture.
+   void addQuad(unsigned char c, const Vec2& uv0, const Vec2& uv1);
+
+   void setAdvance(unsigned char c, Real advance) { glyphs[c].advance = advance; }
+};
+
+// The geometry of one string, which goes to the next line at each '\n'.
+class Mesh
+{
+   public:
+      Mesh(): vbo(0), ebo(0), primitive(GL_TRIANGLES), num_vertices(0) { }
+
+      // May be called again to lay out other text into the same buffers.
+      void build(const Font& font, const std::string& str, const Vec2& size, const Vec2& step);
+      void free();
+
+      // Draws the first num_chars characters, or the whole string. The vertex positions and
+      // texture coordinates go to attributes 0 and 1. With more than one instance, the caller
+      // sets up the per-instance attributes.
+      void draw() const;
+      void draw(int num_chars, int num_instances = 1) const;
+
+      int getCharCount() const { return int(char_ends.size()); }
+
+   private:
+      GLuint vbo, ebo;
+      GLenum primitive;
+      GLuint num_vertices;
+
+      // the number of indices up to the end of each character
+      std::vector<GLuint> char_ends;
+};
+
+// Meshes looked up by their text and layout. A string is only laid out the first time it is
+// asked for, and its mesh is kept until clear(). The meshes don't move in memory, so the
+// pointers to static text can be held on to.
+class Cache
+{
+   public:
+      const Mesh* get(const Font& font, const std::string& str, const Vec2& size, const Vec2& step);
+      void clear();
+
+   private:
+      struct Key
+      {
+         const Font* font;
+         std::string str;
+         Real size_x, size_y, step_x, step_y;
+
+         bool operator<(const Key& k) const;
+      };
+
+      std::map<Key, Mesh> meshes;
+};
+
+}
@@ -14,6 +14,7 @@ extern FILE* g_logfile = NULL;
 
 extern int initAudio();
 extern void uninitAudio();
+extern int writeBeatTrack(const char* file_name, const char* table_name, int first_channel, int num_channels);
 
 
 
@@ -22,6 +23,10 @@ int main(int argc, char** argv)
    int scrw = 0, scrh = 0;
    int scrf = FULL;
 
+   // offline: loopsubdiv -beats <file> <table name> <first channel> <number of channels>
+   if(argc > 5 && !strcmp(argv[1], "-beats"))
+      return writeBeatTrack(argv[2], argv[3], atoi(argv[4]), atoi(argv[5]));
+
    if(argc > 1)
       scrw = atoi(argv[1]);
 
@@ -144,6 +149,8 @@ int main(int argc, char** argv)
 
    unsigned long manual_music_time_offset = 50;
 
+   uint num_frames = 0;
+
 /*
    {
       FILE* mmto_file = fopen("boop_time_offset.txt", "r");
@@ -227,6 +234,15 @@ int main(int argc, char** argv)
 
 
       SDL_GL_SwapBuffers();
+
+      Shader::endFrame();
+      ++num_frames;
+   }
+
+   if(num_frames > 0)
+   {
+      const Shader::Stats& stats = Shader::getTotalStats();
+      log("Uniform calls per frame: %.1f sent, %.1f skipped.\n", double(stats.sent) / num_frames, double(stats.skipped) / num_frames);
    }
 
    fclose(g_logfile);
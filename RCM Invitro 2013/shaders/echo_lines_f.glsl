@@ -0,0 +1,16 @@
+#version 330
+
+noperspective in vec3 lcoord;
+flat in float g2f_intensity;
+
+out vec4 output_colour;
+
+void main()
+{
+    float a = 1.0 - smoothstep(0.1, 0.2, length(lcoord.xy));
+
+    if(a < 0.1)
+        discard;
+
+    output_colour = a * g2f_intensity * vec4(0.7, 0.8, 1.0, 1.0) * (0.7 + 0.7 * pow(abs(lcoord.z), 32.0)) * 0.8;
+}
@@ -0,0 +1,56 @@
+#version 330
+
+uniform mat4 projection, modelview;
+uniform float time;
+
+// The line of the invitation which this text is, and where its row starts. The text under the
+// logo has a line of -1, and is placed by the modelview.
+uniform int line;
+uniform vec2 row_offset;
+
+in vec4 vertex;
+
+// Per echo: the time offset and the echo's colour.
+layout(location = 3) in vec3 echo;
+
+flat out float v2g_intensity;
+
+float cubic(float x)
+{
+    return (3.0 - 2.0 * x) * x * x;
+}
+
+void main()
+{
+    float t = time + echo.x;
+
+    if(line < 0)
+    {
+        v2g_intensity = echo.y * clamp((t - 27.0) * 0.3, 0.0, 1.0);
+        gl_Position = projection * modelview * vertex;
+        return;
+    }
+
+    const float transit_t = 2.0, wait_t = 2.0, t_per_line = transit_t * 2.0 + wait_t;
+
+    // echoes which are showing another line move this one outside of the clip volume
+    if(int(floor(t / t_per_line)) != line)
+    {
+        v2g_intensity = 0.0;
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    float tf = t - float(line) * t_per_line;
+    float x = cubic(1.0 - tf / transit_t);
+
+    if(tf > (wait_t + transit_t))
+        x = -cubic((tf - (wait_t + transit_t)) / transit_t);
+    else if(tf > transit_t)
+        x = 0.0;
+
+    vec3 pos = vertex.xyz + vec3(x * 30.0 + row_offset.x, row_offset.y + sin(t * 2.2) * 0.2 + 0.5, -10.0 + sin(t) * 0.1);
+
+    v2g_intensity = echo.y;
+    gl_Position = projection * vec4(pos, 1.0);
+}
@@ -1,6 +1,5 @@
 #version 330
 
-uniform vec4 colour;
 uniform float brightness;
 uniform float disappear;
 
@@ -11,6 +10,7 @@ in GeometryOut
 {
     noperspective vec2 tc;
     noperspective vec2 coord;
+    flat float intensity;
 
 } g_out;
 
@@ -23,5 +23,5 @@ void main()
     if(a < 0.1)
         discard;
     
-    output_colour = a * colour * vec4(0.7, 0.8, 1.0, 1.0) * brightness * mix(1.0, texture2D(logo_tex, g_out.tc).r, logo_bias) * pow(1.0 - disappear, 3.0);
+    output_colour = a * g_out.intensity * vec4(0.7, 0.8, 1.0, 1.0) * brightness * mix(1.0, texture2D(logo_tex, g_out.tc).r, logo_bias) * pow(1.0 - disappear, 3.0);
 }
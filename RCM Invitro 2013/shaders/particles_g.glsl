@@ -9,6 +9,7 @@ uniform float aspect_ratio;
 in VertexOut
 {
     noperspective vec2 tc;
+    flat float intensity;
     
 } v_out[];
 
@@ -16,6 +17,7 @@ out GeometryOut
 {
     noperspective vec2 tc;
     noperspective vec2 coord;
+    flat float intensity;
     
 } g_out;
 
@@ -24,6 +26,7 @@ void emit(vec2 p, vec2 c)
 {
     g_out.coord = c;
     g_out.tc = v_out[0].tc;
+    g_out.intensity = v_out[0].intensity;
     gl_Position.xy = p;
     gl_Position.zw = vec2(0.0, 1.0);
     EmitVertex();
@@ -1,6 +1,6 @@
 #version 330
 
-uniform mat4 projection, modelview;
+uniform mat4 projection;
 uniform float disappear;
 uniform float time;
 uniform float arp;
@@ -8,16 +8,37 @@ uniform float arp;
 in vec4 vertex;
 in vec2 coord;
 
+// Per echo: the time offset and the echo's colour.
+layout(location = 3) in vec3 echo;
+
 out VertexOut
 {
     noperspective vec2 tc;
+    flat float intensity;
     
 } v_out;
 
+float cubic(float x)
+{
+    return (3.0 - 2.0 * x) * x * x;
+}
+
 void main()
 {
+    float t = time + echo.x;
+
+    // the logo appears after 26 seconds, before which it is moved outside of the clip volume
+    if(t <= 26.0)
+    {
+        v_out.tc = coord;
+        v_out.intensity = 0.0;
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
     v_out.tc = coord;
-    vec4 vpos = modelview * vertex;
+    v_out.intensity = echo.y;
+    vec4 vpos = vec4(vertex.xyz * 2.0 + vec3(0.0, 0.0, -320.0 - 1200.0 * (1.0 - cubic(clamp((t - 26.0) * 0.4, 0.0, 1.0)))), 1.0);
     
     //vpos.xyz += (-sin(vpos.zyx*0.07)*30.0 + sin(vpos.zxy*0.1)*40.0)*8.0*pow(disappear, 4.0)*vec3(4.0,1.0,1.0);
     vpos.xy += (cos(vpos.yx * 0.03) * 1000.0 + vpos.xy * pow(length(vpos.xy), 2.0) * 0.001) * pow(disappear, 4.0);
@@ -0,0 +1,52 @@
+#version 330
+
+uniform mat4 projection;
+uniform float time, fall, rfall, approach;
+
+in vec4 vertex;
+in vec3 normal;
+in vec2 coord;
+
+// Per sprite: the base position, then the sprite index reduced to [0, 2pi) for each of the
+// phases which it drives.
+layout(location = 3) in vec4 sprite_base;
+layout(location = 4) in vec2 sprite_phase;
+
+out vec3 v2f_v /* view vector */, v2f_n /* normal */, v2f_l1, v2f_l2, v2f_l3;
+out vec3 v2f_o; // vertex in object space
+out vec2 v2f_coord;
+
+noperspective out vec2 v2f_screen;
+noperspective out vec2 v2f_zw;
+
+void main()
+{
+    vec3 pos = vec3(sprite_base.x + sin(time * 0.1 + sprite_base.w) * 0.06,
+                    sprite_base.y + cos(time * 0.1 + sprite_base.w) * 0.3,
+                    sprite_base.z + 2.0 - approach) * 10.0;
+
+    pos.y -= fall;
+
+    float ax = cos(sprite_phase.x + time * 0.3 * rfall * 0.4);
+    float ay = sin(sprite_phase.y + time * 0.2 * rfall * 0.5);
+
+    mat3 rx = mat3(1.0, 0.0, 0.0, 0.0, cos(ax), sin(ax), 0.0, -sin(ax), cos(ax));
+    mat3 ry = mat3(cos(ay), 0.0, -sin(ay), 0.0, 1.0, 0.0, sin(ay), 0.0, cos(ay));
+    mat3 rot = rx * ry * 0.6;
+
+    mat4 modelview = mat4(vec4(rot[0], 0.0), vec4(rot[1], 0.0), vec4(rot[2], 0.0), vec4(pos + vec3(0.0, 0.0, -2.6 * 1.2 * 10.0), 1.0));
+
+    v2f_coord = coord;
+
+    v2f_o = vertex.xyz;
+    v2f_v = (modelview * vertex).xyz;
+    v2f_n = mat3(modelview) * normal;
+
+    v2f_l1 = (mat3(modelview)) * normalize(vec3(1.0, -0.01, 1.0)); // lights
+    v2f_l2 = (mat3(modelview)) * normalize(vec3(1.0, -0.01, 0.1));
+    v2f_l3 = (mat3(modelview)) * normalize(vec3(0.0, -1.0, -0.1));
+
+    gl_Position = projection * vec4(v2f_v, 1.0);
+    v2f_zw = gl_Position.zw;
+    v2f_screen = gl_Position.xy / gl_Position.w;
+}
@@ -0,0 +1,40 @@
+#version 330
+
+uniform mat4 projection;
+uniform float time, wobble;
+
+// grid cell
+in vec2 vertex;
+
+// Per echo and grid: the time offset, the echo's colour and which of the two grids it is.
+layout(location = 3) in vec3 echo;
+
+flat out float v2g_intensity;
+
+float cubic(float x)
+{
+    return (3.0 - 2.0 * x) * x * x;
+}
+
+void main()
+{
+    float t = time + echo.x;
+
+    float dis = max(0.0, t - 24.0) * 0.4;
+    float c = cubic(clamp(t - 7.0, 0.0, 1.0));
+    float h = mix(90.0, 4.0, c) * (1.0 - echo.z * 2.0);
+
+    vec3 pos = vec3((vertex.x - 3.5) * 3.0,
+                    h + wobble * cos(vertex.x + time * 8.0) * sin(vertex.y + time * 10.4),
+                    (vertex.y - 3.5) * 3.0);
+
+    float ay = t * 0.33, ax = max(0.0, t - 24.0);
+
+    mat3 ry = mat3(cos(ay), 0.0, -sin(ay), 0.0, 1.0, 0.0, sin(ay), 0.0, cos(ay));
+    mat3 rx = mat3(1.0, 0.0, 0.0, 0.0, cos(ax), sin(ax), 0.0, -sin(ax), cos(ax));
+
+    pos = rx * (ry * pos) + vec3(0.0, 0.0, -20.0 - dis * 80.0);
+
+    v2g_intensity = echo.y * (mix(20.0, 0.05, c) + dis) * (1.0 - clamp(t - 26.0, 0.0, 1.0));
+    gl_Position = projection * vec4(pos, 1.0);
+}